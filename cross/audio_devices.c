@@ -4,6 +4,25 @@
 #include <string.h>
 #include "audio_devices.h"
 
+// Pair playback and capture endpoints that belong to the same hardware.
+// Each endpoint is linked at most once, to the first unlinked match.
+static void link_duplex_endpoints(AudioDevice* devices, int count,
+                                  bool (*same_hardware)(const AudioDevice*, const AudioDevice*)) {
+    for (int i = 0; i < count; i++) {
+        if (devices[i].direction != DEVICE_DIRECTION_PLAYBACK || devices[i].is_duplex) continue;
+        for (int j = 0; j < count; j++) {
+            if (devices[j].direction != DEVICE_DIRECTION_CAPTURE || devices[j].is_duplex) continue;
+            if (!same_hardware(&devices[i], &devices[j])) continue;
+            
+            devices[i].is_duplex = true;
+            devices[j].is_duplex = true;
+            strcpy(devices[i].duplex_peer_id, devices[j].id);
+            strcpy(devices[j].duplex_peer_id, devices[i].id);
+            break;
+        }
+    }
+}
+
 #ifdef _WIN32
 #include <windows.h>
 #include <mmdeviceapi.h>
@@ -13,202 +32,257 @@
 #include <ctype.h>
 
 // Windows implementation
-int list_audio_output_devices(AudioDevice** devices) {
+
+// Append the active endpoints of one data flow to *devices after the
+// first `first` entries. The buffer (of *capacity entries) is reused across
+// calls and only grown when needed. Returns the new total.
+static int wasapi_enumerate(IMMDeviceEnumerator* pEnumerator, EDataFlow flow,
+                            AudioDevice** devices, int* capacity, int first) {
     HRESULT hr;
-    IMMDeviceEnumerator* pEnumerator = NULL;
     IMMDeviceCollection* pCollection = NULL;
     IMMDevice* pDefaultDevice = NULL;
     LPWSTR defaultDeviceId = NULL;
+    int device_count = first;
     
-    *devices = NULL;
-    int device_count = 0;
-    
-    // Initialize COM
-    hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-    if (FAILED(hr)) return 0;
+    // Get default device
+    hr = pEnumerator->lpVtbl->GetDefaultAudioEndpoint(
+        pEnumerator, flow, eConsole, &pDefaultDevice
+    );
+    if (SUCCEEDED(hr)) {
+        pDefaultDevice->lpVtbl->GetId(pDefaultDevice, &defaultDeviceId);
+    }
     
-    // Create device enumerator
-    hr = CoCreateInstance(
-        &CLSID_MMDeviceEnumerator, NULL,
-        CLSCTX_ALL, &IID_IMMDeviceEnumerator,
-        (void**)&pEnumerator
+    // Get all active audio endpoints
+    hr = pEnumerator->lpVtbl->EnumAudioEndpoints(
+        pEnumerator, flow, DEVICE_STATE_ACTIVE, &pCollection
     );
     
     if (SUCCEEDED(hr)) {
-        // Get default device
-        hr = pEnumerator->lpVtbl->GetDefaultAudioEndpoint(
-            pEnumerator, eRender, eConsole, &pDefaultDevice
-        );
-        if (SUCCEEDED(hr)) {
-            pDefaultDevice->lpVtbl->GetId(pDefaultDevice, &defaultDeviceId);
-        }
+        UINT count;
+        pCollection->lpVtbl->GetCount(pCollection, &count);
         
-        // Get all active audio endpoints
-        hr = pEnumerator->lpVtbl->EnumAudioEndpoints(
-            pEnumerator, eRender, DEVICE_STATE_ACTIVE, &pCollection
-        );
-        
-        if (SUCCEEDED(hr)) {
-            UINT count;
-            pCollection->lpVtbl->GetCount(pCollection, &count);
-            
-            // Allocate memory for devices
-            *devices = (AudioDevice*)calloc(count + 1, sizeof(AudioDevice));
-            if (*devices == NULL) {
+        // Grow the device buffer only when the endpoint count exceeds it
+        if (first + (int)count + 1 > *capacity) {
+            AudioDevice* grown = (AudioDevice*)realloc(*devices, (first + count + 1) * sizeof(AudioDevice));
+            if (grown == NULL) {
                 pCollection->lpVtbl->Release(pCollection);
-                pEnumerator->lpVtbl->Release(pEnumerator);
-                CoUninitialize();
-                return 0;
+                if (pDefaultDevice) pDefaultDevice->lpVtbl->Release(pDefaultDevice);
+                if (defaultDeviceId) CoTaskMemFree(defaultDeviceId);
+                return first;
             }
+            *devices = grown;
+            *capacity = first + (int)count + 1;
+        }
+        memset(*devices + first, 0, (count + 1) * sizeof(AudioDevice));
+        
+        // Enumerate devices
+        for (UINT i = 0; i < count; i++) {
+            IMMDevice* pDevice = NULL;
+            hr = pCollection->lpVtbl->Item(pCollection, i, &pDevice);
             
-            // Enumerate devices
-            for (UINT i = 0; i < count; i++) {
-                IMMDevice* pDevice = NULL;
-                hr = pCollection->lpVtbl->Item(pCollection, i, &pDevice);
+            if (SUCCEEDED(hr)) {
+                IPropertyStore* pProps = NULL;
+                LPWSTR deviceId = NULL;
+                
+                // Get device ID
+                pDevice->lpVtbl->GetId(pDevice, &deviceId);
+                
+                // Open property store
+                hr = pDevice->lpVtbl->OpenPropertyStore(
+                    pDevice, STGM_READ, &pProps
+                );
                 
                 if (SUCCEEDED(hr)) {
-                    IPropertyStore* pProps = NULL;
-                    LPWSTR deviceId = NULL;
+                    PROPVARIANT varName, varType, varAdapter;
+                    PropVariantInit(&varName);
+                    PropVariantInit(&varType);
+                    PropVariantInit(&varAdapter);
                     
-                    // Get device ID
-                    pDevice->lpVtbl->GetId(pDevice, &deviceId);
+                    (*devices)[device_count].direction =
+                        flow == eCapture ? DEVICE_DIRECTION_CAPTURE : DEVICE_DIRECTION_PLAYBACK;
                     
-                    // Open property store
-                    hr = pDevice->lpVtbl->OpenPropertyStore(
-                        pDevice, STGM_READ, &pProps
+                    // Get device friendly name
+                    hr = pProps->lpVtbl->GetValue(
+                        pProps, &PKEY_Device_FriendlyName, &varName
                     );
-                    
                     if (SUCCEEDED(hr)) {
-                        PROPVARIANT varName, varType;
-                        PropVariantInit(&varName);
-                        PropVariantInit(&varType);
-                        
-                        // Get device friendly name
-                        hr = pProps->lpVtbl->GetValue(
-                            pProps, &PKEY_Device_FriendlyName, &varName
-                        );
-                        if (SUCCEEDED(hr)) {
-                            WideCharToMultiByte(CP_UTF8, 0, varName.pwszVal, -1,
-                                (*devices)[device_count].name, 256, NULL, NULL);
-                        }
-                        
-                        // Get device ID
-                        if (deviceId) {
-                            WideCharToMultiByte(CP_UTF8, 0, deviceId, -1,
-                                (*devices)[device_count].id, 256, NULL, NULL);
-                                
-                            // Check if default device
-                            if (defaultDeviceId && wcscmp(deviceId, defaultDeviceId) == 0) {
-                                (*devices)[device_count].is_default = true;
-                            }
+                        WideCharToMultiByte(CP_UTF8, 0, varName.pwszVal, -1,
+                            (*devices)[device_count].name, 256, NULL, NULL);
+                    }
+                    
+                    // Get the adapter name, shared by all endpoints of one card
+                    hr = pProps->lpVtbl->GetValue(
+                        pProps, &PKEY_DeviceInterface_FriendlyName, &varAdapter
+                    );
+                    if (SUCCEEDED(hr) && varAdapter.vt == VT_LPWSTR) {
+                        WideCharToMultiByte(CP_UTF8, 0, varAdapter.pwszVal, -1,
+                            (*devices)[device_count].model, 256, NULL, NULL);
+                    }
+                    
+                    // Get device ID
+                    if (deviceId) {
+                        WideCharToMultiByte(CP_UTF8, 0, deviceId, -1,
+                            (*devices)[device_count].id, 256, NULL, NULL);
+                            
+                        // Check if default device
+                        if (defaultDeviceId && wcscmp(deviceId, defaultDeviceId) == 0) {
+                            (*devices)[device_count].is_default = true;
                         }
-                        
-                        // Get form factor
-                        hr = pProps->lpVtbl->GetValue(
-                            pProps, &PKEY_AudioEndpoint_FormFactor, &varType
-                        );
-                        if (SUCCEEDED(hr)) {
-                            switch (varType.uintVal) {
-                                case 0: // RemoteSpeakers
-                                    (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
-                                    (*devices)[device_count].connection = CONNECTION_WIRELESS;
-                                    break;
-                                case 1: // Speakers
-                                    (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
-                                    (*devices)[device_count].connection = CONNECTION_BUILTIN;
-                                    break;
-                                case 2: // LineLevel
-                                    (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 3: // Headphones
-                                    (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 4: // Microphone
-                                    (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 5: // Headset
-                                    (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 6: // Handset
-                                    (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 7: // UnknownDigitalPassthrough
-                                    (*devices)[device_count].type = DEVICE_TYPE_UNKNOWN;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 8: // SPDIF
-                                    (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 9: // DigitalAudioDisplayDevice/HDMI
-                                    (*devices)[device_count].type = DEVICE_TYPE_HDMI;
-                                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                                    break;
-                                case 10: // UnknownFormFactor
-                                default:
-                                    (*devices)[device_count].type = DEVICE_TYPE_UNKNOWN;
-                                    (*devices)[device_count].connection = CONNECTION_UNKNOWN;
-                            }
+                    }
+                    
+                    // Get form factor
+                    hr = pProps->lpVtbl->GetValue(
+                        pProps, &PKEY_AudioEndpoint_FormFactor, &varType
+                    );
+                    if (SUCCEEDED(hr)) {
+                        switch (varType.uintVal) {
+                            case 0: // RemoteSpeakers
+                                (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
+                                (*devices)[device_count].connection = CONNECTION_WIRELESS;
+                                break;
+                            case 1: // Speakers
+                                (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
+                                (*devices)[device_count].connection = CONNECTION_BUILTIN;
+                                break;
+                            case 2: // LineLevel
+                                (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 3: // Headphones
+                                (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 4: // Microphone
+                                (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 5: // Headset
+                                (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 6: // Handset
+                                (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 7: // UnknownDigitalPassthrough
+                                (*devices)[device_count].type = DEVICE_TYPE_UNKNOWN;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 8: // SPDIF
+                                (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 9: // DigitalAudioDisplayDevice/HDMI
+                                (*devices)[device_count].type = DEVICE_TYPE_HDMI;
+                                (*devices)[device_count].connection = CONNECTION_WIRED;
+                                break;
+                            case 10: // UnknownFormFactor
+                            default:
+                                (*devices)[device_count].type = DEVICE_TYPE_UNKNOWN;
+                                (*devices)[device_count].connection = CONNECTION_UNKNOWN;
                         }
-                        
-                        // Check device name for additional hints (convert to lowercase for comparison)
-                        char name_lower[256];
-                        strcpy(name_lower, (*devices)[device_count].name);
-                        for (int j = 0; name_lower[j]; j++) {
-                            name_lower[j] = tolower(name_lower[j]);
+                    }
+                    
+                    // Check device name for additional hints (convert to lowercase for comparison)
+                    char name_lower[256];
+                    strcpy(name_lower, (*devices)[device_count].name);
+                    for (int j = 0; name_lower[j]; j++) {
+                        name_lower[j] = tolower(name_lower[j]);
+                    }
+                    
+                    // Check for headphone/headset keywords in device name
+                    if (strstr(name_lower, "headphone") != NULL || 
+                        strstr(name_lower, "headset") != NULL ||
+                        strstr(name_lower, "earphone") != NULL ||
+                        strstr(name_lower, "earbuds") != NULL) {
+                        (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
+                        // Keep existing connection type unless it's unknown
+                        if ((*devices)[device_count].connection == CONNECTION_UNKNOWN) {
+                            (*devices)[device_count].connection = CONNECTION_WIRED;
                         }
-                        
-                        // Check for headphone/headset keywords in device name
+                    }
+                    
+                    // Check for Bluetooth or USB in device ID or name
+                    if (strstr((*devices)[device_count].id, "BTHENUM") != NULL ||
+                        strstr(name_lower, "bluetooth") != NULL ||
+                        strstr(name_lower, "airpods") != NULL) {
+                        (*devices)[device_count].type = DEVICE_TYPE_BLUETOOTH;
+                        (*devices)[device_count].connection = CONNECTION_WIRELESS;
+                    } else if (strstr((*devices)[device_count].id, "USB") != NULL ||
+                               strstr(name_lower, "usb") != NULL) {
+                        // USB devices could be headphones, check name
                         if (strstr(name_lower, "headphone") != NULL || 
-                            strstr(name_lower, "headset") != NULL ||
-                            strstr(name_lower, "earphone") != NULL ||
-                            strstr(name_lower, "earbuds") != NULL) {
+                            strstr(name_lower, "headset") != NULL) {
                             (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
-                            // Keep existing connection type unless it's unknown
-                            if ((*devices)[device_count].connection == CONNECTION_UNKNOWN) {
-                                (*devices)[device_count].connection = CONNECTION_WIRED;
-                            }
+                        } else {
+                            (*devices)[device_count].type = DEVICE_TYPE_USB;
                         }
-                        
-                        // Check for Bluetooth or USB in device ID or name
-                        if (strstr((*devices)[device_count].id, "BTHENUM") != NULL ||
-                            strstr(name_lower, "bluetooth") != NULL ||
-                            strstr(name_lower, "airpods") != NULL) {
-                            (*devices)[device_count].type = DEVICE_TYPE_BLUETOOTH;
-                            (*devices)[device_count].connection = CONNECTION_WIRELESS;
-                        } else if (strstr((*devices)[device_count].id, "USB") != NULL ||
-                                   strstr(name_lower, "usb") != NULL) {
-                            // USB devices could be headphones, check name
-                            if (strstr(name_lower, "headphone") != NULL || 
-                                strstr(name_lower, "headset") != NULL) {
-                                (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
-                            } else {
-                                (*devices)[device_count].type = DEVICE_TYPE_USB;
-                            }
-                            (*devices)[device_count].connection = CONNECTION_WIRED;
-                        }
-                        
-                        PropVariantClear(&varName);
-                        PropVariantClear(&varType);
-                        pProps->lpVtbl->Release(pProps);
-                        device_count++;
+                        (*devices)[device_count].connection = CONNECTION_WIRED;
                     }
                     
-                    if (deviceId) CoTaskMemFree(deviceId);
-                    pDevice->lpVtbl->Release(pDevice);
+                    PropVariantClear(&varName);
+                    PropVariantClear(&varType);
+                    PropVariantClear(&varAdapter);
+                    pProps->lpVtbl->Release(pProps);
+                    device_count++;
                 }
+                
+                if (deviceId) CoTaskMemFree(deviceId);
+                pDevice->lpVtbl->Release(pDevice);
             }
-            
-            pCollection->lpVtbl->Release(pCollection);
         }
         
-        if (pDefaultDevice) pDefaultDevice->lpVtbl->Release(pDefaultDevice);
-        if (defaultDeviceId) CoTaskMemFree(defaultDeviceId);
+        pCollection->lpVtbl->Release(pCollection);
+    }
+    
+    if (pDefaultDevice) pDefaultDevice->lpVtbl->Release(pDefaultDevice);
+    if (defaultDeviceId) CoTaskMemFree(defaultDeviceId);
+    
+    return device_count;
+}
+
+// Render and capture endpoints of one card report the same adapter
+static bool wasapi_same_adapter(const AudioDevice* playback, const AudioDevice* capture) {
+    return playback->model[0] != '\0' && strcmp(playback->model, capture->model) == 0;
+}
+
+static int wasapi_enumerate_all(IMMDeviceEnumerator* pEnumerator, AudioDeviceDirection direction,
+                                AudioDevice** devices, int* capacity) {
+    int device_count = 0;
+    
+    if (direction & DEVICE_DIRECTION_PLAYBACK) {
+        device_count = wasapi_enumerate(pEnumerator, eRender, devices, capacity, device_count);
+    }
+    if (direction & DEVICE_DIRECTION_CAPTURE) {
+        device_count = wasapi_enumerate(pEnumerator, eCapture, devices, capacity, device_count);
+    }
+    if (device_count > 0) {
+        link_duplex_endpoints(*devices, device_count, wasapi_same_adapter);
+    }
+    return device_count;
+}
+
+int list_audio_devices(AudioDevice** devices, AudioDeviceDirection direction) {
+    HRESULT hr;
+    IMMDeviceEnumerator* pEnumerator = NULL;
+    int capacity = 0;
+    
+    *devices = NULL;
+    int device_count = 0;
+    
+    // Initialize COM
+    hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+    if (FAILED(hr)) return 0;
+    
+    // Create device enumerator
+    hr = CoCreateInstance(
+        &CLSID_MMDeviceEnumerator, NULL,
+        CLSCTX_ALL, &IID_IMMDeviceEnumerator,
+        (void**)&pEnumerator
+    );
+    
+    if (SUCCEEDED(hr)) {
+        device_count = wasapi_enumerate_all(pEnumerator, direction, devices, &capacity);
         pEnumerator->lpVtbl->Release(pEnumerator);
     }
     
@@ -216,12 +290,80 @@ int list_audio_output_devices(AudioDevice** devices) {
     return device_count;
 }
 
+struct audio_ctx {
+    CRITICAL_SECTION lock;
+    bool com_initialized;
+    IMMDeviceEnumerator* pEnumerator;
+    AudioDevice* scratch;
+    int scratch_capacity;
+};
+
+audio_ctx_t* audio_ctx_create(void) {
+    HRESULT hr;
+    audio_ctx_t* ctx = (audio_ctx_t*)calloc(1, sizeof(audio_ctx_t));
+    if (ctx == NULL) return NULL;
+    
+    // Join the multithreaded apartment once so the cached enumerator can be
+    // used from any thread. A thread that already chose STA keeps it.
+    hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    ctx->com_initialized = SUCCEEDED(hr);
+    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
+        free(ctx);
+        return NULL;
+    }
+    
+    hr = CoCreateInstance(
+        &CLSID_MMDeviceEnumerator, NULL,
+        CLSCTX_ALL, &IID_IMMDeviceEnumerator,
+        (void**)&ctx->pEnumerator
+    );
+    if (FAILED(hr)) {
+        if (ctx->com_initialized) CoUninitialize();
+        free(ctx);
+        return NULL;
+    }
+    
+    InitializeCriticalSection(&ctx->lock);
+    return ctx;
+}
+
+int audio_ctx_list_devices(audio_ctx_t* ctx, AudioDeviceDirection direction,
+                           AudioDevice* devices, int max_devices) {
+    if (ctx == NULL || devices == NULL || max_devices < 0) return 0;
+    
+    EnterCriticalSection(&ctx->lock);
+    int count = wasapi_enumerate_all(ctx->pEnumerator, direction, &ctx->scratch, &ctx->scratch_capacity);
+    int copied = count < max_devices ? count : max_devices;
+    if (copied > 0) {
+        memcpy(devices, ctx->scratch, (size_t)copied * sizeof(AudioDevice));
+    }
+    LeaveCriticalSection(&ctx->lock);
+    return count;
+}
+
+void audio_ctx_destroy(audio_ctx_t* ctx) {
+    if (ctx == NULL) return;
+    
+    ctx->pEnumerator->lpVtbl->Release(ctx->pEnumerator);
+    if (ctx->com_initialized) CoUninitialize();
+    DeleteCriticalSection(&ctx->lock);
+    free(ctx->scratch);
+    free(ctx);
+}
+
 #elif defined(__APPLE__)
 #include <CoreAudio/CoreAudio.h>
 #include <CoreFoundation/CoreFoundation.h>
+#include <pthread.h>
 
 // macOS implementation
-int list_audio_output_devices(AudioDevice** devices) {
+
+// Both endpoints of a CoreAudio device are the same AudioObject
+static bool coreaudio_same_device(const AudioDevice* playback, const AudioDevice* capture) {
+    return playback->device_id_numeric == capture->device_id_numeric;
+}
+
+int list_audio_devices(AudioDevice** devices, AudioDeviceDirection direction) {
     AudioObjectPropertyAddress propertyAddress = {
         kAudioHardwarePropertyDevices,
         kAudioObjectPropertyScopeGlobal,
@@ -267,17 +409,35 @@ int list_audio_output_devices(AudioDevice** devices) {
         &defaultDevice
     );
     
-    // Allocate memory for devices
-    *devices = (AudioDevice*)calloc(numDevices + 1, sizeof(AudioDevice));
+    AudioDeviceID defaultInputDevice = 0;
+    propertyAddress.mSelector = kAudioHardwarePropertyDefaultInputDevice;
+    dataSize = sizeof(AudioDeviceID);
+    AudioObjectGetPropertyData(
+        kAudioObjectSystemObject,
+        &propertyAddress,
+        0, NULL,
+        &dataSize,
+        &defaultInputDevice
+    );
+    
+    // Allocate memory for devices (each may have both endpoints)
+    *devices = (AudioDevice*)calloc(numDevices * 2 + 1, sizeof(AudioDevice));
     if (*devices == NULL) {
         free(audioDevices);
         return 0;
     }
     
-    for (int i = 0; i < numDevices; i++) {
-        // Check if device has output channels
+    // One pass over the device list per direction: output streams first,
+    // then input streams
+    for (int k = 0; k < numDevices * 2; k++) {
+        int i = k % numDevices;
+        bool capture = k >= numDevices;
+        AudioObjectPropertyScope streamScope = capture ? kAudioDevicePropertyScopeInput : kAudioDevicePropertyScopeOutput;
+        if (!(direction & (capture ? DEVICE_DIRECTION_CAPTURE : DEVICE_DIRECTION_PLAYBACK))) continue;
+        
+        // Check if device has channels in this direction
         propertyAddress.mSelector = kAudioDevicePropertyStreamConfiguration;
-        propertyAddress.mScope = kAudioDevicePropertyScopeOutput;
+        propertyAddress.mScope = streamScope;
         
         status = AudioObjectGetPropertyDataSize(
             audioDevices[i],
@@ -297,15 +457,15 @@ int list_audio_output_devices(AudioDevice** devices) {
             bufferList
         );
         
-        int outputChannels = 0;
+        int streamChannels = 0;
         if (status == noErr) {
             for (int j = 0; j < bufferList->mNumberBuffers; j++) {
-                outputChannels += bufferList->mBuffers[j].mNumberChannels;
+                streamChannels += bufferList->mBuffers[j].mNumberChannels;
             }
         }
         free(bufferList);
         
-        if (outputChannels == 0) continue;
+        if (streamChannels == 0) continue;
         
         // Get device name
         propertyAddress.mSelector = kAudioDevicePropertyDeviceNameCFString;
@@ -357,7 +517,8 @@ int list_audio_output_devices(AudioDevice** devices) {
         // Initialize all fields
         (*devices)[device_count].device_id_numeric = audioDevices[i];
         (*devices)[device_count].input_channels = 0;
-        (*devices)[device_count].output_channels = outputChannels;
+        (*devices)[device_count].output_channels = capture ? 0 : streamChannels;
+        (*devices)[device_count].direction = capture ? DEVICE_DIRECTION_CAPTURE : DEVICE_DIRECTION_PLAYBACK;
         (*devices)[device_count].sample_rate = 0;
         (*devices)[device_count].bit_depth = 0;
         (*devices)[device_count].volume = 0.0f;
@@ -372,7 +533,7 @@ int list_audio_output_devices(AudioDevice** devices) {
         strcpy((*devices)[device_count].clock_source, "Unknown");
         
         // Check if default device
-        if (audioDevices[i] == defaultDevice) {
+        if (audioDevices[i] == (capture ? defaultInputDevice : defaultDevice)) {
             (*devices)[device_count].is_default = true;
         }
         
@@ -435,7 +596,7 @@ int list_audio_output_devices(AudioDevice** devices) {
         
         // Get volume (if available)
         propertyAddress.mSelector = kAudioDevicePropertyVolumeScalar;
-        propertyAddress.mScope = kAudioDevicePropertyScopeOutput;
+        propertyAddress.mScope = streamScope;
         propertyAddress.mElement = kAudioObjectPropertyElementMain;
         Float32 volume = 0.0f;
         dataSize = sizeof(Float32);
@@ -472,7 +633,7 @@ int list_audio_output_devices(AudioDevice** devices) {
         
         // Get data source (if available)
         propertyAddress.mSelector = kAudioDevicePropertyDataSource;
-        propertyAddress.mScope = kAudioDevicePropertyScopeOutput;
+        propertyAddress.mScope = streamScope;
         UInt32 dataSource = 0;
         dataSize = sizeof(UInt32);
         status = AudioObjectGetPropertyData(audioDevices[i], &propertyAddress, 0, NULL, &dataSize, &dataSource);
@@ -570,120 +731,1063 @@ int list_audio_output_devices(AudioDevice** devices) {
     }
     
     free(audioDevices);
+    link_duplex_endpoints(*devices, device_count, coreaudio_same_device);
     return device_count;
 }
 
+// CoreAudio keeps no per-call session state, so the context only
+// serializes callers and hands back a copy of the one-shot result
+struct audio_ctx {
+    pthread_mutex_t lock;
+};
+
+audio_ctx_t* audio_ctx_create(void) {
+    audio_ctx_t* ctx = (audio_ctx_t*)calloc(1, sizeof(audio_ctx_t));
+    if (ctx == NULL) return NULL;
+    
+    if (pthread_mutex_init(&ctx->lock, NULL) != 0) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+int audio_ctx_list_devices(audio_ctx_t* ctx, AudioDeviceDirection direction,
+                           AudioDevice* devices, int max_devices) {
+    if (ctx == NULL || devices == NULL || max_devices < 0) return 0;
+    
+    pthread_mutex_lock(&ctx->lock);
+    AudioDevice* found = NULL;
+    int count = list_audio_devices(&found, direction);
+    int copied = count < max_devices ? count : max_devices;
+    if (copied > 0) {
+        memcpy(devices, found, (size_t)copied * sizeof(AudioDevice));
+    }
+    free_audio_devices(found);
+    pthread_mutex_unlock(&ctx->lock);
+    return count;
+}
+
+void audio_ctx_destroy(audio_ctx_t* ctx) {
+    if (ctx == NULL) return;
+    
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
+
 #elif defined(__linux__)
 #include <alsa/asoundlib.h>
 #include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "pcm_status.h"
+#include "card_power.h"
+#include "metrics.h"
 
 // Linux implementation using ALSA
-int list_audio_output_devices(AudioDevice** devices) {
+
+#define ALSA_MAX_DEVICES 192     // playback and capture endpoints, hardware and logical
+#define ALSA_MAX_CARDS 32
+#define ALSA_MAX_PLUGINS 128     // logical PCMs from the name hints
+#define ALSA_MAX_SLAVE_DEPTH 16  // plugin chains longer than this are left unresolved
+
+// Where a PCM definition ends up in one direction; card is -1 when it
+// doesn't end on one fixed hw PCM (sound servers, multi, null)
+typedef struct {
+    int card;
+    int device;
+} AlsaRoute;
+
+// A logical PCM from the name hints, resolved against the configuration
+typedef struct {
+    char id[128];
+    char name[256];
+    AudioDeviceDirection direction;     // directions the hint offers
+    AlsaRoute routes[2];                // playback, capture
+} AlsaPlugin;
+
+typedef struct {
+    int count;
+    AlsaPlugin entries[ALSA_MAX_PLUGINS];
+} AlsaPluginList;
+
+// What a walk needs from the configuration. Working it out expands PCM
+// definitions, so contexts keep it until the files or the cards change.
+typedef struct {
+    AlsaRoute default_routes[2];        // playback, capture
+    const AlsaPluginList* plugins;      // NULL unless logical PCMs are listed
+    snd_config_t* config;               // tree control devices are opened with
+} AlsaConfigView;
+
+// A card's entries from its last live query, for walks that find it
+// suspended
+typedef struct {
+    AudioDeviceDirection direction;     // directions that query covered
+    int count;
+    AudioDevice* entries;
+} AlsaCardCache;
+
+// A power-aware walk: where to read power state and metadata, what the
+// context remembers, and what happened to each card
+typedef struct {
+    const char* sysfs_root;             // NULL for /sys
+    const char* proc_root;              // NULL for /proc/asound
+    bool wake;                          // query suspended cards anyway
+    AlsaCardCache* cache;               // ALSA_MAX_CARDS slots, NULL for one-shot walks
+    AudioCardPower* report;             // ALSA_MAX_CARDS entries, may be NULL
+    int report_count;
+} AlsaPowerWalk;
+
+// Open the control device for a card and read its card info into info,
+// reusing a cached handle when the caller keeps one. A cached handle can
+// outlive its card: after an unplug and a replug under the same index it
+// fails every query, so it is dropped and the card opened once more.
+// config is the private tree the walk resolved its view from; the global
+// one is loaded only when there is none.
+static snd_ctl_t* alsa_open_ctl(int card, snd_config_t* config, snd_ctl_t** ctl_cache, snd_ctl_card_info_t* info) {
+    char hw_name[32];
+    snd_ctl_t* ctl = NULL;
+    bool cached = ctl_cache != NULL && card < ALSA_MAX_CARDS;
+    
+    if (cached && ctl_cache[card] != NULL) {
+        if (snd_ctl_card_info(ctl_cache[card], info) >= 0) return ctl_cache[card];
+        snd_ctl_close(ctl_cache[card]);
+        ctl_cache[card] = NULL;
+    }
+    
+    snprintf(hw_name, sizeof(hw_name), "hw:%d", card);
+    int err = config != NULL ? snd_ctl_open_lconf(&ctl, hw_name, 0, config) : snd_ctl_open(&ctl, hw_name, 0);
+    if (err < 0) return NULL;
+    if (snd_ctl_card_info(ctl, info) < 0) {
+        snd_ctl_close(ctl);
+        return NULL;
+    }
+    
+    if (cached) ctl_cache[card] = ctl;
+    return ctl;
+}
+
+// Close a handle the caller doesn't cache
+static void alsa_release_ctl(int card, snd_ctl_t* ctl, snd_ctl_t** ctl_cache) {
+    if (ctl_cache != NULL && card < ALSA_MAX_CARDS && ctl_cache[card] == ctl) return;
+    snd_ctl_close(ctl);
+}
+
+// Determine device type based on driver and name
+static void alsa_classify_device(AudioDevice* device, const char* driver) {
+    char name_lower[256];
+    strcpy(name_lower, device->name);
+    for (int i = 0; name_lower[i]; i++) {
+        name_lower[i] = tolower(name_lower[i]);
+    }
+    
+    if (strstr(name_lower, "hdmi") != NULL) {
+        device->type = DEVICE_TYPE_HDMI;
+        device->connection = CONNECTION_WIRED;
+    } else if (strstr(driver, "USB") != NULL || strstr(name_lower, "usb") != NULL) {
+        device->type = DEVICE_TYPE_USB;
+        device->connection = CONNECTION_WIRED;
+    } else if (strstr(name_lower, "bluetooth") != NULL) {
+        device->type = DEVICE_TYPE_BLUETOOTH;
+        device->connection = CONNECTION_WIRELESS;
+    } else if (strstr(name_lower, "headphone") != NULL) {
+        device->type = DEVICE_TYPE_HEADPHONES;
+        device->connection = CONNECTION_WIRED;
+    } else if (strstr(driver, "HDA") != NULL) {
+        device->type = DEVICE_TYPE_SPEAKERS;
+        device->connection = CONNECTION_BUILTIN;
+    } else {
+        device->type = DEVICE_TYPE_SPEAKERS;
+        device->connection = CONNECTION_UNKNOWN;
+    }
+}
+
+// Card of a card field: an index, or a card id such as "PCH"
+static int alsa_config_card(snd_config_t* node) {
+    long index;
+    const char* card_id;
+    
+    if (snd_config_get_integer(node, &index) >= 0) return (int)index;
+    if (snd_config_get_string(node, &card_id) >= 0) return snd_card_get_index(card_id);
+    return -1;
+}
+
+static bool alsa_resolve_definition(snd_config_t* config, const char* name, AudioDeviceDirection direction,
+                                    int depth, AlsaRoute* route);
+
+// Follow a PCM definition down its slave chain to the hw PCM it opens
+static bool alsa_resolve_node(snd_config_t* config, snd_config_t* pcm, AudioDeviceDirection direction,
+                              int depth, AlsaRoute* route) {
+    snd_config_t* node;
+    const char* type;
+    long device = 0;
+    
+    if (depth > ALSA_MAX_SLAVE_DEPTH) return false;
+    if (snd_config_search(pcm, "type", &node) < 0 || snd_config_get_string(node, &type) < 0) return false;
+    
+    if (strcmp(type, "hw") == 0) {
+        route->card = snd_config_search(pcm, "card", &node) >= 0 ? alsa_config_card(node) : 0;
+        if (snd_config_search(pcm, "device", &node) >= 0) snd_config_get_integer(node, &device);
+        route->device = (int)device;
+        return route->card >= 0;
+    }
+    
+    // asym picks a slave per direction; the other plugins name one as
+    // slave.pcm, or as slave in the short form
+    if (strcmp(type, "asym") == 0) {
+        const char* key = direction == DEVICE_DIRECTION_CAPTURE ? "capture.pcm" : "playback.pcm";
+        if (snd_config_search(pcm, key, &node) < 0) return false;
+    } else if (snd_config_search(pcm, "slave.pcm", &node) < 0 && snd_config_search(pcm, "slave", &node) < 0) {
+        return false;
+    }
+    
+    const char* slave;
+    if (snd_config_get_string(node, &slave) >= 0) {
+        return alsa_resolve_definition(config, slave, direction, depth + 1, route);
+    }
+    if (snd_config_get_type(node) == SND_CONFIG_TYPE_COMPOUND) {
+        return alsa_resolve_node(config, node, direction, depth + 1, route);
+    }
+    return false;
+}
+
+// Resolve a PCM name, arguments and all (e.g. dmix:CARD=PCH,DEV=0)
+static bool alsa_resolve_definition(snd_config_t* config, const char* name, AudioDeviceDirection direction,
+                                    int depth, AlsaRoute* route) {
+    snd_config_t* pcm;
+    if (snd_config_search_definition(config, "pcm", name, &pcm) < 0) return false;
+    bool resolved = alsa_resolve_node(config, pcm, direction, depth, route);
+    snd_config_delete(pcm);
+    return resolved;
+}
+
+// Where "default" routes in each direction. Behind a sound server the
+// hardware is the server's choice; defaults.pcm.card is the best guess.
+static void alsa_default_routes(snd_config_t* config, AlsaRoute routes[2]) {
+    for (int s = 0; s < 2; s++) {
+        AudioDeviceDirection direction = s == 0 ? DEVICE_DIRECTION_PLAYBACK : DEVICE_DIRECTION_CAPTURE;
+        snd_config_t* node;
+        long card_num;
+    
+        routes[s].card = -1;
+        routes[s].device = 0;
+        if (config == NULL || alsa_resolve_definition(config, "default", direction, 0, &routes[s])) continue;
+    
+        routes[s].card = -1;
+        routes[s].device = 0;
+        if (snd_config_search(config, "defaults.pcm.card", &node) >= 0 &&
+            snd_config_get_integer(node, &card_num) >= 0) {
+            routes[s].card = (int)card_num;
+        }
+    }
+}
+
+// Mark the endpoint "default" routes to in each direction, and the
+// logical default PCM itself when it is listed
+static void alsa_mark_default(AudioDevice* devices, int device_count, const AlsaRoute routes[2]) {
+    for (int s = 0; s < 2; s++) {
+        AudioDeviceDirection direction = s == 0 ? DEVICE_DIRECTION_PLAYBACK : DEVICE_DIRECTION_CAPTURE;
+        char default_id[32];
+        bool hardware_marked = false;
+    
+        snprintf(default_id, sizeof(default_id), "hw:%d,%d", routes[s].card, routes[s].device);
+        for (int i = 0; i < device_count; i++) {
+            if (devices[i].direction != direction) continue;
+            if (strcmp(devices[i].id, "default") == 0) {
+                devices[i].is_default = true;
+            } else if (!hardware_marked && routes[s].card >= 0 && strcmp(devices[i].id, default_id) == 0) {
+                devices[i].is_default = true;
+                hardware_marked = true;
+            }
+        }
+    }
+}
+
+// Hint descriptions come as "card, PCM\nwhat it is" lines
+static void alsa_describe(char* out, size_t out_size, const char* description) {
+    size_t n = 0;
+    for (const char* p = description; *p != '\0' && n + 4 < out_size; p++) {
+        if (*p == '\n') {
+            memcpy(out + n, " - ", 3);
+            n += 3;
+        } else {
+            out[n++] = *p;
+        }
+    }
+    out[n] = '\0';
+}
+
+// List the logical PCMs the configuration defines for the current cards.
+// The hint list comes from alsa-lib's shared configuration; resolving it
+// only reads ours.
+static void alsa_load_plugins(AlsaPluginList* list, snd_config_t* config) {
+    void** hints;
+    
+    list->count = 0;
+    if (snd_device_name_hint(-1, "pcm", &hints) < 0) return;
+    
+    for (void** hint = hints; *hint != NULL && list->count < ALSA_MAX_PLUGINS; hint++) {
+        char* name = snd_device_name_get_hint(*hint, "NAME");
+        char* description = snd_device_name_get_hint(*hint, "DESC");
+        char* ioid = snd_device_name_get_hint(*hint, "IOID");
+    
+        // hw:CARD=..,DEV=.. duplicates the hw:C,D entries and null discards audio
+        if (name != NULL && strncmp(name, "hw:", 3) != 0 && strcmp(name, "null") != 0 &&
+            strlen(name) < sizeof(list->entries[0].id)) {
+            AlsaPlugin* plugin = &list->entries[list->count++];
+            strcpy(plugin->id, name);
+            alsa_describe(plugin->name, sizeof(plugin->name), description != NULL ? description : name);
+            plugin->direction = ioid == NULL ? DEVICE_DIRECTION_ALL :
+                strcmp(ioid, "Input") == 0 ? DEVICE_DIRECTION_CAPTURE : DEVICE_DIRECTION_PLAYBACK;
+            for (int s = 0; s < 2; s++) {
+                AudioDeviceDirection direction = s == 0 ? DEVICE_DIRECTION_PLAYBACK : DEVICE_DIRECTION_CAPTURE;
+                plugin->routes[s].device = 0;
+                if (config == NULL || !alsa_resolve_definition(config, name, direction, 0, &plugin->routes[s])) {
+                    plugin->routes[s].card = -1;
+                }
+            }
+        }
+        free(name);
+        free(description);
+        free(ioid);
+    }
+    snd_device_name_free_hint(hints);
+}
+
+// Append the logical PCMs after the hardware entries. One that ends on a
+// listed hw PCM takes after it; the rest are virtual.
+static int alsa_append_plugins(AudioDevice* devices, int device_count, int max_devices,
+                               AudioDeviceDirection direction, const AlsaPluginList* plugins) {
+    int count = device_count;
+    
+    for (int i = 0; i < plugins->count; i++) {
+        const AlsaPlugin* plugin = &plugins->entries[i];
+        for (int s = 0; s < 2; s++) {
+            AudioDeviceDirection stream_direction = s == 0 ? DEVICE_DIRECTION_PLAYBACK : DEVICE_DIRECTION_CAPTURE;
+            if (!(direction & stream_direction) || !(plugin->direction & stream_direction)) continue;
+            if (count >= max_devices) return count - device_count;
+    
+            AudioDevice* device = &devices[count++];
+            strcpy(device->id, plugin->id);
+            strcpy(device->name, plugin->name);
+            device->direction = stream_direction;
+            device->type = DEVICE_TYPE_VIRTUAL;
+            device->connection = CONNECTION_UNKNOWN;
+            if (plugin->routes[s].card < 0) continue;
+    
+            snprintf(device->hardware_id, sizeof(device->hardware_id), "hw:%d,%d",
+                     plugin->routes[s].card, plugin->routes[s].device);
+            for (int j = 0; j < device_count; j++) {
+                if (strcmp(devices[j].id, device->hardware_id) == 0) {
+                    device->type = devices[j].type;
+                    device->connection = devices[j].connection;
+                    break;
+                }
+            }
+        }
+    }
+    return count - device_count;
+}
+
+// Bitmask of the cards present; cheap, it opens no device
+static uint32_t alsa_card_mask(void) {
+    uint32_t mask = 0;
+    int card = -1;
+    while (snd_card_next(&card) >= 0 && card >= 0) {
+        if (card < ALSA_MAX_CARDS) mask |= 1u << card;
+    }
+    return mask;
+}
+
+// Playback and capture on the same hw:C,D are one full-duplex PCM
+static bool alsa_same_pcm(const AudioDevice* playback, const AudioDevice* capture) {
+    return strcmp(playback->id, capture->id) == 0;
+}
+
+// USB audio class devices (headsets, webcams) often expose the speaker and
+// the microphone as different PCM numbers on one card
+static bool alsa_same_usb_card(const AudioDevice* playback, const AudioDevice* capture) {
+    int playback_card, capture_card;
+    if (playback->type != DEVICE_TYPE_USB || capture->type != DEVICE_TYPE_USB) return false;
+    if (sscanf(playback->id, "hw:%d", &playback_card) != 1) return false;
+    if (sscanf(capture->id, "hw:%d", &capture_card) != 1) return false;
+    return playback_card == capture_card;
+}
+
+// Entry of hardware PCM hw:card,dev
+static void alsa_fill_entry(AudioDevice* device, int card, int dev, AudioDeviceDirection direction,
+                            const char* card_name, const char* pcm_name, const char* driver) {
+    snprintf(device->name, sizeof(device->name), "%s - %s", card_name, pcm_name);
+    snprintf(device->id, sizeof(device->id), "hw:%d,%d", card, dev);
+    snprintf(device->hardware_id, sizeof(device->hardware_id), "hw:%d,%d", card, dev);
+    device->direction = direction;
+    alsa_classify_device(device, driver);
+}
+
+// Append one card's PCMs in the requested directions, querying both
+// streams of a PCM through the same control handle. Returns the number of
+// entries added, 0 when the card is gone.
+static int alsa_enumerate_card(int card, AudioDevice* devices, int max_devices, AudioDeviceDirection direction,
+                               snd_config_t* config, snd_ctl_t** ctl_cache) {
     int device_count = 0;
+    snd_ctl_card_info_t* info;
+    snd_ctl_card_info_alloca(&info);
+    snd_ctl_t* ctl = alsa_open_ctl(card, config, ctl_cache, info);
+    if (ctl == NULL) {
+        metrics_count(METRIC_CARD_FAILURES, 1);
+        return 0;
+    }
+    
+    // Get card name and driver
+    const char* card_name = snd_ctl_card_info_get_name(info);
+    const char* driver = snd_ctl_card_info_get_driver(info);
+    
+    // Enumerate PCM devices on this card
+    int dev = -1;
+    snd_pcm_info_t* pcminfo;
+    snd_pcm_info_alloca(&pcminfo);
+    while (snd_ctl_pcm_next_device(ctl, &dev) >= 0 && dev >= 0) {
+        for (int s = 0; s < 2; s++) {
+            AudioDeviceDirection stream_direction = s == 0 ? DEVICE_DIRECTION_PLAYBACK : DEVICE_DIRECTION_CAPTURE;
+            if (!(direction & stream_direction)) continue;
+            if (device_count >= max_devices) break;
+            
+            snd_pcm_info_set_device(pcminfo, dev);
+            snd_pcm_info_set_subdevice(pcminfo, 0);
+            snd_pcm_info_set_stream(pcminfo, s == 0 ? SND_PCM_STREAM_PLAYBACK : SND_PCM_STREAM_CAPTURE);
+            
+            if (snd_ctl_pcm_info(ctl, pcminfo) >= 0) {
+                alsa_fill_entry(&devices[device_count++], card, dev, stream_direction,
+                                card_name, snd_pcm_info_get_name(pcminfo), driver);
+            }
+        }
+    }
+    
+    alsa_release_ctl(card, ctl, ctl_cache);
+    return device_count;
+}
+
+// A suspended card's entries as its last live query found them, if that
+// covered the requested directions. Returns -1 when there are none.
+static int alsa_cached_card(const AlsaCardCache* cache, AudioDevice* devices, int max_devices,
+                            AudioDeviceDirection direction) {
+    if (cache == NULL || cache->entries == NULL || (cache->direction & direction) != direction) return -1;
+    
+    int device_count = 0;
+    for (int i = 0; i < cache->count && device_count < max_devices; i++) {
+        if (cache->entries[i].direction & direction) devices[device_count++] = cache->entries[i];
+    }
+    return device_count;
+}
+
+static void alsa_cache_card(AlsaCardCache* cache, const AudioDevice* devices, int device_count,
+                            AudioDeviceDirection direction) {
+    if (device_count == 0) {
+        // Gone, or nothing in these directions: not worth remembering
+        free(cache->entries);
+        memset(cache, 0, sizeof(*cache));
+        return;
+    }
+    
+    AudioDevice* entries = (AudioDevice*)realloc(cache->entries, (size_t)device_count * sizeof(AudioDevice));
+    if (entries == NULL) return;
+    memcpy(entries, devices, (size_t)device_count * sizeof(AudioDevice));
+    cache->entries = entries;
+    cache->count = device_count;
+    cache->direction = direction;
+}
+
+// A suspended card's entries from /proc/asound, whose card and PCM names
+// are the strings its control device would report. Returns -1 if procfs
+// doesn't list the card.
+static int alsa_procfs_card(const char* proc_root, int card, AudioDevice* devices, int max_devices,
+                            AudioDeviceDirection direction) {
+    char card_name[80];
+    char driver[64];
+    CardPcm pcms[CARD_POWER_MAX_PCMS];
+    if (card_power_card_info(proc_root, card, card_name, sizeof(card_name), driver, sizeof(driver)) < 0) return -1;
+    int pcm_count = card_power_list_pcms(proc_root, card, direction, pcms, CARD_POWER_MAX_PCMS);
+    if (pcm_count < 0) return -1;
+    
+    int device_count = 0;
+    for (int i = 0; i < pcm_count && device_count < max_devices; i++) {
+        alsa_fill_entry(&devices[device_count++], card, pcms[i].device, pcms[i].direction,
+                        card_name, pcms[i].name, driver);
+    }
+    return device_count;
+}
+
+// One card of a power-aware walk. Unless the walk may wake it, a
+// suspended card is listed from the cache or procfs, and left out when
+// neither knows it: its control device is never opened.
+static int alsa_power_card(int card, AudioDevice* devices, int max_devices, AudioDeviceDirection direction,
+                           snd_config_t* config, snd_ctl_t** ctl_cache, AlsaPowerWalk* power) {
+    AudioCardPower report = { card, false, false, false };
+    AlsaCardCache* cache = power->cache != NULL && card < ALSA_MAX_CARDS ? &power->cache[card] : NULL;
+    int device_count;
+    
+    report.suspended = card_power_state(power->sysfs_root, card) == CARD_POWER_SUSPENDED;
+    if (report.suspended && !power->wake) {
+        device_count = alsa_cached_card(cache, devices, max_devices, direction);
+        if (device_count < 0) device_count = alsa_procfs_card(power->proc_root, card, devices, max_devices, direction);
+        if (device_count < 0) device_count = 0;
+        for (int i = 0; i < device_count; i++) devices[i].is_suspended = true;
+    } else {
+        device_count = alsa_enumerate_card(card, devices, max_devices, direction, config, ctl_cache);
+        report.queried = true;
+        // A device that resumed stays active for its autosuspend delay,
+        // so reading right away tells whether the query woke it
+        if (report.suspended) {
+            report.woke = card_power_state(power->sysfs_root, card) != CARD_POWER_SUSPENDED;
+        }
+        if (cache != NULL) alsa_cache_card(cache, devices, device_count, direction);
+    }
+    
+    if (power->report != NULL && power->report_count < ALSA_MAX_CARDS) {
+        power->report[power->report_count++] = report;
+    }
+    return device_count;
+}
+
+// Flag endpoints some client is streaming through, from the procfs status
+// files, so nothing here has to open (and contend for) a PCM
+static void alsa_mark_running(AudioDevice* devices, int device_count, PcmStatusSampler* status) {
+    PcmStreamStatus* statuses = (PcmStreamStatus*)malloc(PCM_STATUS_MAX_SUBDEVICES * sizeof(PcmStreamStatus));
+    if (statuses == NULL) return;
+    
+    int count = pcm_status_sample(status, statuses, PCM_STATUS_MAX_SUBDEVICES);
+    pcm_status_mark_running(statuses, count, devices, device_count);
+    free(statuses);
+}
+
+// Defaults, duplex links and running state, once a walk has collected its
+// entries. status may be NULL when /proc/asound can't be read.
+static void alsa_finish_entries(AudioDevice* devices, int device_count, const AlsaConfigView* view,
+                                PcmStatusSampler* status) {
+    if (device_count > 0) {
+        uint64_t start = metrics_start();
+        alsa_mark_default(devices, device_count, view->default_routes);
+        link_duplex_endpoints(devices, device_count, alsa_same_pcm);
+        link_duplex_endpoints(devices, device_count, alsa_same_usb_card);
+        metrics_observe(METRIC_PHASE_FINISH, start);
+        
+        if (status != NULL) {
+            start = metrics_start();
+            alsa_mark_running(devices, device_count, status);
+            metrics_observe(METRIC_PHASE_RUNNING, start);
+        }
+    }
+}
+
+// Cards a walk visits, in ascending order. A power-aware walk takes them
+// from sysfs, which lists every registered card without opening its
+// control device; otherwise, or when sysfs can't be read, from alsa-lib.
+static int alsa_list_cards(const AlsaPowerWalk* power, int* cards) {
+    int count = power != NULL ? card_power_list_cards(power->sysfs_root, cards, ALSA_MAX_CARDS) : -1;
+    if (count >= 0) return count;
+    
     int card = -1;
-    int max_devices = 32;
+    count = 0;
+    while (snd_card_next(&card) >= 0 && card >= 0 && count < ALSA_MAX_CARDS) {
+        cards[count++] = card;
+    }
+    return count;
+}
+
+// Walk all cards. ctl_cache may be NULL for a one-shot walk that opens
+// and closes every control device, and power is NULL unless the walk
+// checks runtime power state first.
+static int alsa_enumerate(AudioDevice* devices, int max_devices, AudioDeviceDirection direction,
+                          const AlsaConfigView* view, snd_ctl_t** ctl_cache, PcmStatusSampler* status,
+                          AlsaPowerWalk* power) {
+    int device_count = 0;
+    int cards[ALSA_MAX_CARDS];
+    bool seen[ALSA_MAX_CARDS] = { false };
     
-    *devices = (AudioDevice*)calloc(max_devices, sizeof(AudioDevice));
-    if (*devices == NULL) return 0;
+    memset(devices, 0, (size_t)max_devices * sizeof(AudioDevice));
     
     // Enumerate sound cards
-    while (snd_card_next(&card) >= 0 && card >= 0) {
+    uint64_t walk_start = metrics_start();
+    int card_count = alsa_list_cards(power, cards);
+    for (int i = 0; i < card_count; i++) {
+        int card = cards[i];
         if (device_count >= max_devices - 1) break;
-        
+        if (card < ALSA_MAX_CARDS) seen[card] = true;
+        uint64_t card_start = metrics_start();
+        if (power != NULL) {
+            device_count += alsa_power_card(card, devices + device_count, max_devices - 1 - device_count,
+                                            direction, view->config, ctl_cache, power);
+        } else {
+            device_count += alsa_enumerate_card(card, devices + device_count, max_devices - 1 - device_count,
+                                                direction, view->config, ctl_cache);
+        }
+        metrics_observe_card(card, card_start);
+    }
+    metrics_observe(METRIC_PHASE_CARDS, walk_start);
+    
+    // Drop cached handles and entries of cards that disappeared since the
+    // last walk
+    if (ctl_cache != NULL) {
+        for (int i = 0; i < ALSA_MAX_CARDS; i++) {
+            if (!seen[i] && ctl_cache[i] != NULL) {
+                snd_ctl_close(ctl_cache[i]);
+                ctl_cache[i] = NULL;
+            }
+        }
+    }
+    if (power != NULL && power->cache != NULL) {
+        for (int i = 0; i < ALSA_MAX_CARDS; i++) {
+            if (!seen[i]) alsa_cache_card(&power->cache[i], NULL, 0, 0);
+        }
+    }
+    
+    if (view->plugins != NULL) {
+        device_count += alsa_append_plugins(devices, device_count, max_devices - 1, direction, view->plugins);
+    }
+    
+    alsa_finish_entries(devices, device_count, view, status);
+    return device_count;
+}
+
+// Private configuration for one-shot listings, so repeated calls neither
+// re-parse the files nor touch the global snd_config tree applications
+// share. It is reloaded only when the files change.
+static pthread_mutex_t alsa_config_lock = PTHREAD_MUTEX_INITIALIZER;
+static snd_config_t* alsa_config;
+static snd_config_update_t* alsa_config_update;
+
+int list_audio_devices_with_flags(AudioDevice** devices, AudioDeviceDirection direction, unsigned int flags) {
+    *devices = (AudioDevice*)calloc(ALSA_MAX_DEVICES, sizeof(AudioDevice));
+    if (*devices == NULL) return 0;
+    
+    AlsaPluginList* plugins = NULL;
+    if (flags & AUDIO_LIST_PLUGINS) {
+        plugins = (AlsaPluginList*)malloc(sizeof(AlsaPluginList));
+        if (plugins == NULL) return 0;
+    }
+    
+    pthread_mutex_lock(&alsa_config_lock);
+    uint64_t start = metrics_start();
+    snd_config_update_r(&alsa_config, &alsa_config_update, NULL);
+    AlsaConfigView view = { .plugins = plugins, .config = alsa_config };
+    alsa_default_routes(alsa_config, view.default_routes);
+    if (plugins != NULL) alsa_load_plugins(plugins, alsa_config);
+    metrics_observe(METRIC_PHASE_CONFIG, start);
+    
+    // Without a context nothing is cached: suspended cards are listed
+    // from procfs
+    AlsaPowerWalk power = { .wake = (flags & AUDIO_LIST_WAKE) != 0 };
+    PcmStatusSampler* status = pcm_status_open(NULL);
+    int count = alsa_enumerate(*devices, ALSA_MAX_DEVICES, direction, &view, NULL, status,
+                               (flags & AUDIO_LIST_POWER_AWARE) ? &power : NULL);
+    pcm_status_close(status);
+    pthread_mutex_unlock(&alsa_config_lock);
+    
+    free(plugins);
+    return count;
+}
+
+int list_audio_devices(AudioDevice** devices, AudioDeviceDirection direction) {
+    return list_audio_devices_with_flags(devices, direction, 0);
+}
+
+struct audio_ctx {
+    pthread_mutex_t lock;
+    unsigned int flags;
+    snd_config_t* config;               // private tree, never the global snd_config
+    snd_config_update_t* config_update;
+    bool view_valid;
+    uint32_t view_cards;                // cards present when the view was worked out
+    AlsaConfigView view;
+    AlsaPluginList* plugins;            // allocated with AUDIO_LIST_PLUGINS
+    snd_ctl_t* ctl_cache[ALSA_MAX_CARDS];
+    PcmStatusSampler* status;           // procfs status files, kept open across walks
+    char* sysfs_root;                   // NULL for the defaults
+    char* proc_root;
+    AlsaCardCache card_cache[ALSA_MAX_CARDS];
+    AudioCardPower power[ALSA_MAX_CARDS];   // what the last power-aware listing did
+    int power_count;
+    AudioDevice scratch[ALSA_MAX_DEVICES];
+};
+
+// Open the status files on first use and pick up hotplugged cards after
+static PcmStatusSampler* alsa_ctx_status(audio_ctx_t* ctx) {
+    if (ctx->status == NULL) {
+        ctx->status = pcm_status_open(ctx->proc_root);
+    } else {
+        pcm_status_rescan(ctx->status);
+    }
+    return ctx->status;
+}
+
+// Reload the configuration if its files changed, and work out the routes
+// and logical PCMs again only when it did or the cards changed
+static const AlsaConfigView* alsa_ctx_view(audio_ctx_t* ctx) {
+    uint64_t start = metrics_start();
+    int updated = snd_config_update_r(&ctx->config, &ctx->config_update, NULL);
+    uint32_t cards = alsa_card_mask();
+    
+    bool want_plugins = (ctx->flags & AUDIO_LIST_PLUGINS) != 0;
+    if (want_plugins && ctx->plugins == NULL) {
+        ctx->plugins = (AlsaPluginList*)malloc(sizeof(AlsaPluginList));
+        ctx->view_valid = false;
+    }
+    
+    if (!ctx->view_valid || updated != 0 || cards != ctx->view_cards) {
+        alsa_default_routes(ctx->config, ctx->view.default_routes);
+        if (want_plugins && ctx->plugins != NULL) alsa_load_plugins(ctx->plugins, ctx->config);
+        ctx->view_cards = cards;
+        ctx->view_valid = true;
+    }
+    ctx->view.plugins = want_plugins ? ctx->plugins : NULL;
+    ctx->view.config = ctx->config;
+    metrics_observe(METRIC_PHASE_CONFIG, start);
+    return &ctx->view;
+}
+
+// Set up a power-aware walk over the context's cache and report, if the
+// context lists that way
+static bool alsa_ctx_power(audio_ctx_t* ctx, AlsaPowerWalk* power, bool wake) {
+    memset(power, 0, sizeof(*power));
+    if (!(ctx->flags & AUDIO_LIST_POWER_AWARE)) return false;
+    
+    power->sysfs_root = ctx->sysfs_root;
+    power->proc_root = ctx->proc_root;
+    power->wake = wake;
+    power->cache = ctx->card_cache;
+    power->report = ctx->power;
+    return true;
+}
+
+audio_ctx_t* audio_ctx_create(void) {
+    audio_ctx_t* ctx = (audio_ctx_t*)calloc(1, sizeof(audio_ctx_t));
+    if (ctx == NULL) return NULL;
+    
+    if (pthread_mutex_init(&ctx->lock, NULL) != 0) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+int audio_ctx_list_devices(audio_ctx_t* ctx, AudioDeviceDirection direction,
+                           AudioDevice* devices, int max_devices) {
+    if (ctx == NULL || devices == NULL || max_devices < 0) return 0;
+    
+    pthread_mutex_lock(&ctx->lock);
+    
+    const AlsaConfigView* view = alsa_ctx_view(ctx);
+    AlsaPowerWalk power;
+    bool power_aware = alsa_ctx_power(ctx, &power, (ctx->flags & AUDIO_LIST_WAKE) != 0);
+    int count = alsa_enumerate(ctx->scratch, ALSA_MAX_DEVICES, direction, view, ctx->ctl_cache,
+                               alsa_ctx_status(ctx), power_aware ? &power : NULL);
+    ctx->power_count = power.report_count;
+    int copied = count < max_devices ? count : max_devices;
+    if (copied > 0) {
+        memcpy(devices, ctx->scratch, (size_t)copied * sizeof(AudioDevice));
+    }
+    
+    pthread_mutex_unlock(&ctx->lock);
+    return count;
+}
+
+int audio_ctx_list_card(audio_ctx_t* ctx, int card, AudioDeviceDirection direction,
+                        AudioDevice* devices, int max_devices) {
+    if (ctx == NULL || devices == NULL || max_devices < 0 || card < 0) return 0;
+    
+    pthread_mutex_lock(&ctx->lock);
+    
+    const AlsaConfigView* view = alsa_ctx_view(ctx);
+    
+    memset(ctx->scratch, 0, sizeof(ctx->scratch));
+    AlsaPowerWalk power;
+    int count;
+    if (alsa_ctx_power(ctx, &power, true)) {
+        count = alsa_power_card(card, ctx->scratch, ALSA_MAX_DEVICES, direction, view->config,
+                                ctx->ctl_cache, &power);
+    } else {
+        count = alsa_enumerate_card(card, ctx->scratch, ALSA_MAX_DEVICES, direction, view->config, ctx->ctl_cache);
+    }
+    ctx->power_count = power.report_count;
+    alsa_finish_entries(ctx->scratch, count, view, alsa_ctx_status(ctx));
+    int copied = count < max_devices ? count : max_devices;
+    if (copied > 0) {
+        memcpy(devices, ctx->scratch, (size_t)copied * sizeof(AudioDevice));
+    }
+    
+    pthread_mutex_unlock(&ctx->lock);
+    return count;
+}
+
+void audio_ctx_set_flags(audio_ctx_t* ctx, unsigned int flags) {
+    if (ctx == NULL) return;
+    pthread_mutex_lock(&ctx->lock);
+    ctx->flags = flags;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+// Copy a root, or keep NULL for the default
+static char* alsa_copy_root(const char* root) {
+    return root != NULL ? strdup(root) : NULL;
+}
+
+void audio_ctx_set_roots(audio_ctx_t* ctx, const char* sysfs_root, const char* proc_root) {
+    if (ctx == NULL) return;
+    pthread_mutex_lock(&ctx->lock);
+    free(ctx->sysfs_root);
+    free(ctx->proc_root);
+    ctx->sysfs_root = alsa_copy_root(sysfs_root);
+    ctx->proc_root = alsa_copy_root(proc_root);
+    // Reopened under the new root on the next walk
+    pcm_status_close(ctx->status);
+    ctx->status = NULL;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+int audio_ctx_card_power(audio_ctx_t* ctx, AudioCardPower* cards, int max_cards) {
+    if (ctx == NULL || cards == NULL || max_cards < 0) return 0;
+    pthread_mutex_lock(&ctx->lock);
+    int count = ctx->power_count;
+    memcpy(cards, ctx->power, (size_t)(count < max_cards ? count : max_cards) * sizeof(AudioCardPower));
+    pthread_mutex_unlock(&ctx->lock);
+    return count;
+}
+
+void audio_ctx_destroy(audio_ctx_t* ctx) {
+    if (ctx == NULL) return;
+    
+    for (int i = 0; i < ALSA_MAX_CARDS; i++) {
+        if (ctx->ctl_cache[i] != NULL) snd_ctl_close(ctx->ctl_cache[i]);
+        free(ctx->card_cache[i].entries);
+    }
+    pcm_status_close(ctx->status);
+    free(ctx->sysfs_root);
+    free(ctx->proc_root);
+    free(ctx->plugins);
+    if (ctx->config_update) snd_config_update_free(ctx->config_update);
+    if (ctx->config) snd_config_delete(ctx->config);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
+
+static bool alsa_test_format(snd_pcm_t* pcm, snd_pcm_hw_params_t* params, snd_pcm_format_t format) {
+    return snd_pcm_hw_params_test_format(pcm, params, format) == 0;
+}
+
+int probe_audio_device(const AudioDevice* device, AudioDeviceCaps* caps) {
+    snd_pcm_t* pcm;
+    snd_pcm_hw_params_t* params;
+    unsigned int value;
+    int dir = 0;
+    
+    if (device == NULL || caps == NULL) return -1;
+    memset(caps, 0, sizeof(*caps));
+    
+    // Non-blocking so a PCM another client holds fails at once instead of
+    // waiting for it to be released
+    snd_pcm_stream_t stream = device->direction == DEVICE_DIRECTION_CAPTURE ?
+        SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK;
+    if (snd_pcm_open(&pcm, device->id, stream, SND_PCM_NONBLOCK) < 0) return -1;
+    
+    snd_pcm_hw_params_alloca(&params);
+    if (snd_pcm_hw_params_any(pcm, params) < 0) {
+        snd_pcm_close(pcm);
+        return -1;
+    }
+    
+    if (snd_pcm_hw_params_get_rate_min(params, &value, &dir) == 0) caps->min_sample_rate = (int)value;
+    if (snd_pcm_hw_params_get_rate_max(params, &value, &dir) == 0) caps->max_sample_rate = (int)value;
+    if (snd_pcm_hw_params_get_channels_min(params, &value) == 0) caps->min_channels = (int)value;
+    if (snd_pcm_hw_params_get_channels_max(params, &value) == 0) caps->max_channels = (int)value;
+    
+    if (alsa_test_format(pcm, params, SND_PCM_FORMAT_S16_LE)) caps->formats |= AUDIO_FORMAT_S16;
+    if (alsa_test_format(pcm, params, SND_PCM_FORMAT_S24_LE) ||
+        alsa_test_format(pcm, params, SND_PCM_FORMAT_S24_3LE)) caps->formats |= AUDIO_FORMAT_S24;
+    if (alsa_test_format(pcm, params, SND_PCM_FORMAT_S32_LE)) caps->formats |= AUDIO_FORMAT_S32;
+    if (alsa_test_format(pcm, params, SND_PCM_FORMAT_FLOAT_LE)) caps->formats |= AUDIO_FORMAT_FLOAT;
+    
+    snd_pcm_close(pcm);
+    return 0;
+}
+
+struct audio_watch {
+    int inotify_fd;                     // /dev/snd, for cards coming and going
+    snd_config_t* config;               // private tree, like a context's
+    snd_config_update_t* config_update;
+    int ctl_count;
+    snd_ctl_t* ctls[ALSA_MAX_CARDS];    // subscribed, non-blocking
+};
+
+audio_watch_t* audio_watch_open(void) {
+    audio_watch_t* watch = (audio_watch_t*)calloc(1, sizeof(audio_watch_t));
+    if (watch == NULL) return NULL;
+    
+    // A new card has no control handle to report it; its device node does
+    watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->inotify_fd >= 0 && inotify_add_watch(watch->inotify_fd, "/dev/snd", IN_CREATE | IN_DELETE) < 0) {
+        close(watch->inotify_fd);
+        watch->inotify_fd = -1;
+    }
+    
+    // Opening the controls through a private tree keeps the global
+    // snd_config untouched, as listings do
+    snd_config_update_r(&watch->config, &watch->config_update, NULL);
+    
+    int card = -1;
+    while (snd_card_next(&card) >= 0 && card >= 0 && watch->ctl_count < ALSA_MAX_CARDS) {
         char hw_name[32];
         snd_ctl_t* ctl;
-        snd_ctl_card_info_t* info;
-        
         snprintf(hw_name, sizeof(hw_name), "hw:%d", card);
-        
-        if (snd_ctl_open(&ctl, hw_name, 0) < 0) continue;
-        
-        snd_ctl_card_info_alloca(&info);
-        if (snd_ctl_card_info(ctl, info) < 0) {
+        int err = watch->config != NULL ? snd_ctl_open_lconf(&ctl, hw_name, SND_CTL_NONBLOCK, watch->config) :
+                                          snd_ctl_open(&ctl, hw_name, SND_CTL_NONBLOCK);
+        if (err < 0) continue;
+        if (snd_ctl_subscribe_events(ctl, 1) < 0) {
             snd_ctl_close(ctl);
             continue;
         }
-        
-        // Get card name and driver
-        const char* card_name = snd_ctl_card_info_get_name(info);
-        const char* driver = snd_ctl_card_info_get_driver(info);
-        
-        // Enumerate PCM devices on this card
-        int dev = -1;
-        while (snd_ctl_pcm_next_device(ctl, &dev) >= 0 && dev >= 0) {
-            if (device_count >= max_devices - 1) break;
-            
-            snd_pcm_info_t* pcminfo;
-            snd_pcm_info_alloca(&pcminfo);
-            snd_pcm_info_set_device(pcminfo, dev);
-            snd_pcm_info_set_subdevice(pcminfo, 0);
-            snd_pcm_info_set_stream(pcminfo, SND_PCM_STREAM_PLAYBACK);
-            
-            if (snd_ctl_pcm_info(ctl, pcminfo) >= 0) {
-                // Create device entry
-                snprintf((*devices)[device_count].name, 256, "%s - %s",
-                    card_name, snd_pcm_info_get_name(pcminfo));
-                snprintf((*devices)[device_count].id, 256, "hw:%d,%d", card, dev);
-                
-                // Determine device type based on driver and name
-                char name_lower[256];
-                strcpy(name_lower, (*devices)[device_count].name);
-                for (int i = 0; name_lower[i]; i++) {
-                    name_lower[i] = tolower(name_lower[i]);
-                }
-                
-                if (strstr(name_lower, "hdmi") != NULL) {
-                    (*devices)[device_count].type = DEVICE_TYPE_HDMI;
-                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                } else if (strstr(driver, "USB") != NULL || strstr(name_lower, "usb") != NULL) {
-                    (*devices)[device_count].type = DEVICE_TYPE_USB;
-                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                } else if (strstr(name_lower, "bluetooth") != NULL) {
-                    (*devices)[device_count].type = DEVICE_TYPE_BLUETOOTH;
-                    (*devices)[device_count].connection = CONNECTION_WIRELESS;
-                } else if (strstr(name_lower, "headphone") != NULL) {
-                    (*devices)[device_count].type = DEVICE_TYPE_HEADPHONES;
-                    (*devices)[device_count].connection = CONNECTION_WIRED;
-                } else if (strstr(driver, "HDA") != NULL) {
-                    (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
-                    (*devices)[device_count].connection = CONNECTION_BUILTIN;
-                } else {
-                    (*devices)[device_count].type = DEVICE_TYPE_SPEAKERS;
-                    (*devices)[device_count].connection = CONNECTION_UNKNOWN;
-                }
-                
-                device_count++;
-            }
+        watch->ctls[watch->ctl_count++] = ctl;
+    }
+    return watch;
+}
+
+int audio_watch_descriptors(audio_watch_t* watch, int* fds, int max_fds) {
+    int n = 0;
+    if (watch == NULL || fds == NULL) return 0;
+    
+    if (watch->inotify_fd >= 0 && n < max_fds) fds[n++] = watch->inotify_fd;
+    for (int i = 0; i < watch->ctl_count; i++) {
+        struct pollfd pfds[4];
+        int count = snd_ctl_poll_descriptors(watch->ctls[i], pfds, 4);
+        for (int j = 0; j < count && n < max_fds; j++) {
+            fds[n++] = pfds[j].fd;
         }
-        
-        snd_ctl_close(ctl);
     }
+    return n;
+}
+
+int audio_watch_read(audio_watch_t* watch) {
+    bool cards_changed = false;
+    int changes = 0;
+    if (watch == NULL) return -1;
     
-    // Try to get default device from ALSA configuration
-    if (device_count > 0) {
-        snd_config_t* config;
-        snd_config_update();
-        if (snd_config_search(snd_config, "defaults.pcm.card", &config) >= 0) {
-            long card_num;
-            if (snd_config_get_integer(config, &card_num) >= 0) {
-                for (int i = 0; i < device_count; i++) {
-                    char default_id[32];
-                    snprintf(default_id, sizeof(default_id), "hw:%ld,0", card_num);
-                    if (strcmp((*devices)[i].id, default_id) == 0) {
-                        (*devices)[i].is_default = true;
-                        break;
-                    }
-                }
+    if (watch->inotify_fd >= 0) {
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(watch->inotify_fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length; ) {
+                const struct inotify_event* event = (const struct inotify_event*)p;
+                if (event->len > 0 && strncmp(event->name, "controlC", 8) == 0) cards_changed = true;
+                p += sizeof(struct inotify_event) + event->len;
             }
         }
     }
     
-    return device_count;
+    snd_ctl_event_t* event;
+    snd_ctl_event_alloca(&event);
+    for (int i = 0; i < watch->ctl_count; i++) {
+        int err;
+        while ((err = snd_ctl_read(watch->ctls[i], event)) > 0) {
+            if (snd_ctl_event_get_type(event) == SND_CTL_EVENT_ELEM) changes++;
+        }
+        // -ENODEV once the card is unplugged
+        if (err < 0 && err != -EAGAIN) cards_changed = true;
+    }
+    return cards_changed ? -1 : changes;
+}
+
+void audio_watch_close(audio_watch_t* watch) {
+    if (watch == NULL) return;
+    
+    for (int i = 0; i < watch->ctl_count; i++) {
+        snd_ctl_close(watch->ctls[i]);
+    }
+    if (watch->inotify_fd >= 0) close(watch->inotify_fd);
+    if (watch->config_update) snd_config_update_free(watch->config_update);
+    if (watch->config) snd_config_delete(watch->config);
+    free(watch);
 }
 
 #endif
 
 // Common functions
+int list_audio_output_devices(AudioDevice** devices) {
+    return list_audio_devices(devices, DEVICE_DIRECTION_PLAYBACK);
+}
+
+#if defined(_WIN32) || defined(__APPLE__)
+// The listing options only concern ALSA
+int list_audio_devices_with_flags(AudioDevice** devices, AudioDeviceDirection direction, unsigned int flags) {
+    (void)flags;
+    return list_audio_devices(devices, direction);
+}
+
+void audio_ctx_set_flags(audio_ctx_t* ctx, unsigned int flags) {
+    (void)ctx; (void)flags;
+}
+
+// Runtime power state is only honoured on Linux; nothing is ever skipped
+void audio_ctx_set_roots(audio_ctx_t* ctx, const char* sysfs_root, const char* proc_root) {
+    (void)ctx; (void)sysfs_root; (void)proc_root;
+}
+
+int audio_ctx_card_power(audio_ctx_t* ctx, AudioCardPower* cards, int max_cards) {
+    (void)ctx; (void)cards; (void)max_cards;
+    return 0;
+}
+
+// Endpoints here aren't grouped into cards; a card refresh lists them all
+int audio_ctx_list_card(audio_ctx_t* ctx, int card, AudioDeviceDirection direction,
+                        AudioDevice* devices, int max_devices) {
+    (void)card;
+    return audio_ctx_list_devices(ctx, direction, devices, max_devices);
+}
+
+// Endpoints are opened by the system mixer, not by us; report the format
+// the enumeration found
+int probe_audio_device(const AudioDevice* device, AudioDeviceCaps* caps) {
+    if (device == NULL || caps == NULL) return -1;
+    memset(caps, 0, sizeof(*caps));
+    
+    int channels = device->direction == DEVICE_DIRECTION_CAPTURE ? device->input_channels : device->output_channels;
+    caps->min_sample_rate = device->sample_rate;
+    caps->max_sample_rate = device->sample_rate;
+    caps->min_channels = channels;
+    caps->max_channels = channels;
+    switch (device->bit_depth) {
+        case 16: caps->formats = AUDIO_FORMAT_S16; break;
+        case 24: caps->formats = AUDIO_FORMAT_S24; break;
+        case 32: caps->formats = AUDIO_FORMAT_FLOAT; break;
+        default: break;
+    }
+    return 0;
+}
+
+// Change notifications here come through system callbacks, not descriptors
+audio_watch_t* audio_watch_open(void) {
+    return NULL;
+}
+
+int audio_watch_descriptors(audio_watch_t* watch, int* fds, int max_fds) {
+    (void)watch; (void)fds; (void)max_fds;
+    return 0;
+}
+
+int audio_watch_read(audio_watch_t* watch) {
+    (void)watch;
+    return -1;
+}
+
+void audio_watch_close(audio_watch_t* watch) {
+    (void)watch;
+}
+#endif
+
+int audio_ctx_list(audio_ctx_t* ctx, AudioDevice* devices, int max_devices) {
+    return audio_ctx_list_devices(ctx, DEVICE_DIRECTION_PLAYBACK, devices, max_devices);
+}
+
 void free_audio_devices(AudioDevice* devices) {
     if (devices) {
         free(devices);
@@ -709,4 +1813,13 @@ const char* connection_type_to_string(AudioConnectionType connection) {
         case CONNECTION_WIRELESS: return "Wireless";
         default: return "Unknown";
     }
-}
\ No newline at end of file
+}
+
+const char* direction_to_string(AudioDeviceDirection direction) {
+    switch (direction) {
+        case DEVICE_DIRECTION_PLAYBACK: return "playback";
+        case DEVICE_DIRECTION_CAPTURE: return "capture";
+        case DEVICE_DIRECTION_ALL: return "all";
+        default: return "unknown";
+    }
+}
@@ -4,6 +4,10 @@
 
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Audio device types
 typedef enum {
     DEVICE_TYPE_UNKNOWN,
@@ -23,6 +27,13 @@ typedef enum {
     CONNECTION_WIRELESS
 } AudioConnectionType;
 
+// Stream directions, usable as a filter mask
+typedef enum {
+    DEVICE_DIRECTION_PLAYBACK = 1,
+    DEVICE_DIRECTION_CAPTURE = 2,
+    DEVICE_DIRECTION_ALL = 3
+} AudioDeviceDirection;
+
 // Audio device structure
 typedef struct {
     char name[256];
@@ -45,12 +56,107 @@ typedef struct {
     char transport_type_name[64];
     char data_source[256];
     char clock_source[256];
+    AudioDeviceDirection direction;
+    // Set when the same hardware has an endpoint in the other direction.
+    // Only known when both directions are listed in one call.
+    bool is_duplex;
+    char duplex_peer_id[256];   // id of that endpoint (may equal id, e.g. ALSA hw:C,D)
+    // ALSA hw:C,D the endpoint ends up on: its own id for a hardware PCM,
+    // the routed one for a logical PCM, empty behind a sound server
+    char hardware_id[32];
+    // Listed from what was known while the card stayed runtime-suspended
+    // (AUDIO_LIST_POWER_AWARE); nothing was opened to find it
+    bool is_suspended;
 } AudioDevice;
 
 // Function prototypes
+int list_audio_devices(AudioDevice** devices, AudioDeviceDirection direction);
 int list_audio_output_devices(AudioDevice** devices);
 void free_audio_devices(AudioDevice* devices);
 const char* device_type_to_string(AudioDeviceType type);
 const char* connection_type_to_string(AudioConnectionType connection);
+const char* direction_to_string(AudioDeviceDirection direction);
+
+// Listing options for list_audio_devices_with_flags and audio_ctx_set_flags
+#define AUDIO_LIST_PLUGINS 0x01     // also list logical ALSA PCMs (default, dmix, pulse, user-defined)
+#define AUDIO_LIST_POWER_AWARE 0x02 // don't open the control device of runtime-suspended cards
+#define AUDIO_LIST_WAKE 0x04        // with AUDIO_LIST_POWER_AWARE, query suspended cards live anyway
+
+int list_audio_devices_with_flags(AudioDevice** devices, AudioDeviceDirection direction, unsigned int flags);
+
+// Reusable enumeration context for long-running callers. A context keeps
+// its backend session (COM enumerator, private ALSA config tree, cached
+// control handles and device buffers) between calls and serializes its
+// own calls, so it is safe to share between threads.
+typedef struct audio_ctx audio_ctx_t;
+
+audio_ctx_t* audio_ctx_create(void);
+// Copies up to max_devices entries and returns the number of devices found
+int audio_ctx_list(audio_ctx_t* ctx, AudioDevice* devices, int max_devices);
+int audio_ctx_list_devices(audio_ctx_t* ctx, AudioDeviceDirection direction,
+                           AudioDevice* devices, int max_devices);
+// Re-enumerate one ALSA card only (the N of hw:N), e.g. after one of its
+// PCMs failed. Returns 0 once the card is gone. Other backends have no
+// cards and list every endpoint.
+int audio_ctx_list_card(audio_ctx_t* ctx, int card, AudioDeviceDirection direction,
+                        AudioDevice* devices, int max_devices);
+void audio_ctx_set_flags(audio_ctx_t* ctx, unsigned int flags);
+// Read runtime power state under sysfs_root and procfs metadata and PCM
+// status under proc_root instead of /sys and /proc/asound, e.g. fixture
+// trees. NULL keeps the default.
+void audio_ctx_set_roots(audio_ctx_t* ctx, const char* sysfs_root, const char* proc_root);
+void audio_ctx_destroy(audio_ctx_t* ctx);
+
+// What a power-aware walk did with one card
+typedef struct {
+    int card;
+    bool suspended;     // runtime-suspended when the walk reached it
+    bool queried;       // its control device was opened
+    bool woke;          // opened while suspended, and no longer suspended after
+} AudioCardPower;
+
+// Cards of the context's last listing with AUDIO_LIST_POWER_AWARE, in
+// walk order. audio_ctx_list_card always queries its card live and
+// reports just that one. Returns the number of cards, 0 without the flag.
+int audio_ctx_card_power(audio_ctx_t* ctx, AudioCardPower* cards, int max_cards);
+
+// Sample formats a device accepts (AudioDeviceCaps.formats)
+#define AUDIO_FORMAT_S16 0x01
+#define AUDIO_FORMAT_S24 0x02
+#define AUDIO_FORMAT_S32 0x04
+#define AUDIO_FORMAT_FLOAT 0x08
+
+// What a device accepts, as reported by opening it
+typedef struct {
+    int min_sample_rate;
+    int max_sample_rate;
+    int min_channels;
+    int max_channels;
+    unsigned int formats;
+} AudioDeviceCaps;
+
+// Open an enumerated endpoint in its direction and read its supported
+// ranges. Returns 0, or -1 if it can't be opened (busy or gone). This can
+// block for as long as the driver needs to power the device up. Backends
+// without an open-time query report the enumerated format.
+int probe_audio_device(const AudioDevice* device, AudioDeviceCaps* caps);
+
+// Change notifications for long-running callers. Opening subscribes to
+// every card's control events, which can block like an enumeration does;
+// after that the caller waits for any of the descriptors to be readable
+// and calls audio_watch_read. Backends without pollable notifications
+// return NULL.
+typedef struct audio_watch audio_watch_t;
+
+audio_watch_t* audio_watch_open(void);
+int audio_watch_descriptors(audio_watch_t* watch, int* fds, int max_fds);
+// Drain pending events without blocking. Returns the number of device
+// changes, or -1 once cards came or went and the watch has to be reopened.
+int audio_watch_read(audio_watch_t* watch);
+void audio_watch_close(audio_watch_t* watch);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // AUDIO_DEVICES_H
\ No newline at end of file
@@ -0,0 +1,325 @@
+// audio_devices.hpp - C++ wrapper over the audio device enumeration API
+#ifndef AUDIO_DEVICES_HPP
+#define AUDIO_DEVICES_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include "audio_devices.h"
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define AUDIO_DEVICES_HAS_STD_SPAN 1
+#endif
+#endif
+
+namespace audio_devices {
+
+#ifdef AUDIO_DEVICES_HAS_STD_SPAN
+using DeviceSpan = std::span<const AudioDevice>;
+#else
+// Minimal stand-in for std::span<const AudioDevice> on C++17 toolchains
+class DeviceSpan {
+public:
+    constexpr DeviceSpan() noexcept = default;
+    constexpr DeviceSpan(const AudioDevice* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    constexpr const AudioDevice* data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr const AudioDevice* begin() const noexcept { return data_; }
+    constexpr const AudioDevice* end() const noexcept { return data_ + size_; }
+    constexpr const AudioDevice& operator[](std::size_t i) const noexcept { return data_[i]; }
+
+private:
+    const AudioDevice* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+#endif
+
+// Enum names, usable in constant expressions. They match
+// device_type_to_string / connection_type_to_string / direction_to_string.
+constexpr std::string_view to_string(AudioDeviceType type) noexcept {
+    switch (type) {
+        case DEVICE_TYPE_SPEAKERS: return "Speakers";
+        case DEVICE_TYPE_HEADPHONES: return "Headphones";
+        case DEVICE_TYPE_HDMI: return "HDMI";
+        case DEVICE_TYPE_USB: return "USB Audio";
+        case DEVICE_TYPE_BLUETOOTH: return "Bluetooth";
+        case DEVICE_TYPE_VIRTUAL: return "Virtual";
+        default: return "Unknown";
+    }
+}
+
+constexpr std::string_view to_string(AudioConnectionType connection) noexcept {
+    switch (connection) {
+        case CONNECTION_BUILTIN: return "Built-in";
+        case CONNECTION_WIRED: return "Wired";
+        case CONNECTION_WIRELESS: return "Wireless";
+        default: return "Unknown";
+    }
+}
+
+constexpr std::string_view to_string(AudioDeviceDirection direction) noexcept {
+    switch (direction) {
+        case DEVICE_DIRECTION_PLAYBACK: return "playback";
+        case DEVICE_DIRECTION_CAPTURE: return "capture";
+        case DEVICE_DIRECTION_ALL: return "all";
+        default: return "unknown";
+    }
+}
+
+namespace detail {
+template <std::size_t N>
+inline std::string_view field(const char (&text)[N]) noexcept {
+    const void* nul = std::memchr(text, '\0', N);
+    return std::string_view(text, nul ? static_cast<const char*>(nul) - text : N);
+}
+} // namespace detail
+
+// String accessors view the fixed-size fields in place
+inline std::string_view name(const AudioDevice& d) noexcept { return detail::field(d.name); }
+inline std::string_view id(const AudioDevice& d) noexcept { return detail::field(d.id); }
+inline std::string_view manufacturer(const AudioDevice& d) noexcept { return detail::field(d.manufacturer); }
+inline std::string_view model(const AudioDevice& d) noexcept { return detail::field(d.model); }
+inline std::string_view serial_number(const AudioDevice& d) noexcept { return detail::field(d.serial_number); }
+inline std::string_view transport_type_name(const AudioDevice& d) noexcept { return detail::field(d.transport_type_name); }
+inline std::string_view data_source(const AudioDevice& d) noexcept { return detail::field(d.data_source); }
+inline std::string_view clock_source(const AudioDevice& d) noexcept { return detail::field(d.clock_source); }
+inline std::string_view duplex_peer_id(const AudioDevice& d) noexcept { return detail::field(d.duplex_peer_id); }
+inline std::string_view hardware_id(const AudioDevice& d) noexcept { return detail::field(d.hardware_id); }
+
+// Requested stream format. Zero fields match anything.
+struct Format {
+    int sample_rate = 0;
+    int bit_depth = 0;
+    int channels = 0;
+};
+
+// Filter predicates
+struct IsDefault {
+    constexpr bool operator()(const AudioDevice& d) const noexcept { return d.is_default; }
+};
+
+struct ByType {
+    AudioDeviceType type;
+    constexpr bool operator()(const AudioDevice& d) const noexcept { return d.type == type; }
+};
+
+struct ByConnection {
+    AudioConnectionType connection;
+    constexpr bool operator()(const AudioDevice& d) const noexcept { return d.connection == connection; }
+};
+
+struct ByDirection {
+    AudioDeviceDirection direction;
+    constexpr bool operator()(const AudioDevice& d) const noexcept { return (d.direction & direction) != 0; }
+};
+
+// The format an enumerated entry reports. That is the current mix format
+// on Windows and macOS and nothing at all for ALSA hardware entries, so
+// this says whether the device's reported format agrees with the request,
+// not what the device accepts: a property the entry reports as zero is
+// unknown and passes. Use probe_audio_device() and supports() for the
+// latter. Channels are compared in the device's direction: input channels
+// for a capture endpoint, output channels for a playback one, and the
+// wider of the two for an entry listed in both.
+struct MatchesReportedFormat {
+    Format format;
+    constexpr bool operator()(const AudioDevice& d) const noexcept {
+        int channels = channels_for(d);
+        return (format.sample_rate == 0 || d.sample_rate == 0 || d.sample_rate == format.sample_rate) &&
+               (format.bit_depth == 0 || d.bit_depth == 0 || d.bit_depth >= format.bit_depth) &&
+               (format.channels == 0 || channels == 0 || channels >= format.channels);
+    }
+
+private:
+    static constexpr int channels_for(const AudioDevice& d) noexcept {
+        switch (d.direction) {
+            case DEVICE_DIRECTION_CAPTURE: return d.input_channels;
+            case DEVICE_DIRECTION_PLAYBACK: return d.output_channels;
+            default: return d.input_channels > d.output_channels ? d.input_channels : d.output_channels;
+        }
+    }
+};
+
+// Whether probed caps accept a format: the rate and channel count within
+// the reported ranges, and a sample format of at least the requested
+// depth (FLOAT counts as 32 bits). Unlike the enumerated fields, probed
+// caps are never unknown, so a zero range accepts nothing.
+constexpr bool supports(const AudioDeviceCaps& caps, Format format) noexcept {
+    unsigned int depths = format.bit_depth > 32 ? 0u : AUDIO_FORMAT_S32 | AUDIO_FORMAT_FLOAT;
+    if (format.bit_depth <= 24) depths |= AUDIO_FORMAT_S24;
+    if (format.bit_depth <= 16) depths |= AUDIO_FORMAT_S16;
+    return (format.sample_rate == 0 ? caps.max_sample_rate > 0 :
+                caps.min_sample_rate <= format.sample_rate && format.sample_rate <= caps.max_sample_rate) &&
+           (format.channels == 0 ? caps.max_channels > 0 :
+                caps.min_channels <= format.channels && format.channels <= caps.max_channels) &&
+           (caps.formats & depths) != 0;
+}
+
+constexpr IsDefault is_default() noexcept { return {}; }
+constexpr ByType by_type(AudioDeviceType type) noexcept { return {type}; }
+constexpr ByConnection by_connection(AudioConnectionType connection) noexcept { return {connection}; }
+constexpr ByDirection by_direction(AudioDeviceDirection direction) noexcept { return {direction}; }
+constexpr MatchesReportedFormat matches_reported_format(Format format) noexcept { return {format}; }
+
+// Lazy filtered view over a device span. Iteration skips non-matching
+// entries on the fly; nothing is copied or allocated.
+template <class Pred>
+class FilterView {
+public:
+    class iterator {
+    public:
+        using value_type = AudioDevice;
+        using reference = const AudioDevice&;
+        using pointer = const AudioDevice*;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr iterator(const AudioDevice* pos, const AudioDevice* end, const Pred* pred) noexcept
+            : pos_(pos), end_(end), pred_(pred) { skip(); }
+
+        constexpr reference operator*() const noexcept { return *pos_; }
+        constexpr pointer operator->() const noexcept { return pos_; }
+        constexpr iterator& operator++() noexcept { ++pos_; skip(); return *this; }
+        constexpr iterator operator++(int) noexcept { iterator prev = *this; ++*this; return prev; }
+        constexpr bool operator==(const iterator& other) const noexcept { return pos_ == other.pos_; }
+        constexpr bool operator!=(const iterator& other) const noexcept { return pos_ != other.pos_; }
+
+    private:
+        constexpr void skip() noexcept {
+            while (pos_ != end_ && !(*pred_)(*pos_)) ++pos_;
+        }
+
+        const AudioDevice* pos_;
+        const AudioDevice* end_;
+        const Pred* pred_;
+    };
+
+    constexpr FilterView(DeviceSpan devices, Pred pred) noexcept : devices_(devices), pred_(pred) {}
+
+    constexpr iterator begin() const noexcept {
+        return iterator(devices_.data(), devices_.data() + devices_.size(), &pred_);
+    }
+    constexpr iterator end() const noexcept {
+        const AudioDevice* last = devices_.data() + devices_.size();
+        return iterator(last, last, &pred_);
+    }
+    constexpr bool empty() const noexcept { return begin() == end(); }
+    constexpr const AudioDevice* first() const noexcept {
+        iterator it = begin();
+        return it == end() ? nullptr : &*it;
+    }
+
+    // Chain another filter: list | by_type(...) | is_default()
+    template <class Next>
+    constexpr auto operator|(Next next) const noexcept {
+        Pred pred = pred_;
+        return FilterView<And<Next>>(devices_, And<Next>{pred, next});
+    }
+
+private:
+    template <class Next>
+    struct And {
+        Pred first;
+        Next second;
+        constexpr bool operator()(const AudioDevice& d) const noexcept { return first(d) && second(d); }
+    };
+
+    DeviceSpan devices_;
+    Pred pred_;
+};
+
+// Move-only owner of one enumeration snapshot
+class DeviceList {
+public:
+    DeviceList() noexcept = default;
+    ~DeviceList() { free_audio_devices(devices_); }
+
+    DeviceList(const DeviceList&) = delete;
+    DeviceList& operator=(const DeviceList&) = delete;
+
+    DeviceList(DeviceList&& other) noexcept
+        : devices_(std::exchange(other.devices_, nullptr)), count_(std::exchange(other.count_, 0)) {}
+
+    DeviceList& operator=(DeviceList&& other) noexcept {
+        if (this != &other) {
+            free_audio_devices(devices_);
+            devices_ = std::exchange(other.devices_, nullptr);
+            count_ = std::exchange(other.count_, 0);
+        }
+        return *this;
+    }
+
+    // Takes ownership of a buffer from list_audio_devices()
+    static DeviceList adopt(AudioDevice* devices, int count) noexcept {
+        DeviceList list;
+        list.devices_ = devices;
+        list.count_ = count > 0 ? static_cast<std::size_t>(count) : 0;
+        return list;
+    }
+
+    static DeviceList enumerate(AudioDeviceDirection direction = DEVICE_DIRECTION_PLAYBACK) noexcept;
+
+    DeviceSpan devices() const noexcept { return DeviceSpan(devices_, count_); }
+    const AudioDevice* begin() const noexcept { return devices_; }
+    const AudioDevice* end() const noexcept { return devices_ + count_; }
+    std::size_t size() const noexcept { return count_; }
+    bool empty() const noexcept { return count_ == 0; }
+    const AudioDevice& operator[](std::size_t i) const noexcept { return devices_[i]; }
+
+    const AudioDevice* find(std::string_view device_id) const noexcept;
+    const AudioDevice* default_device() const noexcept { return filter(is_default()).first(); }
+
+    template <class Pred>
+    FilterView<Pred> filter(Pred pred) const noexcept { return FilterView<Pred>(devices(), pred); }
+
+private:
+    AudioDevice* devices_ = nullptr;
+    std::size_t count_ = 0;
+};
+
+template <class Pred>
+inline FilterView<Pred> operator|(const DeviceList& list, Pred pred) noexcept {
+    return list.filter(pred);
+}
+
+// RAII owner of an audio_ctx_t for repeated enumeration
+class Context {
+public:
+    Context() noexcept : ctx_(audio_ctx_create()) {}
+    ~Context() { audio_ctx_destroy(ctx_); }
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    Context(Context&& other) noexcept : ctx_(std::exchange(other.ctx_, nullptr)) {}
+    Context& operator=(Context&& other) noexcept {
+        if (this != &other) {
+            audio_ctx_destroy(ctx_);
+            ctx_ = std::exchange(other.ctx_, nullptr);
+        }
+        return *this;
+    }
+
+    explicit operator bool() const noexcept { return ctx_ != nullptr; }
+    audio_ctx_t* get() const noexcept { return ctx_; }
+    void set_flags(unsigned int flags) const noexcept { audio_ctx_set_flags(ctx_, flags); }
+    void set_roots(const char* sysfs_root, const char* proc_root) const noexcept {
+        audio_ctx_set_roots(ctx_, sysfs_root, proc_root);
+    }
+    int card_power(AudioCardPower* cards, int max_cards) const noexcept {
+        return audio_ctx_card_power(ctx_, cards, max_cards);
+    }
+
+    DeviceList list(AudioDeviceDirection direction = DEVICE_DIRECTION_PLAYBACK) const noexcept;
+
+private:
+    audio_ctx_t* ctx_;
+};
+
+} // namespace audio_devices
+
+#endif // AUDIO_DEVICES_HPP
@@ -0,0 +1,364 @@
+// audio_devices_async.cpp - Poll loop, worker pool and awaiters of the coroutine API
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include "audio_devices_async.hpp"
+
+namespace audio_devices {
+
+PollLoop::PollLoop() {
+    if (pipe(wake_fds_) == 0) {
+        for (int fd : wake_fds_) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+}
+
+PollLoop::~PollLoop() {
+    for (int fd : wake_fds_) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void PollLoop::wake() noexcept {
+    // A full pipe already has a wake-up pending
+    char byte = 0;
+    ssize_t written = write(wake_fds_[1], &byte, 1);
+    (void)written;
+}
+
+void PollLoop::post(Operation* op) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        op->next = nullptr;
+        if (ready_tail_ != nullptr) {
+            ready_tail_->next = op;
+        } else {
+            ready_head_ = op;
+        }
+        ready_tail_ = op;
+    }
+    wake();
+}
+
+void PollLoop::watch(FdWait* wait) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wait->cancelled = false;
+        wait->next = waits_;
+        waits_ = wait;
+    }
+    wake();
+}
+
+bool PollLoop::unlink(FdWait* wait) noexcept {
+    FdWait* previous = nullptr;
+    for (FdWait* armed = waits_; armed != nullptr; armed = static_cast<FdWait*>(armed->next)) {
+        if (armed == wait) {
+            if (previous != nullptr) {
+                previous->next = wait->next;
+            } else {
+                waits_ = static_cast<FdWait*>(wait->next);
+            }
+            return true;
+        }
+        previous = armed;
+    }
+    return false;
+}
+
+bool PollLoop::cancel(FdWait* wait) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!unlink(wait)) return false;
+        wait->cancelled = true;
+    }
+    post(wait);
+    return true;
+}
+
+void PollLoop::stop() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    wake();
+}
+
+Operation* PollLoop::pop() noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Operation* op = ready_head_;
+    if (op != nullptr) {
+        ready_head_ = op->next;
+        if (ready_head_ == nullptr) ready_tail_ = nullptr;
+        op->next = nullptr;
+    }
+    return op;
+}
+
+void PollLoop::run() {
+    for (;;) {
+        // One at a time: a resumed coroutine may post, arm or cancel
+        // others, or destroy them
+        while (Operation* op = pop()) {
+            op->continuation.resume();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_) {
+                stopped_ = false;
+                return;
+            }
+            if (ready_head_ != nullptr) continue;
+
+            pollfds_.clear();
+            owners_.clear();
+            pollfds_.push_back(pollfd{ wake_fds_[0], POLLIN, 0 });
+            owners_.push_back(nullptr);
+            for (FdWait* wait = waits_; wait != nullptr; wait = static_cast<FdWait*>(wait->next)) {
+                for (int i = 0; i < wait->count; i++) {
+                    pollfds_.push_back(pollfd{ wait->fds[i], POLLIN, 0 });
+                    owners_.push_back(wait);
+                }
+            }
+        }
+
+        if (poll(pollfds_.data(), static_cast<nfds_t>(pollfds_.size()), -1) < 0 && errno != EINTR) return;
+
+        if (pollfds_[0].revents & POLLIN) {
+            char buffer[64];
+            while (read(wake_fds_[0], buffer, sizeof(buffer)) > 0) {}
+        }
+
+        // A wait cancelled since the pollfds were built is no longer
+        // linked and is skipped
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::size_t i = 1; i < pollfds_.size(); i++) {
+            if (pollfds_[i].revents == 0 || !unlink(owners_[i])) continue;
+            owners_[i]->next = nullptr;
+            if (ready_tail_ != nullptr) {
+                ready_tail_->next = owners_[i];
+            } else {
+                ready_head_ = owners_[i];
+            }
+            ready_tail_ = owners_[i];
+        }
+    }
+}
+
+WorkerPool::WorkerPool(int threads) {
+    if (threads < 1) threads = 1;
+    threads_.reserve(static_cast<std::size_t>(threads));
+    for (int i = 0; i < threads; i++) {
+        threads_.emplace_back([this] { work(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) thread.join();
+
+    // Nothing runs jobs still queued; hand them back as cancelled
+    while (head_ != nullptr) {
+        Job* job = static_cast<Job*>(head_);
+        head_ = job->next;
+        job->cancelled = true;
+        job->executor->post(job);
+    }
+}
+
+void WorkerPool::submit(Job* job) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job->next = nullptr;
+        job->cancelled = false;
+        if (tail_ != nullptr) {
+            tail_->next = job;
+        } else {
+            head_ = job;
+        }
+        tail_ = job;
+    }
+    wake_.notify_one();
+}
+
+bool WorkerPool::cancel(Job* job) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Operation* previous = nullptr;
+        Operation* op = head_;
+        while (op != nullptr && op != job) {
+            previous = op;
+            op = op->next;
+        }
+        if (op == nullptr) return false;
+
+        if (previous != nullptr) {
+            previous->next = job->next;
+        } else {
+            head_ = job->next;
+        }
+        if (tail_ == job) tail_ = previous;
+        job->cancelled = true;
+    }
+    job->executor->post(job);
+    return true;
+}
+
+void WorkerPool::work() {
+    for (;;) {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || head_ != nullptr; });
+            if (stopping_) return;
+            job = static_cast<Job*>(head_);
+            head_ = job->next;
+            if (head_ == nullptr) tail_ = nullptr;
+        }
+        job->run(job->context);
+        job->executor->post(job);
+    }
+}
+
+namespace detail {
+
+PoolCall::PoolCall(AsyncEnumerator& owner, std::stop_token stop, void (*run)(void*)) noexcept
+    : owner_(owner), stop_(std::move(stop)) {
+    job_.run = run;
+    job_.context = this;
+    job_.executor = &owner.executor_;
+}
+
+bool PoolCall::await_suspend(std::coroutine_handle<> continuation) noexcept {
+    if (stop_.stop_requested()) {
+        job_.cancelled = true;
+        return false;
+    }
+    job_.continuation = continuation;
+    owner_.pool_.submit(&job_);
+    // Runs the callback right here if a stop raced with the submit; the
+    // coroutine is still only resumed by the executor
+    on_stop_.emplace(stop_, Cancel{this});
+    return true;
+}
+
+void PoolCall::Cancel::operator()() const noexcept {
+    call->owner_.pool_.cancel(&call->job_);
+}
+
+} // namespace detail
+
+AsyncEnumerator::AsyncEnumerator(Executor& executor, int threads)
+    : executor_(executor), pool_(threads) {}
+
+AsyncEnumerator::~AsyncEnumerator() {
+    audio_watch_close(watch_);
+}
+
+void AsyncEnumerator::install_watch(audio_watch_t* watch) noexcept {
+    close_watch();
+    watch_ = watch;
+    watch_fd_count_ = audio_watch_descriptors(watch_, watch_fds_, max_watch_fds);
+}
+
+void AsyncEnumerator::close_watch() noexcept {
+    audio_watch_close(watch_);
+    watch_ = nullptr;
+    watch_fd_count_ = 0;
+}
+
+AsyncEnumerator::ListAwaiter::ListAwaiter(AsyncEnumerator& owner, AudioDevice* devices, int max_devices,
+                                          AudioDeviceDirection direction, std::stop_token stop) noexcept
+    : PoolCall(owner, std::move(stop), &ListAwaiter::run),
+      devices_(devices), max_devices_(max_devices), direction_(direction) {}
+
+void AsyncEnumerator::ListAwaiter::run(void* self) noexcept {
+    ListAwaiter* awaiter = static_cast<ListAwaiter*>(static_cast<PoolCall*>(self));
+    awaiter->count_ = audio_ctx_list_devices(awaiter->owner_.context_.get(), awaiter->direction_,
+                                             awaiter->devices_, awaiter->max_devices_);
+}
+
+Listed AsyncEnumerator::ListAwaiter::await_resume() const noexcept {
+    if (cancelled()) return Listed{ Status::cancelled, 0 };
+    if (!owner_.context_) return Listed{ Status::failed, 0 };
+    return Listed{ Status::ok, count_ };
+}
+
+AsyncEnumerator::ProbeAwaiter::ProbeAwaiter(AsyncEnumerator& owner, const AudioDevice& device,
+                                            std::stop_token stop) noexcept
+    : PoolCall(owner, std::move(stop), &ProbeAwaiter::run), device_(&device) {}
+
+void AsyncEnumerator::ProbeAwaiter::run(void* self) noexcept {
+    ProbeAwaiter* awaiter = static_cast<ProbeAwaiter*>(static_cast<PoolCall*>(self));
+    awaiter->result_ = probe_audio_device(awaiter->device_, &awaiter->caps_);
+}
+
+Probed AsyncEnumerator::ProbeAwaiter::await_resume() const noexcept {
+    if (cancelled()) return Probed{ Status::cancelled, {} };
+    if (result_ != 0) return Probed{ Status::failed, {} };
+    return Probed{ Status::ok, caps_ };
+}
+
+AsyncEnumerator::ChangeAwaiter::ChangeAwaiter(AsyncEnumerator& owner, std::stop_token stop) noexcept
+    : owner_(owner), stop_(std::move(stop)) {
+    job_.run = &ChangeAwaiter::open;
+    job_.context = this;
+    job_.executor = &owner.executor_;
+}
+
+void AsyncEnumerator::ChangeAwaiter::open(void* self) noexcept {
+    static_cast<ChangeAwaiter*>(self)->opened_ = audio_watch_open();
+}
+
+bool AsyncEnumerator::ChangeAwaiter::await_suspend(std::coroutine_handle<> continuation) noexcept {
+    if (stop_.stop_requested()) {
+        stopped_early_ = true;
+        return false;
+    }
+
+    opening_ = owner_.watch_ == nullptr;
+    if (opening_) {
+        job_.continuation = continuation;
+        owner_.pool_.submit(&job_);
+    } else {
+        wait_.continuation = continuation;
+        wait_.fds = owner_.watch_fds_;
+        wait_.count = owner_.watch_fd_count_;
+        owner_.executor_.watch(&wait_);
+    }
+    on_stop_.emplace(stop_, Cancel{this});
+    return true;
+}
+
+void AsyncEnumerator::ChangeAwaiter::Cancel::operator()() const noexcept {
+    if (awaiter->opening_) {
+        awaiter->owner_.pool_.cancel(&awaiter->job_);
+    } else {
+        awaiter->owner_.executor_.cancel(&awaiter->wait_);
+    }
+}
+
+Status AsyncEnumerator::ChangeAwaiter::await_resume() noexcept {
+    if (stopped_early_) return Status::cancelled;
+
+    if (opening_) {
+        // Keep a watch that opened even if the wait was cancelled meanwhile
+        if (opened_ != nullptr) owner_.install_watch(opened_);
+        if (job_.cancelled || stop_.stop_requested()) return Status::cancelled;
+        return opened_ != nullptr ? Status::ok : Status::failed;
+    }
+
+    if (wait_.cancelled) return Status::cancelled;
+    // Cards came or went: the next call reopens the control devices
+    if (audio_watch_read(owner_.watch_) < 0) owner_.close_watch();
+    return Status::ok;
+}
+
+} // namespace audio_devices
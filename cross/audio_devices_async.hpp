@@ -0,0 +1,361 @@
+// audio_devices_async.hpp - C++20 coroutine API over enumeration, probing and change notifications
+#ifndef AUDIO_DEVICES_ASYNC_HPP
+#define AUDIO_DEVICES_ASYNC_HPP
+
+#include <poll.h>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "audio_devices.hpp"
+
+namespace audio_devices {
+
+enum class Status { ok, cancelled, failed };
+
+// A suspended coroutine waiting to be resumed. Nodes live inside the
+// awaiters, and so in the awaiting coroutine's frame: queueing one on the
+// executor or the worker pool never allocates.
+struct Operation {
+    Operation* next = nullptr;
+    std::coroutine_handle<> continuation;
+};
+
+// Wait for any of a set of descriptors to become readable
+struct FdWait : Operation {
+    const int* fds = nullptr;
+    int count = 0;
+    bool cancelled = false;
+};
+
+// Where coroutines resume. post(), watch() and cancel() may be called from
+// any thread, but operations are only ever resumed on the executor's own
+// thread and never from inside those calls. An io_uring loop implements
+// watch() with one POLL_ADD per descriptor and cancel() with POLL_REMOVE.
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    virtual void post(Operation* op) noexcept = 0;
+    // Arm a one-shot wait, resumed once any of its descriptors is readable
+    virtual void watch(FdWait* wait) noexcept = 0;
+    // Resume an armed wait with cancelled set. Returns false when it
+    // already fired.
+    virtual bool cancel(FdWait* wait) noexcept = 0;
+};
+
+// Single-threaded executor over poll(2)
+class PollLoop final : public Executor {
+public:
+    PollLoop();
+    ~PollLoop() override;
+
+    PollLoop(const PollLoop&) = delete;
+    PollLoop& operator=(const PollLoop&) = delete;
+
+    void post(Operation* op) noexcept override;
+    void watch(FdWait* wait) noexcept override;
+    bool cancel(FdWait* wait) noexcept override;
+
+    // Resume operations as they become ready until stop() is called
+    void run();
+    void stop() noexcept;
+
+private:
+    void wake() noexcept;
+    bool unlink(FdWait* wait) noexcept;     // under mutex_
+    Operation* pop() noexcept;
+
+    std::mutex mutex_;
+    Operation* ready_head_ = nullptr;
+    Operation* ready_tail_ = nullptr;
+    FdWait* waits_ = nullptr;               // armed, linked through next
+    bool stopped_ = false;
+    int wake_fds_[2] = { -1, -1 };
+    // Rebuilt on every pass; only ever grows, so a steady state of waits
+    // polls without allocating
+    std::vector<pollfd> pollfds_;
+    std::vector<FdWait*> owners_;
+};
+
+// A blocking call run on a worker thread. The job is posted back to its
+// executor when the call returns, or straight away, with cancelled set,
+// if it is taken back before a worker picks it up.
+struct Job : Operation {
+    void (*run)(void* context) = nullptr;
+    void* context = nullptr;
+    Executor* executor = nullptr;
+    bool cancelled = false;
+};
+
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads = 2);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(Job* job) noexcept;
+    // Returns false once a worker started the job
+    bool cancel(Job* job) noexcept;
+
+private:
+    void work();
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    Operation* head_ = nullptr;             // queued jobs, linked through next
+    Operation* tail_ = nullptr;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+namespace detail {
+
+struct TaskPromiseBase {
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() const noexcept { std::terminate(); }
+
+    std::coroutine_handle<> continuation;
+};
+
+template <class T>
+struct TaskPromise : TaskPromiseBase {
+    void return_value(T value) { result.emplace(std::move(value)); }
+    T take() { return std::move(*result); }
+
+    std::optional<T> result;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    void return_void() const noexcept {}
+    void take() const noexcept {}
+};
+
+} // namespace detail
+
+// Lazily started coroutine. Awaiting a task runs it and resumes the
+// awaiter when it finishes, by symmetric transfer; a top-level task is
+// started with start() and has to stay alive until done().
+template <class T = void>
+class Task {
+public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct promise_type : detail::TaskPromise<T> {
+        Task get_return_object() noexcept { return Task(handle_type::from_promise(*this)); }
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    void start() noexcept { handle_.resume(); }
+    bool done() const noexcept { return !handle_ || handle_.done(); }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            handle_type handle;
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                handle.promise().continuation = continuation;
+                return handle;
+            }
+            T await_resume() { return handle.promise().take(); }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    explicit Task(handle_type handle) noexcept : handle_(handle) {}
+
+    handle_type handle_;
+};
+
+struct Listed {
+    Status status = Status::failed;
+    int count = 0;              // devices found; may exceed the buffer, as with audio_ctx_list_devices
+};
+
+struct Probed {
+    Status status = Status::failed;
+    AudioDeviceCaps caps = {};
+};
+
+class AsyncEnumerator;
+
+namespace detail {
+
+// Awaiter for one blocking call on the pool. It doesn't move once
+// suspended: it's a temporary in the awaiting coroutine's frame.
+class PoolCall {
+public:
+    PoolCall(const PoolCall&) = delete;
+    PoolCall& operator=(const PoolCall&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> continuation) noexcept;
+
+protected:
+    PoolCall(AsyncEnumerator& owner, std::stop_token stop, void (*run)(void*)) noexcept;
+
+    // A request_stop() takes the job back if it is still queued; a
+    // running call can't be interrupted and is reported cancelled once it
+    // returns
+    bool cancelled() const noexcept { return job_.cancelled || stop_.stop_requested(); }
+
+    AsyncEnumerator& owner_;
+
+private:
+    struct Cancel {
+        PoolCall* call;
+        void operator()() const noexcept;
+    };
+
+    Job job_;
+    std::stop_token stop_;
+    std::optional<std::stop_callback<Cancel>> on_stop_;
+};
+
+} // namespace detail
+
+// Enumeration, probing and change notifications for event-loop callers.
+// Blocking ALSA calls (snd_ctl_open, snd_pcm_open, which can take hundreds
+// of milliseconds while a USB device wakes up) run on a small internal
+// pool; change notifications are waited for through the control devices'
+// poll descriptors on the executor. Every coroutine resumes on the
+// executor.
+class AsyncEnumerator {
+public:
+    static constexpr int max_watch_fds = 64;
+
+    explicit AsyncEnumerator(Executor& executor, int threads = 2);
+    ~AsyncEnumerator();
+
+    AsyncEnumerator(const AsyncEnumerator&) = delete;
+    AsyncEnumerator& operator=(const AsyncEnumerator&) = delete;
+
+    // co_await enumerate(buffer, max, direction, stop) -> Listed. Queries
+    // share one Context, so overlapping enumerations run one at a time.
+    class ListAwaiter : public detail::PoolCall {
+    public:
+        ListAwaiter(AsyncEnumerator& owner, AudioDevice* devices, int max_devices,
+                    AudioDeviceDirection direction, std::stop_token stop) noexcept;
+        Listed await_resume() const noexcept;
+
+    private:
+        static void run(void* self) noexcept;
+
+        AudioDevice* devices_;
+        int max_devices_;
+        AudioDeviceDirection direction_;
+        int count_ = 0;
+    };
+
+    // co_await probe(device, stop) -> Probed. The device has to outlive
+    // the await.
+    class ProbeAwaiter : public detail::PoolCall {
+    public:
+        ProbeAwaiter(AsyncEnumerator& owner, const AudioDevice& device, std::stop_token stop) noexcept;
+        Probed await_resume() const noexcept;
+
+    private:
+        static void run(void* self) noexcept;
+
+        const AudioDevice* device_;
+        AudioDeviceCaps caps_ = {};
+        int result_ = -1;
+    };
+
+    // co_await changed(stop) -> Status. Completes when devices may have
+    // changed, so a caller re-enumerates after each one. The first call,
+    // and the first after cards came or went, (re)opens the control
+    // devices on the pool and completes as soon as they are open. Only one
+    // coroutine may wait at a time; a wait can complete without a visible
+    // change. Fails on backends without pollable notifications.
+    class ChangeAwaiter {
+    public:
+        ChangeAwaiter(AsyncEnumerator& owner, std::stop_token stop) noexcept;
+        ChangeAwaiter(const ChangeAwaiter&) = delete;
+        ChangeAwaiter& operator=(const ChangeAwaiter&) = delete;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> continuation) noexcept;
+        Status await_resume() noexcept;
+
+    private:
+        struct Cancel {
+            ChangeAwaiter* awaiter;
+            void operator()() const noexcept;
+        };
+
+        static void open(void* self) noexcept;
+
+        AsyncEnumerator& owner_;
+        std::stop_token stop_;
+        bool opening_ = false;
+        bool stopped_early_ = false;
+        audio_watch_t* opened_ = nullptr;
+        Job job_;
+        FdWait wait_;
+        std::optional<std::stop_callback<Cancel>> on_stop_;
+    };
+
+    ListAwaiter enumerate(AudioDevice* devices, int max_devices,
+                          AudioDeviceDirection direction = DEVICE_DIRECTION_PLAYBACK,
+                          std::stop_token stop = {}) noexcept {
+        return ListAwaiter(*this, devices, max_devices, direction, std::move(stop));
+    }
+
+    ProbeAwaiter probe(const AudioDevice& device, std::stop_token stop = {}) noexcept {
+        return ProbeAwaiter(*this, device, std::move(stop));
+    }
+
+    ChangeAwaiter changed(std::stop_token stop = {}) noexcept {
+        return ChangeAwaiter(*this, std::move(stop));
+    }
+
+    Executor& executor() const noexcept { return executor_; }
+
+private:
+    friend class detail::PoolCall;
+
+    void install_watch(audio_watch_t* watch) noexcept;
+    void close_watch() noexcept;
+
+    Executor& executor_;
+    Context context_;
+    audio_watch_t* watch_ = nullptr;
+    int watch_fds_[max_watch_fds];
+    int watch_fd_count_ = 0;
+    WorkerPool pool_;           // last, so workers stop before the rest goes
+};
+
+} // namespace audio_devices
+
+#endif // AUDIO_DEVICES_ASYNC_HPP
@@ -0,0 +1,43 @@
+// audio_devices_cpp.cpp - Out-of-line parts of the C++ wrapper
+#include <cstdlib>
+#include "audio_devices.hpp"
+
+namespace audio_devices {
+
+static_assert(to_string(DEVICE_TYPE_HDMI) == "HDMI", "enum names must be constant expressions");
+static_assert(to_string(CONNECTION_WIRELESS) == "Wireless", "enum names must be constant expressions");
+static_assert(to_string(DEVICE_DIRECTION_CAPTURE) == "capture", "enum names must be constant expressions");
+
+DeviceList DeviceList::enumerate(AudioDeviceDirection direction) noexcept {
+    AudioDevice* devices = nullptr;
+    int count = list_audio_devices(&devices, direction);
+    return adopt(devices, count);
+}
+
+const AudioDevice* DeviceList::find(std::string_view device_id) const noexcept {
+    for (const AudioDevice& device : devices()) {
+        if (id(device) == device_id) return &device;
+    }
+    return nullptr;
+}
+
+DeviceList Context::list(AudioDeviceDirection direction) const noexcept {
+    if (ctx_ == nullptr) return DeviceList();
+
+    // The buffer is handed to DeviceList, which releases it with
+    // free_audio_devices(), so it has to come from malloc
+    int capacity = 32;
+    for (;;) {
+        AudioDevice* devices = static_cast<AudioDevice*>(std::malloc(sizeof(AudioDevice) * capacity));
+        if (devices == nullptr) return DeviceList();
+
+        int count = audio_ctx_list_devices(ctx_, direction, devices, capacity);
+        if (count <= capacity) return DeviceList::adopt(devices, count);
+
+        // More devices appeared than fit; retry with room for all of them
+        std::free(devices);
+        capacity = count;
+    }
+}
+
+} // namespace audio_devices
@@ -0,0 +1,90 @@
+// bench_meter.c - Metering throughput at 2, 8 and 32 channels, per kernel set
+//
+// Usage: bench_meter [seconds per run]
+//
+// Prints how many times faster than real time meter_process runs on 48 kHz
+// noise, with the default publish rate.
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "meter.h"
+#include "sample_convert.h"
+
+#define RATE 48000
+#define BLOCK_FRAMES 1024       // a typical capture read
+
+static long readings;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void count_reading(const MeterReading* reading, void* user) {
+    (void)reading;
+    (void)user;
+    readings++;
+}
+
+// Stream seconds metered per wall-clock second
+static double measure(int channels, const float* block, double seconds) {
+    MeterConfig config;
+    meter_default_config(&config);
+    config.sample_rate = RATE;
+    config.channels = channels;
+    Meter* meter = meter_create(&config);
+    if (meter == NULL) return 0.0;
+
+    long frames = 0;
+    double start = now(), elapsed;
+    do {
+        for (int i = 0; i < 16; i++) meter_process(meter, block, BLOCK_FRAMES, count_reading, NULL);
+        frames += 16 * BLOCK_FRAMES;
+        elapsed = now() - start;
+    } while (elapsed < seconds);
+
+    meter_destroy(meter);
+    return (double)frames / RATE / elapsed;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    if (seconds <= 0) {
+        fprintf(stderr, "usage: %s [seconds per run]\n", argv[0]);
+        return 2;
+    }
+
+    float* block = (float*)malloc((size_t)BLOCK_FRAMES * METER_MAX_CHANNELS * sizeof(float));
+    if (block == NULL) return 1;
+    srand(1);
+    for (int i = 0; i < BLOCK_FRAMES * METER_MAX_CHANNELS; i++) {
+        block[i] = ((float)rand() / RAND_MAX * 2.0f - 1.0f) * 0.5f;
+    }
+
+    static const int channel_counts[] = { 2, 8, 32 };
+    static const SampleIsa sets[] = { SAMPLE_ISA_SCALAR, SAMPLE_ISA_SSE2, SAMPLE_ISA_AVX2, SAMPLE_ISA_NEON };
+    size_t set_count = sizeof(sets) / sizeof(sets[0]);
+
+    printf("%-18s", "x realtime");
+    for (size_t s = 0; s < set_count; s++) printf("%10s", sample_isa_to_string(sets[s]));
+    printf("\n");
+
+    for (size_t c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++) {
+        char label[32];
+        snprintf(label, sizeof(label), "%d ch", channel_counts[c]);
+        printf("%-18s", label);
+        for (size_t s = 0; s < set_count; s++) {
+            if (sample_convert_set_isa(sets[s]) != 0) {
+                printf("%10s", "-");
+                continue;
+            }
+            printf("%10.0f", measure(channel_counts[c], block, seconds));
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    free(block);
+    return readings > 0 ? 0 : 1;
+}
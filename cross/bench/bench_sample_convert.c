@@ -0,0 +1,168 @@
+// bench_sample_convert.c - Throughput of each kernel set, at 1, 2, 8 and 32 channels
+//
+// Usage: bench_sample_convert [seconds per kernel]
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "sample_convert.h"
+
+#define FRAMES 1024             // one period
+#define MAX_CHANNELS 32
+#define SAMPLES (FRAMES * MAX_CHANNELS)
+
+static float input[SAMPLES];
+static float plane_data[SAMPLES];
+static float* planes[MAX_CHANNELS];
+static float output[SAMPLES * 2];
+static uint8_t native[SAMPLES * 4];
+static float wr[SAMPLES], wi[SAMPLES], ar[SAMPLES], ai[SAMPLES], br[SAMPLES], bi[SAMPLES];
+static volatile float sink;
+static int channels;
+static Resampler* resampler;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Each returns the samples it processed
+typedef long (*BenchFunc)(void);
+
+static long from_s16(void) { sample_convert_from_float(SAMPLE_FORMAT_S16, input, native, FRAMES * channels); return FRAMES * channels; }
+static long from_s24(void) { sample_convert_from_float(SAMPLE_FORMAT_S24, input, native, FRAMES * channels); return FRAMES * channels; }
+static long from_s32(void) { sample_convert_from_float(SAMPLE_FORMAT_S32, input, native, FRAMES * channels); return FRAMES * channels; }
+static long to_s16(void) { sample_convert_to_float(SAMPLE_FORMAT_S16, native, output, FRAMES * channels); return FRAMES * channels; }
+static long to_s32(void) { sample_convert_to_float(SAMPLE_FORMAT_S32, native, output, FRAMES * channels); return FRAMES * channels; }
+
+static long deinterleave(void) {
+    sample_deinterleave(input, planes, channels, FRAMES);
+    return FRAMES * channels;
+}
+
+static long interleave(void) {
+    sample_interleave((const float* const*)planes, output, channels, FRAMES);
+    return FRAMES * channels;
+}
+
+// 44.1 kHz program to a 48 kHz device, the usual fan-out case; counts the
+// input samples consumed
+static long resample(void) {
+    long consumed;
+    resampler_process(resampler, input, FRAMES, &consumed, output, FRAMES * 2);
+    return consumed * channels;
+}
+
+static long peak_energy(void) {
+    float peak, energy;
+    sample_peak_energy(input, FRAMES * 2, &peak, &energy);
+    sink = peak + energy;
+    return FRAMES * 2;
+}
+
+static long butterfly(void) {
+    sample_butterfly(ar, ai, br, bi, wr, wi, FRAMES * 2);
+    return FRAMES * 2;
+}
+
+// Per channel count
+static const struct {
+    const char* name;
+    BenchFunc func;
+} layout_benches[] = {
+    { "from_float s16", from_s16 },
+    { "from_float s24", from_s24 },
+    { "from_float s32", from_s32 },
+    { "to_float s16", to_s16 },
+    { "to_float s32", to_s32 },
+    { "deinterleave", deinterleave },
+    { "interleave", interleave },
+    { "resample 44.1k", resample },
+};
+
+// Over one run of samples, whatever the layout
+static const struct {
+    const char* name;
+    BenchFunc func;
+} flat_benches[] = {
+    { "peak_energy", peak_energy },
+    { "butterfly", butterfly },
+};
+
+static const int channel_counts[] = { 1, 2, 8, 32 };
+static const SampleIsa sets[] = { SAMPLE_ISA_SCALAR, SAMPLE_ISA_SSE2, SAMPLE_ISA_AVX2, SAMPLE_ISA_NEON };
+#define SET_COUNT (sizeof(sets) / sizeof(sets[0]))
+
+// Million samples per second over at least the given time
+static double measure(BenchFunc func, double seconds) {
+    long samples = 0;
+    double start = now(), elapsed;
+    do {
+        for (int i = 0; i < 64; i++) samples += func();
+        elapsed = now() - start;
+    } while (elapsed < seconds);
+    return (double)samples / elapsed / 1e6;
+}
+
+// One table row: the bench under every kernel set available
+static void run_row(const char* label, BenchFunc func, bool uses_resampler, double seconds) {
+    printf("%-22s", label);
+    for (size_t s = 0; s < SET_COUNT; s++) {
+        if (sample_convert_set_isa(sets[s]) != 0) {
+            printf("%10s", "-");
+            continue;
+        }
+        // The resampler binds its kernels when created
+        if (uses_resampler) {
+            resampler = resampler_create(44100, 48000, channels);
+            if (resampler == NULL) {
+                printf("%10s", "?");
+                continue;
+            }
+        }
+        printf("%10.0f", measure(func, seconds));
+        if (uses_resampler) {
+            resampler_destroy(resampler);
+            resampler = NULL;
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 0.2;
+    if (seconds <= 0) {
+        fprintf(stderr, "usage: %s [seconds per kernel]\n", argv[0]);
+        return 2;
+    }
+
+    srand(1);
+    for (int i = 0; i < SAMPLES; i++) {
+        input[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+        wr[i] = (float)rand() / RAND_MAX;
+        wi[i] = 1.0f - wr[i];
+        ar[i] = ai[i] = br[i] = bi[i] = 0.0f;
+    }
+    sample_convert_from_float(SAMPLE_FORMAT_S32, input, native, SAMPLES);
+    for (int c = 0; c < MAX_CHANNELS; c++) planes[c] = plane_data + c * FRAMES;
+
+    printf("%-22s", "Msamples/s");
+    for (size_t s = 0; s < SET_COUNT; s++) printf("%10s", sample_isa_to_string(sets[s]));
+    printf("\n");
+
+    for (size_t c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++) {
+        channels = channel_counts[c];
+        for (size_t b = 0; b < sizeof(layout_benches) / sizeof(layout_benches[0]); b++) {
+            char label[48];
+            snprintf(label, sizeof(label), "%s %dch", layout_benches[b].name, channels);
+            run_row(label, layout_benches[b].func, layout_benches[b].func == resample, seconds);
+        }
+    }
+    for (size_t b = 0; b < sizeof(flat_benches) / sizeof(flat_benches[0]); b++) {
+        run_row(flat_benches[b].name, flat_benches[b].func, false, seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+// card_power.c - Runtime power state of sound cards, and what procfs tells about them without waking them
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "card_power.h"
+#include "pcm_status.h"
+
+#if defined(__linux__)
+
+#include <dirent.h>
+
+// Read a small text file whole. Returns the length, or -1.
+static int read_text(const char* path, char* buffer, size_t size) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return -1;
+    size_t n = fread(buffer, 1, size - 1, file);
+    fclose(file);
+    buffer[n] = '\0';
+    return (int)n;
+}
+
+CardPowerState card_power_state(const char* sysfs_root, int card) {
+    if (sysfs_root == NULL) sysfs_root = CARD_POWER_DEFAULT_SYSFS_ROOT;
+
+    // The card's device is the PCI function, USB interface or platform
+    // device the driver bound to; its runtime PM covers the codecs below
+    char path[512];
+    char status[32];
+    snprintf(path, sizeof(path), "%s/class/sound/card%d/device/power/runtime_status", sysfs_root, card);
+    if (read_text(path, status, sizeof(status)) < 0) return CARD_POWER_UNKNOWN;
+
+    if (strncmp(status, "suspended", 9) == 0 || strncmp(status, "suspending", 10) == 0) {
+        return CARD_POWER_SUSPENDED;
+    }
+    if (strncmp(status, "active", 6) == 0 || strncmp(status, "resuming", 8) == 0) {
+        return CARD_POWER_ACTIVE;
+    }
+    // "unsupported" or "error": runtime PM doesn't manage the device
+    return CARD_POWER_UNKNOWN;
+}
+
+static int compare_cards(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+int card_power_list_cards(const char* sysfs_root, int* cards, int max_cards) {
+    if (sysfs_root == NULL) sysfs_root = CARD_POWER_DEFAULT_SYSFS_ROOT;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/class/sound", sysfs_root);
+    DIR* dir = opendir(path);
+    if (dir == NULL) return -1;
+
+    // Besides cardN the class holds the controlC, pcmC, hwC and midiC nodes
+    int count = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL && count < max_cards) {
+        int card;
+        char tail;
+        if (sscanf(ent->d_name, "card%d%c", &card, &tail) != 1 || card < 0) continue;
+        cards[count++] = card;
+    }
+    closedir(dir);
+
+    qsort(cards, (size_t)count, sizeof(int), compare_cards);
+    return count;
+}
+
+// Copy src up to the end of the line, without trailing blanks
+static void copy_line(char* out, size_t out_size, const char* src) {
+    size_t n = 0;
+    while (src[n] != '\0' && src[n] != '\n' && n + 1 < out_size) n++;
+    while (n > 0 && (src[n - 1] == ' ' || src[n - 1] == '\t')) n--;
+    memcpy(out, src, n);
+    out[n] = '\0';
+}
+
+int card_power_card_info(const char* proc_root, int card, char* name, size_t name_size,
+                         char* driver, size_t driver_size) {
+    if (proc_root == NULL) proc_root = PCM_STATUS_DEFAULT_ROOT;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/cards", proc_root);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return -1;
+
+    // " 0 [PCH            ]: HDA-Intel - HDA Intel PCH", then a second
+    // line with the long name that doesn't start with a number
+    char line[512];
+    int result = -1;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* end;
+        long number = strtol(line, &end, 10);
+        if (end == line || number != card) continue;
+
+        const char* fields = strstr(end, "]: ");
+        const char* separator = fields ? strstr(fields + 3, " - ") : NULL;
+        if (separator == NULL) break;
+
+        fields += 3;
+        size_t n = (size_t)(separator - fields);
+        if (n >= driver_size) n = driver_size - 1;
+        memcpy(driver, fields, n);
+        driver[n] = '\0';
+        copy_line(name, name_size, separator + 3);
+        result = 0;
+        break;
+    }
+    fclose(file);
+    return result;
+}
+
+static int compare_pcms(const void* a, const void* b) {
+    const CardPcm* x = a;
+    const CardPcm* y = b;
+    if (x->device != y->device) return x->device - y->device;
+    return (int)x->direction - (int)y->direction;
+}
+
+int card_power_list_pcms(const char* proc_root, int card, AudioDeviceDirection direction,
+                         CardPcm* pcms, int max_pcms) {
+    if (proc_root == NULL) proc_root = PCM_STATUS_DEFAULT_ROOT;
+
+    char card_path[512];
+    snprintf(card_path, sizeof(card_path), "%s/card%d", proc_root, card);
+    DIR* dir = opendir(card_path);
+    if (dir == NULL) return -1;
+
+    int count = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL && count < max_pcms) {
+        int device;
+        char stream;
+        char tail;
+        if (sscanf(ent->d_name, "pcm%d%c%c", &device, &stream, &tail) != 2) continue;
+        if (stream != 'p' && stream != 'c') continue;
+
+        AudioDeviceDirection stream_direction = stream == 'p' ? DEVICE_DIRECTION_PLAYBACK : DEVICE_DIRECTION_CAPTURE;
+        if (!(direction & stream_direction)) continue;
+
+        // info is generated from the PCM's registration data; reading it
+        // doesn't call into the driver
+        char path[800];
+        char text[1024];
+        snprintf(path, sizeof(path), "%s/%s/info", card_path, ent->d_name);
+        if (read_text(path, text, sizeof(text)) < 0) continue;
+
+        CardPcm* pcm = &pcms[count++];
+        pcm->device = device;
+        pcm->direction = stream_direction;
+        pcm->name[0] = '\0';
+        for (const char* line = text; line != NULL && *line != '\0'; ) {
+            if (strncmp(line, "name: ", 6) == 0) {
+                copy_line(pcm->name, sizeof(pcm->name), line + 6);
+                break;
+            }
+            line = strchr(line, '\n');
+            if (line != NULL) line++;
+        }
+    }
+    closedir(dir);
+
+    qsort(pcms, (size_t)count, sizeof(CardPcm), compare_pcms);
+    return count;
+}
+
+#else
+
+// Runtime PM and /proc/asound are Linux only
+CardPowerState card_power_state(const char* sysfs_root, int card) {
+    (void)sysfs_root; (void)card;
+    return CARD_POWER_UNKNOWN;
+}
+
+int card_power_list_cards(const char* sysfs_root, int* cards, int max_cards) {
+    (void)sysfs_root; (void)cards; (void)max_cards;
+    return -1;
+}
+
+int card_power_card_info(const char* proc_root, int card, char* name, size_t name_size,
+                         char* driver, size_t driver_size) {
+    (void)proc_root; (void)card; (void)name; (void)name_size; (void)driver; (void)driver_size;
+    return -1;
+}
+
+int card_power_list_pcms(const char* proc_root, int card, AudioDeviceDirection direction,
+                         CardPcm* pcms, int max_pcms) {
+    (void)proc_root; (void)card; (void)direction; (void)pcms; (void)max_pcms;
+    return -1;
+}
+
+#endif
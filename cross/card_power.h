@@ -0,0 +1,55 @@
+// card_power.h - Runtime power state of sound cards, and what procfs tells about them without waking them
+#ifndef CARD_POWER_H
+#define CARD_POWER_H
+
+#include <stddef.h>
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CARD_POWER_DEFAULT_SYSFS_ROOT "/sys"
+#define CARD_POWER_MAX_PCMS 64
+
+typedef enum {
+    CARD_POWER_UNKNOWN,             // no runtime PM status (not supported, or not Linux)
+    CARD_POWER_ACTIVE,              // active or resuming
+    CARD_POWER_SUSPENDED            // suspended or suspending
+} CardPowerState;
+
+// One PCM stream as procfs lists it
+typedef struct {
+    int device;
+    AudioDeviceDirection direction;
+    char name[80];                  // as snd_pcm_info_get_name reports it
+} CardPcm;
+
+// Runtime PM status of the device behind a card, from
+// <sysfs_root>/class/sound/cardN/device/power/runtime_status. sysfs_root
+// is NULL for /sys, or a fixture tree laid out the same way. Reading it
+// never resumes the device.
+CardPowerState card_power_state(const char* sysfs_root, int card);
+
+// Numbers of the cards registered under <sysfs_root>/class/sound, in
+// ascending order. Listing them opens no control device. Returns the
+// number filled, or -1 if the directory can't be read.
+int card_power_list_cards(const char* sysfs_root, int* cards, int max_cards);
+
+// Card name and driver from <proc_root>/cards, the same strings the
+// control device's card info has. proc_root is NULL for /proc/asound.
+// Returns 0, or -1 if the card isn't listed.
+int card_power_card_info(const char* proc_root, int card, char* name, size_t name_size,
+                         char* driver, size_t driver_size);
+
+// The card's PCM streams in the requested directions, from the
+// <proc_root>/cardN/pcmD{p,c}/info files, sorted by device and playback
+// first. Returns the number filled, or -1 if the card directory can't be read.
+int card_power_list_pcms(const char* proc_root, int card, AudioDeviceDirection direction,
+                         CardPcm* pcms, int max_pcms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CARD_POWER_H
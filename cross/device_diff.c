@@ -0,0 +1,390 @@
+// device_diff.c - Content-hashed device snapshots and snapshot deltas
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "device_diff.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SNAPSHOT_MAGIC 0x56414453u   // "VADS"
+#define SNAPSHOT_VERSION 4
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t device_size;
+    int32_t count;
+} SnapshotHeader;
+
+static const char* field_names[DEVICE_FIELD_COUNT] = {
+    "name", "id", "manufacturer", "model", "serial_number", "type",
+    "connection", "transport_type_name", "is_default", "is_alive",
+    "is_running", "is_muted", "device_id_numeric", "input_channels",
+    "output_channels", "sample_rate", "bit_depth", "volume",
+    "data_source", "clock_source", "direction", "is_duplex",
+    "duplex_peer_id", "hardware_id", "is_suspended"
+};
+
+const char* device_field_name(DeviceField field) {
+    if (field < 0 || field >= DEVICE_FIELD_COUNT) return "unknown";
+    return field_names[field];
+}
+
+// Volume is reported with three decimals, so smaller changes are noise
+static int volume_millis(float volume) {
+    return (int)(volume * 1000.0f + (volume >= 0.0f ? 0.5f : -0.5f));
+}
+
+bool device_field_equal(const AudioDevice* a, const AudioDevice* b, DeviceField field) {
+    switch (field) {
+        case DEVICE_FIELD_NAME: return strcmp(a->name, b->name) == 0;
+        case DEVICE_FIELD_ID: return strcmp(a->id, b->id) == 0;
+        case DEVICE_FIELD_MANUFACTURER: return strcmp(a->manufacturer, b->manufacturer) == 0;
+        case DEVICE_FIELD_MODEL: return strcmp(a->model, b->model) == 0;
+        case DEVICE_FIELD_SERIAL_NUMBER: return strcmp(a->serial_number, b->serial_number) == 0;
+        case DEVICE_FIELD_TYPE: return a->type == b->type;
+        case DEVICE_FIELD_CONNECTION: return a->connection == b->connection;
+        case DEVICE_FIELD_TRANSPORT_TYPE_NAME: return strcmp(a->transport_type_name, b->transport_type_name) == 0;
+        case DEVICE_FIELD_IS_DEFAULT: return a->is_default == b->is_default;
+        case DEVICE_FIELD_IS_ALIVE: return a->is_alive == b->is_alive;
+        case DEVICE_FIELD_IS_RUNNING: return a->is_running == b->is_running;
+        case DEVICE_FIELD_IS_MUTED: return a->is_muted == b->is_muted;
+        case DEVICE_FIELD_DEVICE_ID_NUMERIC: return a->device_id_numeric == b->device_id_numeric;
+        case DEVICE_FIELD_INPUT_CHANNELS: return a->input_channels == b->input_channels;
+        case DEVICE_FIELD_OUTPUT_CHANNELS: return a->output_channels == b->output_channels;
+        case DEVICE_FIELD_SAMPLE_RATE: return a->sample_rate == b->sample_rate;
+        case DEVICE_FIELD_BIT_DEPTH: return a->bit_depth == b->bit_depth;
+        case DEVICE_FIELD_VOLUME: return volume_millis(a->volume) == volume_millis(b->volume);
+        case DEVICE_FIELD_DATA_SOURCE: return strcmp(a->data_source, b->data_source) == 0;
+        case DEVICE_FIELD_CLOCK_SOURCE: return strcmp(a->clock_source, b->clock_source) == 0;
+        case DEVICE_FIELD_DIRECTION: return a->direction == b->direction;
+        case DEVICE_FIELD_IS_DUPLEX: return a->is_duplex == b->is_duplex;
+        case DEVICE_FIELD_DUPLEX_PEER_ID: return strcmp(a->duplex_peer_id, b->duplex_peer_id) == 0;
+        case DEVICE_FIELD_HARDWARE_ID: return strcmp(a->hardware_id, b->hardware_id) == 0;
+        case DEVICE_FIELD_IS_SUSPENDED: return a->is_suspended == b->is_suspended;
+        default: return true;
+    }
+}
+
+// FNV-1a over the serialized fields only, so struct padding and bytes
+// after a string's terminator never affect the token
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char* str) {
+    return hash_bytes(hash, str, strlen(str) + 1);
+}
+
+static uint64_t hash_int(uint64_t hash, int value) {
+    uint32_t v = (uint32_t)value;
+    unsigned char bytes[4] = {
+        (unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24)
+    };
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+uint64_t device_snapshot_hash(const AudioDevice* devices, int count) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    // A token names a file in the snapshot format; one written in another
+    // layout must not be mistaken for it
+    hash = hash_int(hash, SNAPSHOT_VERSION);
+    hash = hash_int(hash, (int)sizeof(AudioDevice));
+    hash = hash_int(hash, count);
+    for (int i = 0; i < count; i++) {
+        const AudioDevice* d = &devices[i];
+        hash = hash_string(hash, d->name);
+        hash = hash_string(hash, d->id);
+        hash = hash_string(hash, d->manufacturer);
+        hash = hash_string(hash, d->model);
+        hash = hash_string(hash, d->serial_number);
+        hash = hash_int(hash, d->type);
+        hash = hash_int(hash, d->connection);
+        hash = hash_string(hash, d->transport_type_name);
+        hash = hash_int(hash, (d->is_default ? 1 : 0) | (d->is_alive ? 2 : 0) |
+                              (d->is_running ? 4 : 0) | (d->is_muted ? 8 : 0));
+        hash = hash_int(hash, d->device_id_numeric);
+        hash = hash_int(hash, d->input_channels);
+        hash = hash_int(hash, d->output_channels);
+        hash = hash_int(hash, d->sample_rate);
+        hash = hash_int(hash, d->bit_depth);
+        hash = hash_int(hash, volume_millis(d->volume));
+        hash = hash_string(hash, d->data_source);
+        hash = hash_string(hash, d->clock_source);
+        hash = hash_int(hash, d->direction | (d->is_duplex ? 16 : 0));
+        hash = hash_string(hash, d->duplex_peer_id);
+        hash = hash_string(hash, d->hardware_id);
+        hash = hash_int(hash, d->is_suspended ? 1 : 0);
+    }
+    return hash;
+}
+
+void device_snapshot_token(uint64_t hash, char token[DEVICE_SNAPSHOT_TOKEN_SIZE]) {
+    snprintf(token, DEVICE_SNAPSHOT_TOKEN_SIZE, "%016llx", (unsigned long long)hash);
+}
+
+// Tokens come from the command line; only accept our own format so they
+// can't name a file outside the snapshot directory
+static bool valid_token(const char* token) {
+    if (token == NULL || strlen(token) != DEVICE_SNAPSHOT_TOKEN_SIZE - 1) return false;
+    for (int i = 0; token[i]; i++) {
+        char c = token[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
+}
+
+// Snapshots live in the per-user cache directory rather than a shared
+// temp directory, so other users can't plant files under our names
+static void snapshot_dir(char* dir, size_t size) {
+#ifdef _WIN32
+    const char* base = getenv("LOCALAPPDATA");
+    if (base == NULL) base = getenv("TEMP");
+    if (base == NULL) base = ".";
+    snprintf(dir, size, "%s", base);
+#else
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (xdg != NULL && xdg[0] != '\0') {
+        snprintf(dir, size, "%s", xdg);
+    } else if (home != NULL && home[0] != '\0') {
+        snprintf(dir, size, "%s/.cache", home);
+        mkdir(dir, 0700);
+    } else {
+        snprintf(dir, size, "/tmp");
+    }
+#endif
+}
+
+static void snapshot_path(const char* token, char* path, size_t size) {
+    char dir[900];
+    snapshot_dir(dir, sizeof(dir));
+    snprintf(path, size, "%s/audio_devices_%s.snap", dir, token);
+}
+
+typedef struct {
+    char token[DEVICE_SNAPSHOT_TOKEN_SIZE];
+    int64_t mtime;
+} SnapshotFile;
+
+// Whether a directory entry is one of our snapshots, and its token
+static bool snapshot_name(const char* name, char token[DEVICE_SNAPSHOT_TOKEN_SIZE]) {
+    static const char prefix[] = "audio_devices_";
+    static const char suffix[] = ".snap";
+    size_t prefix_len = sizeof(prefix) - 1;
+    if (strlen(name) != prefix_len + DEVICE_SNAPSHOT_TOKEN_SIZE - 1 + sizeof(suffix) - 1) return false;
+    if (strncmp(name, prefix, prefix_len) != 0) return false;
+    if (strcmp(name + prefix_len + DEVICE_SNAPSHOT_TOKEN_SIZE - 1, suffix) != 0) return false;
+    memcpy(token, name + prefix_len, DEVICE_SNAPSHOT_TOKEN_SIZE - 1);
+    token[DEVICE_SNAPSHOT_TOKEN_SIZE - 1] = '\0';
+    return valid_token(token);
+}
+
+// The snapshots in the cache directory with their modification times.
+// Returns the number found, at most max_files.
+static int list_snapshots(SnapshotFile* files, int max_files) {
+    char dir[900];
+    int count = 0;
+    snapshot_dir(dir, sizeof(dir));
+#ifdef _WIN32
+    char pattern[1000];
+    WIN32_FIND_DATAA data;
+    snprintf(pattern, sizeof(pattern), "%s\\audio_devices_*.snap", dir);
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) return 0;
+    do {
+        if (count < max_files && snapshot_name(data.cFileName, files[count].token)) {
+            files[count].mtime = ((int64_t)data.ftLastWriteTime.dwHighDateTime << 32) |
+                                 data.ftLastWriteTime.dwLowDateTime;
+            count++;
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* d = opendir(dir);
+    if (d == NULL) return 0;
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL && count < max_files) {
+        char path[1200];
+        struct stat st;
+        if (!snapshot_name(ent->d_name, files[count].token)) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) != 0) continue;
+        files[count++].mtime = (int64_t)st.st_mtime;
+    }
+    closedir(d);
+#endif
+    return count;
+}
+
+static int newest_first(const void* a, const void* b) {
+    const SnapshotFile* x = (const SnapshotFile*)a;
+    const SnapshotFile* y = (const SnapshotFile*)b;
+    if (x->mtime != y->mtime) return x->mtime < y->mtime ? 1 : -1;
+    return strcmp(x->token, y->token);
+}
+
+// Every distinct device list leaves a file behind; keep the newest
+// DEVICE_SNAPSHOT_KEEP so the directory doesn't grow without bound
+static void prune_snapshots(const char* keep_token) {
+    SnapshotFile* files = (SnapshotFile*)malloc(DEVICE_SNAPSHOT_SCAN_MAX * sizeof(SnapshotFile));
+    if (files == NULL) return;
+
+    int count = list_snapshots(files, DEVICE_SNAPSHOT_SCAN_MAX);
+    qsort(files, (size_t)count, sizeof(SnapshotFile), newest_first);
+    for (int i = DEVICE_SNAPSHOT_KEEP; i < count; i++) {
+        char path[1024];
+        if (strcmp(files[i].token, keep_token) == 0) continue;
+        snapshot_path(files[i].token, path, sizeof(path));
+        remove(path);
+    }
+    free(files);
+}
+
+// Whether the stored snapshot under this token holds exactly these devices
+static bool snapshot_matches(const char* token, const AudioDevice* devices, int count) {
+    AudioDevice* stored;
+    int stored_count = device_snapshot_load(token, &stored);
+    bool same = stored_count == count &&
+                device_snapshot_hash(stored, stored_count) == device_snapshot_hash(devices, count);
+    free(stored);
+    return same;
+}
+
+int device_snapshot_save(const char* token, const AudioDevice* devices, int count) {
+    char path[1024];
+    char tmp_path[1100];
+    if (!valid_token(token) || count < 0) return -1;
+
+    // An existing file is kept only if it loads and holds the same list;
+    // one that is truncated or from another build is replaced
+    if (snapshot_matches(token, devices, count)) return 0;
+
+    // The temporary name is per process, so concurrent runs never write
+    // into each other's file
+    snapshot_path(token, path, sizeof(path));
+#ifdef _WIN32
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lu.tmp", path, (unsigned long)GetCurrentProcessId());
+#else
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+#endif
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) return -1;
+
+    SnapshotHeader header = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(AudioDevice), count };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              (count == 0 || fwrite(devices, sizeof(AudioDevice), (size_t)count, file) == (size_t)count);
+    ok = (fclose(file) == 0) && ok;
+
+    // Publish with a rename so readers never see a partial snapshot
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows
+    ok = ok && MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmp_path, path) == 0;
+#endif
+    if (!ok) {
+        remove(tmp_path);
+        return -1;
+    }
+
+    prune_snapshots(token);
+    return 0;
+}
+
+int device_snapshot_load(const char* token, AudioDevice** devices) {
+    char path[1024];
+    SnapshotHeader header;
+    *devices = NULL;
+    if (!valid_token(token)) return -1;
+
+    snapshot_path(token, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return -1;
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.device_size != sizeof(AudioDevice) || header.count < 0) {
+        fclose(file);
+        return -1;
+    }
+
+    *devices = (AudioDevice*)calloc((size_t)header.count + 1, sizeof(AudioDevice));
+    if (*devices == NULL ||
+        fread(*devices, sizeof(AudioDevice), (size_t)header.count, file) != (size_t)header.count) {
+        free(*devices);
+        *devices = NULL;
+        fclose(file);
+        return -1;
+    }
+
+    fclose(file);
+    return header.count;
+}
+
+// ALSA reports playback and capture of one PCM under the same id
+static const AudioDevice* find_endpoint(const AudioDevice* devices, int count, const AudioDevice* device) {
+    for (int i = 0; i < count; i++) {
+        if (devices[i].direction == device->direction && strcmp(devices[i].id, device->id) == 0) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+int device_diff(const AudioDevice* before, int before_count,
+                const AudioDevice* after, int after_count,
+                DeviceChange* changes, int max_changes) {
+    int n = 0;
+
+    // Removed: in before, missing from after
+    for (int i = 0; i < before_count && n < max_changes; i++) {
+        if (find_endpoint(after, after_count, &before[i]) == NULL) {
+            changes[n].kind = DEVICE_CHANGE_REMOVED;
+            changes[n].before = &before[i];
+            changes[n].after = NULL;
+            changes[n].changed_fields = 0;
+            n++;
+        }
+    }
+
+    // Added and modified, in the order of the new snapshot
+    for (int i = 0; i < after_count && n < max_changes; i++) {
+        const AudioDevice* old = find_endpoint(before, before_count, &after[i]);
+        if (old == NULL) {
+            changes[n].kind = DEVICE_CHANGE_ADDED;
+            changes[n].before = NULL;
+            changes[n].after = &after[i];
+            changes[n].changed_fields = 0;
+            n++;
+            continue;
+        }
+
+        uint32_t fields = 0;
+        for (int f = 0; f < DEVICE_FIELD_COUNT; f++) {
+            if (!device_field_equal(old, &after[i], (DeviceField)f)) {
+                fields |= 1u << f;
+            }
+        }
+        if (fields != 0) {
+            changes[n].kind = DEVICE_CHANGE_MODIFIED;
+            changes[n].before = old;
+            changes[n].after = &after[i];
+            changes[n].changed_fields = fields;
+            n++;
+        }
+    }
+
+    return n;
+}
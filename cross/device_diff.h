@@ -0,0 +1,85 @@
+// device_diff.h - Content-hashed device snapshots and snapshot deltas
+#ifndef DEVICE_DIFF_H
+#define DEVICE_DIFF_H
+
+#include <stdint.h>
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Serialized device fields, in JSON output order
+typedef enum {
+    DEVICE_FIELD_NAME,
+    DEVICE_FIELD_ID,
+    DEVICE_FIELD_MANUFACTURER,
+    DEVICE_FIELD_MODEL,
+    DEVICE_FIELD_SERIAL_NUMBER,
+    DEVICE_FIELD_TYPE,
+    DEVICE_FIELD_CONNECTION,
+    DEVICE_FIELD_TRANSPORT_TYPE_NAME,
+    DEVICE_FIELD_IS_DEFAULT,
+    DEVICE_FIELD_IS_ALIVE,
+    DEVICE_FIELD_IS_RUNNING,
+    DEVICE_FIELD_IS_MUTED,
+    DEVICE_FIELD_DEVICE_ID_NUMERIC,
+    DEVICE_FIELD_INPUT_CHANNELS,
+    DEVICE_FIELD_OUTPUT_CHANNELS,
+    DEVICE_FIELD_SAMPLE_RATE,
+    DEVICE_FIELD_BIT_DEPTH,
+    DEVICE_FIELD_VOLUME,
+    DEVICE_FIELD_DATA_SOURCE,
+    DEVICE_FIELD_CLOCK_SOURCE,
+    DEVICE_FIELD_DIRECTION,
+    DEVICE_FIELD_IS_DUPLEX,
+    DEVICE_FIELD_DUPLEX_PEER_ID,
+    DEVICE_FIELD_HARDWARE_ID,
+    DEVICE_FIELD_IS_SUSPENDED,
+    DEVICE_FIELD_COUNT
+} DeviceField;
+
+typedef enum {
+    DEVICE_CHANGE_ADDED,
+    DEVICE_CHANGE_REMOVED,
+    DEVICE_CHANGE_MODIFIED
+} DeviceChangeKind;
+
+typedef struct {
+    DeviceChangeKind kind;
+    const AudioDevice* before;      // NULL for added devices
+    const AudioDevice* after;       // NULL for removed devices
+    uint32_t changed_fields;        // bit (1u << DeviceField) per modified field
+} DeviceChange;
+
+// Snapshot tokens are the 64-bit content hash as 16 hex digits
+#define DEVICE_SNAPSHOT_TOKEN_SIZE 17
+
+const char* device_field_name(DeviceField field);
+bool device_field_equal(const AudioDevice* a, const AudioDevice* b, DeviceField field);
+
+uint64_t device_snapshot_hash(const AudioDevice* devices, int count);
+void device_snapshot_token(uint64_t hash, char token[DEVICE_SNAPSHOT_TOKEN_SIZE]);
+
+// Snapshots kept in the cache directory; older ones are removed on save
+#define DEVICE_SNAPSHOT_KEEP 32
+// Snapshot files looked at when pruning
+#define DEVICE_SNAPSHOT_SCAN_MAX 1024
+
+// Snapshots are stored in the user's cache directory under their token.
+// The file is written to a temporary name and renamed over the target;
+// an existing one is kept only if it loads and matches.
+int device_snapshot_save(const char* token, const AudioDevice* devices, int count);
+int device_snapshot_load(const char* token, AudioDevice** devices);
+
+// Devices are matched by id and direction. Returns the number of changes
+// written (at most max_changes).
+int device_diff(const AudioDevice* before, int before_count,
+                const AudioDevice* after, int after_count,
+                DeviceChange* changes, int max_changes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEVICE_DIFF_H
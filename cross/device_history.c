@@ -0,0 +1,264 @@
+// device_history.c - Lock-free appender for the device history ring file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "device_history.h"
+#include "device_diff.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Room for every device going away and as many coming back in one poll
+#define DEVICE_HISTORY_MAX_BATCH (DEVICE_HISTORY_MAX_DEVICES * 2 + 1)
+
+// Changes worth a record. Volume moves with every slider drag and would
+// push the presence history out of the ring.
+#define DEVICE_HISTORY_TRACKED_FIELDS (~(1u << DEVICE_FIELD_VOLUME))
+
+struct DeviceHistoryWriter {
+    int fd;
+    size_t map_size;
+    DeviceHistoryHeader* header;
+    DeviceHistoryRecord* records;
+    audio_ctx_t* ctx;               // created on first record_current
+    bool have_previous;
+    int previous_count;
+    AudioDevice previous[DEVICE_HISTORY_MAX_DEVICES];
+    AudioDevice scratch[DEVICE_HISTORY_MAX_DEVICES];
+    DeviceChange changes[DEVICE_HISTORY_MAX_DEVICES * 2];
+    DeviceHistoryRecord batch[DEVICE_HISTORY_MAX_BATCH];
+};
+
+static int64_t realtime_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// FNV-1a over the full id and the direction
+static uint64_t device_key(const AudioDevice* device) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char* p = device->id; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * 0x100000001b3ull;
+    }
+    return (hash ^ (uint64_t)device->direction) * 0x100000001b3ull;
+}
+
+static void copy_truncated(char* out, size_t out_size, const char* text) {
+    size_t n = strlen(text);
+    if (n >= out_size) n = out_size - 1;
+    memcpy(out, text, n);
+    out[n] = '\0';
+}
+
+static void fill_record(DeviceHistoryRecord* record, DeviceHistoryKind kind, int64_t now,
+                        const AudioDevice* device, uint32_t changed_fields) {
+    memset(record, 0, sizeof(*record));
+    record->kind = (uint8_t)kind;
+    record->time_usec = now;
+    record->changed_fields = changed_fields;
+    if (device == NULL) return;
+
+    record->direction = (uint8_t)device->direction;
+    record->type = (uint8_t)device->type;
+    record->flags = (uint8_t)((device->is_default ? DEVICE_HISTORY_DEFAULT : 0) |
+                              (device->is_alive ? DEVICE_HISTORY_ALIVE : 0) |
+                              (device->is_running ? DEVICE_HISTORY_RUNNING : 0) |
+                              (device->is_muted ? DEVICE_HISTORY_MUTED : 0));
+    record->sample_rate = device->sample_rate;
+    record->input_channels = (uint16_t)device->input_channels;
+    record->output_channels = (uint16_t)device->output_channels;
+    record->key = device_key(device);
+    copy_truncated(record->id, sizeof(record->id), device->id);
+    copy_truncated(record->name, sizeof(record->name), device->name);
+}
+
+// Reserve count consecutive indices with one atomic add, so concurrent
+// appenders never share a slot and a batch stays contiguous. Each slot is
+// invalidated, filled and then committed with its index; a crash anywhere
+// in between leaves a slot readers skip.
+static uint64_t append_records(DeviceHistoryWriter* writer, DeviceHistoryRecord* batch, int count) {
+    uint32_t capacity = writer->header->capacity;
+    uint64_t index = __atomic_fetch_add(&writer->header->head, (uint64_t)count, __ATOMIC_ACQ_REL);
+
+    for (int i = 0; i < count; i++) {
+        DeviceHistoryRecord* slot = &writer->records[(index + (uint64_t)i) % capacity];
+        __atomic_store_n(&slot->commit, 0, __ATOMIC_RELAXED);
+        // Make the cleared commit visible before any of the body stores
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy((char*)slot + sizeof(slot->commit), (const char*)&batch[i] + sizeof(slot->commit),
+               sizeof(DeviceHistoryRecord) - sizeof(slot->commit));
+        __atomic_store_n(&slot->commit, index + (uint64_t)i + 1, __ATOMIC_RELEASE);
+    }
+    return index;
+}
+
+// The full list, so a reader can rebuild state once older deltas have
+// been overwritten
+static int append_snapshot(DeviceHistoryWriter* writer, const AudioDevice* devices, int count, int64_t now) {
+    fill_record(&writer->batch[0], DEVICE_HISTORY_SNAPSHOT, now, NULL, (uint32_t)count);
+    for (int i = 0; i < count; i++) {
+        fill_record(&writer->batch[i + 1], DEVICE_HISTORY_PRESENT, now, &devices[i], 0);
+    }
+    uint64_t index = append_records(writer, writer->batch, count + 1);
+    __atomic_store_n(&writer->header->snapshot, index, __ATOMIC_RELEASE);
+    return count + 1;
+}
+
+DeviceHistoryWriter* device_history_writer_open(const char* path, int capacity) {
+    if (capacity <= 0) capacity = DEVICE_HISTORY_DEFAULT_CAPACITY;
+    if (capacity < DEVICE_HISTORY_MIN_CAPACITY) capacity = DEVICE_HISTORY_MIN_CAPACITY;
+
+    DeviceHistoryWriter* writer = (DeviceHistoryWriter*)calloc(1, sizeof(DeviceHistoryWriter));
+    if (writer == NULL) return NULL;
+
+    writer->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (writer->fd < 0) {
+        free(writer);
+        return NULL;
+    }
+
+    // Keep an existing history when its layout matches, whatever capacity
+    // it was created with
+    DeviceHistoryHeader existing;
+    struct stat st;
+    bool reuse = fstat(writer->fd, &st) == 0 &&
+        pread(writer->fd, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing) &&
+        existing.magic == DEVICE_HISTORY_MAGIC && existing.version == DEVICE_HISTORY_VERSION &&
+        existing.record_size == sizeof(DeviceHistoryRecord) &&
+        existing.capacity >= DEVICE_HISTORY_MIN_CAPACITY &&
+        (uint64_t)st.st_size >= DEVICE_HISTORY_HEADER_SIZE + (uint64_t)existing.capacity * sizeof(DeviceHistoryRecord);
+    if (reuse) capacity = (int)existing.capacity;
+
+    writer->map_size = DEVICE_HISTORY_HEADER_SIZE + (size_t)capacity * sizeof(DeviceHistoryRecord);
+    if (!reuse && (ftruncate(writer->fd, 0) < 0 || ftruncate(writer->fd, (off_t)writer->map_size) < 0)) {
+        close(writer->fd);
+        free(writer);
+        return NULL;
+    }
+
+    void* mapping = mmap(NULL, writer->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(writer->fd);
+        free(writer);
+        return NULL;
+    }
+    writer->header = (DeviceHistoryHeader*)mapping;
+    writer->records = (DeviceHistoryRecord*)((char*)mapping + DEVICE_HISTORY_HEADER_SIZE);
+
+    // A fresh file is all zeros; the magic goes in last so readers never
+    // see a half-initialized header
+    if (!reuse) {
+        DeviceHistoryHeader* header = writer->header;
+        header->version = DEVICE_HISTORY_VERSION;
+        header->record_size = sizeof(DeviceHistoryRecord);
+        header->capacity = (uint32_t)capacity;
+        header->created_usec = realtime_usec();
+        __atomic_store_n(&header->magic, DEVICE_HISTORY_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    return writer;
+}
+
+int device_history_record(DeviceHistoryWriter* writer, const AudioDevice* devices, int count) {
+    if (writer == NULL || count < 0) return -1;
+    if (count > DEVICE_HISTORY_MAX_DEVICES) count = DEVICE_HISTORY_MAX_DEVICES;
+    int64_t now = realtime_usec();
+    int appended = 0;
+
+    // The first poll of a session is a snapshot: whatever happened while
+    // nothing was recording shows up as one jump
+    if (!writer->have_previous) {
+        appended = append_snapshot(writer, devices, count, now);
+    } else {
+        int changes = device_diff(writer->previous, writer->previous_count, devices, count,
+                                  writer->changes, DEVICE_HISTORY_MAX_DEVICES * 2);
+        int n = 0;
+        for (int i = 0; i < changes; i++) {
+            const DeviceChange* change = &writer->changes[i];
+            switch (change->kind) {
+                case DEVICE_CHANGE_ADDED:
+                    fill_record(&writer->batch[n++], DEVICE_HISTORY_ADDED, now, change->after, 0);
+                    break;
+                case DEVICE_CHANGE_REMOVED:
+                    fill_record(&writer->batch[n++], DEVICE_HISTORY_REMOVED, now, change->before, 0);
+                    break;
+                case DEVICE_CHANGE_MODIFIED:
+                    if ((change->changed_fields & DEVICE_HISTORY_TRACKED_FIELDS) == 0) break;
+                    fill_record(&writer->batch[n++], DEVICE_HISTORY_MODIFIED, now, change->after,
+                                change->changed_fields);
+                    break;
+            }
+        }
+        if (n > 0) {
+            append_records(writer, writer->batch, n);
+            appended = n;
+        }
+
+        // Keep a snapshot within the newer half of the ring
+        uint64_t head = __atomic_load_n(&writer->header->head, __ATOMIC_ACQUIRE);
+        uint64_t snapshot = __atomic_load_n(&writer->header->snapshot, __ATOMIC_ACQUIRE);
+        if (head - snapshot >= writer->header->capacity / 2) {
+            appended += append_snapshot(writer, devices, count, now);
+        }
+    }
+
+    if (count > 0) {
+        memcpy(writer->previous, devices, (size_t)count * sizeof(AudioDevice));
+    }
+    writer->previous_count = count;
+    writer->have_previous = true;
+    __atomic_store_n(&writer->header->updated_usec, now, __ATOMIC_RELEASE);
+    return appended;
+}
+
+int device_history_record_current(DeviceHistoryWriter* writer) {
+    if (writer == NULL) return -1;
+    if (writer->ctx == NULL) {
+        writer->ctx = audio_ctx_create();
+        if (writer->ctx == NULL) return -1;
+    }
+
+    int count = audio_ctx_list(writer->ctx, writer->scratch, DEVICE_HISTORY_MAX_DEVICES);
+    if (count > DEVICE_HISTORY_MAX_DEVICES) count = DEVICE_HISTORY_MAX_DEVICES;
+    return device_history_record(writer, writer->scratch, count);
+}
+
+void device_history_writer_close(DeviceHistoryWriter* writer) {
+    if (writer == NULL) return;
+    audio_ctx_destroy(writer->ctx);
+    // Records are in the page cache as soon as they are committed; this
+    // only hurries them to disk
+    msync(writer->header, writer->map_size, MS_ASYNC);
+    munmap(writer->header, writer->map_size);
+    close(writer->fd);
+    free(writer);
+}
+
+#else
+
+// Memory-mapped history files are not supported on Windows builds
+DeviceHistoryWriter* device_history_writer_open(const char* path, int capacity) {
+    (void)path; (void)capacity;
+    return NULL;
+}
+
+int device_history_record(DeviceHistoryWriter* writer, const AudioDevice* devices, int count) {
+    (void)writer; (void)devices; (void)count;
+    return -1;
+}
+
+int device_history_record_current(DeviceHistoryWriter* writer) {
+    (void)writer;
+    return -1;
+}
+
+void device_history_writer_close(DeviceHistoryWriter* writer) {
+    (void)writer;
+}
+
+#endif
@@ -0,0 +1,132 @@
+// device_history.h - Append-only device history in a memory-mapped ring file
+#ifndef DEVICE_HISTORY_H
+#define DEVICE_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEVICE_HISTORY_MAGIC 0x56414448u   // "VADH"
+#define DEVICE_HISTORY_VERSION 1
+#define DEVICE_HISTORY_DEFAULT_CAPACITY 8192   // records, 1 MiB of ring
+#define DEVICE_HISTORY_MIN_CAPACITY 1024
+#define DEVICE_HISTORY_MAX_DEVICES 128
+#define DEVICE_HISTORY_HEADER_SIZE 4096        // records start on the second page
+
+typedef enum {
+    DEVICE_HISTORY_SNAPSHOT,        // the next changed_fields records are PRESENT
+    DEVICE_HISTORY_PRESENT,
+    DEVICE_HISTORY_ADDED,
+    DEVICE_HISTORY_REMOVED,
+    DEVICE_HISTORY_MODIFIED
+} DeviceHistoryKind;
+
+// State flags kept per device
+#define DEVICE_HISTORY_DEFAULT 0x01
+#define DEVICE_HISTORY_ALIVE 0x02
+#define DEVICE_HISTORY_RUNNING 0x04
+#define DEVICE_HISTORY_MUTED 0x08
+
+// One 128-byte record. commit is 0 while a writer fills the slot and the
+// record's index + 1 once it is complete, so a reader skips slots that a
+// crashed writer left half written or that were overwritten mid-copy.
+typedef struct {
+    uint64_t commit;
+    int64_t time_usec;              // CLOCK_REALTIME
+    uint8_t kind;                   // DeviceHistoryKind
+    uint8_t direction;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t changed_fields;        // MODIFIED: DeviceField bits; SNAPSHOT: device count
+    int32_t sample_rate;
+    uint16_t input_channels;
+    uint16_t output_channels;
+    uint64_t key;                   // hash of the full id and direction
+    char id[40];                    // truncated for display; key identifies the device
+    char name[48];
+} DeviceHistoryRecord;
+
+// File layout: this header, padded to DEVICE_HISTORY_HEADER_SIZE, then
+// capacity records. Record n lives in slot n % capacity.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint64_t head;                  // records ever reserved
+    uint64_t snapshot;              // index of the newest snapshot
+    int64_t created_usec;
+    int64_t updated_usec;           // last poll, whether or not anything changed
+} DeviceHistoryHeader;
+
+// A device as the history knows it
+typedef struct {
+    uint64_t key;
+    char id[40];
+    char name[48];
+    AudioDeviceDirection direction;
+    AudioDeviceType type;
+    uint8_t flags;
+    int sample_rate;
+    int input_channels;
+    int output_channels;
+} DeviceHistoryDevice;
+
+// Presence over a time window
+typedef struct {
+    DeviceHistoryDevice device;     // as last seen
+    int64_t uptime_usec;            // time present within the window
+    int64_t first_seen_usec;
+    int64_t last_seen_usec;         // last moment present (the window end if still present)
+    int drops;                      // times it went away
+    int flaps;                      // drops it came back from
+    int64_t shortest_gap_usec;      // shortest absence it came back from, 0 if none
+    bool present;                   // at the end of the window
+} DeviceHistoryStats;
+
+typedef struct DeviceHistoryWriter DeviceHistoryWriter;
+typedef struct DeviceHistoryReader DeviceHistoryReader;
+
+// Writer (device_history.c). Opens or creates the ring file; an existing
+// file with the same layout keeps its history and capacity.
+DeviceHistoryWriter* device_history_writer_open(const char* path, int capacity);
+
+// Append what changed since the previous call (everything, as a snapshot,
+// on the first). Returns the number of records appended.
+int device_history_record(DeviceHistoryWriter* writer, const AudioDevice* devices, int count);
+
+// Enumerate and record in one step, reusing one enumeration context
+int device_history_record_current(DeviceHistoryWriter* writer);
+
+void device_history_writer_close(DeviceHistoryWriter* writer);
+
+// Reader (device_history_reader.c, no audio backend dependencies)
+DeviceHistoryReader* device_history_reader_open(const char* path);
+
+// Time span the ring covers, from its oldest complete snapshot (older
+// deltas have nothing to apply to) to the writer's last poll; 0 for both
+// when empty
+void device_history_span(DeviceHistoryReader* reader, int64_t* oldest_usec, int64_t* newest_usec);
+
+// Rebuild the device list as it was at time_usec. Returns the number of
+// devices, or -1 if the history doesn't reach back that far.
+int device_history_devices_at(DeviceHistoryReader* reader, int64_t time_usec,
+                              DeviceHistoryDevice* devices, int max_devices);
+
+// Per-device uptime and flap counts between from_usec and to_usec (0 for
+// either end of the span). Returns the number of devices present at some
+// point in the window.
+int device_history_stats(DeviceHistoryReader* reader, int64_t from_usec, int64_t to_usec,
+                         DeviceHistoryStats* stats, int max_stats);
+
+void device_history_reader_close(DeviceHistoryReader* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEVICE_HISTORY_H
@@ -0,0 +1,379 @@
+// device_history_reader.c - Replays the device history ring file
+#include <stdlib.h>
+#include <string.h>
+#include "device_history.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct DeviceHistoryReader {
+    size_t map_size;
+    const DeviceHistoryHeader* header;
+    const DeviceHistoryRecord* records;
+    DeviceHistoryDevice snapshot[DEVICE_HISTORY_MAX_DEVICES];
+};
+
+// Device list while replaying. known stays false until the first complete
+// snapshot, since deltas before it have nothing to apply to.
+typedef struct {
+    bool known;
+    int count;
+    DeviceHistoryDevice devices[DEVICE_HISTORY_MAX_DEVICES];
+} HistoryState;
+
+// Presence bookkeeping for device_history_stats
+typedef struct {
+    int64_t from;
+    int64_t to;
+    int count;
+    int max;
+    DeviceHistoryStats* stats;
+    int64_t since[DEVICE_HISTORY_MAX_DEVICES];  // present since, or absent since after a drop
+} HistoryStatsBuilder;
+
+DeviceHistoryReader* device_history_reader_open(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    DeviceHistoryHeader header;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        header.magic != DEVICE_HISTORY_MAGIC || header.version != DEVICE_HISTORY_VERSION ||
+        header.record_size != sizeof(DeviceHistoryRecord) || header.capacity == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t map_size = DEVICE_HISTORY_HEADER_SIZE + (size_t)header.capacity * sizeof(DeviceHistoryRecord);
+    if ((size_t)st.st_size < map_size) {
+        close(fd);
+        return NULL;
+    }
+    void* mapping = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return NULL;
+
+    DeviceHistoryReader* reader = (DeviceHistoryReader*)calloc(1, sizeof(DeviceHistoryReader));
+    if (reader == NULL) {
+        munmap(mapping, map_size);
+        return NULL;
+    }
+    reader->map_size = map_size;
+    reader->header = (const DeviceHistoryHeader*)mapping;
+    reader->records = (const DeviceHistoryRecord*)((const char*)mapping + DEVICE_HISTORY_HEADER_SIZE);
+    return reader;
+}
+
+// Copy record index if it is committed and wasn't overwritten while being
+// copied
+static bool read_record(const DeviceHistoryReader* reader, uint64_t index, DeviceHistoryRecord* record) {
+    const DeviceHistoryRecord* slot = &reader->records[index % reader->header->capacity];
+    uint64_t commit = __atomic_load_n(&slot->commit, __ATOMIC_ACQUIRE);
+    if (commit != index + 1) return false;
+
+    memcpy(record, slot, sizeof(*record));
+    // Order the body loads before re-checking the commit word
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->commit, __ATOMIC_RELAXED) == commit;
+}
+
+static void oldest_index(const DeviceHistoryReader* reader, uint64_t* start, uint64_t* head) {
+    uint32_t capacity = reader->header->capacity;
+    *head = __atomic_load_n(&reader->header->head, __ATOMIC_ACQUIRE);
+    *start = *head > capacity ? *head - capacity : 0;
+}
+
+static void record_device(const DeviceHistoryRecord* record, DeviceHistoryDevice* device);
+
+// Copy the members of the snapshot at index into reader->snapshot.
+// Returns how many were read in a row; the snapshot is complete only if
+// that is all of them.
+static uint32_t read_snapshot(DeviceHistoryReader* reader, uint64_t index, uint64_t head,
+                              const DeviceHistoryRecord* record) {
+    uint32_t count = record->changed_fields;
+    uint32_t n = 0;
+    DeviceHistoryRecord member;
+    while (n < count && n < DEVICE_HISTORY_MAX_DEVICES && index + 1 + n < head &&
+           read_record(reader, index + 1 + n, &member) && member.kind == DEVICE_HISTORY_PRESENT) {
+        record_device(&member, &reader->snapshot[n]);
+        n++;
+    }
+    return n;
+}
+
+void device_history_span(DeviceHistoryReader* reader, int64_t* oldest_usec, int64_t* newest_usec) {
+    *oldest_usec = 0;
+    *newest_usec = 0;
+    if (reader == NULL) return;
+
+    uint64_t start, head;
+    oldest_index(reader, &start, &head);
+    DeviceHistoryRecord record;
+    for (uint64_t i = start; i < head; i++) {
+        if (read_record(reader, i, &record) && record.kind == DEVICE_HISTORY_SNAPSHOT &&
+            read_snapshot(reader, i, head, &record) == record.changed_fields) {
+            *oldest_usec = record.time_usec;
+            *newest_usec = __atomic_load_n(&reader->header->updated_usec, __ATOMIC_ACQUIRE);
+            if (*newest_usec < record.time_usec) *newest_usec = record.time_usec;
+            return;
+        }
+    }
+}
+
+static void record_device(const DeviceHistoryRecord* record, DeviceHistoryDevice* device) {
+    memset(device, 0, sizeof(*device));
+    device->key = record->key;
+    memcpy(device->id, record->id, sizeof(device->id));
+    memcpy(device->name, record->name, sizeof(device->name));
+    device->id[sizeof(device->id) - 1] = '\0';
+    device->name[sizeof(device->name) - 1] = '\0';
+    device->direction = (AudioDeviceDirection)record->direction;
+    device->type = (AudioDeviceType)record->type;
+    device->flags = record->flags;
+    device->sample_rate = record->sample_rate;
+    device->input_channels = record->input_channels;
+    device->output_channels = record->output_channels;
+}
+
+static int state_find(const HistoryState* state, uint64_t key) {
+    for (int i = 0; i < state->count; i++) {
+        if (state->devices[i].key == key) return i;
+    }
+    return -1;
+}
+
+// Stats side of the replay
+
+static int64_t overlap(int64_t begin, int64_t end, int64_t from, int64_t to) {
+    if (begin < from) begin = from;
+    if (end > to) end = to;
+    return end > begin ? end - begin : 0;
+}
+
+static DeviceHistoryStats* stats_entry(HistoryStatsBuilder* builder, const DeviceHistoryDevice* device, int* slot) {
+    for (int i = 0; i < builder->count; i++) {
+        if (builder->stats[i].device.key == device->key) {
+            *slot = i;
+            return &builder->stats[i];
+        }
+    }
+    if (builder->count >= builder->max || builder->count >= DEVICE_HISTORY_MAX_DEVICES) return NULL;
+
+    *slot = builder->count++;
+    DeviceHistoryStats* entry = &builder->stats[*slot];
+    memset(entry, 0, sizeof(*entry));
+    entry->device = *device;
+    builder->since[*slot] = 0;
+    return entry;
+}
+
+static void stats_appear(HistoryStatsBuilder* builder, const DeviceHistoryDevice* device, int64_t t) {
+    int slot;
+    DeviceHistoryStats* entry = builder ? stats_entry(builder, device, &slot) : NULL;
+    if (entry == NULL || entry->present) return;
+
+    // Coming back from a drop is a flap; the first appearance isn't
+    if (entry->last_seen_usec > 0 && t >= builder->from && t <= builder->to) {
+        int64_t gap = t - builder->since[slot];
+        entry->flaps++;
+        if (entry->shortest_gap_usec == 0 || gap < entry->shortest_gap_usec) entry->shortest_gap_usec = gap;
+    }
+    if (entry->first_seen_usec == 0) entry->first_seen_usec = t;
+    entry->device = *device;
+    entry->present = true;
+    builder->since[slot] = t;
+}
+
+static void stats_disappear(HistoryStatsBuilder* builder, const DeviceHistoryDevice* device, int64_t t) {
+    int slot;
+    DeviceHistoryStats* entry = builder ? stats_entry(builder, device, &slot) : NULL;
+    if (entry == NULL || !entry->present) return;
+
+    entry->uptime_usec += overlap(builder->since[slot], t, builder->from, builder->to);
+    entry->last_seen_usec = t;
+    if (t >= builder->from && t <= builder->to) entry->drops++;
+    entry->present = false;
+    builder->since[slot] = t;
+}
+
+// Replay side
+
+static void state_add(HistoryState* state, const DeviceHistoryDevice* device, int64_t t,
+                      HistoryStatsBuilder* builder) {
+    int i = state_find(state, device->key);
+    if (i < 0) {
+        if (state->count >= DEVICE_HISTORY_MAX_DEVICES) return;
+        i = state->count++;
+        stats_appear(builder, device, t);
+    } else if (builder) {
+        int slot;
+        DeviceHistoryStats* entry = stats_entry(builder, device, &slot);
+        if (entry) entry->device = *device;
+    }
+    state->devices[i] = *device;
+}
+
+static void state_remove(HistoryState* state, const DeviceHistoryDevice* device, int64_t t,
+                         HistoryStatsBuilder* builder) {
+    int i = state_find(state, device->key);
+    if (i < 0) return;
+    stats_disappear(builder, &state->devices[i], t);
+    state->devices[i] = state->devices[--state->count];
+}
+
+// A snapshot replaces the list. Mid-session snapshots match the replayed
+// state; one that starts a new recording session turns what changed while
+// nothing was recording into adds and removes.
+static void state_apply_snapshot(HistoryState* state, const DeviceHistoryDevice* devices, int count,
+                                 int64_t t, HistoryStatsBuilder* builder) {
+    for (int i = state->count - 1; i >= 0; i--) {
+        bool still = false;
+        for (int j = 0; j < count && !still; j++) still = devices[j].key == state->devices[i].key;
+        if (!still) state_remove(state, &state->devices[i], t, builder);
+    }
+    for (int j = 0; j < count; j++) {
+        state_add(state, &devices[j], t, builder);
+    }
+    state->known = true;
+}
+
+// Replay every surviving record up to until_usec
+static void replay(DeviceHistoryReader* reader, int64_t until_usec, HistoryState* state,
+                   HistoryStatsBuilder* builder) {
+    uint64_t start, head;
+    oldest_index(reader, &start, &head);
+    memset(state, 0, sizeof(*state));
+
+    DeviceHistoryRecord record;
+    uint64_t i = start;
+    while (i < head) {
+        if (!read_record(reader, i, &record)) {
+            i++;
+            continue;
+        }
+        if (record.time_usec > until_usec) break;
+
+        DeviceHistoryDevice device;
+        switch ((DeviceHistoryKind)record.kind) {
+            case DEVICE_HISTORY_SNAPSHOT: {
+                // Only a snapshot with every member still readable counts
+                uint32_t n = read_snapshot(reader, i, head, &record);
+                if (n == record.changed_fields) {
+                    state_apply_snapshot(state, reader->snapshot, (int)n, record.time_usec, builder);
+                    i += 1 + n;
+                    continue;
+                }
+                break;
+            }
+            case DEVICE_HISTORY_ADDED:
+            case DEVICE_HISTORY_MODIFIED:
+                if (!state->known) break;
+                record_device(&record, &device);
+                state_add(state, &device, record.time_usec, builder);
+                break;
+            case DEVICE_HISTORY_REMOVED:
+                if (!state->known) break;
+                record_device(&record, &device);
+                state_remove(state, &device, record.time_usec, builder);
+                break;
+            case DEVICE_HISTORY_PRESENT:
+                break;                  // member of a snapshot that didn't survive whole
+        }
+        i++;
+    }
+}
+
+int device_history_devices_at(DeviceHistoryReader* reader, int64_t time_usec,
+                              DeviceHistoryDevice* devices, int max_devices) {
+    if (reader == NULL || max_devices < 0) return -1;
+
+    HistoryState* state = (HistoryState*)malloc(sizeof(HistoryState));
+    if (state == NULL) return -1;
+    replay(reader, time_usec, state, NULL);
+
+    int count = -1;
+    if (state->known) {
+        count = state->count < max_devices ? state->count : max_devices;
+        if (count > 0) memcpy(devices, state->devices, (size_t)count * sizeof(DeviceHistoryDevice));
+    }
+    free(state);
+    return count;
+}
+
+int device_history_stats(DeviceHistoryReader* reader, int64_t from_usec, int64_t to_usec,
+                         DeviceHistoryStats* stats, int max_stats) {
+    if (reader == NULL || max_stats < 0) return -1;
+
+    int64_t oldest, newest;
+    device_history_span(reader, &oldest, &newest);
+    if (from_usec <= 0) from_usec = oldest;
+    if (to_usec <= 0) to_usec = newest;
+
+    HistoryState* state = (HistoryState*)malloc(sizeof(HistoryState));
+    HistoryStatsBuilder* builder = (HistoryStatsBuilder*)calloc(1, sizeof(HistoryStatsBuilder));
+    if (state == NULL || builder == NULL) {
+        free(state);
+        free(builder);
+        return -1;
+    }
+    builder->from = from_usec;
+    builder->to = to_usec;
+    builder->max = max_stats;
+    builder->stats = stats;
+    replay(reader, to_usec, state, builder);
+
+    // Close out what is still present, then keep only devices the window saw
+    int count = 0;
+    for (int i = 0; i < builder->count; i++) {
+        DeviceHistoryStats entry = stats[i];
+        if (entry.present) {
+            entry.uptime_usec += overlap(builder->since[i], to_usec, from_usec, to_usec);
+            entry.last_seen_usec = to_usec;
+        }
+        if (entry.uptime_usec > 0 || entry.drops > 0) stats[count++] = entry;
+    }
+
+    free(state);
+    free(builder);
+    return count;
+}
+
+void device_history_reader_close(DeviceHistoryReader* reader) {
+    if (reader == NULL) return;
+    munmap((void*)reader->header, reader->map_size);
+    free(reader);
+}
+
+#else
+
+DeviceHistoryReader* device_history_reader_open(const char* path) {
+    (void)path;
+    return NULL;
+}
+
+void device_history_span(DeviceHistoryReader* reader, int64_t* oldest_usec, int64_t* newest_usec) {
+    (void)reader;
+    *oldest_usec = 0;
+    *newest_usec = 0;
+}
+
+int device_history_devices_at(DeviceHistoryReader* reader, int64_t time_usec,
+                              DeviceHistoryDevice* devices, int max_devices) {
+    (void)reader; (void)time_usec; (void)devices; (void)max_devices;
+    return -1;
+}
+
+int device_history_stats(DeviceHistoryReader* reader, int64_t from_usec, int64_t to_usec,
+                         DeviceHistoryStats* stats, int max_stats) {
+    (void)reader; (void)from_usec; (void)to_usec; (void)stats; (void)max_stats;
+    return -1;
+}
+
+void device_history_reader_close(DeviceHistoryReader* reader) {
+    (void)reader;
+}
+
+#endif
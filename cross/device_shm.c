@@ -0,0 +1,182 @@
+// device_shm.c - Seqlock publisher for the shared-memory device table
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "device_shm.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct DeviceShmPublisher {
+    char name[256];
+    int fd;
+    DeviceShmTable* table;
+    audio_ctx_t* ctx;           // created on first publish_current
+    AudioDevice scratch[DEVICE_SHM_MAX_DEVICES];
+};
+
+static int64_t realtime_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// A publisher that holds the write side but no longer exists. EPERM means
+// the process is alive under another user.
+static bool writer_dead(int32_t pid) {
+    return pid <= 0 || (kill((pid_t)pid, 0) < 0 && errno == ESRCH);
+}
+
+// Take the write side of the seqlock. Claiming writer_pid serializes
+// publishers running in different processes; one that died holding it
+// is taken over, and the counter it left odd stays odd until this
+// update ends.
+static void seq_write_begin(DeviceShmTable* table) {
+    int32_t self = (int32_t)getpid();
+    for (;;) {
+        int32_t owner = 0;
+        if (__atomic_compare_exchange_n(&table->writer_pid, &owner, self, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        if (writer_dead(owner) &&
+            __atomic_compare_exchange_n(&table->writer_pid, &owner, self, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        sched_yield();
+    }
+
+    uint64_t seq = __atomic_load_n(&table->seq, __ATOMIC_RELAXED);
+    if ((seq & 1) == 0) __atomic_store_n(&table->seq, seq + 1, __ATOMIC_RELAXED);
+    // Make the odd counter visible before any of the table stores
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void seq_write_end(DeviceShmTable* table) {
+    __atomic_fetch_add(&table->seq, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&table->writer_pid, 0, __ATOMIC_RELEASE);
+}
+
+DeviceShmPublisher* device_shm_publisher_open(const char* name) {
+    if (name == NULL) name = DEVICE_SHM_DEFAULT_NAME;
+
+    DeviceShmPublisher* publisher = (DeviceShmPublisher*)calloc(1, sizeof(DeviceShmPublisher));
+    if (publisher == NULL) return NULL;
+    snprintf(publisher->name, sizeof(publisher->name), "%s", name);
+
+    publisher->fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (publisher->fd < 0) {
+        free(publisher);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(publisher->fd, &st) < 0 ||
+        ((size_t)st.st_size < sizeof(DeviceShmTable) &&
+         ftruncate(publisher->fd, sizeof(DeviceShmTable)) < 0)) {
+        close(publisher->fd);
+        free(publisher);
+        return NULL;
+    }
+
+    publisher->table = (DeviceShmTable*)mmap(NULL, sizeof(DeviceShmTable),
+        PROT_READ | PROT_WRITE, MAP_SHARED, publisher->fd, 0);
+    if (publisher->table == MAP_FAILED) {
+        close(publisher->fd);
+        free(publisher);
+        return NULL;
+    }
+
+    // First publisher (or a layout change) initializes the header
+    DeviceShmTable* table = publisher->table;
+    if (table->magic != DEVICE_SHM_MAGIC || table->version != DEVICE_SHM_VERSION ||
+        table->device_size != sizeof(AudioDevice)) {
+        // An older layout has device data where writer_pid is now
+        if (table->version != DEVICE_SHM_VERSION) __atomic_store_n(&table->writer_pid, 0, __ATOMIC_RELAXED);
+        seq_write_begin(table);
+        table->version = DEVICE_SHM_VERSION;
+        table->device_size = sizeof(AudioDevice);
+        table->capacity = DEVICE_SHM_MAX_DEVICES;
+        table->count = 0;
+        table->total = 0;
+        table->published_usec = 0;
+        __atomic_store_n(&table->magic, DEVICE_SHM_MAGIC, __ATOMIC_RELAXED);
+        seq_write_end(table);
+    }
+
+    return publisher;
+}
+
+int device_shm_publish(DeviceShmPublisher* publisher, const AudioDevice* devices, int count) {
+    if (publisher == NULL || count < 0) return -1;
+    int total = count;
+    if (count > DEVICE_SHM_MAX_DEVICES) count = DEVICE_SHM_MAX_DEVICES;
+
+    DeviceShmTable* table = publisher->table;
+    seq_write_begin(table);
+    if (count > 0) {
+        memcpy(table->devices, devices, (size_t)count * sizeof(AudioDevice));
+    }
+    table->count = count;
+    table->total = total;
+    table->published_usec = realtime_usec();
+    seq_write_end(table);
+
+    return count;
+}
+
+// Enumerate and publish in one step; returns the published device count.
+// Repeated calls reuse one enumeration context and its cached handles.
+int device_shm_publish_current(DeviceShmPublisher* publisher) {
+    if (publisher == NULL) return -1;
+    if (publisher->ctx == NULL) {
+        publisher->ctx = audio_ctx_create();
+        if (publisher->ctx == NULL) return -1;
+    }
+
+    int count = audio_ctx_list(publisher->ctx, publisher->scratch, DEVICE_SHM_MAX_DEVICES);
+    return device_shm_publish(publisher, publisher->scratch, count);
+}
+
+void device_shm_publisher_close(DeviceShmPublisher* publisher, bool unlink_segment) {
+    if (publisher == NULL) return;
+    audio_ctx_destroy(publisher->ctx);
+    munmap(publisher->table, sizeof(DeviceShmTable));
+    close(publisher->fd);
+    if (unlink_segment) {
+        shm_unlink(publisher->name);
+    }
+    free(publisher);
+}
+
+#else
+
+// POSIX shared memory is not available on Windows builds
+DeviceShmPublisher* device_shm_publisher_open(const char* name) {
+    (void)name;
+    return NULL;
+}
+
+int device_shm_publish(DeviceShmPublisher* publisher, const AudioDevice* devices, int count) {
+    (void)publisher; (void)devices; (void)count;
+    return -1;
+}
+
+int device_shm_publish_current(DeviceShmPublisher* publisher) {
+    (void)publisher;
+    return -1;
+}
+
+void device_shm_publisher_close(DeviceShmPublisher* publisher, bool unlink_segment) {
+    (void)publisher; (void)unlink_segment;
+}
+
+#endif
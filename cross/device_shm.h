@@ -0,0 +1,64 @@
+// device_shm.h - Device table published through POSIX shared memory
+#ifndef DEVICE_SHM_H
+#define DEVICE_SHM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEVICE_SHM_DEFAULT_NAME "/voxi_audio_devices"
+#define DEVICE_SHM_MAGIC 0x56414454u   // "VADT"
+#define DEVICE_SHM_VERSION 2
+#define DEVICE_SHM_MAX_DEVICES 64
+
+// Shared segment layout. The seqlock counter is odd while a writer is
+// updating the table; readers copy the table and retry if the counter
+// moved or was odd, so they never take a lock or enter the kernel.
+// Publishers claim writer_pid before making the counter odd, so one that
+// died mid-update can be told apart from one that is still writing.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t device_size;       // sizeof(AudioDevice) of the publisher
+    uint32_t capacity;
+    uint64_t seq;               // seqlock counter, generation = seq / 2
+    int64_t published_usec;     // CLOCK_REALTIME of the last publish
+    int32_t count;              // devices in the table
+    int32_t total;              // devices found; more than count when the list was cut off
+    int32_t writer_pid;         // publisher holding the write side, 0 when free
+    int32_t reserved;
+    AudioDevice devices[DEVICE_SHM_MAX_DEVICES];
+} DeviceShmTable;
+
+typedef struct DeviceShmPublisher DeviceShmPublisher;
+typedef struct DeviceShmReader DeviceShmReader;
+
+// Publisher (device_shm.c)
+DeviceShmPublisher* device_shm_publisher_open(const char* name);
+// count is the number of devices found; the first DEVICE_SHM_MAX_DEVICES
+// are published and readers see the full count as total. Returns the
+// number published.
+int device_shm_publish(DeviceShmPublisher* publisher, const AudioDevice* devices, int count);
+int device_shm_publish_current(DeviceShmPublisher* publisher);
+void device_shm_publisher_close(DeviceShmPublisher* publisher, bool unlink_segment);
+
+// Reader (device_shm_reader.c, no audio backend dependencies)
+DeviceShmReader* device_shm_reader_open(const char* name);
+uint64_t device_shm_generation(const DeviceShmReader* reader);
+// total (may be NULL) receives the number of devices the publisher found,
+// which exceeds the return value when the table or buffer cut the list off.
+// Returns -1 with errno EAGAIN when publishers kept the table busy for a
+// few milliseconds; that is retryable, not a sign the publisher died.
+int device_shm_read(DeviceShmReader* reader, AudioDevice* devices, int max_devices, uint64_t* generation,
+                    int* total);
+void device_shm_reader_close(DeviceShmReader* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEVICE_SHM_H
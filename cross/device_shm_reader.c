@@ -0,0 +1,157 @@
+// device_shm_reader.c - Lock-free reader for the shared-memory device table
+#include <stdlib.h>
+#include <string.h>
+#include "device_shm.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// A publisher holds the odd counter for one memcpy of the table, but it
+// can be preempted in the middle of it. A reader therefore waits for a
+// stable copy by time rather than by attempts: a short spin for the
+// common case, then yielding so a publisher sharing the CPU can finish.
+// Failing for the whole timeout means a very slow or a dead publisher,
+// and the two can't be told apart from here.
+#define DEVICE_SHM_READ_TIMEOUT_NS 5000000      // 5 ms
+#define DEVICE_SHM_READ_SPINS 64
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause");
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct DeviceShmReader {
+    const DeviceShmTable* table;
+};
+
+DeviceShmReader* device_shm_reader_open(const char* name) {
+    if (name == NULL) name = DEVICE_SHM_DEFAULT_NAME;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(DeviceShmTable)) {
+        close(fd);
+        return NULL;
+    }
+
+    void* mapping = mmap(NULL, sizeof(DeviceShmTable), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return NULL;
+
+    const DeviceShmTable* table = (const DeviceShmTable*)mapping;
+    if (table->magic != DEVICE_SHM_MAGIC || table->version != DEVICE_SHM_VERSION ||
+        table->device_size != sizeof(AudioDevice)) {
+        munmap(mapping, sizeof(DeviceShmTable));
+        return NULL;
+    }
+
+    DeviceShmReader* reader = (DeviceShmReader*)calloc(1, sizeof(DeviceShmReader));
+    if (reader == NULL) {
+        munmap(mapping, sizeof(DeviceShmTable));
+        return NULL;
+    }
+    reader->table = table;
+    return reader;
+}
+
+// Cheap change check: compare against the generation of the last read
+uint64_t device_shm_generation(const DeviceShmReader* reader) {
+    if (reader == NULL) return 0;
+    return __atomic_load_n(&reader->table->seq, __ATOMIC_ACQUIRE) / 2;
+}
+
+// Copy a consistent snapshot into the caller's buffer. Returns the number
+// of devices copied, or -1 with errno set to EAGAIN if no stable copy
+// could be taken within the timeout; the table is intact and a later
+// call may succeed.
+int device_shm_read(DeviceShmReader* reader, AudioDevice* devices, int max_devices, uint64_t* generation,
+                    int* total) {
+    if (reader == NULL || max_devices < 0) return -1;
+    const DeviceShmTable* table = reader->table;
+    int64_t deadline = 0;
+
+    for (int attempt = 0; ; attempt++) {
+        // Back off before every retry; the clock is only read once the
+        // spin is over
+        if (attempt > 0) {
+            if (attempt < DEVICE_SHM_READ_SPINS) {
+                cpu_relax();
+            } else {
+                int64_t now = monotonic_ns();
+                if (deadline == 0) deadline = now + DEVICE_SHM_READ_TIMEOUT_NS;
+                if (now >= deadline) break;
+                sched_yield();
+            }
+        }
+
+        uint64_t begin = __atomic_load_n(&table->seq, __ATOMIC_ACQUIRE);
+        if (begin & 1) continue;
+
+        int count = table->count;
+        int found = table->total;
+        if (count < 0) count = 0;
+        if (count > DEVICE_SHM_MAX_DEVICES) count = DEVICE_SHM_MAX_DEVICES;
+        if (count > max_devices) count = max_devices;
+        if (count > 0) {
+            memcpy(devices, table->devices, (size_t)count * sizeof(AudioDevice));
+        }
+
+        // Order the table loads before re-checking the counter
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&table->seq, __ATOMIC_RELAXED) == begin) {
+            if (generation) *generation = begin / 2;
+            if (total) *total = found > count ? found : count;
+            return count;
+        }
+    }
+
+    errno = EAGAIN;
+    return -1;
+}
+
+void device_shm_reader_close(DeviceShmReader* reader) {
+    if (reader == NULL) return;
+    munmap((void*)reader->table, sizeof(DeviceShmTable));
+    free(reader);
+}
+
+#else
+
+DeviceShmReader* device_shm_reader_open(const char* name) {
+    (void)name;
+    return NULL;
+}
+
+uint64_t device_shm_generation(const DeviceShmReader* reader) {
+    (void)reader;
+    return 0;
+}
+
+int device_shm_read(DeviceShmReader* reader, AudioDevice* devices, int max_devices, uint64_t* generation,
+                    int* total) {
+    (void)reader; (void)devices; (void)max_devices; (void)generation; (void)total;
+    return -1;
+}
+
+void device_shm_reader_close(DeviceShmReader* reader) {
+    (void)reader;
+}
+
+#endif
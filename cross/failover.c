@@ -0,0 +1,758 @@
+// failover.c - Playback sink that moves to the next-best device when its device goes away
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "failover.h"
+
+void failover_default_config(FailoverConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->sample_rate = 48000;
+    config->channels = 2;
+    config->period_frames = 480;
+    config->preroll_ms = 200;
+    config->budget_ms = 250;
+    config->check_interval_ms = 100;
+
+    // Wired and built-in outputs before the ones that tend to vanish
+    FailoverRanking* ranking = &config->ranking;
+    ranking->keys[0] = FAILOVER_KEY_DEFAULT;
+    ranking->keys[1] = FAILOVER_KEY_TYPE;
+    ranking->keys[2] = FAILOVER_KEY_CONNECTION;
+    ranking->key_count = 3;
+    ranking->types[0] = DEVICE_TYPE_HEADPHONES;
+    ranking->types[1] = DEVICE_TYPE_USB;
+    ranking->types[2] = DEVICE_TYPE_SPEAKERS;
+    ranking->types[3] = DEVICE_TYPE_HDMI;
+    ranking->types[4] = DEVICE_TYPE_BLUETOOTH;
+    ranking->type_count = 5;
+    ranking->connections[0] = CONNECTION_WIRED;
+    ranking->connections[1] = CONNECTION_BUILTIN;
+    ranking->connections[2] = CONNECTION_WIRELESS;
+    ranking->connection_count = 3;
+}
+
+static const struct { const char* name; AudioDeviceType type; } type_names[] = {
+    { "speakers", DEVICE_TYPE_SPEAKERS },
+    { "headphones", DEVICE_TYPE_HEADPHONES },
+    { "hdmi", DEVICE_TYPE_HDMI },
+    { "usb", DEVICE_TYPE_USB },
+    { "bluetooth", DEVICE_TYPE_BLUETOOTH },
+    { "virtual", DEVICE_TYPE_VIRTUAL },
+    { "unknown", DEVICE_TYPE_UNKNOWN }
+};
+
+static const struct { const char* name; AudioConnectionType connection; } connection_names[] = {
+    { "builtin", CONNECTION_BUILTIN },
+    { "wired", CONNECTION_WIRED },
+    { "wireless", CONNECTION_WIRELESS },
+    { "unknown", CONNECTION_UNKNOWN }
+};
+
+#define COUNT_OF(a) (int)(sizeof(a) / sizeof((a)[0]))
+
+// Split s at the first sep, returning the rest or NULL
+static char* split(char* s, char sep) {
+    char* rest = strchr(s, sep);
+    if (rest != NULL) *rest++ = '\0';
+    return rest;
+}
+
+// Parse one "a>b>c" list into the values of the matching name table
+static int parse_order(char* list, int* values, int max_values, bool types) {
+    int count = 0;
+    for (char* item = list, *next; item != NULL; item = next) {
+        next = split(item, '>');
+        int found = -1;
+        int table_size = types ? COUNT_OF(type_names) : COUNT_OF(connection_names);
+        for (int i = 0; i < table_size && found < 0; i++) {
+            const char* name = types ? type_names[i].name : connection_names[i].name;
+            if (strcmp(item, name) == 0) {
+                found = types ? (int)type_names[i].type : (int)connection_names[i].connection;
+            }
+        }
+        if (found < 0 || count >= max_values) return -1;
+        values[count++] = found;
+    }
+    return count;
+}
+
+int failover_parse_ranking(const char* spec, FailoverRanking* ranking) {
+    FailoverRanking parsed;
+    FailoverConfig defaults;
+    char buffer[256];
+
+    // Keys without a list keep the default order for that key
+    failover_default_config(&defaults);
+    parsed = defaults.ranking;
+    parsed.key_count = 0;
+
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+    for (char* key = buffer, *next; key != NULL; key = next) {
+        next = split(key, ',');
+        char* list = split(key, '=');
+        int values[8];
+        if (parsed.key_count >= 3) return -1;
+
+        if (strcmp(key, "default") == 0 && list == NULL) {
+            parsed.keys[parsed.key_count++] = FAILOVER_KEY_DEFAULT;
+        } else if (strcmp(key, "type") == 0) {
+            parsed.keys[parsed.key_count++] = FAILOVER_KEY_TYPE;
+            if (list == NULL) continue;
+            int n = parse_order(list, values, COUNT_OF(parsed.types), true);
+            if (n < 0) return -1;
+            for (int i = 0; i < n; i++) parsed.types[i] = (AudioDeviceType)values[i];
+            parsed.type_count = n;
+        } else if (strcmp(key, "connection") == 0) {
+            parsed.keys[parsed.key_count++] = FAILOVER_KEY_CONNECTION;
+            if (list == NULL) continue;
+            int n = parse_order(list, values, COUNT_OF(parsed.connections), false);
+            if (n < 0) return -1;
+            for (int i = 0; i < n; i++) parsed.connections[i] = (AudioConnectionType)values[i];
+            parsed.connection_count = n;
+        } else {
+            return -1;
+        }
+    }
+    *ranking = parsed;
+    return 0;
+}
+
+#if defined(__linux__)
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <time.h>
+#include "sample_convert.h"
+
+#define FAILOVER_BUFFER_PERIODS 4
+
+typedef struct {
+    FailoverCandidate info;
+    int card;                       // N of hw:N, -1 for PCMs defined in the configuration
+    bool named;                     // added by name; ranks ahead of enumerated devices
+    bool configured;                // defined in the configuration, so removal there is visible
+    int order;                      // insertion order, the final tie-break
+} Candidate;
+
+struct FailoverSink {
+    FailoverConfig config;
+    audio_ctx_t* ctx;
+    snd_config_t* alsa_config;      // private tree, refreshed when its files change
+    snd_config_update_t* alsa_update;
+    Candidate candidates[FAILOVER_MAX_CANDIDATES];
+    int candidate_count;
+    int current;                    // index into candidates, -1 while none is open
+
+    // Open device
+    snd_pcm_t* pcm;
+    SampleFormat format;
+    int device_rate;
+    Resampler* resampler;           // only when the device rate differs
+    float* resampled;
+    long resampled_capacity;
+    void* native;
+    long native_capacity;
+    long buffer_frames;             // device buffer, in program frames
+    long queued_frames;             // program frames the device held after the last write
+
+    // Preroll: the most recent program frames, replayed onto a new device
+    // to cover what the failed one had queued but not played
+    float* history;
+    long history_capacity;
+    long history_total;             // frames ever appended
+
+    double next_check_ms;
+    FailoverStats stats;
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void sleep_frames(long frames, int rate) {
+    long usec = (long)((double)frames * 1000000.0 / rate);
+    struct timespec ts = { usec / 1000000, (usec % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static int type_rank(const FailoverRanking* r, AudioDeviceType type) {
+    for (int i = 0; i < r->type_count; i++) {
+        if (r->types[i] == type) return i;
+    }
+    return r->type_count;
+}
+
+static int connection_rank(const FailoverRanking* r, AudioConnectionType connection) {
+    for (int i = 0; i < r->connection_count; i++) {
+        if (r->connections[i] == connection) return i;
+    }
+    return r->connection_count;
+}
+
+// qsort takes no context; set just before sorting
+static const FailoverRanking* sort_ranking;
+
+static int compare_candidates(const void* pa, const void* pb) {
+    const Candidate* a = (const Candidate*)pa;
+    const Candidate* b = (const Candidate*)pb;
+    const FailoverRanking* r = sort_ranking;
+
+    if (a->named != b->named) return a->named ? -1 : 1;
+    if (!a->named) {
+        for (int k = 0; k < r->key_count; k++) {
+            int da = 0, db = 0;
+            switch (r->keys[k]) {
+                case FAILOVER_KEY_DEFAULT:
+                    da = a->info.is_default ? 0 : 1;
+                    db = b->info.is_default ? 0 : 1;
+                    break;
+                case FAILOVER_KEY_TYPE:
+                    da = type_rank(r, a->info.type);
+                    db = type_rank(r, b->info.type);
+                    break;
+                case FAILOVER_KEY_CONNECTION:
+                    da = connection_rank(r, a->info.connection);
+                    db = connection_rank(r, b->info.connection);
+                    break;
+            }
+            if (da != db) return da - db;
+        }
+    }
+    return a->order - b->order;
+}
+
+// Card number of hw:N / plughw:N style names, -1 for anything else
+static int pcm_card(const char* pcm) {
+    int card;
+    if (sscanf(pcm, "hw:%d", &card) == 1) return card;
+    if (sscanf(pcm, "plughw:%d", &card) == 1) return card;
+    return -1;
+}
+
+// Whether pcm.NAME (arguments after ':' stripped) is defined in the tree
+static bool pcm_configured(snd_config_t* config, const char* pcm) {
+    char key[300];
+    snd_config_t* node;
+    size_t length = strcspn(pcm, ":");
+    if (config == NULL) return false;
+    snprintf(key, sizeof(key), "pcm.%.*s", (int)length, pcm);
+    return snd_config_search(config, key, &node) == 0;
+}
+
+FailoverSink* failover_create(const FailoverConfig* config) {
+    if (config->sample_rate <= 0 || config->channels <= 0 || config->period_frames <= 0) return NULL;
+
+    FailoverSink* sink = (FailoverSink*)calloc(1, sizeof(FailoverSink));
+    if (sink == NULL) return NULL;
+    sink->config = *config;
+    sink->current = -1;
+    sink->ctx = audio_ctx_create();
+    snd_config_update_r(&sink->alsa_config, &sink->alsa_update, NULL);
+
+    // Preroll covers at least one device buffer
+    long preroll = (long)config->sample_rate * config->preroll_ms / 1000;
+    long buffer = (long)config->period_frames * FAILOVER_BUFFER_PERIODS;
+    sink->history_capacity = preroll > buffer ? preroll : buffer;
+    sink->history = (float*)calloc((size_t)sink->history_capacity * config->channels, sizeof(float));
+    if (sink->ctx == NULL || sink->history == NULL) {
+        failover_destroy(sink);
+        return NULL;
+    }
+    return sink;
+}
+
+static Candidate* new_candidate(FailoverSink* sink, const char* pcm) {
+    for (int i = 0; i < sink->candidate_count; i++) {
+        if (strcmp(sink->candidates[i].info.pcm, pcm) == 0) return NULL;
+    }
+    if (sink->candidate_count >= FAILOVER_MAX_CANDIDATES) return NULL;
+
+    Candidate* c = &sink->candidates[sink->candidate_count];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->info.pcm, sizeof(c->info.pcm), "%s", pcm);
+    snprintf(c->info.name, sizeof(c->info.name), "%s", pcm);
+    c->info.present = true;
+    c->card = pcm_card(pcm);
+    c->order = sink->candidate_count++;
+    return c;
+}
+
+int failover_add_pcm(FailoverSink* sink, const char* pcm) {
+    Candidate* c = new_candidate(sink, pcm);
+    if (c == NULL) return -ENOSPC;
+    c->named = true;
+    c->configured = c->card < 0 && pcm_configured(sink->alsa_config, pcm);
+    return 0;
+}
+
+int failover_add_devices(FailoverSink* sink) {
+    AudioDevice devices[FAILOVER_MAX_CANDIDATES];
+    int count = audio_ctx_list_devices(sink->ctx, DEVICE_DIRECTION_PLAYBACK, devices, FAILOVER_MAX_CANDIDATES);
+    int added = 0;
+
+    if (count > FAILOVER_MAX_CANDIDATES) count = FAILOVER_MAX_CANDIDATES;
+    for (int i = 0; i < count; i++) {
+        Candidate* c = new_candidate(sink, devices[i].id);
+        if (c == NULL) continue;
+        snprintf(c->info.name, sizeof(c->info.name), "%s", devices[i].name);
+        c->info.type = devices[i].type;
+        c->info.connection = devices[i].connection;
+        c->info.is_default = devices[i].is_default;
+        added++;
+    }
+    return added;
+}
+
+// Refresh presence of every candidate on one card, with one walk of that
+// card only; configured PCMs are checked against the configuration tree
+static void refresh_card(FailoverSink* sink, int card) {
+    AudioDevice devices[FAILOVER_MAX_CANDIDATES];
+    int count = audio_ctx_list_card(sink->ctx, card, DEVICE_DIRECTION_PLAYBACK, devices, FAILOVER_MAX_CANDIDATES);
+    if (count > FAILOVER_MAX_CANDIDATES) count = FAILOVER_MAX_CANDIDATES;
+
+    for (int i = 0; i < sink->candidate_count; i++) {
+        Candidate* c = &sink->candidates[i];
+        if (c->card != card) continue;
+
+        // Named hw/plughw PCMs only need their card; enumerated ones
+        // need their exact device
+        bool present = c->named ? count > 0 : false;
+        for (int j = 0; j < count && !present; j++) {
+            present = strcmp(devices[j].id, c->info.pcm) == 0;
+        }
+        c->info.present = present;
+    }
+}
+
+static void refresh_configured(FailoverSink* sink) {
+    snd_config_update_r(&sink->alsa_config, &sink->alsa_update, NULL);
+    for (int i = 0; i < sink->candidate_count; i++) {
+        Candidate* c = &sink->candidates[i];
+        if (c->configured) c->info.present = pcm_configured(sink->alsa_config, c->info.pcm);
+    }
+}
+
+static void refresh_candidate(FailoverSink* sink, const Candidate* c) {
+    if (c->card >= 0) {
+        refresh_card(sink, c->card);
+    } else if (c->configured) {
+        refresh_configured(sink);
+    }
+}
+
+// Every candidate, walking each card once
+static void refresh_all(FailoverSink* sink) {
+    bool walked[FAILOVER_MAX_CANDIDATES] = { false };
+    refresh_configured(sink);
+    for (int i = 0; i < sink->candidate_count; i++) {
+        int card = sink->candidates[i].card;
+        if (card < 0) continue;
+        bool seen = false;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = walked[j] && sink->candidates[j].card == card;
+        }
+        if (!seen) refresh_card(sink, card);
+        walked[i] = true;
+    }
+}
+
+static void close_device(FailoverSink* sink) {
+    if (sink->pcm) {
+        snd_pcm_drop(sink->pcm);
+        snd_pcm_close(sink->pcm);
+    }
+    sink->pcm = NULL;
+    resampler_destroy(sink->resampler);
+    sink->resampler = NULL;
+    sink->queued_frames = 0;
+    sink->current = -1;
+}
+
+static int configure_device(FailoverSink* sink) {
+    const FailoverConfig* config = &sink->config;
+    snd_pcm_hw_params_t* hw;
+    snd_pcm_sw_params_t* sw;
+    unsigned int rate = (unsigned int)config->sample_rate;
+    snd_pcm_uframes_t period, buffer;
+    int err;
+
+    snd_pcm_hw_params_alloca(&hw);
+    if ((err = snd_pcm_hw_params_any(sink->pcm, hw)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_access(sink->pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) return err;
+
+    sink->format = SAMPLE_FORMAT_UNKNOWN;
+    for (int i = 0; i < SAMPLE_FORMAT_PREFERENCE_COUNT; i++) {
+        snd_pcm_format_t candidate = (snd_pcm_format_t)sample_format_to_alsa(sample_format_preference[i]);
+        if (snd_pcm_hw_params_test_format(sink->pcm, hw, candidate) == 0) {
+            sink->format = sample_format_preference[i];
+            break;
+        }
+    }
+    if (sink->format == SAMPLE_FORMAT_UNKNOWN) return -EINVAL;
+    if ((err = snd_pcm_hw_params_set_format(sink->pcm, hw, (snd_pcm_format_t)sample_format_to_alsa(sink->format))) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_channels(sink->pcm, hw, (unsigned)config->channels)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_rate_near(sink->pcm, hw, &rate, NULL)) < 0) return err;
+
+    period = (snd_pcm_uframes_t)((long long)config->period_frames * rate / config->sample_rate);
+    buffer = period * FAILOVER_BUFFER_PERIODS;
+    if ((err = snd_pcm_hw_params_set_period_size_near(sink->pcm, hw, &period, NULL)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(sink->pcm, hw, &buffer)) < 0) return err;
+    if ((err = snd_pcm_hw_params(sink->pcm, hw)) < 0) return err;
+    snd_pcm_hw_params_get_buffer_size(hw, &buffer);
+    sink->device_rate = (int)rate;
+    sink->buffer_frames = (long)((double)buffer * config->sample_rate / rate);
+
+    // Start at half a buffer: the replayed preroll gets the new device
+    // going without waiting for fresh program audio
+    snd_pcm_sw_params_alloca(&sw);
+    if ((err = snd_pcm_sw_params_current(sink->pcm, sw)) < 0) return err;
+    snd_pcm_sw_params_set_start_threshold(sink->pcm, sw, buffer / 2);
+    return snd_pcm_sw_params(sink->pcm, sw);
+}
+
+static int open_device(FailoverSink* sink, int index) {
+    const char* pcm = sink->candidates[index].info.pcm;
+    int err;
+
+    // Non-blocking open so a busy device fails at once instead of
+    // stalling the switch; writes then block as usual
+    if (sink->alsa_config) {
+        err = snd_pcm_open_lconf(&sink->pcm, pcm, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK, sink->alsa_config);
+    } else {
+        err = snd_pcm_open(&sink->pcm, pcm, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
+    }
+    if (err < 0) {
+        sink->pcm = NULL;
+        return err;
+    }
+    if ((err = snd_pcm_nonblock(sink->pcm, 0)) < 0 || (err = configure_device(sink)) < 0) {
+        close_device(sink);
+        return err;
+    }
+    if (sink->device_rate != sink->config.sample_rate) {
+        sink->resampler = resampler_create(sink->config.sample_rate, sink->device_rate, sink->config.channels);
+        if (sink->resampler == NULL) {
+            close_device(sink);
+            return -ENOMEM;
+        }
+    }
+    sink->current = index;
+    return 0;
+}
+
+static bool grow(void** buffer, long* capacity, long needed, size_t unit) {
+    if (needed <= *capacity) return true;
+    void* grown = realloc(*buffer, (size_t)needed * unit);
+    if (grown == NULL) return false;
+    *buffer = grown;
+    *capacity = needed;
+    return true;
+}
+
+// Write device frames, recovering from underruns. Anything else (the
+// device vanished, the driver died) is returned for a failover.
+static int write_native(FailoverSink* sink, const void* data, long frames) {
+    size_t frame_bytes = (size_t)sink->config.channels * sample_format_bytes(sink->format);
+    const char* p = (const char*)data;
+
+    while (frames > 0) {
+        snd_pcm_sframes_t written = snd_pcm_writei(sink->pcm, p, (snd_pcm_uframes_t)frames);
+        if (written < 0) {
+            if (written != -EPIPE && written != -ESTRPIPE) return (int)written;
+            if (written == -EPIPE) sink->stats.xruns++;
+            int err = snd_pcm_recover(sink->pcm, (int)written, 1);
+            if (err < 0) return err;
+            continue;
+        }
+        p += (size_t)written * frame_bytes;
+        frames -= written;
+    }
+    return 0;
+}
+
+static int write_converted(FailoverSink* sink, const float* frames, long count) {
+    size_t frame_bytes = (size_t)sink->config.channels * sample_format_bytes(sink->format);
+    if (!grow(&sink->native, &sink->native_capacity, count, frame_bytes)) return -ENOMEM;
+    sample_convert_from_float(sink->format, frames, sink->native, count * sink->config.channels);
+    return write_native(sink, sink->native, count);
+}
+
+// Write program frames to the open device
+static int write_device(FailoverSink* sink, const float* frames, long count) {
+    int channels = sink->config.channels;
+    int err;
+
+    if (sink->resampler == NULL) {
+        if ((err = write_converted(sink, frames, count)) < 0) return err;
+    } else {
+        // One period of program audio, plus slack for the filter window
+        long capacity = (long)((double)sink->config.period_frames * sink->device_rate / sink->config.sample_rate) + 1024;
+        if (!grow((void**)&sink->resampled, &sink->resampled_capacity, capacity, (size_t)channels * sizeof(float))) {
+            return -ENOMEM;
+        }
+        for (long used = 0; used < count; ) {
+            long consumed;
+            long produced = resampler_process(sink->resampler, frames + used * channels, count - used, &consumed,
+                                              sink->resampled, sink->resampled_capacity);
+            if ((err = write_converted(sink, sink->resampled, produced)) < 0) return err;
+            used += consumed;
+        }
+    }
+
+    // Track what the device holds, in program frames, so a switch knows
+    // how much preroll to replay
+    snd_pcm_sframes_t delay;
+    if (snd_pcm_delay(sink->pcm, &delay) == 0 && delay >= 0) {
+        sink->queued_frames = (long)((double)delay * sink->config.sample_rate / sink->device_rate);
+    }
+    return 0;
+}
+
+static void history_append(FailoverSink* sink, const float* frames, long count) {
+    int channels = sink->config.channels;
+    for (long i = 0; i < count; ) {
+        long slot = (sink->history_total + i) % sink->history_capacity;
+        long run = count - i;
+        if (run > sink->history_capacity - slot) run = sink->history_capacity - slot;
+        memcpy(sink->history + slot * channels, frames + i * channels, (size_t)run * channels * sizeof(float));
+        i += run;
+    }
+    sink->history_total += count;
+}
+
+// Write the newest frames of history to the open device
+static int replay_history(FailoverSink* sink, long frames) {
+    int channels = sink->config.channels;
+    if (frames > sink->history_total) frames = sink->history_total;
+    if (frames > sink->history_capacity) frames = sink->history_capacity;
+
+    long start = sink->history_total - frames;
+    while (frames > 0) {
+        long slot = start % sink->history_capacity;
+        long run = frames < sink->history_capacity - slot ? frames : sink->history_capacity - slot;
+        int err = write_device(sink, sink->history + slot * channels, run);
+        if (err < 0) return err;
+        start += run;
+        frames -= run;
+    }
+    return 0;
+}
+
+static void record_event(FailoverSink* sink, const FailoverEvent* event) {
+    if (sink->stats.event_count < FAILOVER_MAX_EVENTS) {
+        sink->stats.events[sink->stats.event_count] = *event;
+    }
+    sink->stats.event_count++;
+    if (sink->config.on_failover) sink->config.on_failover(event, sink->config.user);
+}
+
+// Close the failed device, if any, and open the best present candidate
+// within the time budget, replaying what the old device still held. A
+// quiet switch (a retry with nothing open) is only reported if it works.
+static bool switch_device(FailoverSink* sink, const char* reason, bool quiet) {
+    double start = now_ms();
+    FailoverEvent event;
+    memset(&event, 0, sizeof(event));
+
+    int failed = sink->current;
+    long replay = sink->queued_frames + sink->config.period_frames;
+    if (failed >= 0) {
+        Candidate* c = &sink->candidates[failed];
+        snprintf(event.from, sizeof(event.from), "%s", c->info.pcm);
+        close_device(sink);
+        // Only the failed device's card is walked again; it may still
+        // hold other usable PCMs, or none. The failed PCM itself is out
+        // until a later check sees it again.
+        refresh_candidate(sink, c);
+        c->info.present = false;
+    }
+    snprintf(event.reason, sizeof(event.reason), "%s", reason);
+
+    for (int i = 0; i < sink->candidate_count; i++) {
+        if (i == failed || !sink->candidates[i].info.present) continue;
+        if (now_ms() - start > sink->config.budget_ms) break;
+        if (open_device(sink, i) < 0) continue;
+
+        // The new device starts from what the old one never played, up
+        // to one buffer so the replay itself never blocks
+        if (replay > sink->buffer_frames) replay = sink->buffer_frames;
+        if (replay_history(sink, replay) == 0) {
+            event.replayed_frames = replay < sink->history_total ? replay : sink->history_total;
+            snprintf(event.to, sizeof(event.to), "%s", sink->candidates[i].info.pcm);
+            event.ok = true;
+            break;
+        }
+        close_device(sink);
+        sink->candidates[i].info.present = false;
+    }
+
+    event.elapsed_ms = now_ms() - start;
+    if (event.ok || !quiet) record_event(sink, &event);
+    sink->next_check_ms = now_ms() + sink->config.check_interval_ms;
+    return event.ok;
+}
+
+int failover_start(FailoverSink* sink) {
+    if (sink->candidate_count == 0) return -ENODEV;
+
+    sort_ranking = &sink->config.ranking;
+    qsort(sink->candidates, (size_t)sink->candidate_count, sizeof(Candidate), compare_candidates);
+
+    for (int i = 0; i < sink->candidate_count; i++) {
+        if (open_device(sink, i) == 0) {
+            sink->next_check_ms = now_ms() + sink->config.check_interval_ms;
+            return 0;
+        }
+    }
+    return -ENODEV;
+}
+
+// Periodic presence check of the open device: a write to a removed USB
+// card fails on its own, but a PCM dropped from the configuration or a
+// card going away behind a plugin only shows up here
+static const char* check_current(FailoverSink* sink) {
+    Candidate* c = &sink->candidates[sink->current];
+    sink->next_check_ms = now_ms() + sink->config.check_interval_ms;
+    if (c->card < 0 && !c->configured) return NULL;
+
+    refresh_candidate(sink, c);
+    if (c->info.present) return NULL;
+    return c->card >= 0 ? "card removed" : "removed from configuration";
+}
+
+long failover_write(FailoverSink* sink, const float* frames, long count) {
+    int channels = sink->config.channels;
+    long done = 0;
+
+    while (done < count) {
+        long chunk = count - done;
+        if (chunk > sink->config.period_frames) chunk = sink->config.period_frames;
+        const float* src = frames + (size_t)done * channels;
+        history_append(sink, src, chunk);
+        done += chunk;
+        sink->stats.frames_written += chunk;
+
+        // With nothing open, retry at the check interval and drop audio
+        // in between, still at the program rate so the producer keeps
+        // real time. The chunk just queued is already in the preroll.
+        if (sink->current < 0) {
+            if (now_ms() >= sink->next_check_ms) {
+                refresh_all(sink);
+                if (switch_device(sink, "recovered", true)) continue;
+            }
+            sink->stats.dropped_frames += chunk;
+            sleep_frames(chunk, sink->config.sample_rate);
+            continue;
+        }
+
+        if (now_ms() >= sink->next_check_ms) {
+            const char* gone = check_current(sink);
+            if (gone != NULL) {
+                switch_device(sink, gone, false);
+                continue;
+            }
+        }
+
+        int err = write_device(sink, src, chunk);
+        if (err < 0) {
+            char reason[128];
+            snprintf(reason, sizeof(reason), "write: %s", snd_strerror(err));
+            switch_device(sink, reason, false);
+        }
+    }
+    return done;
+}
+
+void failover_drain(FailoverSink* sink) {
+    if (sink->pcm) {
+        if (snd_pcm_state(sink->pcm) == SND_PCM_STATE_PREPARED) snd_pcm_start(sink->pcm);
+        snd_pcm_drain(sink->pcm);
+    }
+}
+
+void failover_stats(FailoverSink* sink, FailoverStats* stats) {
+    *stats = sink->stats;
+    stats->current[0] = '\0';
+    if (sink->current >= 0) {
+        snprintf(stats->current, sizeof(stats->current), "%s", sink->candidates[sink->current].info.pcm);
+    }
+}
+
+int failover_candidates(FailoverSink* sink, FailoverCandidate* candidates, int max_candidates) {
+    int n = sink->candidate_count < max_candidates ? sink->candidate_count : max_candidates;
+    for (int i = 0; i < n; i++) {
+        candidates[i] = sink->candidates[i].info;
+    }
+    return n;
+}
+
+void failover_destroy(FailoverSink* sink) {
+    if (sink == NULL) return;
+
+    close_device(sink);
+    free(sink->resampled);
+    free(sink->native);
+    free(sink->history);
+    if (sink->alsa_update) snd_config_update_free(sink->alsa_update);
+    if (sink->alsa_config) snd_config_delete(sink->alsa_config);
+    audio_ctx_destroy(sink->ctx);
+    free(sink);
+}
+
+#else
+
+// Playback drives ALSA PCMs directly; other backends can create a sink
+// but it never opens a device
+struct FailoverSink {
+    FailoverStats stats;
+};
+
+FailoverSink* failover_create(const FailoverConfig* config) {
+    (void)config;
+    return (FailoverSink*)calloc(1, sizeof(FailoverSink));
+}
+
+int failover_add_pcm(FailoverSink* sink, const char* pcm) {
+    (void)sink;
+    (void)pcm;
+    return -1;
+}
+
+int failover_add_devices(FailoverSink* sink) {
+    (void)sink;
+    return 0;
+}
+
+int failover_start(FailoverSink* sink) {
+    (void)sink;
+    return -1;
+}
+
+long failover_write(FailoverSink* sink, const float* frames, long count) {
+    (void)sink;
+    (void)frames;
+    (void)count;
+    return -1;
+}
+
+void failover_drain(FailoverSink* sink) {
+    (void)sink;
+}
+
+void failover_stats(FailoverSink* sink, FailoverStats* stats) {
+    *stats = sink->stats;
+}
+
+int failover_candidates(FailoverSink* sink, FailoverCandidate* candidates, int max_candidates) {
+    (void)sink;
+    (void)candidates;
+    (void)max_candidates;
+    return 0;
+}
+
+void failover_destroy(FailoverSink* sink) {
+    free(sink);
+}
+
+#endif
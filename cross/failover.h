@@ -0,0 +1,112 @@
+// failover.h - Playback sink that moves to the next-best device when its device goes away
+#ifndef FAILOVER_H
+#define FAILOVER_H
+
+#include <stdbool.h>
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FAILOVER_MAX_CANDIDATES 32
+#define FAILOVER_MAX_EVENTS 32
+
+typedef enum {
+    FAILOVER_KEY_DEFAULT,           // the system default first
+    FAILOVER_KEY_TYPE,              // by position in types[]
+    FAILOVER_KEY_CONNECTION         // by position in connections[]
+} FailoverRankKey;
+
+// Order of preference among enumerated devices. Keys are compared in
+// order; types and connections missing from their list rank after the
+// listed ones. PCMs added by name always rank first, in the order added.
+typedef struct {
+    FailoverRankKey keys[3];
+    int key_count;
+    AudioDeviceType types[7];
+    int type_count;
+    AudioConnectionType connections[4];
+    int connection_count;
+} FailoverRanking;
+
+typedef struct {
+    char from[256];                 // empty when recovering with no device open
+    char to[256];                   // empty when no candidate could be opened
+    char reason[128];
+    double elapsed_ms;              // from detection to audio flowing again
+    long replayed_frames;           // preroll written again to the new device
+    bool ok;
+} FailoverEvent;
+
+typedef struct {
+    int sample_rate;                // program format; devices are resampled to it
+    int channels;
+    int period_frames;
+    int preroll_ms;                 // recent program audio kept for replay after a switch
+    int budget_ms;                  // stop trying candidates after this long
+    int check_interval_ms;          // how often the open device's presence is checked
+    FailoverRanking ranking;
+    // Called on the writing thread as each failover completes
+    void (*on_failover)(const FailoverEvent* event, void* user);
+    void* user;
+} FailoverConfig;
+
+typedef struct {
+    char current[256];              // PCM playing now, empty if none
+    long frames_written;            // program frames accepted
+    long dropped_frames;            // program frames written while no device was open
+    int xruns;
+    int event_count;                // failovers so far; events[] keeps the first FAILOVER_MAX_EVENTS
+    FailoverEvent events[FAILOVER_MAX_EVENTS];
+} FailoverStats;
+
+typedef struct {
+    char pcm[256];
+    char name[256];
+    AudioDeviceType type;
+    AudioConnectionType connection;
+    bool is_default;
+    bool present;                   // as of the last check
+} FailoverCandidate;
+
+typedef struct FailoverSink FailoverSink;
+
+void failover_default_config(FailoverConfig* config);
+
+// Parse "key[=value>value...],..." where key is default, type or
+// connection, e.g. "default,type=usb>headphones,connection=wired".
+// Returns 0, or -1 on an unknown key or value.
+int failover_parse_ranking(const char* spec, FailoverRanking* ranking);
+
+FailoverSink* failover_create(const FailoverConfig* config);
+
+// Add a PCM by name (an enumerated id, or any configured PCM such as a
+// file or dummy fixture). Returns 0, or a negative error code.
+int failover_add_pcm(FailoverSink* sink, const char* pcm);
+
+// Add every enumerated playback device. Returns the number added.
+int failover_add_devices(FailoverSink* sink);
+
+// Rank the candidates and open the best one
+int failover_start(FailoverSink* sink);
+
+// Queue interleaved float frames, switching devices as needed. Blocks
+// while the device buffer is full. Returns frames accepted.
+long failover_write(FailoverSink* sink, const float* frames, long count);
+
+// Let the open device play out what it holds
+void failover_drain(FailoverSink* sink);
+
+void failover_stats(FailoverSink* sink, FailoverStats* stats);
+
+// Candidates in rank order. Returns the number copied.
+int failover_candidates(FailoverSink* sink, FailoverCandidate* candidates, int max_candidates);
+
+void failover_destroy(FailoverSink* sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FAILOVER_H
@@ -0,0 +1,502 @@
+// fanout.c - Play one program stream on several output devices at once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fanout.h"
+
+void fanout_default_config(FanoutConfig* config) {
+    config->sample_rate = 48000;
+    config->channels = 2;
+    config->period_frames = 480;
+    config->ring_frames = 8192;
+}
+
+#if defined(__linux__)
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "sample_convert.h"
+
+// Drift correction is a PI controller on each sink's ring fill. The
+// limits cover any real crystal mismatch; larger errors are a stalled or
+// misconfigured device, not drift.
+#define FANOUT_MAX_CORRECTION_PPM 5000.0
+#define FANOUT_KP 4.0               // ppm per frame of fill error
+#define FANOUT_KI 0.25              // ppm per frame-second of fill error
+#define FANOUT_FILL_SMOOTHING 0.02  // per-period EMA weight of the fill level
+
+// Single-producer single-consumer ring of interleaved float frames. The
+// positions only grow; the producer publishes tail and the consumer
+// publishes head with release stores, each reading the other's with
+// acquire loads, so neither side takes a lock.
+typedef struct {
+    float* data;
+    uint32_t capacity;              // frames, power of two
+    uint32_t mask;
+    int channels;
+    uint64_t head;
+    uint64_t tail;
+} SpscRing;
+
+typedef struct {
+    FanoutEngine* engine;
+    int index;
+    char pcm_name[256];
+    snd_pcm_t* pcm;
+    SampleFormat format;
+    SpscRing ring;
+    pthread_t thread;
+    bool thread_started;
+
+    int sample_rate;                // device rate granted
+    long period_frames;             // device frames per write
+
+    // Writer thread state
+    bool primed;
+    Resampler* resampler;           // program rate to device rate, plus drift
+    float* output;
+    void* native;
+    double fill_avg;
+    double integral_ppm;
+
+    // Shared with fanout_stats, accessed atomically
+    int alive;
+    int status;
+    char error[128];
+    long frames_played;
+    int xruns;
+    long dropped_frames;
+    long starved_frames;
+    int64_t drift_milli_ppm;
+} FanoutSink;
+
+struct FanoutEngine {
+    FanoutConfig config;
+    FanoutSink sinks[FANOUT_MAX_SINKS];
+    int sink_count;
+    int target_fill;
+    int draining;
+};
+
+static uint32_t round_up_pow2(uint32_t v) {
+    uint32_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+static uint32_t ring_fill(SpscRing* ring) {
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    return (uint32_t)(tail - head);
+}
+
+// Producer only. The caller has checked there is room.
+static void ring_write(SpscRing* ring, const float* frames, uint32_t count) {
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t start = (uint32_t)tail & ring->mask;
+    uint32_t first = count < ring->capacity - start ? count : ring->capacity - start;
+    size_t frame_size = (size_t)ring->channels * sizeof(float);
+
+    memcpy(ring->data + (size_t)start * ring->channels, frames, first * frame_size);
+    memcpy(ring->data, frames + (size_t)first * ring->channels, (count - first) * frame_size);
+    __atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+}
+
+static void sleep_usec(long usec) {
+    struct timespec ts = { usec / 1000000, (usec % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void sink_fail(FanoutSink* sink, int err, const char* what) {
+    snprintf(sink->error, sizeof(sink->error), "%s: %s", what, snd_strerror(err));
+    __atomic_store_n(&sink->status, err, __ATOMIC_RELEASE);
+    __atomic_store_n(&sink->alive, 0, __ATOMIC_RELEASE);
+}
+
+// The first sink still playing paces the producer
+static FanoutSink* reference_sink(FanoutEngine* engine) {
+    for (int i = 0; i < engine->sink_count; i++) {
+        if (__atomic_load_n(&engine->sinks[i].alive, __ATOMIC_ACQUIRE)) return &engine->sinks[i];
+    }
+    return NULL;
+}
+
+// Resample frames device frames out of the ring, corrected by ppm. Only
+// the input this period needs is taken, so the ring fill stays a true
+// measure of queued audio. Frames are read in place, in at most two runs
+// around the wrap, and released in one head update; a short ring pads
+// with silence.
+static void sink_render(FanoutSink* sink, long frames, double ppm) {
+    SpscRing* ring = &sink->ring;
+    int channels = ring->channels;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t available = ring_fill(ring);
+    long needed = resampler_input_needed(sink->resampler, frames);
+    uint32_t wanted = needed < (long)available ? (uint32_t)needed : available;
+    uint32_t used = 0;
+    long produced = 0;
+
+    resampler_set_drift(sink->resampler, ppm);
+    while (produced < frames && used < wanted) {
+        uint32_t start = (uint32_t)(head + used) & ring->mask;
+        uint32_t run = wanted - used;
+        if (run > ring->capacity - start) run = ring->capacity - start;
+
+        long consumed;
+        produced += resampler_process(sink->resampler, ring->data + (size_t)start * channels, run, &consumed,
+                                      sink->output + produced * channels, frames - produced);
+        used += (uint32_t)consumed;
+    }
+    __atomic_store_n(&ring->head, head + used, __ATOMIC_RELEASE);
+
+    if (produced < frames) {
+        memset(sink->output + produced * channels, 0, (size_t)(frames - produced) * channels * sizeof(float));
+        __atomic_fetch_add(&sink->starved_frames, frames - produced, __ATOMIC_RELAXED);
+    }
+}
+
+// Returns the resampling correction in ppm for the next period
+static double sink_update_drift(FanoutSink* sink, bool reference) {
+    FanoutEngine* engine = sink->engine;
+
+    // The producer holds the reference ring at its target, so the
+    // reference plays at exactly the program rate
+    if (reference) {
+        __atomic_store_n(&sink->drift_milli_ppm, 0, __ATOMIC_RELAXED);
+        return 0.0;
+    }
+
+    // Every ring receives the same chunks at the same moment, so comparing
+    // against the reference ring cancels the producer's write pattern and
+    // leaves only the difference in consumption
+    FanoutSink* ref = reference_sink(engine);
+    double fill = (double)ring_fill(&sink->ring);
+    if (ref != NULL) fill += engine->target_fill - (double)ring_fill(&ref->ring);
+    double seconds = (double)sink->period_frames / sink->sample_rate;
+    sink->fill_avg += (fill - sink->fill_avg) * FANOUT_FILL_SMOOTHING;
+    double error = sink->fill_avg - engine->target_fill;
+
+    sink->integral_ppm += FANOUT_KI * error * seconds;
+    if (sink->integral_ppm > FANOUT_MAX_CORRECTION_PPM) sink->integral_ppm = FANOUT_MAX_CORRECTION_PPM;
+    if (sink->integral_ppm < -FANOUT_MAX_CORRECTION_PPM) sink->integral_ppm = -FANOUT_MAX_CORRECTION_PPM;
+
+    double correction = FANOUT_KP * error + sink->integral_ppm;
+    if (correction > FANOUT_MAX_CORRECTION_PPM) correction = FANOUT_MAX_CORRECTION_PPM;
+    if (correction < -FANOUT_MAX_CORRECTION_PPM) correction = -FANOUT_MAX_CORRECTION_PPM;
+
+    // A sink that consumes extra input per output frame runs slow; the
+    // settled integral term is its clock offset
+    __atomic_store_n(&sink->drift_milli_ppm, (int64_t)(-sink->integral_ppm * 1000.0), __ATOMIC_RELAXED);
+    return correction;
+}
+
+static void* sink_thread(void* arg) {
+    FanoutSink* sink = (FanoutSink*)arg;
+    FanoutEngine* engine = sink->engine;
+    long period = sink->period_frames;
+    long samples = period * engine->config.channels;
+
+    // Real-time priority when permitted (rtprio limit or CAP_SYS_NICE);
+    // otherwise the thread still runs, just without the guarantee
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    while (__atomic_load_n(&sink->alive, __ATOMIC_ACQUIRE)) {
+        bool draining = __atomic_load_n(&engine->draining, __ATOMIC_ACQUIRE);
+        uint32_t fill = ring_fill(&sink->ring);
+
+        // Wait for the producer to queue the target latency before the
+        // first write, so startup doesn't count as starvation
+        if (!sink->primed) {
+            if (fill < (uint32_t)engine->target_fill && !draining) {
+                sleep_usec(1000);
+                continue;
+            }
+            sink->primed = true;
+        }
+        if (draining && fill == 0) break;
+
+        bool reference = reference_sink(engine) == sink;
+        double correction = sink_update_drift(sink, reference);
+        sink_render(sink, period, correction);
+        sample_convert_from_float(sink->format, sink->output, sink->native, samples);
+
+        snd_pcm_sframes_t written = snd_pcm_writei(sink->pcm, sink->native, (snd_pcm_uframes_t)period);
+        if (written < 0) {
+            if (written == -EPIPE) __atomic_fetch_add(&sink->xruns, 1, __ATOMIC_RELAXED);
+            int err = snd_pcm_recover(sink->pcm, (int)written, 1);
+            if (err < 0) {
+                sink_fail(sink, err, "write");
+                break;
+            }
+            continue;
+        }
+        __atomic_fetch_add(&sink->frames_played, (long)written, __ATOMIC_RELAXED);
+    }
+
+    if (__atomic_load_n(&sink->alive, __ATOMIC_ACQUIRE)) {
+        snd_pcm_drain(sink->pcm);
+    } else {
+        snd_pcm_drop(sink->pcm);
+    }
+    return NULL;
+}
+
+FanoutEngine* fanout_create(const FanoutConfig* config) {
+    if (config->sample_rate <= 0 || config->channels <= 0 || config->period_frames <= 0) return NULL;
+
+    FanoutEngine* engine = (FanoutEngine*)calloc(1, sizeof(FanoutEngine));
+    if (engine == NULL) return NULL;
+    engine->config = *config;
+
+    // Rings hold at least four periods and run half full, leaving equal
+    // headroom for either clock to wander
+    uint32_t ring_frames = (uint32_t)config->ring_frames;
+    if (ring_frames < (uint32_t)config->period_frames * 4) ring_frames = (uint32_t)config->period_frames * 4;
+    engine->config.ring_frames = (int)round_up_pow2(ring_frames);
+    engine->target_fill = engine->config.ring_frames / 2;
+    return engine;
+}
+
+static int configure_sink(FanoutSink* sink, const FanoutConfig* config) {
+    snd_pcm_hw_params_t* hw;
+    snd_pcm_sw_params_t* sw;
+    unsigned int rate = (unsigned int)config->sample_rate;
+    snd_pcm_uframes_t period;
+    snd_pcm_uframes_t buffer;
+    int err;
+
+    snd_pcm_hw_params_alloca(&hw);
+    if ((err = snd_pcm_hw_params_any(sink->pcm, hw)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_access(sink->pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) return err;
+
+    sink->format = SAMPLE_FORMAT_UNKNOWN;
+    for (int i = 0; i < SAMPLE_FORMAT_PREFERENCE_COUNT; i++) {
+        snd_pcm_format_t candidate = (snd_pcm_format_t)sample_format_to_alsa(sample_format_preference[i]);
+        if (snd_pcm_hw_params_test_format(sink->pcm, hw, candidate) == 0) {
+            sink->format = sample_format_preference[i];
+            break;
+        }
+    }
+    if (sink->format == SAMPLE_FORMAT_UNKNOWN) return -EINVAL;
+    if ((err = snd_pcm_hw_params_set_format(sink->pcm, hw, (snd_pcm_format_t)sample_format_to_alsa(sink->format))) < 0) return err;
+
+    // Sinks take the program's channel count but may run at their own
+    // rate: the sink's resampler converts, so hw devices need no plug layer
+    if ((err = snd_pcm_hw_params_set_channels(sink->pcm, hw, (unsigned)config->channels)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_rate_near(sink->pcm, hw, &rate, NULL)) < 0) return err;
+
+    // The period covers the same time as the program's
+    period = (snd_pcm_uframes_t)((long long)config->period_frames * rate / config->sample_rate);
+    buffer = period * 4;
+    if ((err = snd_pcm_hw_params_set_period_size_near(sink->pcm, hw, &period, NULL)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(sink->pcm, hw, &buffer)) < 0) return err;
+    if ((err = snd_pcm_hw_params(sink->pcm, hw)) < 0) return err;
+    snd_pcm_hw_params_get_period_size(hw, &period, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw, &buffer);
+    sink->sample_rate = (int)rate;
+    sink->period_frames = (long)period;
+
+    snd_pcm_sw_params_alloca(&sw);
+    if ((err = snd_pcm_sw_params_current(sink->pcm, sw)) < 0) return err;
+    snd_pcm_sw_params_set_start_threshold(sink->pcm, sw, buffer);
+    return snd_pcm_sw_params(sink->pcm, sw);
+}
+
+static void free_sink(FanoutSink* sink) {
+    if (sink->pcm) snd_pcm_close(sink->pcm);
+    free(sink->ring.data);
+    resampler_destroy(sink->resampler);
+    free(sink->output);
+    free(sink->native);
+    memset(sink, 0, sizeof(*sink));
+}
+
+int fanout_add_sink(FanoutEngine* engine, const char* pcm) {
+    const FanoutConfig* config = &engine->config;
+    int err;
+
+    if (engine->sink_count >= FANOUT_MAX_SINKS) return -ENOSPC;
+
+    FanoutSink* sink = &engine->sinks[engine->sink_count];
+    memset(sink, 0, sizeof(*sink));
+    sink->engine = engine;
+    sink->index = engine->sink_count;
+    snprintf(sink->pcm_name, sizeof(sink->pcm_name), "%s", pcm);
+
+    if ((err = snd_pcm_open(&sink->pcm, pcm, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
+        sink->pcm = NULL;
+        free_sink(sink);
+        return err;
+    }
+    if ((err = configure_sink(sink, config)) < 0) {
+        free_sink(sink);
+        return err;
+    }
+
+    size_t channels = (size_t)config->channels;
+    sink->ring.capacity = (uint32_t)config->ring_frames;
+    sink->ring.mask = sink->ring.capacity - 1;
+    sink->ring.channels = config->channels;
+    sink->ring.data = (float*)calloc(sink->ring.capacity * channels, sizeof(float));
+    sink->resampler = resampler_create(config->sample_rate, sink->sample_rate, config->channels);
+    sink->output = (float*)malloc(sink->period_frames * channels * sizeof(float));
+    sink->native = malloc(sink->period_frames * channels * sample_format_bytes(sink->format));
+    if (!sink->ring.data || !sink->resampler || !sink->output || !sink->native) {
+        free_sink(sink);
+        return -ENOMEM;
+    }
+
+    sink->fill_avg = engine->target_fill;
+    sink->alive = 1;
+    return engine->sink_count++;
+}
+
+int fanout_start(FanoutEngine* engine) {
+    if (engine->sink_count == 0) return -ENODEV;
+
+    for (int i = 0; i < engine->sink_count; i++) {
+        FanoutSink* sink = &engine->sinks[i];
+        int err = pthread_create(&sink->thread, NULL, sink_thread, sink);
+        if (err != 0) {
+            sink_fail(sink, -err, "thread");
+            continue;
+        }
+        sink->thread_started = true;
+    }
+    return reference_sink(engine) ? 0 : -ENODEV;
+}
+
+long fanout_write(FanoutEngine* engine, const float* frames, long count) {
+    const FanoutConfig* config = &engine->config;
+    long done = 0;
+
+    while (done < count) {
+        FanoutSink* reference = reference_sink(engine);
+        if (reference == NULL) return done > 0 ? done : -1;
+
+        // Keep the reference ring at its target; its device clock then
+        // sets the program rate for everyone
+        uint32_t fill = ring_fill(&reference->ring);
+        if (fill >= (uint32_t)engine->target_fill) {
+            sleep_usec((long)config->period_frames * 1000000 / config->sample_rate / 4);
+            continue;
+        }
+
+        long chunk = count - done;
+        if (chunk > engine->target_fill - (long)fill) chunk = engine->target_fill - (long)fill;
+        if (chunk > config->period_frames) chunk = config->period_frames;
+
+        const float* src = frames + (size_t)done * config->channels;
+        for (int i = 0; i < engine->sink_count; i++) {
+            FanoutSink* sink = &engine->sinks[i];
+            if (!__atomic_load_n(&sink->alive, __ATOMIC_ACQUIRE)) continue;
+
+            // A sink that fell this far behind loses the chunk rather
+            // than stalling the others
+            if (sink->ring.capacity - ring_fill(&sink->ring) < (uint32_t)chunk) {
+                __atomic_fetch_add(&sink->dropped_frames, chunk, __ATOMIC_RELAXED);
+                continue;
+            }
+            ring_write(&sink->ring, src, (uint32_t)chunk);
+        }
+        done += chunk;
+    }
+    return done;
+}
+
+void fanout_stop(FanoutEngine* engine) {
+    __atomic_store_n(&engine->draining, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < engine->sink_count; i++) {
+        FanoutSink* sink = &engine->sinks[i];
+        if (sink->thread_started) {
+            pthread_join(sink->thread, NULL);
+            sink->thread_started = false;
+        }
+    }
+}
+
+int fanout_stats(FanoutEngine* engine, FanoutSinkStats* stats, int max_sinks) {
+    FanoutSink* reference = reference_sink(engine);
+    int n = engine->sink_count < max_sinks ? engine->sink_count : max_sinks;
+
+    for (int i = 0; i < n; i++) {
+        FanoutSink* sink = &engine->sinks[i];
+        FanoutSinkStats* s = &stats[i];
+        memset(s, 0, sizeof(*s));
+        snprintf(s->pcm, sizeof(s->pcm), "%s", sink->pcm_name);
+        s->status = __atomic_load_n(&sink->status, __ATOMIC_ACQUIRE);
+        if (s->status != 0) snprintf(s->error, sizeof(s->error), "%s", sink->error);
+        s->reference = sink == reference;
+        s->sample_rate = sink->sample_rate;
+        s->frames_played = __atomic_load_n(&sink->frames_played, __ATOMIC_RELAXED);
+        s->xruns = __atomic_load_n(&sink->xruns, __ATOMIC_RELAXED);
+        s->dropped_frames = __atomic_load_n(&sink->dropped_frames, __ATOMIC_RELAXED);
+        s->starved_frames = __atomic_load_n(&sink->starved_frames, __ATOMIC_RELAXED);
+        s->ring_fill = (int)ring_fill(&sink->ring);
+        s->drift_ppm = __atomic_load_n(&sink->drift_milli_ppm, __ATOMIC_RELAXED) / 1000.0;
+    }
+    return n;
+}
+
+void fanout_destroy(FanoutEngine* engine) {
+    if (engine == NULL) return;
+
+    fanout_stop(engine);
+    for (int i = 0; i < engine->sink_count; i++) {
+        free_sink(&engine->sinks[i]);
+    }
+    free(engine);
+}
+
+#else
+
+// The engine drives ALSA PCMs directly; other backends can create an
+// engine but not add sinks to it
+struct FanoutEngine {
+    FanoutConfig config;
+};
+
+FanoutEngine* fanout_create(const FanoutConfig* config) {
+    FanoutEngine* engine = (FanoutEngine*)calloc(1, sizeof(FanoutEngine));
+    if (engine) engine->config = *config;
+    return engine;
+}
+
+int fanout_add_sink(FanoutEngine* engine, const char* pcm) {
+    (void)engine;
+    (void)pcm;
+    return -1;
+}
+
+int fanout_start(FanoutEngine* engine) {
+    (void)engine;
+    return -1;
+}
+
+long fanout_write(FanoutEngine* engine, const float* frames, long count) {
+    (void)engine;
+    (void)frames;
+    (void)count;
+    return -1;
+}
+
+void fanout_stop(FanoutEngine* engine) {
+    (void)engine;
+}
+
+int fanout_stats(FanoutEngine* engine, FanoutSinkStats* stats, int max_sinks) {
+    (void)engine;
+    (void)stats;
+    (void)max_sinks;
+    return 0;
+}
+
+void fanout_destroy(FanoutEngine* engine) {
+    free(engine);
+}
+
+#endif
@@ -0,0 +1,64 @@
+// fanout.h - Play one program stream on several output devices at once
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FANOUT_MAX_SINKS 8
+
+typedef struct {
+    int sample_rate;            // program rate; sinks open as near to it as they can
+    int channels;
+    int period_frames;          // device period, and the producer's write granularity
+    int ring_frames;            // per-sink ring capacity, rounded up to a power of two
+} FanoutConfig;
+
+typedef struct {
+    char pcm[256];
+    int status;                 // 0 while healthy, negative error code once failed
+    char error[128];
+    bool reference;             // paces the producer and defines the program clock
+    int sample_rate;            // device rate; the sink resamples the program to it
+    long frames_played;         // device frames written
+    int xruns;
+    long dropped_frames;        // program frames lost because the ring was full
+    long starved_frames;        // device frames padded with silence
+    int ring_fill;              // program frames queued
+    double drift_ppm;           // sink clock relative to the reference, resampled away
+} FanoutSinkStats;
+
+typedef struct FanoutEngine FanoutEngine;
+
+void fanout_default_config(FanoutConfig* config);
+
+FanoutEngine* fanout_create(const FanoutConfig* config);
+
+// Open a sink. All sinks must be added before fanout_start. Returns the
+// sink index, or a negative error code if the PCM can't be configured.
+int fanout_add_sink(FanoutEngine* engine, const char* pcm);
+
+// Start one real-time writer thread per sink
+int fanout_start(FanoutEngine* engine);
+
+// Producer side, called from one thread: queue interleaved float frames
+// to every sink. Blocks while the reference sink's ring is at its target
+// fill. Returns frames queued, or -1 once no sink is left running.
+long fanout_write(FanoutEngine* engine, const float* frames, long count);
+
+// Wait for the rings to play out, then stop the writer threads
+void fanout_stop(FanoutEngine* engine);
+
+int fanout_stats(FanoutEngine* engine, FanoutSinkStats* stats, int max_sinks);
+
+void fanout_destroy(FanoutEngine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FANOUT_H
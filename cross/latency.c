@@ -0,0 +1,247 @@
+// latency.c - Output latency measurement and latency-ranked device selection
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "latency.h"
+
+int measure_devices_latency(const AudioDevice* devices, int count, const LatencyFormat* format,
+                            int burst_ms, DeviceLatency* results) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (devices[i].direction != DEVICE_DIRECTION_PLAYBACK) continue;
+        measure_output_latency(devices[i].id, format, burst_ms, &results[n]);
+        snprintf(results[n].name, sizeof(results[n].name), "%s", devices[i].name);
+        n++;
+    }
+    return n;
+}
+
+int lowest_latency_device(const DeviceLatency* results, int count) {
+    int best = -1;
+    for (int i = 0; i < count; i++) {
+        if (results[i].status != 0) continue;
+        if (best < 0 ||
+            results[i].min_latency_ms < results[best].min_latency_ms ||
+            (results[i].min_latency_ms == results[best].min_latency_ms &&
+             results[i].jitter_ms < results[best].jitter_ms)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+#if defined(__linux__)
+#include <alsa/asoundlib.h>
+#include <errno.h>
+
+// Period sizes tried, in frames; each step doubles the previous one
+#define LATENCY_MIN_PERIOD 16
+#define LATENCY_MAX_PERIOD 8192
+
+typedef struct {
+    double min_ms;
+    double max_ms;
+    double sum_ms;
+    double jitter_sum_ms;
+    double last_ms;
+    int samples;
+} LatencyStats;
+
+// Jitter is the mean absolute change between consecutive delay samples
+// rather than their standard deviation: the delay of a stream that is
+// still filling its buffer, or drifting against the card's clock, moves
+// steadily, and a deviation would count that trend as jitter. Successive
+// differences only see the period-to-period wobble that makes a device
+// hard to schedule against.
+static void stats_add(LatencyStats* stats, double ms) {
+    if (stats->samples == 0 || ms < stats->min_ms) stats->min_ms = ms;
+    if (stats->samples == 0 || ms > stats->max_ms) stats->max_ms = ms;
+    if (stats->samples > 0) {
+        double change = ms - stats->last_ms;
+        stats->jitter_sum_ms += change < 0 ? -change : change;
+    }
+    stats->sum_ms += ms;
+    stats->last_ms = ms;
+    stats->samples++;
+}
+
+static snd_pcm_format_t latency_pcm_format(int bit_depth) {
+    switch (bit_depth) {
+        case 16: return SND_PCM_FORMAT_S16_LE;
+        case 24: return SND_PCM_FORMAT_S24_LE;
+        case 32: return SND_PCM_FORMAT_S32_LE;
+        default: return SND_PCM_FORMAT_UNKNOWN;
+    }
+}
+
+static void set_error(DeviceLatency* result, int err, const char* what) {
+    result->status = err;
+    snprintf(result->error, sizeof(result->error), "%s: %s", what, snd_strerror(err));
+}
+
+// Fix the stream format. Failing here means no period size can help.
+static int set_stream_format(snd_pcm_t* pcm, snd_pcm_hw_params_t* hw, const LatencyFormat* format) {
+    int err;
+    if ((err = snd_pcm_hw_params_any(pcm, hw)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_format(pcm, hw, latency_pcm_format(format->bit_depth))) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_channels(pcm, hw, (unsigned)format->channels)) < 0) return err;
+    return snd_pcm_hw_params_set_rate(pcm, hw, (unsigned)format->sample_rate, 0);
+}
+
+// Two periods per buffer, as small as the device grants around *period.
+// The granted sizes are written back.
+static int set_buffer_geometry(snd_pcm_t* pcm, snd_pcm_hw_params_t* hw,
+                               snd_pcm_uframes_t* period, snd_pcm_uframes_t* buffer) {
+    snd_pcm_sw_params_t* sw;
+    int err;
+
+    if ((err = snd_pcm_hw_params_set_period_size_near(pcm, hw, period, NULL)) < 0) return err;
+    *buffer = *period * 2;
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, buffer)) < 0) return err;
+    if ((err = snd_pcm_hw_params(pcm, hw)) < 0) return err;
+    snd_pcm_hw_params_get_period_size(hw, period, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw, buffer);
+
+    // Start only once the buffer is full, so every sample sees the whole
+    // buffer ahead of the DAC
+    snd_pcm_sw_params_alloca(&sw);
+    if ((err = snd_pcm_sw_params_current(pcm, sw)) < 0) return err;
+    snd_pcm_sw_params_set_start_threshold(pcm, sw, *buffer);
+    snd_pcm_sw_params_set_avail_min(pcm, sw, *period);
+    return snd_pcm_sw_params(pcm, sw);
+}
+
+// Write total_frames of silence one period at a time, sampling the delay
+// after every write once the stream runs. Returns -EPIPE on underrun.
+static int play_burst(snd_pcm_t* pcm, const void* silence, snd_pcm_uframes_t period,
+                      long total_frames, int sample_rate, LatencyStats* stats) {
+    snd_pcm_status_t* status;
+    snd_pcm_status_alloca(&status);
+
+    for (long written = 0; written < total_frames; ) {
+        snd_pcm_sframes_t n = snd_pcm_writei(pcm, silence, period);
+        if (n < 0) return (int)n;
+        written += n;
+
+        if (snd_pcm_status(pcm, status) < 0) continue;
+        snd_pcm_state_t state = snd_pcm_status_get_state(status);
+        if (state == SND_PCM_STATE_XRUN) return -EPIPE;
+        if (state != SND_PCM_STATE_RUNNING) continue;
+
+        // snd_pcm_delay accounts for plugin buffering the status may not
+        snd_pcm_sframes_t delay;
+        if (snd_pcm_delay(pcm, &delay) == 0 && delay >= 0) {
+            stats_add(stats, (double)delay * 1000.0 / sample_rate);
+        }
+    }
+    return 0;
+}
+
+int measure_output_latency(const char* pcm_name, const LatencyFormat* format, int burst_ms, DeviceLatency* result) {
+    snd_pcm_t* pcm = NULL;
+    snd_pcm_hw_params_t* hw;
+    void* silence = NULL;
+    int err;
+
+    memset(result, 0, sizeof(*result));
+    snprintf(result->pcm, sizeof(result->pcm), "%s", pcm_name);
+    snprintf(result->name, sizeof(result->name), "%s", pcm_name);
+
+    if (latency_pcm_format(format->bit_depth) == SND_PCM_FORMAT_UNKNOWN) {
+        set_error(result, -EINVAL, "unsupported bit depth");
+        return result->status;
+    }
+    if (burst_ms <= 0) burst_ms = LATENCY_DEFAULT_BURST_MS;
+
+    if ((err = snd_pcm_open(&pcm, pcm_name, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
+        set_error(result, err, "open");
+        return result->status;
+    }
+
+    snd_pcm_hw_params_alloca(&hw);
+    size_t frame_bytes = (size_t)format->channels *
+                         (snd_pcm_format_physical_width(latency_pcm_format(format->bit_depth)) / 8);
+    long burst_frames = (long)format->sample_rate * burst_ms / 1000;
+
+    // Walk up from the smallest period until a whole burst plays without
+    // an underrun; that is the lowest latency the device sustains
+    err = -EPIPE;
+    for (snd_pcm_uframes_t request = LATENCY_MIN_PERIOD; request <= LATENCY_MAX_PERIOD; request *= 2) {
+        snd_pcm_uframes_t period = request;
+        snd_pcm_uframes_t buffer = 0;
+        LatencyStats stats = { 0 };
+
+        if ((err = set_stream_format(pcm, hw, format)) < 0) {
+            set_error(result, err, "format not supported");
+            break;
+        }
+        if ((err = set_buffer_geometry(pcm, hw, &period, &buffer)) < 0) continue;
+
+        // Devices with a larger minimum period skip the sizes below it
+        if (period > request) request = period;
+
+        void* grown = realloc(silence, period * frame_bytes);
+        if (grown == NULL) {
+            err = -ENOMEM;
+            set_error(result, err, "allocate");
+            break;
+        }
+        silence = grown;
+        memset(silence, 0, period * frame_bytes);
+
+        // Run for at least a few buffers so the stream reaches steady state
+        long total = burst_frames > (long)buffer * 4 ? burst_frames : (long)buffer * 4;
+        err = play_burst(pcm, silence, period, total, format->sample_rate, &stats);
+        snd_pcm_drop(pcm);
+
+        if (err == -EPIPE) {
+            result->underruns++;
+            continue;
+        }
+        if (err < 0) {
+            set_error(result, err, "write");
+            break;
+        }
+
+        result->period_frames = (int)period;
+        result->buffer_frames = (int)buffer;
+        result->samples = stats.samples;
+        if (stats.samples > 0) {
+            result->min_latency_ms = stats.min_ms;
+            result->max_latency_ms = stats.max_ms;
+            result->mean_latency_ms = stats.sum_ms / stats.samples;
+        }
+        if (stats.samples > 1) {
+            result->jitter_ms = stats.jitter_sum_ms / (stats.samples - 1);
+        }
+        break;
+    }
+
+    if (err == -EPIPE) {
+        set_error(result, err, "underruns at every period size");
+    } else if (err < 0 && result->status == 0) {
+        set_error(result, err, "configure");
+    }
+
+    free(silence);
+    snd_pcm_close(pcm);
+    return result->status;
+}
+
+#else
+
+// Measurement drives ALSA PCMs directly; other backends only report
+// that it is unavailable
+int measure_output_latency(const char* pcm_name, const LatencyFormat* format, int burst_ms, DeviceLatency* result) {
+    (void)format;
+    (void)burst_ms;
+    memset(result, 0, sizeof(*result));
+    snprintf(result->pcm, sizeof(result->pcm), "%s", pcm_name);
+    snprintf(result->name, sizeof(result->name), "%s", pcm_name);
+    result->status = -1;
+    snprintf(result->error, sizeof(result->error), "latency measurement is not supported on this platform");
+    return result->status;
+}
+
+#endif
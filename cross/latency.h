@@ -0,0 +1,52 @@
+// latency.h - Output latency measurement and latency-ranked device selection
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LATENCY_DEFAULT_BURST_MS 250
+
+// Stream format a device has to accept natively to be measured
+typedef struct {
+    int sample_rate;
+    int bit_depth;              // 16, 24 (in 32-bit containers) or 32
+    int channels;
+} LatencyFormat;
+
+typedef struct {
+    char pcm[256];              // PCM that was opened (device id or plugin name)
+    char name[256];
+    int status;                 // 0 on success, negative error code otherwise
+    char error[128];
+    int period_frames;          // smallest period that played the burst without an underrun
+    int buffer_frames;
+    int underruns;              // smaller periods that underran before it
+    double min_latency_ms;      // delay seen while running
+    double mean_latency_ms;
+    double max_latency_ms;
+    double jitter_ms;           // mean change in delay between consecutive periods
+    int samples;
+} DeviceLatency;
+
+// Measure one PCM by name. Works with any playback PCM, including the
+// "null" and "file" plugins and snd-dummy cards, so no hardware is needed.
+int measure_output_latency(const char* pcm, const LatencyFormat* format, int burst_ms, DeviceLatency* result);
+
+// Measure every playback device. Returns the number of results written.
+int measure_devices_latency(const AudioDevice* devices, int count, const LatencyFormat* format,
+                            int burst_ms, DeviceLatency* results);
+
+// Index of the successfully measured result with the lowest minimum
+// latency (ties go to the lower jitter), or -1 if none succeeded
+int lowest_latency_device(const DeviceLatency* results, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_H
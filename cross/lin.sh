@@ -2,4 +2,4 @@
 # Ubuntu/Debian: sudo apt-get install libasound2-dev
 # Fedora: sudo dnf install alsa-lib-devel
 
-gcc -D__linux__ -Wall -Wextra -O2 main.c audio_devices.c -o list_audio_devices -lasound
\ No newline at end of file
+gcc -D__linux__ -Wall -Wextra -O2 main.c audio_devices.c device_shm.c device_shm_reader.c device_diff.c latency.c test_tone.c sample_convert.c fanout.c failover.c meter.c wav.c recorder.c pcm_status.c card_power.c device_history.c device_history_reader.c metrics.c -o list_audio_devices -lasound -lrt -lpthread -lm
\ No newline at end of file
@@ -1 +1 @@
-gcc -D__APPLE__ -Wall -Wextra -O2 main.c audio_devices.c -o list_audio_devices -framework CoreAudio -framework CoreFoundation
+gcc -D__APPLE__ -Wall -Wextra -O2 main.c audio_devices.c device_shm.c device_shm_reader.c device_diff.c latency.c test_tone.c sample_convert.c fanout.c failover.c meter.c wav.c recorder.c pcm_status.c card_power.c device_history.c device_history_reader.c metrics.c -o list_audio_devices -framework CoreAudio -framework CoreFoundation
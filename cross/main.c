@@ -1,95 +1,1318 @@
 // main.c - JSON output for Electron integration
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "audio_devices.h"
+#include "device_diff.h"
+#include "device_shm.h"
+#include "latency.h"
+#include "test_tone.h"
+#include "fanout.h"
+#include "sample_convert.h"
+#include "failover.h"
+#include "meter.h"
+#include "recorder.h"
+#include "pcm_status.h"
+#include "device_history.h"
+#include "metrics.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 // Escape JSON string
-void print_json_string(const char* str) {
-    printf("\"");
+static void fprint_json_string(FILE* out, const char* str) {
+    fprintf(out, "\"");
     for (int i = 0; str[i] != '\0'; i++) {
         switch (str[i]) {
             case '"':
-                printf("\\\"");
+                fprintf(out, "\\\"");
                 break;
             case '\\':
-                printf("\\\\");
+                fprintf(out, "\\\\");
                 break;
             case '\n':
-                printf("\\n");
+                fprintf(out, "\\n");
                 break;
             case '\r':
-                printf("\\r");
+                fprintf(out, "\\r");
                 break;
             case '\t':
-                printf("\\t");
+                fprintf(out, "\\t");
                 break;
             default:
-                printf("%c", str[i]);
+                fprintf(out, "%c", str[i]);
                 break;
         }
     }
-    printf("\"");
+    fprintf(out, "\"");
 }
 
-int main() {
-    AudioDevice* devices = NULL;
-    int count = list_audio_output_devices(&devices);
-    
+void print_json_string(const char* str) {
+    fprint_json_string(stdout, str);
+}
+
+// Print one field's JSON value
+static void print_device_field(const AudioDevice* device, DeviceField field) {
+    switch (field) {
+        case DEVICE_FIELD_NAME: print_json_string(device->name); break;
+        case DEVICE_FIELD_ID: print_json_string(device->id); break;
+        case DEVICE_FIELD_MANUFACTURER: print_json_string(device->manufacturer); break;
+        case DEVICE_FIELD_MODEL: print_json_string(device->model); break;
+        case DEVICE_FIELD_SERIAL_NUMBER: print_json_string(device->serial_number); break;
+        case DEVICE_FIELD_TYPE: print_json_string(device_type_to_string(device->type)); break;
+        case DEVICE_FIELD_CONNECTION: print_json_string(connection_type_to_string(device->connection)); break;
+        case DEVICE_FIELD_TRANSPORT_TYPE_NAME: print_json_string(device->transport_type_name); break;
+        case DEVICE_FIELD_IS_DEFAULT: printf("%s", device->is_default ? "true" : "false"); break;
+        case DEVICE_FIELD_IS_ALIVE: printf("%s", device->is_alive ? "true" : "false"); break;
+        case DEVICE_FIELD_IS_RUNNING: printf("%s", device->is_running ? "true" : "false"); break;
+        case DEVICE_FIELD_IS_MUTED: printf("%s", device->is_muted ? "true" : "false"); break;
+        case DEVICE_FIELD_DEVICE_ID_NUMERIC: printf("%d", device->device_id_numeric); break;
+        case DEVICE_FIELD_INPUT_CHANNELS: printf("%d", device->input_channels); break;
+        case DEVICE_FIELD_OUTPUT_CHANNELS: printf("%d", device->output_channels); break;
+        case DEVICE_FIELD_SAMPLE_RATE: printf("%d", device->sample_rate); break;
+        case DEVICE_FIELD_BIT_DEPTH: printf("%d", device->bit_depth); break;
+        case DEVICE_FIELD_VOLUME: printf("%.3f", device->volume); break;
+        case DEVICE_FIELD_DATA_SOURCE: print_json_string(device->data_source); break;
+        case DEVICE_FIELD_CLOCK_SOURCE: print_json_string(device->clock_source); break;
+        case DEVICE_FIELD_DIRECTION: print_json_string(direction_to_string(device->direction)); break;
+        case DEVICE_FIELD_IS_DUPLEX: printf("%s", device->is_duplex ? "true" : "false"); break;
+        case DEVICE_FIELD_DUPLEX_PEER_ID: print_json_string(device->duplex_peer_id); break;
+        case DEVICE_FIELD_HARDWARE_ID: print_json_string(device->hardware_id); break;
+        case DEVICE_FIELD_IS_SUSPENDED: printf("%s", device->is_suspended ? "true" : "false"); break;
+        default: printf("null"); break;
+    }
+}
+
+static void print_device_json(const AudioDevice* device, const char* indent) {
+    printf("%s{\n", indent);
+    for (int f = 0; f < DEVICE_FIELD_COUNT; f++) {
+        printf("%s  \"%s\": ", indent, device_field_name((DeviceField)f));
+        print_device_field(device, (DeviceField)f);
+        printf(f < DEVICE_FIELD_COUNT - 1 ? ",\n" : "\n");
+    }
+    printf("%s}", indent);
+}
+
+// What a power-aware listing did with each card; nothing without one
+static void print_card_power_json(const AudioCardPower* cards, int card_count) {
+    if (card_count < 0) return;
+    printf("  \"cards\": [");
+    for (int i = 0; i < card_count; i++) {
+        printf(i == 0 ? "\n" : ",\n");
+        printf("    { \"card\": %d, \"suspended\": %s, \"queried\": %s, \"woke\": %s }",
+               cards[i].card, cards[i].suspended ? "true" : "false",
+               cards[i].queried ? "true" : "false", cards[i].woke ? "true" : "false");
+    }
+    printf(card_count > 0 ? "\n  ],\n" : "],\n");
+}
+
+static void print_devices_json(const AudioDevice* devices, int count, const char* token,
+                               const AudioCardPower* cards, int card_count) {
     printf("{\n");
     printf("  \"devices\": [\n");
     
     for (int i = 0; i < count; i++) {
+        print_device_json(&devices[i], "    ");
+        if (i < count - 1) {
+            printf(",");
+        }
+        printf("\n");
+    }
+    
+    printf("  ],\n");
+    print_card_power_json(cards, card_count);
+    printf("  \"count\": %d,\n", count);
+    printf("  \"token\": ");
+    print_json_string(token);
+    printf("\n");
+    printf("}\n");
+}
+
+// Print only what changed since the snapshot identified by since_token
+static void print_delta_json(const AudioDevice* before, int before_count,
+                             const AudioDevice* devices, int count,
+                             const char* since_token, const char* token,
+                             const AudioCardPower* cards, int card_count) {
+    DeviceChange* changes = (DeviceChange*)calloc((size_t)(before_count + count + 1), sizeof(DeviceChange));
+    int change_count = changes ? device_diff(before, before_count, devices, count, changes, before_count + count) : 0;
+    
+    printf("{\n");
+    printf("  \"since\": ");
+    print_json_string(since_token);
+    printf(",\n");
+    
+    // Added devices are sent in full
+    printf("  \"added\": [");
+    bool first = true;
+    for (int i = 0; i < change_count; i++) {
+        if (changes[i].kind != DEVICE_CHANGE_ADDED) continue;
+        printf(first ? "\n" : ",\n");
+        print_device_json(changes[i].after, "    ");
+        first = false;
+    }
+    printf(first ? "],\n" : "\n  ],\n");
+    
+    // Removed devices are identified by id and direction only
+    printf("  \"removed\": [");
+    first = true;
+    for (int i = 0; i < change_count; i++) {
+        if (changes[i].kind != DEVICE_CHANGE_REMOVED) continue;
+        printf(first ? "" : ", ");
+        printf("{ \"id\": ");
+        print_json_string(changes[i].before->id);
+        printf(", \"direction\": ");
+        print_json_string(direction_to_string(changes[i].before->direction));
+        printf(" }");
+        first = false;
+    }
+    printf("],\n");
+    
+    // Modified devices carry only the fields that changed
+    printf("  \"modified\": [");
+    first = true;
+    for (int i = 0; i < change_count; i++) {
+        if (changes[i].kind != DEVICE_CHANGE_MODIFIED) continue;
+        printf(first ? "\n" : ",\n");
         printf("    {\n");
-        printf("      \"name\": ");
-        print_json_string(devices[i].name);
-        printf(",\n");
         printf("      \"id\": ");
-        print_json_string(devices[i].id);
-        printf(",\n");
-        printf("      \"manufacturer\": ");
-        print_json_string(devices[i].manufacturer);
-        printf(",\n");
-        printf("      \"model\": ");
-        print_json_string(devices[i].model);
-        printf(",\n");
-        printf("      \"serial_number\": ");
-        print_json_string(devices[i].serial_number);
-        printf(",\n");
-        printf("      \"type\": ");
-        print_json_string(device_type_to_string(devices[i].type));
+        print_json_string(changes[i].after->id);
         printf(",\n");
-        printf("      \"connection\": ");
-        print_json_string(connection_type_to_string(devices[i].connection));
+        printf("      \"direction\": ");
+        print_json_string(direction_to_string(changes[i].after->direction));
         printf(",\n");
-        printf("      \"transport_type_name\": ");
-        print_json_string(devices[i].transport_type_name);
+        printf("      \"changes\": {\n");
+        bool first_field = true;
+        for (int f = 0; f < DEVICE_FIELD_COUNT; f++) {
+            if (!(changes[i].changed_fields & (1u << f))) continue;
+            printf(first_field ? "" : ",\n");
+            printf("        \"%s\": { \"from\": ", device_field_name((DeviceField)f));
+            print_device_field(changes[i].before, (DeviceField)f);
+            printf(", \"to\": ");
+            print_device_field(changes[i].after, (DeviceField)f);
+            printf(" }");
+            first_field = false;
+        }
+        printf("\n      }\n");
+        printf("    }");
+        first = false;
+    }
+    printf(first ? "],\n" : "\n  ],\n");
+    
+    print_card_power_json(cards, card_count);
+    printf("  \"count\": %d,\n", count);
+    printf("  \"token\": ");
+    print_json_string(token);
+    printf("\n");
+    printf("}\n");
+    
+    free(changes);
+}
+
+// Print latency results and the lowest-latency device for the format
+static void print_latency_json(const DeviceLatency* results, int count, const LatencyFormat* format) {
+    int lowest = lowest_latency_device(results, count);
+    
+    printf("{\n");
+    printf("  \"format\": { \"sample_rate\": %d, \"bit_depth\": %d, \"channels\": %d },\n",
+           format->sample_rate, format->bit_depth, format->channels);
+    printf("  \"latency\": [");
+    for (int i = 0; i < count; i++) {
+        const DeviceLatency* r = &results[i];
+        printf(i == 0 ? "\n" : ",\n");
+        printf("    {\n");
+        printf("      \"pcm\": ");
+        print_json_string(r->pcm);
+        printf(",\n      \"name\": ");
+        print_json_string(r->name);
+        if (r->status != 0) {
+            printf(",\n      \"error\": ");
+            print_json_string(r->error);
+            printf("\n    }");
+            continue;
+        }
         printf(",\n");
-        printf("      \"is_default\": %s,\n", devices[i].is_default ? "true" : "false");
-        printf("      \"is_alive\": %s,\n", devices[i].is_alive ? "true" : "false");
-        printf("      \"is_running\": %s,\n", devices[i].is_running ? "true" : "false");
-        printf("      \"is_muted\": %s,\n", devices[i].is_muted ? "true" : "false");
-        printf("      \"device_id_numeric\": %d,\n", devices[i].device_id_numeric);
-        printf("      \"input_channels\": %d,\n", devices[i].input_channels);
-        printf("      \"output_channels\": %d,\n", devices[i].output_channels);
-        printf("      \"sample_rate\": %d,\n", devices[i].sample_rate);
-        printf("      \"bit_depth\": %d,\n", devices[i].bit_depth);
-        printf("      \"volume\": %.3f,\n", devices[i].volume);
-        printf("      \"data_source\": ");
-        print_json_string(devices[i].data_source);
+        printf("      \"period_frames\": %d,\n", r->period_frames);
+        printf("      \"buffer_frames\": %d,\n", r->buffer_frames);
+        printf("      \"underruns\": %d,\n", r->underruns);
+        printf("      \"min_latency_ms\": %.3f,\n", r->min_latency_ms);
+        printf("      \"mean_latency_ms\": %.3f,\n", r->mean_latency_ms);
+        printf("      \"max_latency_ms\": %.3f,\n", r->max_latency_ms);
+        printf("      \"jitter_ms\": %.3f,\n", r->jitter_ms);
+        printf("      \"samples\": %d\n", r->samples);
+        printf("    }");
+    }
+    printf(count > 0 ? "\n  ],\n" : "],\n");
+    printf("  \"lowest\": ");
+    if (lowest >= 0) {
+        print_json_string(results[lowest].pcm);
+    } else {
+        printf("null");
+    }
+    printf("\n");
+    printf("}\n");
+}
+
+// --format RATE[:BITS[:CHANNELS]], e.g. 48000:16:2
+static bool parse_latency_format(const char* text, LatencyFormat* format) {
+    int fields = sscanf(text, "%d:%d:%d", &format->sample_rate, &format->bit_depth, &format->channels);
+    return fields >= 1 && format->sample_rate > 0 && format->bit_depth > 0 && format->channels > 0;
+}
+
+static void print_test_output_json(const char* device_id, const TestToneOptions* options,
+                                   const TestToneResult* result) {
+    printf("{\n");
+    printf("  \"device\": ");
+    print_json_string(device_id);
+    printf(",\n");
+    printf("  \"signal\": ");
+    print_json_string(test_signal_to_string(options->signal));
+    printf(",\n");
+    if (result->status != 0) {
+        printf("  \"error\": ");
+        print_json_string(result->error);
+        printf("\n}\n");
+        return;
+    }
+    printf("  \"format\": ");
+    print_json_string(result->format);
+    printf(",\n");
+    printf("  \"sample_rate\": %d,\n", result->sample_rate);
+    printf("  \"channels\": %d,\n", result->channels);
+    printf("  \"access\": \"%s\",\n", result->mmap ? "mmap" : "rw");
+    printf("  \"frames\": %ld,\n", result->frames);
+    printf("  \"underruns\": %d\n", result->underruns);
+    printf("}\n");
+}
+
+#define MAX_LATENCY_PCMS 16
+#define MAX_LISTED_DEVICES 256
+#define MAX_REPORTED_CARDS 32
+
+#ifndef _WIN32
+static volatile sig_atomic_t keep_running = 1;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    keep_running = 0;
+}
+#endif
+
+// A power-aware listing goes through a context, which can tell what it
+// did with each card. The card report goes to cards and card_count.
+static int list_power_aware(AudioDevice** devices, AudioDeviceDirection direction, unsigned int flags,
+                            const char* sys_root, const char* proc_root,
+                            AudioCardPower* cards, int* card_count) {
+    *devices = (AudioDevice*)calloc(MAX_LISTED_DEVICES, sizeof(AudioDevice));
+    audio_ctx_t* ctx = audio_ctx_create();
+    if (*devices == NULL || ctx == NULL) {
+        audio_ctx_destroy(ctx);
+        return 0;
+    }
+    
+    audio_ctx_set_flags(ctx, flags);
+    audio_ctx_set_roots(ctx, sys_root, proc_root);
+    int count = audio_ctx_list_devices(ctx, direction, *devices, MAX_LISTED_DEVICES);
+    *card_count = audio_ctx_card_power(ctx, cards, MAX_REPORTED_CARDS);
+    if (*card_count > MAX_REPORTED_CARDS) *card_count = MAX_REPORTED_CARDS;
+    audio_ctx_destroy(ctx);
+    return count < MAX_LISTED_DEVICES ? count : MAX_LISTED_DEVICES;
+}
+
+// Publish the device table to shared memory. With an interval of 0 the
+// table is published once and left in place for readers; otherwise it is
+// refreshed until SIGINT/SIGTERM and removed on exit.
+static int run_publisher(const char* shm_name, int interval_ms) {
+#ifndef _WIN32
+    DeviceShmPublisher* publisher = device_shm_publisher_open(shm_name);
+    if (publisher == NULL) {
+        fprintf(stderr, "Failed to open shared memory segment %s\n", shm_name);
+        return 1;
+    }
+
+    if (interval_ms <= 0) {
+        int count = device_shm_publish_current(publisher);
+        printf("{ \"published\": %d, \"shm\": ", count);
+        print_json_string(shm_name);
+        printf(" }\n");
+        device_shm_publisher_close(publisher, false);
+        return 0;
+    }
+
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+    while (keep_running) {
+        device_shm_publish_current(publisher);
+        usleep((useconds_t)interval_ms * 1000);
+    }
+
+    device_shm_publisher_close(publisher, true);
+    return 0;
+#else
+    (void)shm_name;
+    (void)interval_ms;
+    fprintf(stderr, "Shared memory publishing is not supported on Windows\n");
+    return 1;
+#endif
+}
+
+// Program audio for the playback modes: the test signal for its
+// duration, or interleaved S16_LE from stdin until end of file
+typedef struct {
+    ToneGenerator* gen;
+    int16_t* input;
+    long total;
+    long produced;
+    int channels;
+} ProgramSource;
+
+static bool program_open(ProgramSource* source, const TestToneOptions* tone, long max_frames, bool from_stdin) {
+    memset(source, 0, sizeof(*source));
+    source->channels = tone->channels;
+    if (from_stdin) {
+        source->input = (int16_t*)malloc((size_t)max_frames * tone->channels * sizeof(int16_t));
+        return source->input != NULL;
+    }
+    source->total = (long)tone->sample_rate * tone->duration_ms / 1000;
+    source->gen = tone_generator_create(tone, tone->sample_rate, source->total);
+    return source->gen != NULL;
+}
+
+// Returns frames read into block, 0 at the end
+static long program_read(ProgramSource* source, float* block, long frames) {
+    if (source->input != NULL) {
+        frames = (long)fread(source->input, (size_t)source->channels * sizeof(int16_t), (size_t)frames, stdin);
+        if (frames <= 0) return 0;
+        sample_convert_to_float(SAMPLE_FORMAT_S16, source->input, block, frames * source->channels);
+        return frames;
+    }
+    if (frames > source->total - source->produced) frames = source->total - source->produced;
+    if (frames <= 0) return 0;
+    tone_generator_render(source->gen, block, frames, source->channels);
+    source->produced += frames;
+    return frames;
+}
+
+static void program_close(ProgramSource* source) {
+    tone_generator_destroy(source->gen);
+    free(source->input);
+}
+
+// Play the test signal, or S16_LE program audio from stdin, on every
+// sink at once and report per-sink xruns and drift
+static int run_fanout(const char** pcms, int pcm_count, const TestToneOptions* tone, bool from_stdin) {
+    FanoutConfig config;
+    fanout_default_config(&config);
+    config.sample_rate = tone->sample_rate;
+    config.channels = tone->channels;
+
+    FanoutEngine* engine = fanout_create(&config);
+    if (engine == NULL) {
+        fprintf(stderr, "Invalid fan-out format\n");
+        return 1;
+    }
+
+    int add_errors[FANOUT_MAX_SINKS];
+    for (int i = 0; i < pcm_count; i++) {
+        int index = fanout_add_sink(engine, pcms[i]);
+        add_errors[i] = index < 0 ? index : 0;
+    }
+    
+    if (fanout_start(engine) == 0) {
+        long period = config.period_frames;
+        float* block = (float*)malloc((size_t)period * config.channels * sizeof(float));
+        ProgramSource source;
+        bool ready = program_open(&source, tone, period, from_stdin) && block != NULL;
+        
+        for (long frames; ready && (frames = program_read(&source, block, period)) > 0; ) {
+            if (fanout_write(engine, block, frames) < 0) break;
+        }
+        
+        program_close(&source);
+        free(block);
+        fanout_stop(engine);
+    }
+
+    FanoutSinkStats stats[FANOUT_MAX_SINKS];
+    int count = fanout_stats(engine, stats, FANOUT_MAX_SINKS);
+    
+    printf("{\n");
+    printf("  \"sinks\": [");
+    int printed = 0;
+    for (int i = 0, s = 0; i < pcm_count; i++) {
+        printf(printed++ == 0 ? "\n" : ",\n");
+        printf("    {\n");
+        printf("      \"pcm\": ");
+        print_json_string(pcms[i]);
+        if (add_errors[i] < 0 || s >= count) {
+            printf(",\n      \"error\": \"open failed (%d)\"\n    }", add_errors[i]);
+            continue;
+        }
+        const FanoutSinkStats* st = &stats[s++];
+        if (st->status != 0) {
+            printf(",\n      \"error\": ");
+            print_json_string(st->error);
+        }
         printf(",\n");
-        printf("      \"clock_source\": ");
-        print_json_string(devices[i].clock_source);
-        printf("\n");
+        printf("      \"reference\": %s,\n", st->reference ? "true" : "false");
+        printf("      \"sample_rate\": %d,\n", st->sample_rate);
+        printf("      \"frames_played\": %ld,\n", st->frames_played);
+        printf("      \"xruns\": %d,\n", st->xruns);
+        printf("      \"dropped_frames\": %ld,\n", st->dropped_frames);
+        printf("      \"starved_frames\": %ld,\n", st->starved_frames);
+        printf("      \"drift_ppm\": %.1f\n", st->drift_ppm);
         printf("    }");
-        if (i < count - 1) {
-            printf(",");
+    }
+    printf(printed > 0 ? "\n  ]\n" : "]\n");
+    printf("}\n");
+
+    fanout_destroy(engine);
+    return count > 0 ? 0 : 1;
+}
+
+static void print_failover_event_json(FILE* out, const FailoverEvent* event, const char* indent) {
+    fprintf(out, "%s{ \"from\": ", indent);
+    fprint_json_string(out, event->from);
+    fprintf(out, ", \"to\": ");
+    fprint_json_string(out, event->to);
+    fprintf(out, ", \"reason\": ");
+    fprint_json_string(out, event->reason);
+    fprintf(out, ", \"elapsed_ms\": %.2f, \"replayed_frames\": %ld, \"ok\": %s }",
+            event->elapsed_ms, event->replayed_frames, event->ok ? "true" : "false");
+}
+
+// Each failover goes to stderr as it happens, one JSON object per line
+static void report_failover(const FailoverEvent* event, void* user) {
+    (void)user;
+    print_failover_event_json(stderr, event, "");
+    fprintf(stderr, "\n");
+}
+
+// Play program audio through a failover sink over the named PCMs and/or
+// the enumerated devices, then report the switches it made
+static int run_failover(const char** pcms, int pcm_count, bool devices, const FailoverRanking* ranking,
+                        int preroll_ms, int budget_ms, const TestToneOptions* tone, bool from_stdin) {
+    FailoverConfig config;
+    failover_default_config(&config);
+    config.sample_rate = tone->sample_rate;
+    config.channels = tone->channels;
+    config.ranking = *ranking;
+    if (preroll_ms > 0) config.preroll_ms = preroll_ms;
+    if (budget_ms > 0) config.budget_ms = budget_ms;
+    config.on_failover = report_failover;
+
+    FailoverSink* sink = failover_create(&config);
+    if (sink == NULL) {
+        fprintf(stderr, "Invalid failover format\n");
+        return 1;
+    }
+    for (int i = 0; i < pcm_count; i++) {
+        failover_add_pcm(sink, pcms[i]);
+    }
+    if (devices) failover_add_devices(sink);
+    
+    int status = failover_start(sink);
+    if (status == 0) {
+        long period = config.period_frames;
+        float* block = (float*)malloc((size_t)period * config.channels * sizeof(float));
+        ProgramSource source;
+        bool ready = program_open(&source, tone, period, from_stdin) && block != NULL;
+        
+        for (long frames; ready && (frames = program_read(&source, block, period)) > 0; ) {
+            failover_write(sink, block, frames);
         }
-        printf("\n");
+        
+        program_close(&source);
+        free(block);
+        failover_drain(sink);
     }
     
-    printf("  ],\n");
-    printf("  \"count\": %d\n", count);
+    FailoverCandidate candidates[FAILOVER_MAX_CANDIDATES];
+    int candidate_count = failover_candidates(sink, candidates, FAILOVER_MAX_CANDIDATES);
+    FailoverStats stats;
+    failover_stats(sink, &stats);
+    
+    printf("{\n");
+    if (status != 0) printf("  \"error\": \"no candidate could be opened\",\n");
+    printf("  \"candidates\": [");
+    for (int i = 0; i < candidate_count; i++) {
+        printf(i == 0 ? "\n" : ",\n");
+        printf("    { \"pcm\": ");
+        print_json_string(candidates[i].pcm);
+        printf(", \"name\": ");
+        print_json_string(candidates[i].name);
+        printf(", \"type\": \"%s\", \"connection\": \"%s\", \"is_default\": %s, \"present\": %s }",
+               device_type_to_string(candidates[i].type), connection_type_to_string(candidates[i].connection),
+               candidates[i].is_default ? "true" : "false", candidates[i].present ? "true" : "false");
+    }
+    printf(candidate_count > 0 ? "\n  ],\n" : "],\n");
+    printf("  \"current\": ");
+    print_json_string(stats.current);
+    printf(",\n");
+    printf("  \"frames_written\": %ld,\n", stats.frames_written);
+    printf("  \"dropped_frames\": %ld,\n", stats.dropped_frames);
+    printf("  \"xruns\": %d,\n", stats.xruns);
+    printf("  \"failover_count\": %d,\n", stats.event_count);
+    printf("  \"failovers\": [");
+    int shown = stats.event_count < FAILOVER_MAX_EVENTS ? stats.event_count : FAILOVER_MAX_EVENTS;
+    for (int i = 0; i < shown; i++) {
+        printf(i == 0 ? "\n" : ",\n");
+        print_failover_event_json(stdout, &stats.events[i], "    ");
+    }
+    printf(shown > 0 ? "\n  ]\n" : "]\n");
     printf("}\n");
     
+    failover_destroy(sink);
+    return status == 0 ? 0 : 1;
+}
+
+static void print_float_array(const float* values, int count) {
+    printf("[");
+    for (int i = 0; i < count; i++) {
+        printf(i == 0 ? "%.2f" : ", %.2f", values[i]);
+    }
+    printf("]");
+}
+
+// One JSON object per line, flushed as it is published
+static void print_meter_reading_json(const MeterReading* reading, void* user) {
+    (void)user;
+    printf("{ \"time\": %.3f, \"peak_db\": ", reading->time);
+    print_float_array(reading->peak_db, reading->channels);
+    printf(", \"rms_db\": ");
+    print_float_array(reading->rms_db, reading->channels);
+    printf(", \"momentary_lufs\": %.2f, \"short_term_lufs\": %.2f, \"integrated_lufs\": %.2f, \"spectrum_db\": ",
+           reading->momentary_lufs, reading->short_term_lufs, reading->integrated_lufs);
+    print_float_array(reading->spectrum_db, METER_SPECTRUM_BANDS);
+    printf(" }\n");
+    fflush(stdout);
+}
+
+// Binary readings: native-endian records of double time, then floats
+// peak_db[channels], rms_db[channels], momentary, short-term and
+// integrated loudness, and spectrum_db[bands]
+static void write_meter_reading_binary(const MeterReading* reading, void* user) {
+    (void)user;
+    fwrite(&reading->time, sizeof(double), 1, stdout);
+    fwrite(reading->peak_db, sizeof(float), (size_t)reading->channels, stdout);
+    fwrite(reading->rms_db, sizeof(float), (size_t)reading->channels, stdout);
+    fwrite(&reading->momentary_lufs, sizeof(float), 1, stdout);
+    fwrite(&reading->short_term_lufs, sizeof(float), 1, stdout);
+    fwrite(&reading->integrated_lufs, sizeof(float), 1, stdout);
+    fwrite(reading->spectrum_db, sizeof(float), METER_SPECTRUM_BANDS, stdout);
+    fflush(stdout);
+}
+
+// Meter a capture PCM until SIGINT/SIGTERM, or a WAV file to its end.
+// The stream opens with a header (a JSON line, or the "AMTR" magic and
+// uint32 version, sample_rate, channels, bands and publish_hz followed by
+// float band_hz[bands]) and then carries publish_hz readings per second
+// of audio.
+static int run_meter(const char* pcm, const char* wav_path, const LatencyFormat* format,
+                     int publish_hz, bool binary) {
+    char error[128] = "";
+    MeterSource* source = wav_path
+        ? meter_source_open_wav(wav_path, error, sizeof(error))
+        : meter_source_open_capture(pcm, format->sample_rate, format->channels, error, sizeof(error));
+    if (source == NULL) {
+        fprintf(stderr, "Cannot meter %s: %s\n", wav_path ? wav_path : pcm, error);
+        return 1;
+    }
+
+    MeterConfig config;
+    meter_default_config(&config);
+    config.sample_rate = meter_source_rate(source);
+    config.channels = meter_source_channels(source);
+    if (publish_hz > 0) config.publish_hz = publish_hz;
+    Meter* meter = meter_create(&config);
+    long block_frames = 1024;
+    float* block = (float*)malloc((size_t)block_frames * config.channels * sizeof(float));
+    if (meter == NULL || block == NULL) {
+        fprintf(stderr, "Cannot meter %d channels at %d Hz\n", config.channels, config.sample_rate);
+        meter_destroy(meter);
+        free(block);
+        meter_source_close(source);
+        return 1;
+    }
+
+    if (binary) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        uint32_t header[5] = { 1, (uint32_t)config.sample_rate, (uint32_t)config.channels,
+                               METER_SPECTRUM_BANDS, (uint32_t)config.publish_hz };
+        fwrite("AMTR", 1, 4, stdout);
+        fwrite(header, sizeof(uint32_t), 5, stdout);
+        for (int b = 0; b < METER_SPECTRUM_BANDS; b++) {
+            float hz = meter_band_hz(meter, b);
+            fwrite(&hz, sizeof(float), 1, stdout);
+        }
+    } else {
+        printf("{ \"source\": ");
+        print_json_string(wav_path ? wav_path : pcm);
+        printf(", \"sample_rate\": %d, \"channels\": %d, \"publish_hz\": %d, \"isa\": \"%s\", \"band_hz\": [",
+               config.sample_rate, config.channels, config.publish_hz, sample_isa_to_string(sample_convert_isa()));
+        for (int b = 0; b < METER_SPECTRUM_BANDS; b++) {
+            printf(b == 0 ? "%.1f" : ", %.1f", meter_band_hz(meter, b));
+        }
+        printf("] }\n");
+    }
+    fflush(stdout);
+
+#ifndef _WIN32
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+#endif
+    MeterCallback callback = binary ? write_meter_reading_binary : print_meter_reading_json;
+    long frames = 0;
+    for (;;) {
+#ifndef _WIN32
+        if (!keep_running) break;
+#endif
+        frames = meter_source_read(source, block, block_frames);
+        if (frames <= 0) break;
+        meter_process(meter, block, frames, callback, NULL);
+    }
+    if (frames < 0) fprintf(stderr, "Metering stopped: read error %ld\n", frames);
+    if (meter_source_overruns(source) > 0) {
+        fprintf(stderr, "Capture overruns: %d\n", meter_source_overruns(source));
+    }
+
+    free(block);
+    meter_destroy(meter);
+    meter_source_close(source);
+    return frames < 0 ? 1 : 0;
+}
+
+// Each finished file goes to stderr as it is closed, one JSON object per line
+static void report_recorded_file(const char* path, int64_t frames, int64_t bytes, void* user) {
+    (void)user;
+    fprintf(stderr, "{ \"file\": ");
+    fprint_json_string(stderr, path);
+    fprintf(stderr, ", \"frames\": %lld, \"bytes\": %lld }\n", (long long)frames, (long long)bytes);
+}
+
+// Record what an output plays. target is an enumerated playback device,
+// recorded through its loopback/monitor capture PCM, or any capture PCM
+// (e.g. hw:Loopback,1 or a file plugin fixture). Runs for duration_s
+// seconds of audio, or until SIGINT/SIGTERM when 0.
+static int run_recorder(const char* target, const LatencyFormat* format, const RecorderConfig* base,
+                        int duration_s) {
+    char pcm[256];
+    snprintf(pcm, sizeof(pcm), "%s", target);
+
+    AudioDevice* devices = NULL;
+    int count = list_audio_devices(&devices, DEVICE_DIRECTION_ALL);
+    for (int i = 0; i < count; i++) {
+        if (devices[i].direction != DEVICE_DIRECTION_PLAYBACK || strcmp(devices[i].id, target) != 0) continue;
+        if (recorder_monitor_pcm(&devices[i], devices, count, pcm, sizeof(pcm)) != 0) {
+            fprintf(stderr, "No loopback or monitor capture for %s; pass a capture PCM instead\n", target);
+            free_audio_devices(devices);
+            return 1;
+        }
+        break;
+    }
     free_audio_devices(devices);
+
+    RecorderConfig config = *base;
+    config.sample_rate = format->sample_rate;
+    config.channels = format->channels;
+    config.on_file = report_recorded_file;
+
+    char error[128] = "";
+    Recorder* recorder = recorder_open(pcm, &config, error, sizeof(error));
+    if (recorder == NULL) {
+        fprintf(stderr, "Cannot record %s: %s\n", pcm, error);
+        return 1;
+    }
+
+    RecorderStats stats;
+    recorder_stats(recorder, &stats);
+    int status = recorder_start(recorder, (int64_t)duration_s * stats.sample_rate);
+#ifndef _WIN32
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+    while (status == 0 && keep_running && !recorder_finished(recorder)) {
+        usleep(50000);
+    }
+#endif
+    recorder_stop(recorder);
+    recorder_stats(recorder, &stats);
+
+    printf("{\n");
+    printf("  \"device\": ");
+    print_json_string(target);
+    printf(",\n  \"pcm\": ");
+    print_json_string(stats.pcm);
+    printf(",\n");
+    if (status != 0 || stats.error != 0) {
+        printf("  \"error\": %d,\n", status != 0 ? status : stats.error);
+    }
+    printf("  \"sample_rate\": %d,\n", stats.sample_rate);
+    printf("  \"channels\": %d,\n", stats.channels);
+    printf("  \"format\": ");
+    print_json_string(stats.format ? stats.format : "");
+    printf(",\n");
+    printf("  \"container\": \"%s\",\n", config.w64 ? "w64" : "wav");
+    printf("  \"frames_captured\": %lld,\n", (long long)stats.frames_captured);
+    printf("  \"frames_written\": %lld,\n", (long long)stats.frames_written);
+    printf("  \"periods\": %ld,\n", stats.periods_captured);
+    printf("  \"dropped_periods\": %ld,\n", stats.dropped_periods);
+    printf("  \"overruns\": %d,\n", stats.overruns);
+    printf("  \"files\": %d,\n", stats.files);
+    printf("  \"last_file\": ");
+    print_json_string(stats.current_file);
+    printf("\n}\n");
+
+    recorder_close(recorder);
+    return status == 0 && stats.error == 0 ? 0 : 1;
+}
+
+static void print_pcm_stream_json(const PcmStreamStatus* s) {
+    printf("{ \"id\": ");
+    print_json_string(s->id);
+    printf(", \"subdevice\": %d, \"direction\": \"%s\", \"state\": \"%s\"",
+           s->subdevice, direction_to_string(s->direction), pcm_state_to_string(s->state));
+    if (s->owner_pid > 0) printf(", \"owner_pid\": %d", s->owner_pid);
+    if (s->format[0] != '\0') {
+        printf(", \"access\": ");
+        print_json_string(s->access);
+        printf(", \"format\": ");
+        print_json_string(s->format);
+        printf(", \"channels\": %d, \"rate\": %d, \"period_size\": %ld, \"buffer_size\": %ld",
+               s->channels, s->rate, s->period_size, s->buffer_size);
+    }
+    if (s->state != PCM_STATE_OPEN && s->state != PCM_STATE_SETUP) {
+        printf(", \"hw_ptr\": %lld, \"appl_ptr\": %lld, \"delay\": %ld, \"avail\": %ld",
+               s->hw_ptr, s->appl_ptr, s->delay, s->avail);
+    }
+    printf(" }");
+}
+
+// Print the open substreams from /proc/asound (or a fixture tree laid out
+// like it) without opening any PCM: once, or with an interval one line per
+// sample until SIGINT/SIGTERM. Cards that come and go are picked up every
+// second.
+static int run_pcm_status(const char* proc_root, int interval_ms) {
+    PcmStatusSampler* sampler = pcm_status_open(proc_root);
+    PcmStreamStatus* statuses = (PcmStreamStatus*)malloc(PCM_STATUS_MAX_SUBDEVICES * sizeof(PcmStreamStatus));
+    if (sampler == NULL || statuses == NULL) {
+        fprintf(stderr, "Cannot read PCM status from %s\n", proc_root ? proc_root : PCM_STATUS_DEFAULT_ROOT);
+        pcm_status_close(sampler);
+        free(statuses);
+        return 1;
+    }
+
+#ifndef _WIN32
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+#endif
+    int elapsed_ms = 0;
+    for (;;) {
+        int count = pcm_status_sample(sampler, statuses, PCM_STATUS_MAX_SUBDEVICES);
+        printf("{ \"subdevices\": %d, \"streams\": [", count);
+        bool first = true;
+        for (int i = 0; i < count; i++) {
+            if (statuses[i].state == PCM_STATE_CLOSED) continue;
+            printf(first ? " " : ", ");
+            print_pcm_stream_json(&statuses[i]);
+            first = false;
+        }
+        printf(first ? "] }\n" : " ] }\n");
+        fflush(stdout);
+
+#ifndef _WIN32
+        if (interval_ms <= 0 || !keep_running) break;
+        usleep((useconds_t)interval_ms * 1000);
+        if (!keep_running) break;
+        elapsed_ms += interval_ms;
+        if (elapsed_ms >= 1000) {
+            pcm_status_rescan(sampler);
+            elapsed_ms = 0;
+        }
+#else
+        (void)interval_ms;
+        (void)elapsed_ms;
+        break;
+#endif
+    }
+
+    free(statuses);
+    pcm_status_close(sampler);
     return 0;
+}
+
+// Append device changes to a history ring file every interval_ms until
+// SIGINT/SIGTERM
+static int run_history_recorder(const char* path, int capacity, int interval_ms) {
+#ifndef _WIN32
+    DeviceHistoryWriter* writer = device_history_writer_open(path, capacity);
+    if (writer == NULL) {
+        fprintf(stderr, "Cannot open history file %s\n", path);
+        return 1;
+    }
+    if (interval_ms <= 0) interval_ms = 500;
+
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+    long records = 0;
+    while (keep_running) {
+        int appended = device_history_record_current(writer);
+        if (appended > 0) records += appended;
+        usleep((useconds_t)interval_ms * 1000);
+    }
+
+    device_history_writer_close(writer);
+    printf("{ \"history\": ");
+    print_json_string(path);
+    printf(", \"records\": %ld }\n", records);
+    return 0;
+#else
+    (void)path;
+    (void)capacity;
+    (void)interval_ms;
+    fprintf(stderr, "Device history is not supported on Windows\n");
+    return 1;
+#endif
+}
+
+static void print_history_device_fields(const DeviceHistoryDevice* device) {
+    printf("\"id\": ");
+    print_json_string(device->id);
+    printf(", \"name\": ");
+    print_json_string(device->name);
+    printf(", \"direction\": \"%s\", \"type\": \"%s\"",
+           direction_to_string(device->direction), device_type_to_string(device->type));
+    printf(", \"is_default\": %s, \"is_running\": %s",
+           (device->flags & DEVICE_HISTORY_DEFAULT) ? "true" : "false",
+           (device->flags & DEVICE_HISTORY_RUNNING) ? "true" : "false");
+}
+
+// Report a history file: the device list at at_ms (milliseconds since the
+// epoch, 0 for the latest) and per-device uptime and flaps over the
+// window_s seconds before it (0 for everything the ring holds)
+static int run_history_report(const char* path, int64_t at_ms, int window_s) {
+    DeviceHistoryReader* reader = device_history_reader_open(path);
+    if (reader == NULL) {
+        fprintf(stderr, "Cannot read history file %s\n", path);
+        return 1;
+    }
+
+    int64_t oldest, newest;
+    device_history_span(reader, &oldest, &newest);
+    int64_t at = at_ms > 0 ? at_ms * 1000 : newest;
+    int64_t from = window_s > 0 ? at - (int64_t)window_s * 1000000 : 0;
+
+    DeviceHistoryDevice* devices = (DeviceHistoryDevice*)malloc(DEVICE_HISTORY_MAX_DEVICES * sizeof(DeviceHistoryDevice));
+    DeviceHistoryStats* stats = (DeviceHistoryStats*)malloc(DEVICE_HISTORY_MAX_DEVICES * sizeof(DeviceHistoryStats));
+    if (devices == NULL || stats == NULL) {
+        free(devices);
+        free(stats);
+        device_history_reader_close(reader);
+        return 1;
+    }
+    int count = device_history_devices_at(reader, at, devices, DEVICE_HISTORY_MAX_DEVICES);
+    int stat_count = device_history_stats(reader, from, at, stats, DEVICE_HISTORY_MAX_DEVICES);
+
+    printf("{\n");
+    printf("  \"history\": ");
+    print_json_string(path);
+    printf(",\n");
+    printf("  \"oldest_ms\": %lld,\n", (long long)(oldest / 1000));
+    printf("  \"newest_ms\": %lld,\n", (long long)(newest / 1000));
+    printf("  \"at_ms\": %lld,\n", (long long)(at / 1000));
+    if (count < 0) {
+        printf("  \"devices\": null,\n");
+    } else {
+        printf("  \"devices\": [\n");
+        for (int i = 0; i < count; i++) {
+            printf("    { ");
+            print_history_device_fields(&devices[i]);
+            printf(" }%s\n", i + 1 < count ? "," : "");
+        }
+        printf("  ],\n");
+    }
+    printf("  \"window_ms\": %lld,\n", (long long)((at - (from > 0 ? from : oldest)) / 1000));
+    printf("  \"stats\": [\n");
+    for (int i = 0; i < stat_count; i++) {
+        const DeviceHistoryStats* s = &stats[i];
+        printf("    { ");
+        print_history_device_fields(&s->device);
+        printf(", \"uptime_ms\": %lld, \"drops\": %d, \"flaps\": %d, \"shortest_gap_ms\": %lld",
+               (long long)(s->uptime_usec / 1000), s->drops, s->flaps, (long long)(s->shortest_gap_usec / 1000));
+        printf(", \"first_seen_ms\": %lld, \"last_seen_ms\": %lld, \"present\": %s }%s\n",
+               (long long)(s->first_seen_usec / 1000), (long long)(s->last_seen_usec / 1000),
+               s->present ? "true" : "false", i + 1 < stat_count ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+
+    free(devices);
+    free(stats);
+    device_history_reader_close(reader);
+    return 0;
+}
+
+// Print a metrics file in the Prometheus text format, or write it to
+// out_path through a temporary file and a rename so a textfile collector
+// never reads it half written
+static int run_metrics_export(const char* metrics_path, const char* out_path) {
+    if (out_path == NULL) {
+        if (metrics_export_prometheus(metrics_path, stdout) != 0) {
+            fprintf(stderr, "Cannot read metrics file %s\n", metrics_path);
+            return 1;
+        }
+        return 0;
+    }
+
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+    FILE* out = fopen(tmp_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot write %s\n", tmp_path);
+        return 1;
+    }
+    int result = metrics_export_prometheus(metrics_path, out);
+    if (fclose(out) != 0) result = -1;
+    if (result != 0 || rename(tmp_path, out_path) != 0) {
+        fprintf(stderr, "Cannot export metrics file %s to %s\n", metrics_path, out_path);
+        remove(tmp_path);
+        return 1;
+    }
+    return 0;
+}
+
+// List the devices (or measure the latency of each) and record the
+// enumeration in the metrics file, if one is open
+static int run_list(AudioDeviceDirection direction, unsigned int list_flags, const char* sys_root,
+                    const char* proc_root, const char* since_token, bool measure_latency,
+                    const LatencyFormat* format, int burst_ms) {
+    AudioDevice* devices = NULL;
+    AudioCardPower cards[MAX_REPORTED_CARDS];
+    int card_count = -1;
+    uint64_t enumeration_start = metrics_start();
+    int count;
+    if (list_flags & AUDIO_LIST_POWER_AWARE) {
+        count = list_power_aware(&devices, direction, list_flags, sys_root, proc_root, cards, &card_count);
+    } else {
+        count = list_audio_devices_with_flags(&devices, direction, list_flags);
+    }
+    metrics_observe(METRIC_PHASE_TOTAL, enumeration_start);
+    
+    if (measure_latency) {
+        DeviceLatency* results = (DeviceLatency*)calloc((size_t)count + 1, sizeof(DeviceLatency));
+        int measured = results ? measure_devices_latency(devices, count, format, burst_ms, results) : 0;
+        print_latency_json(results, measured, format);
+        free(results);
+        free_audio_devices(devices);
+        return 0;
+    }
+    
+    // Every run stores its snapshot under the content hash so a later
+    // --since can diff against it
+    char token[DEVICE_SNAPSHOT_TOKEN_SIZE];
+    device_snapshot_token(device_snapshot_hash(devices, count), token);
+    device_snapshot_save(token, devices, count);
+    
+    AudioDevice* before = NULL;
+    int before_count = since_token ? device_snapshot_load(since_token, &before) : -1;
+    if (before_count >= 0) {
+        print_delta_json(before, before_count, devices, count, since_token, token, cards, card_count);
+        free(before);
+    } else {
+        // No token, or one we no longer have: fall back to the full list
+        if (since_token != NULL) metrics_count(METRIC_FULL_LIST_FALLBACKS, 1);
+        print_devices_json(devices, count, token, cards, card_count);
+    }
+    
+    metrics_count(METRIC_SUCCESSES, 1);
+    metrics_count(METRIC_DEVICES_LISTED, (uint64_t)count);
+    metrics_set(METRIC_DEVICES, (uint64_t)count);
+    
+    free_audio_devices(devices);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* shm_name = NULL;
+    const char* since_token = NULL;
+    int interval_ms = 0;
+    AudioDeviceDirection direction = DEVICE_DIRECTION_PLAYBACK;
+    unsigned int list_flags = 0;
+    bool measure_latency = false;
+    LatencyFormat latency_format = { 48000, 16, 2 };
+    int burst_ms = LATENCY_DEFAULT_BURST_MS;
+    const char* latency_pcms[MAX_LATENCY_PCMS];
+    int latency_pcm_count = 0;
+    const char* test_device = NULL;
+    const char* fanout_pcms[FANOUT_MAX_SINKS];
+    int fanout_count = 0;
+    bool fanout_stdin = false;
+    const char* failover_pcms[FAILOVER_MAX_CANDIDATES];
+    int failover_count = 0;
+    bool failover_devices = false;
+    int preroll_ms = 0;
+    int budget_ms = 0;
+    FailoverConfig failover_defaults;
+    failover_default_config(&failover_defaults);
+    FailoverRanking ranking = failover_defaults.ranking;
+    const char* meter_pcm = NULL;
+    const char* meter_wav = NULL;
+    int meter_rate_hz = 0;
+    bool meter_binary = false;
+    const char* record_target = NULL;
+    int record_duration_s = 0;
+    bool pcm_status = false;
+    const char* history_record_path = NULL;
+    const char* history_path = NULL;
+    int history_capacity = 0;
+    long long history_at_ms = 0;
+    int history_window_s = 0;
+    const char* metrics_file = NULL;
+    const char* metrics_export = NULL;
+    const char* metrics_out = NULL;
+    const char* metrics_counter = NULL;
+    const char* proc_root = NULL;
+    const char* sys_root = NULL;
+    RecorderConfig record_config;
+    recorder_default_config(&record_config);
+    TestToneOptions tone;
+    test_tone_default_options(&tone);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--publish-shm") == 0) {
+            shm_name = DEVICE_SHM_DEFAULT_NAME;
+            if (i + 1 < argc && argv[i + 1][0] == '/') {
+                shm_name = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--since") == 0 && i + 1 < argc) {
+            since_token = argv[++i];
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--direction") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "playback") == 0) {
+                direction = DEVICE_DIRECTION_PLAYBACK;
+            } else if (strcmp(value, "capture") == 0) {
+                direction = DEVICE_DIRECTION_CAPTURE;
+            } else if (strcmp(value, "all") == 0) {
+                direction = DEVICE_DIRECTION_ALL;
+            } else {
+                fprintf(stderr, "Unknown direction: %s (expected playback, capture or all)\n", value);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--plugins") == 0) {
+            list_flags |= AUDIO_LIST_PLUGINS;
+        } else if (strcmp(argv[i], "--power-aware") == 0) {
+            list_flags |= AUDIO_LIST_POWER_AWARE;
+        } else if (strcmp(argv[i], "--wake") == 0) {
+            list_flags |= AUDIO_LIST_POWER_AWARE | AUDIO_LIST_WAKE;
+        } else if (strcmp(argv[i], "--sys-root") == 0 && i + 1 < argc) {
+            sys_root = argv[++i];
+        } else if (strcmp(argv[i], "--measure-latency") == 0) {
+            measure_latency = true;
+        } else if (strcmp(argv[i], "--pcm") == 0 && i + 1 < argc) {
+            // Measure this PCM (e.g. "null" or "hw:Dummy") instead of the enumerated devices
+            const char* pcm = argv[++i];
+            if (latency_pcm_count < MAX_LATENCY_PCMS) {
+                latency_pcms[latency_pcm_count++] = pcm;
+            }
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            if (!parse_latency_format(argv[++i], &latency_format)) {
+                fprintf(stderr, "Invalid format: %s (expected RATE[:BITS[:CHANNELS]])\n", argv[i]);
+                return 2;
+            }
+            // The test signal takes rate and channels; it always plays
+            // in the device's native sample format
+            tone.sample_rate = latency_format.sample_rate;
+            tone.channels = latency_format.channels;
+        } else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            burst_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--test-output") == 0 && i + 1 < argc) {
+            test_device = argv[++i];
+        } else if (strcmp(argv[i], "--fanout") == 0 && i + 1 < argc) {
+            const char* pcm = argv[++i];
+            if (fanout_count < FANOUT_MAX_SINKS) {
+                fanout_pcms[fanout_count++] = pcm;
+            }
+        } else if (strcmp(argv[i], "--failover") == 0 && i + 1 < argc) {
+            // A PCM to fail over between, e.g. a file or dummy fixture;
+            // named PCMs rank ahead of enumerated devices, in order given
+            const char* pcm = argv[++i];
+            if (failover_count < FAILOVER_MAX_CANDIDATES) {
+                failover_pcms[failover_count++] = pcm;
+            }
+        } else if (strcmp(argv[i], "--failover-devices") == 0) {
+            failover_devices = true;
+        } else if (strcmp(argv[i], "--failover-rank") == 0 && i + 1 < argc) {
+            if (failover_parse_ranking(argv[++i], &ranking) != 0) {
+                fprintf(stderr, "Invalid ranking: %s (expected e.g. default,type=usb>headphones,connection=wired)\n", argv[i]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--preroll") == 0 && i + 1 < argc) {
+            preroll_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--failover-budget") == 0 && i + 1 < argc) {
+            budget_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--meter") == 0 && i + 1 < argc) {
+            // A capture or monitor PCM, opened at --format's rate/channels
+            meter_pcm = argv[++i];
+        } else if (strcmp(argv[i], "--meter-wav") == 0 && i + 1 < argc) {
+            meter_wav = argv[++i];
+        } else if (strcmp(argv[i], "--meter-rate") == 0 && i + 1 < argc) {
+            meter_rate_hz = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--meter-output") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "json") == 0) {
+                meter_binary = false;
+            } else if (strcmp(value, "binary") == 0) {
+                meter_binary = true;
+            } else {
+                fprintf(stderr, "Unknown meter output: %s (expected json or binary)\n", value);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_target = argv[++i];
+        } else if (strcmp(argv[i], "--record-to") == 0 && i + 1 < argc) {
+            snprintf(record_config.path_prefix, sizeof(record_config.path_prefix), "%s", argv[++i]);
+        } else if (strcmp(argv[i], "--record-format") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "wav") == 0) {
+                record_config.w64 = false;
+            } else if (strcmp(value, "w64") == 0) {
+                record_config.w64 = true;
+            } else {
+                fprintf(stderr, "Unknown record format: %s (expected wav or w64)\n", value);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--roll-size") == 0 && i + 1 < argc) {
+            record_config.max_file_bytes = (int64_t)atoi(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--roll-time") == 0 && i + 1 < argc) {
+            record_config.max_file_seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record-duration") == 0 && i + 1 < argc) {
+            record_duration_s = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pcm-status") == 0) {
+            pcm_status = true;
+        } else if (strcmp(argv[i], "--proc-root") == 0 && i + 1 < argc) {
+            proc_root = argv[++i];
+        } else if (strcmp(argv[i], "--history-record") == 0 && i + 1 < argc) {
+            history_record_path = argv[++i];
+        } else if (strcmp(argv[i], "--history-capacity") == 0 && i + 1 < argc) {
+            history_capacity = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            history_path = argv[++i];
+        } else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc) {
+            history_at_ms = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            history_window_s = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            metrics_file = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-export") == 0 && i + 1 < argc) {
+            metrics_export = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-out") == 0 && i + 1 < argc) {
+            metrics_out = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-count") == 0 && i + 1 < argc) {
+            metrics_counter = argv[++i];
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc && strcmp(argv[i + 1], "-") == 0) {
+            // Program audio as interleaved S16_LE at --format's rate/channels
+            fanout_stdin = true;
+            i++;
+        } else if (strcmp(argv[i], "--signal") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "tone") == 0) {
+                tone.signal = TEST_SIGNAL_TONE;
+            } else if (strcmp(value, "pink") == 0) {
+                tone.signal = TEST_SIGNAL_PINK_NOISE;
+            } else {
+                fprintf(stderr, "Unknown signal: %s (expected tone or pink)\n", value);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--frequency") == 0 && i + 1 < argc) {
+            tone.frequency_hz = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--amplitude") == 0 && i + 1 < argc) {
+            tone.amplitude = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            tone.duration_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    // The tone is generated at the requested rate, so it has to stay
+    // below that rate's Nyquist frequency to come out as itself
+    if (!(tone.frequency_hz > 0.0 && tone.frequency_hz < tone.sample_rate / 2.0)) {
+        fprintf(stderr, "Invalid frequency: %g (expected above 0 and below %g Hz)\n",
+                tone.frequency_hz, tone.sample_rate / 2.0);
+        return 2;
+    }
+    if (!(tone.amplitude >= 0.0 && tone.amplitude <= 1.0)) {
+        fprintf(stderr, "Invalid amplitude: %g (expected 0 to 1)\n", tone.amplitude);
+        return 2;
+    }
+    if (tone.duration_ms <= 0) {
+        fprintf(stderr, "Invalid duration: %d (expected milliseconds above 0)\n", tone.duration_ms);
+        return 2;
+    }
+    
+    if (metrics_export != NULL) {
+        return run_metrics_export(metrics_export, metrics_out);
+    }
+
+    // Metrics are best effort: a file that can't be opened only disables them
+    if (metrics_file != NULL && metrics_open(metrics_file) != 0) {
+        fprintf(stderr, "Cannot open metrics file %s; metrics disabled\n", metrics_file);
+    }
+
+    // Let the caller record what only it can see (timeouts, fallbacks).
+    // Every mode falls through to the one metrics_close below.
+    int status;
+    if (metrics_counter != NULL) {
+        MetricCounter counter;
+        if (metrics_file == NULL || !metrics_counter_by_name(metrics_counter, &counter)) {
+            fprintf(stderr, "Unknown metrics counter %s, or no --metrics-file\n", metrics_counter);
+            status = 2;
+        } else {
+            metrics_count(counter, 1);
+            status = 0;
+        }
+    } else if (shm_name != NULL) {
+        status = run_publisher(shm_name, interval_ms);
+    } else if (history_record_path != NULL) {
+        status = run_history_recorder(history_record_path, history_capacity, interval_ms);
+    } else if (history_path != NULL) {
+        status = run_history_report(history_path, history_at_ms, history_window_s);
+    } else if (pcm_status) {
+        status = run_pcm_status(proc_root, interval_ms);
+    } else if (record_target != NULL) {
+        status = run_recorder(record_target, &latency_format, &record_config, record_duration_s);
+    } else if (meter_pcm != NULL || meter_wav != NULL) {
+        status = run_meter(meter_pcm, meter_wav, &latency_format, meter_rate_hz, meter_binary);
+    } else if (fanout_count > 0) {
+        status = run_fanout(fanout_pcms, fanout_count, &tone, fanout_stdin);
+    } else if (failover_count > 0 || failover_devices) {
+        status = run_failover(failover_pcms, failover_count, failover_devices, &ranking,
+                              preroll_ms, budget_ms, &tone, fanout_stdin);
+    } else if (test_device != NULL) {
+        TestToneResult result;
+        play_test_output(test_device, &tone, &result);
+        print_test_output_json(test_device, &tone, &result);
+        status = result.status == 0 ? 0 : 1;
+    } else if (measure_latency && latency_pcm_count > 0) {
+        DeviceLatency results[MAX_LATENCY_PCMS];
+        for (int i = 0; i < latency_pcm_count; i++) {
+            measure_output_latency(latency_pcms[i], &latency_format, burst_ms, &results[i]);
+        }
+        print_latency_json(results, latency_pcm_count, &latency_format);
+        status = 0;
+    } else {
+        status = run_list(direction, list_flags, sys_root, proc_root, since_token,
+                          measure_latency, &latency_format, burst_ms);
+    }
+    
+    metrics_close();
+    return status;
 }
\ No newline at end of file
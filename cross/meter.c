@@ -0,0 +1,584 @@
+// meter.c - Level, loudness and spectrum metering of a capture stream or WAV file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "meter.h"
+#include "sample_convert.h"
+#include "wav.h"
+
+#if defined(__linux__)
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#endif
+
+// Audio is analysed in 10 ms blocks. BS.1770 loudness is built from the
+// K-weighted mean square of each block: momentary over 40 blocks,
+// short-term over 300, and integrated from 400 ms windows taken every
+// 100 ms and gated at -70 LUFS and then 10 LU below their own mean.
+#define METER_BLOCK_MS 10
+#define METER_MOMENTARY_BLOCKS 40
+#define METER_SHORT_TERM_BLOCKS 300
+#define METER_GATE_STEP_BLOCKS 10
+#define METER_ABSOLUTE_GATE -70.0
+#define METER_RELATIVE_GATE -10.0
+#define METER_GATE_BINS 1000            // 0.1 LU each, from the absolute gate up to +30 LUFS
+#define METER_BAND_LOW_HZ 20.0
+#define METER_BAND_HIGH_HZ 20000.0
+
+static const double PI = 3.141592653589793;
+
+// Transposed direct form II biquad, a0 normalised to 1
+typedef struct {
+    double b0, b1, b2, a1, a2;
+} Biquad;
+
+struct Meter {
+    MeterConfig config;
+    int block_frames;
+    long publish_frames;
+
+    // Input is staged until a whole block is available
+    float* staging;
+    long staged;
+
+    float* planes[METER_MAX_CHANNELS];
+    float* mix;
+
+    // K-weighting: a high shelf for the head's acoustic effect, then a
+    // high pass. State is laid out by channel so one frame's channels
+    // filter side by side, independent lanes rather than one long chain.
+    Biquad shelf;
+    Biquad highpass;
+    double state[4][METER_MAX_CHANNELS];
+    double weighted_energy[METER_MAX_CHANNELS];
+    float channel_gain[METER_MAX_CHANNELS];
+
+    double block_energy[METER_SHORT_TERM_BLOCKS];   // ring of weighted mean squares
+    long blocks_seen;
+
+    // Gating histogram: the count and summed mean square of the 400 ms
+    // windows that fell in each 0.1 LU bin, so the integrated value can be
+    // re-gated at any time without keeping every window
+    uint32_t gate_count[METER_GATE_BINS];
+    double gate_energy[METER_GATE_BINS];
+
+    // Levels over the current publish interval
+    float peak[METER_MAX_CHANNELS];
+    double energy[METER_MAX_CHANNELS];
+    long interval_frames;
+    long long frames_total;
+
+    // Spectrum of the channel mix, from the last METER_FFT_SIZE frames
+    float* history;
+    int history_pos;
+    float* window;
+    double window_power;
+    float* re;
+    float* im;
+    float* twiddle_re;                  // N - 1 entries: each stage's half-size run, smallest first
+    float* twiddle_im;
+    uint16_t* bit_reverse;
+    int band_first[METER_SPECTRUM_BANDS];
+    int band_last[METER_SPECTRUM_BANDS];
+    float band_hz[METER_SPECTRUM_BANDS];
+
+    MeterReading reading;
+};
+
+void meter_default_config(MeterConfig* config) {
+    config->sample_rate = 48000;
+    config->channels = 2;
+    config->publish_hz = 10;
+}
+
+// BS.1770 gives the filters at 48 kHz; these are the analogue prototypes
+// they came from, so other rates get the same response
+static void k_weighting(Biquad* shelf, Biquad* highpass, int sample_rate) {
+    double f0 = 1681.974450955533;
+    double gain_db = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(PI * f0 / sample_rate);
+    double vh = pow(10.0, gain_db / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf->b0 = (vh + vb * k / q + k * k) / a0;
+    shelf->b1 = 2.0 * (k * k - vh) / a0;
+    shelf->b2 = (vh - vb * k / q + k * k) / a0;
+    shelf->a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf->a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(PI * f0 / sample_rate);
+    a0 = 1.0 + k / q + k * k;
+    highpass->b0 = 1.0;
+    highpass->b1 = -2.0;
+    highpass->b2 = 1.0;
+    highpass->a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass->a2 = (1.0 - k / q + k * k) / a0;
+}
+
+static void build_spectrum(Meter* m) {
+    const int n = METER_FFT_SIZE;
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+
+    m->window_power = 0.0;
+    for (int i = 0; i < n; i++) {
+        double w = 0.5 - 0.5 * cos(2.0 * PI * i / n);
+        m->window[i] = (float)w;
+        m->window_power += w * w;
+
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        m->bit_reverse[i] = (uint16_t)r;
+    }
+
+    for (int half = 1; half < n; half *= 2) {
+        for (int j = 0; j < half; j++) {
+            m->twiddle_re[half - 1 + j] = (float)cos(PI * j / half);
+            m->twiddle_im[half - 1 + j] = (float)-sin(PI * j / half);
+        }
+    }
+
+    // Bands split 20 Hz..20 kHz (or Nyquist) evenly in log frequency; a
+    // band narrower than a bin reads the bin holding its centre
+    double rate = m->config.sample_rate;
+    double high = METER_BAND_HIGH_HZ < rate * 0.5 ? METER_BAND_HIGH_HZ : rate * 0.5;
+    double ratio = high / METER_BAND_LOW_HZ;
+    for (int b = 0; b < METER_SPECTRUM_BANDS; b++) {
+        double lo = METER_BAND_LOW_HZ * pow(ratio, (double)b / METER_SPECTRUM_BANDS);
+        double hi = METER_BAND_LOW_HZ * pow(ratio, (double)(b + 1) / METER_SPECTRUM_BANDS);
+        double centre = sqrt(lo * hi);
+        int first = (int)ceil(lo * n / rate);
+        int last = (int)ceil(hi * n / rate);
+        if (last > n / 2) last = n / 2;
+        if (last <= first) {
+            first = (int)(centre * n / rate + 0.5);
+            if (first >= n / 2) first = n / 2 - 1;
+            last = first + 1;
+        }
+        m->band_first[b] = first;
+        m->band_last[b] = last;
+        m->band_hz[b] = (float)centre;
+    }
+}
+
+Meter* meter_create(const MeterConfig* config) {
+    if (config->channels <= 0 || config->channels > METER_MAX_CHANNELS ||
+        config->sample_rate < 8000 || config->publish_hz <= 0) {
+        return NULL;
+    }
+
+    Meter* m = (Meter*)calloc(1, sizeof(Meter));
+    if (m == NULL) return NULL;
+    m->config = *config;
+    m->block_frames = config->sample_rate * METER_BLOCK_MS / 1000;
+    m->publish_frames = config->sample_rate / config->publish_hz;
+    if (m->publish_frames < m->block_frames) m->publish_frames = m->block_frames;
+
+    size_t block = (size_t)m->block_frames;
+    size_t channels = (size_t)config->channels;
+    m->staging = (float*)malloc(block * channels * sizeof(float));
+    m->planes[0] = (float*)malloc(block * channels * sizeof(float));
+    m->mix = (float*)malloc(block * sizeof(float));
+    m->history = (float*)calloc(METER_FFT_SIZE, sizeof(float));
+    m->window = (float*)malloc(METER_FFT_SIZE * sizeof(float));
+    m->re = (float*)malloc(METER_FFT_SIZE * sizeof(float));
+    m->im = (float*)malloc(METER_FFT_SIZE * sizeof(float));
+    m->twiddle_re = (float*)malloc(METER_FFT_SIZE * sizeof(float));
+    m->twiddle_im = (float*)malloc(METER_FFT_SIZE * sizeof(float));
+    m->bit_reverse = (uint16_t*)malloc(METER_FFT_SIZE * sizeof(uint16_t));
+    if (!m->staging || !m->planes[0] || !m->mix || !m->history || !m->window ||
+        !m->re || !m->im || !m->twiddle_re || !m->twiddle_im || !m->bit_reverse) {
+        meter_destroy(m);
+        return NULL;
+    }
+    for (int c = 1; c < config->channels; c++) {
+        m->planes[c] = m->planes[0] + block * c;
+    }
+
+    // BS.1770 weights the surround pair of a 5.1 stream up by 1.5 dB and
+    // leaves out the LFE; other layouts weight every channel equally
+    for (int c = 0; c < config->channels; c++) {
+        m->channel_gain[c] = 1.0f;
+    }
+    if (config->channels == 6) {
+        m->channel_gain[3] = 0.0f;
+        m->channel_gain[4] = 1.41f;
+        m->channel_gain[5] = 1.41f;
+    }
+
+    k_weighting(&m->shelf, &m->highpass, config->sample_rate);
+    build_spectrum(m);
+    m->reading.channels = config->channels;
+    return m;
+}
+
+void meter_destroy(Meter* m) {
+    if (m == NULL) return;
+    free(m->staging);
+    free(m->planes[0]);
+    free(m->mix);
+    free(m->history);
+    free(m->window);
+    free(m->re);
+    free(m->im);
+    free(m->twiddle_re);
+    free(m->twiddle_im);
+    free(m->bit_reverse);
+    free(m);
+}
+
+float meter_band_hz(const Meter* m, int band) {
+    return band >= 0 && band < METER_SPECTRUM_BANDS ? m->band_hz[band] : 0.0f;
+}
+
+static float power_db(double power) {
+    if (power <= 1e-12) return METER_FLOOR_DB;
+    float db = (float)(10.0 * log10(power));
+    return db > METER_FLOOR_DB ? db : METER_FLOOR_DB;
+}
+
+static double loudness(double energy) {
+    return energy > 0.0 ? -0.691 + 10.0 * log10(energy) : -HUGE_VAL;
+}
+
+static float loudness_lufs(double energy) {
+    double l = loudness(energy);
+    return l > METER_FLOOR_DB ? (float)l : METER_FLOOR_DB;
+}
+
+// Mean of the last count block energies
+static double window_energy(const Meter* m, int count) {
+    double sum = 0.0;
+    for (int i = 1; i <= count; i++) {
+        sum += m->block_energy[(m->blocks_seen - i) % METER_SHORT_TERM_BLOCKS];
+    }
+    return sum / count;
+}
+
+static void gate_window(Meter* m, double energy) {
+    double l = loudness(energy);
+    if (l <= METER_ABSOLUTE_GATE) return;
+    int bin = (int)((l - METER_ABSOLUTE_GATE) * 10.0);
+    if (bin >= METER_GATE_BINS) bin = METER_GATE_BINS - 1;
+    m->gate_count[bin]++;
+    m->gate_energy[bin] += energy;
+}
+
+static float integrated_lufs(const Meter* m) {
+    double energy = 0.0;
+    double count = 0.0;
+    for (int i = 0; i < METER_GATE_BINS; i++) {
+        energy += m->gate_energy[i];
+        count += m->gate_count[i];
+    }
+    if (count == 0.0) return METER_FLOOR_DB;
+
+    double threshold = loudness(energy / count) + METER_RELATIVE_GATE;
+    int first = (int)ceil((threshold - METER_ABSOLUTE_GATE) * 10.0);
+    if (first < 0) first = 0;
+    energy = 0.0;
+    count = 0.0;
+    for (int i = first; i < METER_GATE_BINS; i++) {
+        energy += m->gate_energy[i];
+        count += m->gate_count[i];
+    }
+    return count > 0.0 ? loudness_lufs(energy / count) : METER_FLOOR_DB;
+}
+
+// Both K-weighting stages over interleaved frames, summing each
+// channel's weighted energy
+static void k_weight(Meter* m, const float* frames, int n) {
+    const int channels = m->config.channels;
+    const Biquad shelf = m->shelf;
+    const Biquad hp = m->highpass;
+    double* s1 = m->state[0];
+    double* s2 = m->state[1];
+    double* s3 = m->state[2];
+    double* s4 = m->state[3];
+    double* energy = m->weighted_energy;
+
+    for (int i = 0; i < n; i++) {
+        const float* x = frames + (size_t)i * channels;
+        for (int c = 0; c < channels; c++) {
+            double v = x[c];
+            double y = shelf.b0 * v + s1[c];
+            s1[c] = shelf.b1 * v - shelf.a1 * y + s2[c];
+            s2[c] = shelf.b2 * v - shelf.a2 * y;
+            double z = y + s3[c];
+            s3[c] = -2.0 * y - hp.a1 * z + s4[c];
+            s4[c] = y - hp.a2 * z;
+            energy[c] += z * z;
+        }
+    }
+}
+
+static void compute_spectrum(Meter* m) {
+    const int n = METER_FFT_SIZE;
+    for (int i = 0; i < n; i++) {
+        int r = m->bit_reverse[i];
+        m->re[r] = m->history[(m->history_pos + i) & (n - 1)] * m->window[i];
+        m->im[r] = 0.0f;
+    }
+    for (int half = 1; half < n; half *= 2) {
+        const float* wr = m->twiddle_re + half - 1;
+        const float* wi = m->twiddle_im + half - 1;
+        for (int start = 0; start < n; start += 2 * half) {
+            sample_butterfly(m->re + start, m->im + start, m->re + start + half, m->im + start + half,
+                             wr, wi, half);
+        }
+    }
+
+    // One-sided band power, scaled so a full-scale sine reads 0 dB
+    double scale = 4.0 / ((double)n * m->window_power);
+    for (int b = 0; b < METER_SPECTRUM_BANDS; b++) {
+        double power = 0.0;
+        for (int k = m->band_first[b]; k < m->band_last[b]; k++) {
+            power += (double)m->re[k] * m->re[k] + (double)m->im[k] * m->im[k];
+        }
+        m->reading.spectrum_db[b] = power_db(power * scale);
+    }
+}
+
+static void publish(Meter* m, MeterCallback callback, void* user) {
+    MeterReading* r = &m->reading;
+    r->time = (double)m->frames_total / m->config.sample_rate;
+    for (int c = 0; c < m->config.channels; c++) {
+        r->peak_db[c] = power_db((double)m->peak[c] * m->peak[c]);
+        r->rms_db[c] = power_db(m->energy[c] / m->interval_frames);
+        m->peak[c] = 0.0f;
+        m->energy[c] = 0.0;
+    }
+    m->interval_frames = 0;
+
+    r->momentary_lufs = m->blocks_seen >= METER_MOMENTARY_BLOCKS ?
+        loudness_lufs(window_energy(m, METER_MOMENTARY_BLOCKS)) : METER_FLOOR_DB;
+    r->short_term_lufs = m->blocks_seen >= METER_SHORT_TERM_BLOCKS ?
+        loudness_lufs(window_energy(m, METER_SHORT_TERM_BLOCKS)) : METER_FLOOR_DB;
+    r->integrated_lufs = integrated_lufs(m);
+    compute_spectrum(m);
+
+    if (callback) callback(r, user);
+}
+
+static void process_block(Meter* m, MeterCallback callback, void* user) {
+    const int n = m->block_frames;
+    const int channels = m->config.channels;
+    double weighted_energy = 0.0;
+
+    memset(m->weighted_energy, 0, sizeof(m->weighted_energy));
+    k_weight(m, m->staging, n);
+
+    sample_deinterleave(m->staging, m->planes, channels, n);
+    for (int c = 0; c < channels; c++) {
+        const float* plane = m->planes[c];
+        float peak, energy;
+        sample_peak_energy(plane, n, &peak, &energy);
+        if (peak > m->peak[c]) m->peak[c] = peak;
+        m->energy[c] += energy;
+        weighted_energy += m->channel_gain[c] * m->weighted_energy[c];
+
+        if (c == 0) {
+            memcpy(m->mix, plane, (size_t)n * sizeof(float));
+        } else {
+            for (int i = 0; i < n; i++) m->mix[i] += plane[i];
+        }
+    }
+
+    m->block_energy[m->blocks_seen % METER_SHORT_TERM_BLOCKS] = weighted_energy / n;
+    m->blocks_seen++;
+    if (m->blocks_seen >= METER_MOMENTARY_BLOCKS && m->blocks_seen % METER_GATE_STEP_BLOCKS == 0) {
+        gate_window(m, window_energy(m, METER_MOMENTARY_BLOCKS));
+    }
+
+    float mix_scale = 1.0f / channels;
+    for (int i = 0; i < n; i++) {
+        m->history[m->history_pos] = m->mix[i] * mix_scale;
+        m->history_pos = (m->history_pos + 1) & (METER_FFT_SIZE - 1);
+    }
+
+    m->interval_frames += n;
+    m->frames_total += n;
+    if (m->interval_frames >= m->publish_frames) publish(m, callback, user);
+}
+
+void meter_process(Meter* m, const float* frames, long count, MeterCallback callback, void* user) {
+    const int channels = m->config.channels;
+    while (count > 0) {
+        long take = m->block_frames - m->staged;
+        if (take > count) take = count;
+        memcpy(m->staging + m->staged * channels, frames, (size_t)take * channels * sizeof(float));
+        m->staged += take;
+        frames += take * channels;
+        count -= take;
+        if (m->staged == m->block_frames) {
+            process_block(m, callback, user);
+            m->staged = 0;
+        }
+    }
+}
+
+// Sources
+
+struct MeterSource {
+    bool is_wav;
+    WavReader wav;
+    int sample_rate;
+    int channels;
+    int overruns;
+#if defined(__linux__)
+    snd_pcm_t* pcm;
+    SampleFormat format;
+    void* native;
+    long native_frames;
+#endif
+};
+
+MeterSource* meter_source_open_wav(const char* path, char* error, size_t error_size) {
+    MeterSource* source = (MeterSource*)calloc(1, sizeof(MeterSource));
+    if (source == NULL) {
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    if (wav_open_read(&source->wav, path, error, error_size) != 0) {
+        free(source);
+        return NULL;
+    }
+    if (source->wav.channels > METER_MAX_CHANNELS) {
+        snprintf(error, error_size, "more than %d channels", METER_MAX_CHANNELS);
+        wav_close_read(&source->wav);
+        free(source);
+        return NULL;
+    }
+    source->is_wav = true;
+    source->sample_rate = source->wav.sample_rate;
+    source->channels = source->wav.channels;
+    return source;
+}
+
+int meter_source_rate(const MeterSource* source) {
+    return source->sample_rate;
+}
+
+int meter_source_channels(const MeterSource* source) {
+    return source->channels;
+}
+
+int meter_source_overruns(const MeterSource* source) {
+    return source->overruns;
+}
+
+#if defined(__linux__)
+
+static int configure_capture(MeterSource* source, unsigned int rate, unsigned int channels) {
+    snd_pcm_hw_params_t* hw;
+    snd_pcm_uframes_t period = rate * METER_BLOCK_MS / 1000;
+    snd_pcm_uframes_t buffer = period * 8;
+    int err;
+
+    snd_pcm_hw_params_alloca(&hw);
+    if ((err = snd_pcm_hw_params_any(source->pcm, hw)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_access(source->pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) return err;
+
+    source->format = SAMPLE_FORMAT_UNKNOWN;
+    for (int i = 0; i < SAMPLE_FORMAT_PREFERENCE_COUNT; i++) {
+        snd_pcm_format_t candidate = (snd_pcm_format_t)sample_format_to_alsa(sample_format_preference[i]);
+        if (snd_pcm_hw_params_test_format(source->pcm, hw, candidate) == 0) {
+            source->format = sample_format_preference[i];
+            break;
+        }
+    }
+    if (source->format == SAMPLE_FORMAT_UNKNOWN) return -EINVAL;
+    if ((err = snd_pcm_hw_params_set_format(source->pcm, hw, (snd_pcm_format_t)sample_format_to_alsa(source->format))) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_channels_near(source->pcm, hw, &channels)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_rate_near(source->pcm, hw, &rate, NULL)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_period_size_near(source->pcm, hw, &period, NULL)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(source->pcm, hw, &buffer)) < 0) return err;
+    if ((err = snd_pcm_hw_params(source->pcm, hw)) < 0) return err;
+    snd_pcm_hw_params_get_period_size(hw, &period, NULL);
+
+    if (channels > METER_MAX_CHANNELS) return -EINVAL;
+    source->sample_rate = (int)rate;
+    source->channels = (int)channels;
+    source->native_frames = (long)period;
+    return 0;
+}
+
+MeterSource* meter_source_open_capture(const char* pcm, int sample_rate, int channels, char* error, size_t error_size) {
+    MeterSource* source = (MeterSource*)calloc(1, sizeof(MeterSource));
+    int err;
+
+    if (source == NULL) {
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    if ((err = snd_pcm_open(&source->pcm, pcm, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+        snprintf(error, error_size, "%s", snd_strerror(err));
+        free(source);
+        return NULL;
+    }
+    if ((err = configure_capture(source, (unsigned)sample_rate, (unsigned)channels)) < 0) {
+        snprintf(error, error_size, "%s", snd_strerror(err));
+        meter_source_close(source);
+        return NULL;
+    }
+    source->native = malloc((size_t)source->native_frames * source->channels * sample_format_bytes(source->format));
+    if (source->native == NULL) {
+        snprintf(error, error_size, "out of memory");
+        meter_source_close(source);
+        return NULL;
+    }
+    return source;
+}
+
+static long capture_read(MeterSource* source, float* frames, long count) {
+    if (count > source->native_frames) count = source->native_frames;
+    for (;;) {
+        snd_pcm_sframes_t got = snd_pcm_readi(source->pcm, source->native, (snd_pcm_uframes_t)count);
+        if (got > 0) {
+            sample_convert_to_float(source->format, source->native, frames, (long)got * source->channels);
+            return (long)got;
+        }
+        if (got == -EAGAIN) continue;
+        if (got == -EPIPE || got == -ESTRPIPE) source->overruns++;
+        if (snd_pcm_recover(source->pcm, (int)got, 1) < 0) return (long)got;
+    }
+}
+
+#else
+
+MeterSource* meter_source_open_capture(const char* pcm, int sample_rate, int channels, char* error, size_t error_size) {
+    (void)pcm;
+    (void)sample_rate;
+    (void)channels;
+    snprintf(error, error_size, "capture metering is only supported on Linux");
+    return NULL;
+}
+
+#endif
+
+long meter_source_read(MeterSource* source, float* frames, long count) {
+    if (source->is_wav) return wav_read_float(&source->wav, frames, count);
+#if defined(__linux__)
+    return capture_read(source, frames, count);
+#else
+    return -1;
+#endif
+}
+
+void meter_source_close(MeterSource* source) {
+    if (source == NULL) return;
+    if (source->is_wav) wav_close_read(&source->wav);
+#if defined(__linux__)
+    if (source->pcm) snd_pcm_close(source->pcm);
+    free(source->native);
+#endif
+    free(source);
+}
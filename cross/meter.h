@@ -0,0 +1,77 @@
+// meter.h - Level, loudness and spectrum metering of a capture stream or WAV file
+#ifndef METER_H
+#define METER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METER_MAX_CHANNELS 32
+#define METER_SPECTRUM_BANDS 32
+#define METER_FFT_SIZE 2048
+#define METER_FLOOR_DB -120.0f          // silence, and loudness not yet measurable
+
+typedef struct {
+    int sample_rate;
+    int channels;
+    int publish_hz;                     // readings per second of stream time
+} MeterConfig;
+
+// Levels in dBFS and loudness in LUFS (EBU R128 / ITU-R BS.1770)
+typedef struct {
+    double time;                        // stream seconds at the end of the interval
+    int channels;
+    float peak_db[METER_MAX_CHANNELS];  // sample peak over the interval
+    float rms_db[METER_MAX_CHANNELS];   // over the interval
+    float momentary_lufs;               // last 400 ms
+    float short_term_lufs;              // last 3 s
+    float integrated_lufs;              // gated, since the start
+    float spectrum_db[METER_SPECTRUM_BANDS]; // channel mix, log-spaced bands; a full-scale sine reads 0
+} MeterReading;
+
+typedef void (*MeterCallback)(const MeterReading* reading, void* user);
+
+typedef struct Meter Meter;
+
+void meter_default_config(MeterConfig* config);
+
+// Everything the meter needs is allocated here; meter_process never
+// allocates. Returns NULL on a bad config or out of memory.
+Meter* meter_create(const MeterConfig* config);
+
+// Feed interleaved float frames. The callback runs once per publish
+// interval completed, on the calling thread.
+void meter_process(Meter* meter, const float* frames, long count, MeterCallback callback, void* user);
+
+// Centre frequency of a spectrum band
+float meter_band_hz(const Meter* meter, int band);
+
+void meter_destroy(Meter* meter);
+
+// Where metered audio comes from: a capture PCM (Linux; monitor sources
+// are capture PCMs too) or a WAV file
+typedef struct MeterSource MeterSource;
+
+// Rate and channel count are requests; the device may choose its nearest
+MeterSource* meter_source_open_capture(const char* pcm, int sample_rate, int channels, char* error, size_t error_size);
+MeterSource* meter_source_open_wav(const char* path, char* error, size_t error_size);
+
+int meter_source_rate(const MeterSource* source);
+int meter_source_channels(const MeterSource* source);
+
+// Capture overruns recovered from so far
+int meter_source_overruns(const MeterSource* source);
+
+// Read up to count interleaved float frames, blocking for capture.
+// Returns frames read, 0 at the end of a file, or a negative error code.
+long meter_source_read(MeterSource* source, float* frames, long count);
+
+void meter_source_close(MeterSource* source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METER_H
@@ -0,0 +1,265 @@
+// metrics.c - Enumeration latency histograms and counters in a shared memory-mapped file
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+
+static const struct {
+    const char* name;
+    const char* help;
+    bool gauge;
+} counter_info[METRIC_COUNTER_COUNT] = {
+    { "successes", "Enumerations that produced a device list", false },
+    { "card_failures", "Cards whose control device could not be queried", false },
+    { "full_list_fallbacks", "Delta requests answered with the full list because the snapshot was unknown", false },
+    { "timeouts", "Enumerator runs the caller killed for taking too long", false },
+    { "fallbacks", "Times the caller fell back to platform tools", false },
+    { "devices_listed", "Devices returned, summed over all enumerations", false },
+    { "devices", "Devices returned by the latest enumeration", true },
+};
+
+bool metrics_counter_by_name(const char* name, MetricCounter* counter) {
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        if (strcmp(name, counter_info[i].name) == 0) {
+            *counter = (MetricCounter)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* phase_names[METRIC_PHASE_COUNT] = {
+    "total", "config", "cards", "card", "finish", "running"
+};
+
+// Bucket of a duration in microseconds: values below 8 us get one bucket
+// each, then every power of two is split in 8
+static int bucket_index(uint64_t us) {
+    if (us < METRICS_SUB_BUCKETS) return (int)us;
+    int exponent = 63 - __builtin_clzll(us);
+    if (exponent >= METRICS_MAX_EXPONENT) return METRICS_BUCKETS - 1;
+    int sub = (int)((us >> (exponent - 3)) & (METRICS_SUB_BUCKETS - 1));
+    return METRICS_SUB_BUCKETS * (exponent - 2) + sub;
+}
+
+// Exclusive upper bound in microseconds of a regular bucket
+static uint64_t bucket_limit(int index) {
+    if (index < METRICS_SUB_BUCKETS) return (uint64_t)index + 1;
+    int exponent = index / METRICS_SUB_BUCKETS + 2;
+    int sub = index % METRICS_SUB_BUCKETS;
+    return (uint64_t)(METRICS_SUB_BUCKETS + sub + 1) << (exponent - 3);
+}
+
+static uint64_t load(const uint64_t* value) {
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+// Prometheus wants few, stable bucket bounds: the fine buckets are summed
+// up to each power of two. _count is the bucket total, so it always agrees
+// with +Inf even while another process is updating the file.
+static void export_histogram(FILE* out, const char* name, const char* label, const char* value,
+                             const MetricHistogram* histogram) {
+    uint64_t cumulative = 0;
+    int index = 0;
+    for (int exponent = 0; exponent < METRICS_MAX_EXPONENT; exponent++) {
+        uint64_t bound = (uint64_t)1 << exponent;
+        while (index < METRICS_BUCKETS - 1 && bucket_limit(index) <= bound) {
+            cumulative += load(&histogram->buckets[index++]);
+        }
+        fprintf(out, "%s_bucket{%s=\"%s\",le=\"%g\"} %llu\n", name, label, value,
+                (double)bound / 1e6, (unsigned long long)cumulative);
+    }
+    while (index < METRICS_BUCKETS) cumulative += load(&histogram->buckets[index++]);
+    fprintf(out, "%s_bucket{%s=\"%s\",le=\"+Inf\"} %llu\n", name, label, value, (unsigned long long)cumulative);
+    fprintf(out, "%s_sum{%s=\"%s\"} %.9f\n", name, label, value, (double)load(&histogram->sum_ns) / 1e9);
+    fprintf(out, "%s_count{%s=\"%s\"} %llu\n", name, label, value, (unsigned long long)cumulative);
+}
+
+static bool histogram_empty(const MetricHistogram* histogram) {
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        if (load(&histogram->buckets[i]) != 0) return false;
+    }
+    return true;
+}
+
+static void export_file(const MetricsFile* file, FILE* out) {
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        const char* suffix = counter_info[i].gauge ? "" : "_total";
+        fprintf(out, "# HELP audio_enum_%s%s %s\n", counter_info[i].name, suffix, counter_info[i].help);
+        fprintf(out, "# TYPE audio_enum_%s%s %s\n", counter_info[i].name, suffix,
+                counter_info[i].gauge ? "gauge" : "counter");
+        fprintf(out, "audio_enum_%s%s %llu\n", counter_info[i].name, suffix,
+                (unsigned long long)load(&file->counters[i]));
+    }
+
+    fprintf(out, "# HELP audio_enum_phase_duration_seconds Time spent per enumeration phase\n");
+    fprintf(out, "# TYPE audio_enum_phase_duration_seconds histogram\n");
+    for (int i = 0; i < METRIC_PHASE_COUNT; i++) {
+        export_histogram(out, "audio_enum_phase_duration_seconds", "phase", phase_names[i], &file->phases[i]);
+    }
+
+    fprintf(out, "# HELP audio_enum_card_duration_seconds Time spent querying each card\n");
+    fprintf(out, "# TYPE audio_enum_card_duration_seconds histogram\n");
+    for (int card = 0; card < METRICS_MAX_CARDS; card++) {
+        if (histogram_empty(&file->cards[card])) continue;
+        char value[16];
+        snprintf(value, sizeof(value), "%d", card);
+        export_histogram(out, "audio_enum_card_duration_seconds", "card", value, &file->cards[card]);
+    }
+}
+
+static MetricsFile* active;
+
+static int64_t realtime_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool layout_matches(const MetricsFile* file) {
+    return file->version == METRICS_VERSION && file->size == sizeof(MetricsFile);
+}
+
+int metrics_open(const char* path) {
+    if (active != NULL) return 0;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    // Growing a file only ever adds zeros, so racing creators are harmless
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        ((size_t)st.st_size < sizeof(MetricsFile) && ftruncate(fd, sizeof(MetricsFile)) < 0)) {
+        close(fd);
+        return -1;
+    }
+
+    MetricsFile* file = (MetricsFile*)mmap(NULL, sizeof(MetricsFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) return -1;
+
+    // The first process to map a fresh file claims it by swapping in the
+    // magic; the layout fields are the same for every creator
+    uint32_t expected = 0;
+    if (__atomic_load_n(&file->magic, __ATOMIC_ACQUIRE) == 0) {
+        file->version = METRICS_VERSION;
+        file->size = sizeof(MetricsFile);
+        file->created_usec = realtime_usec();
+        __atomic_compare_exchange_n(&file->magic, &expected, METRICS_MAGIC, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+    if (__atomic_load_n(&file->magic, __ATOMIC_ACQUIRE) != METRICS_MAGIC || !layout_matches(file)) {
+        munmap(file, sizeof(MetricsFile));
+        return -1;
+    }
+
+    active = file;
+    return 0;
+}
+
+void metrics_close(void) {
+    if (active == NULL) return;
+    munmap(active, sizeof(MetricsFile));
+    active = NULL;
+}
+
+uint64_t metrics_start(void) {
+    if (active == NULL) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void observe(MetricHistogram* histogram, uint64_t start) {
+    uint64_t now = metrics_start();
+    uint64_t ns = now > start ? now - start : 0;
+    __atomic_fetch_add(&histogram->buckets[bucket_index(ns / 1000)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sum_ns, ns, __ATOMIC_RELAXED);
+}
+
+void metrics_observe(MetricPhase phase, uint64_t start) {
+    if (active == NULL || start == 0 || phase < 0 || phase >= METRIC_PHASE_COUNT) return;
+    observe(&active->phases[phase], start);
+}
+
+void metrics_observe_card(int card, uint64_t start) {
+    if (active == NULL || start == 0) return;
+    observe(&active->phases[METRIC_PHASE_CARD], start);
+    if (card >= 0 && card < METRICS_MAX_CARDS) observe(&active->cards[card], start);
+}
+
+void metrics_count(MetricCounter counter, uint64_t n) {
+    if (active == NULL || counter < 0 || counter >= METRIC_COUNTER_COUNT) return;
+    __atomic_fetch_add(&active->counters[counter], n, __ATOMIC_RELAXED);
+}
+
+void metrics_set(MetricCounter counter, uint64_t value) {
+    if (active == NULL || counter < 0 || counter >= METRIC_COUNTER_COUNT) return;
+    __atomic_store_n(&active->counters[counter], value, __ATOMIC_RELAXED);
+}
+
+int metrics_export_prometheus(const char* path, FILE* out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(MetricsFile)) {
+        close(fd);
+        return -1;
+    }
+    const MetricsFile* file = (const MetricsFile*)mmap(NULL, sizeof(MetricsFile), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) return -1;
+
+    int result = -1;
+    if (__atomic_load_n(&file->magic, __ATOMIC_ACQUIRE) == METRICS_MAGIC && layout_matches(file)) {
+        export_file(file, out);
+        result = 0;
+    }
+    munmap((void*)file, sizeof(MetricsFile));
+    return result;
+}
+
+#else
+
+// Memory-mapped metrics are not supported on Windows builds
+int metrics_open(const char* path) {
+    (void)path;
+    return -1;
+}
+
+void metrics_close(void) {
+}
+
+uint64_t metrics_start(void) {
+    return 0;
+}
+
+void metrics_observe(MetricPhase phase, uint64_t start) {
+    (void)phase; (void)start;
+}
+
+void metrics_observe_card(int card, uint64_t start) {
+    (void)card; (void)start;
+}
+
+void metrics_count(MetricCounter counter, uint64_t n) {
+    (void)counter; (void)n;
+}
+
+void metrics_set(MetricCounter counter, uint64_t value) {
+    (void)counter; (void)value;
+}
+
+int metrics_export_prometheus(const char* path, FILE* out) {
+    (void)path; (void)out;
+    return -1;
+}
+
+#endif
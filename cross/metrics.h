@@ -0,0 +1,87 @@
+// metrics.h - Enumeration latency histograms and counters in a shared memory-mapped file
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRICS_MAGIC 0x56414d54u   // "VAMT"
+#define METRICS_VERSION 1
+#define METRICS_MAX_CARDS 32
+
+// Log-linear buckets over microseconds: 8 per power of two (12.5%
+// resolution) up to 2^27 us, plus one overflow bucket
+#define METRICS_SUB_BUCKETS 8
+#define METRICS_MAX_EXPONENT 27
+#define METRICS_BUCKETS (METRICS_SUB_BUCKETS * (METRICS_MAX_EXPONENT - 2) + 1)
+
+typedef enum {
+    METRIC_PHASE_TOTAL,             // one whole enumeration
+    METRIC_PHASE_CONFIG,            // backend configuration reload
+    METRIC_PHASE_CARDS,             // walking every card
+    METRIC_PHASE_CARD,              // one card (also kept per card)
+    METRIC_PHASE_FINISH,            // defaults and duplex links
+    METRIC_PHASE_RUNNING,           // running state from procfs
+    METRIC_PHASE_COUNT
+} MetricPhase;
+
+typedef enum {
+    METRIC_SUCCESSES,               // enumerations that printed a result
+    METRIC_CARD_FAILURES,           // cards whose control device couldn't be queried
+    METRIC_FULL_LIST_FALLBACKS,     // --since token unknown, full list sent instead
+    METRIC_TIMEOUTS,                // reported by the caller (--metrics-count)
+    METRIC_FALLBACKS,               // caller fell back to platform tools (--metrics-count)
+    METRIC_DEVICES_LISTED,          // sum of device counts over all enumerations
+    METRIC_DEVICES,                 // gauge: device count of the latest enumeration
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+typedef struct {
+    uint64_t sum_ns;
+    uint64_t buckets[METRICS_BUCKETS];
+} MetricHistogram;
+
+// File layout. Every field after the header is only ever changed with
+// atomic adds or stores, so any number of processes can update one file
+// without locks.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                  // sizeof(MetricsFile) of the creator
+    uint32_t reserved;
+    int64_t created_usec;
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    MetricHistogram phases[METRIC_PHASE_COUNT];
+    MetricHistogram cards[METRICS_MAX_CARDS];
+} MetricsFile;
+
+// Map the metrics file for this process, creating it if needed. Until
+// then (or if it fails) every update below is a no-op.
+int metrics_open(const char* path);
+void metrics_close(void);
+
+// Start of a timed phase; 0 when metrics are off, so callers pay no clock
+// read then
+uint64_t metrics_start(void);
+void metrics_observe(MetricPhase phase, uint64_t start);
+void metrics_observe_card(int card, uint64_t start);
+
+void metrics_count(MetricCounter counter, uint64_t n);
+void metrics_set(MetricCounter counter, uint64_t value);
+
+// Counter by its exported name without the _total suffix, e.g. "timeouts"
+bool metrics_counter_by_name(const char* name, MetricCounter* counter);
+
+// Write a metrics file in the Prometheus text exposition format
+int metrics_export_prometheus(const char* path, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
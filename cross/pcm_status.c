@@ -0,0 +1,308 @@
+// pcm_status.c - Per-substream PCM status from /proc/asound, without opening any PCM
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pcm_status.h"
+
+static const char* state_names[] = {
+    "CLOSED", "OPEN", "SETUP", "PREPARED", "RUNNING", "XRUN",
+    "DRAINING", "PAUSED", "SUSPENDED", "DISCONNECTED", "UNKNOWN"
+};
+
+const char* pcm_state_to_string(PcmState state) {
+    if (state < PCM_STATE_CLOSED || state > PCM_STATE_UNKNOWN) return "UNKNOWN";
+    return state_names[state];
+}
+
+void pcm_status_mark_running(const PcmStreamStatus* statuses, int count, AudioDevice* devices, int device_count) {
+    for (int i = 0; i < device_count; i++) {
+        int card, dev;
+        if (sscanf(devices[i].id, "hw:%d,%d", &card, &dev) != 2) continue;
+        for (int j = 0; j < count; j++) {
+            const PcmStreamStatus* s = &statuses[j];
+            if (s->card != card || s->device != dev || s->direction != devices[i].direction) continue;
+            if (s->state == PCM_STATE_RUNNING || s->state == PCM_STATE_DRAINING) {
+                devices[i].is_running = true;
+                break;
+            }
+        }
+    }
+}
+
+#if defined(__linux__)
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// procfs files are generated on read; 1 KB holds either file whole
+#define PCM_STATUS_READ_SIZE 1024
+
+typedef struct {
+    int card;
+    int device;
+    int subdevice;
+    AudioDeviceDirection direction;
+    int status_fd;
+    int hw_params_fd;
+} PcmStatusEntry;
+
+struct PcmStatusSampler {
+    char root[256];
+    PcmStatusEntry entries[PCM_STATUS_MAX_SUBDEVICES];
+    int count;
+};
+
+// Parse "<prefix><number><rest>" where the number is the whole digit run
+static bool parse_indexed(const char* name, const char* prefix, int* value, const char** rest) {
+    size_t n = strlen(prefix);
+    if (strncmp(name, prefix, n) != 0 || name[n] < '0' || name[n] > '9') return false;
+    char* end;
+    *value = (int)strtol(name + n, &end, 10);
+    *rest = end;
+    return true;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const PcmStatusEntry* x = a;
+    const PcmStatusEntry* y = b;
+    if (x->card != y->card) return x->card - y->card;
+    if (x->device != y->device) return x->device - y->device;
+    if (x->direction != y->direction) return (int)x->direction - (int)y->direction;
+    return x->subdevice - y->subdevice;
+}
+
+// Take the descriptors of a substream the previous scan already had open
+static bool adopt_entry(PcmStatusEntry* entry, PcmStatusEntry* previous, int previous_count) {
+    for (int i = 0; i < previous_count; i++) {
+        PcmStatusEntry* p = &previous[i];
+        if (p->status_fd < 0 || compare_entries(p, entry) != 0) continue;
+        entry->status_fd = p->status_fd;
+        entry->hw_params_fd = p->hw_params_fd;
+        p->status_fd = p->hw_params_fd = -1;
+        return true;
+    }
+    return false;
+}
+
+static void scan_pcm_dir(PcmStatusSampler* sampler, const char* path, PcmStatusEntry* base,
+                         PcmStatusEntry* previous, int previous_count) {
+    DIR* dir = opendir(path);
+    if (dir == NULL) return;
+
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL && sampler->count < PCM_STATUS_MAX_SUBDEVICES) {
+        const char* rest;
+        int sub;
+        if (!parse_indexed(ent->d_name, "sub", &sub, &rest) || *rest != '\0') continue;
+
+        PcmStatusEntry entry = *base;
+        entry.subdevice = sub;
+        if (!adopt_entry(&entry, previous, previous_count)) {
+            char file[1088];
+            snprintf(file, sizeof(file), "%s/%s/status", path, ent->d_name);
+            entry.status_fd = open(file, O_RDONLY | O_CLOEXEC);
+            if (entry.status_fd < 0) continue;
+            snprintf(file, sizeof(file), "%s/%s/hw_params", path, ent->d_name);
+            entry.hw_params_fd = open(file, O_RDONLY | O_CLOEXEC);
+        }
+        sampler->entries[sampler->count++] = entry;
+    }
+    closedir(dir);
+}
+
+int pcm_status_rescan(PcmStatusSampler* sampler) {
+    PcmStatusEntry* previous = malloc(sizeof(sampler->entries));
+    int previous_count = sampler->count;
+    if (previous == NULL) return sampler->count;
+    memcpy(previous, sampler->entries, sizeof(PcmStatusEntry) * (size_t)previous_count);
+    sampler->count = 0;
+
+    // cardN/pcmDp/subS and cardN/pcmDc/subS; the card id symlinks beside
+    // the cardN directories are skipped by name
+    DIR* root = opendir(sampler->root);
+    struct dirent* card_ent;
+    while (root != NULL && (card_ent = readdir(root)) != NULL) {
+        const char* rest;
+        int card;
+        if (!parse_indexed(card_ent->d_name, "card", &card, &rest) || *rest != '\0') continue;
+
+        char card_path[528];
+        snprintf(card_path, sizeof(card_path), "%s/%s", sampler->root, card_ent->d_name);
+        DIR* card_dir = opendir(card_path);
+        if (card_dir == NULL) continue;
+
+        struct dirent* pcm_ent;
+        while ((pcm_ent = readdir(card_dir)) != NULL) {
+            int dev;
+            if (!parse_indexed(pcm_ent->d_name, "pcm", &dev, &rest)) continue;
+            if ((rest[0] != 'p' && rest[0] != 'c') || rest[1] != '\0') continue;
+
+            AudioDeviceDirection direction = rest[0] == 'p' ? DEVICE_DIRECTION_PLAYBACK : DEVICE_DIRECTION_CAPTURE;
+            PcmStatusEntry base = { card, dev, 0, direction, -1, -1 };
+            char pcm_path[800];
+            snprintf(pcm_path, sizeof(pcm_path), "%s/%s", card_path, pcm_ent->d_name);
+            scan_pcm_dir(sampler, pcm_path, &base, previous, previous_count);
+        }
+        closedir(card_dir);
+    }
+    if (root != NULL) closedir(root);
+
+    // Whatever wasn't adopted belongs to a card that went away
+    for (int i = 0; i < previous_count; i++) {
+        if (previous[i].status_fd >= 0) close(previous[i].status_fd);
+        if (previous[i].hw_params_fd >= 0) close(previous[i].hw_params_fd);
+    }
+    free(previous);
+
+    qsort(sampler->entries, (size_t)sampler->count, sizeof(PcmStatusEntry), compare_entries);
+    return sampler->count;
+}
+
+PcmStatusSampler* pcm_status_open(const char* root) {
+    if (root == NULL) root = PCM_STATUS_DEFAULT_ROOT;
+    DIR* dir = opendir(root);
+    if (dir == NULL) return NULL;
+    closedir(dir);
+
+    PcmStatusSampler* sampler = calloc(1, sizeof(*sampler));
+    if (sampler == NULL) return NULL;
+    snprintf(sampler->root, sizeof(sampler->root), "%s", root);
+    pcm_status_rescan(sampler);
+    return sampler;
+}
+
+void pcm_status_close(PcmStatusSampler* sampler) {
+    if (sampler == NULL) return;
+    for (int i = 0; i < sampler->count; i++) {
+        if (sampler->entries[i].status_fd >= 0) close(sampler->entries[i].status_fd);
+        if (sampler->entries[i].hw_params_fd >= 0) close(sampler->entries[i].hw_params_fd);
+    }
+    free(sampler);
+}
+
+// procfs regenerates the text on every read from offset 0, so one pread
+// per file is a fresh snapshot without reopening. Returns the length, or
+// -1 if the file is gone (card unplugged).
+static int read_file(int fd, char* buffer) {
+    if (fd < 0) return -1;
+    ssize_t n = pread(fd, buffer, PCM_STATUS_READ_SIZE - 1, 0);
+    if (n < 0) return -1;
+    buffer[n] = '\0';
+    return (int)n;
+}
+
+// The value after "key   :" at the start of a line, or NULL
+static const char* find_field(const char* text, const char* key) {
+    size_t n = strlen(key);
+    const char* line = text;
+    while (*line) {
+        if (strncmp(line, key, n) == 0) {
+            const char* p = line + n;
+            while (*p == ' ' || *p == '\t') p++;
+            if (*p == ':') {
+                p++;
+                while (*p == ' ' || *p == '\t') p++;
+                return p;
+            }
+        }
+        const char* next = strchr(line, '\n');
+        if (next == NULL) break;
+        line = next + 1;
+    }
+    return NULL;
+}
+
+static long long field_number(const char* text, const char* key) {
+    const char* value = find_field(text, key);
+    return value ? strtoll(value, NULL, 10) : 0;
+}
+
+static void field_word(const char* text, const char* key, char* out, size_t out_size) {
+    const char* value = find_field(text, key);
+    size_t n = 0;
+    if (value) {
+        while (value[n] && value[n] != '\n' && value[n] != ' ' && n + 1 < out_size) n++;
+        memcpy(out, value, n);
+    }
+    out[n] = '\0';
+}
+
+static PcmState parse_state(const char* text) {
+    char name[32];
+    field_word(text, "state", name, sizeof(name));
+    for (int i = PCM_STATE_OPEN; i < PCM_STATE_UNKNOWN; i++) {
+        if (strcmp(name, state_names[i]) == 0) return (PcmState)i;
+    }
+    return PCM_STATE_UNKNOWN;
+}
+
+int pcm_status_sample(PcmStatusSampler* sampler, PcmStreamStatus* statuses, int max_statuses) {
+    char text[PCM_STATUS_READ_SIZE];
+    int n = 0;
+
+    for (int i = 0; i < sampler->count && n < max_statuses; i++) {
+        const PcmStatusEntry* e = &sampler->entries[i];
+        PcmStreamStatus* s = &statuses[n++];
+        memset(s, 0, sizeof(*s));
+        s->card = e->card;
+        s->device = e->device;
+        s->subdevice = e->subdevice;
+        s->direction = e->direction;
+        snprintf(s->id, sizeof(s->id), "hw:%d,%d", e->card, e->device);
+
+        // A closed substream reads "closed"; the kernel only prints the
+        // state line once something has it open
+        if (read_file(e->status_fd, text) < 0) {
+            s->state = PCM_STATE_DISCONNECTED;
+            continue;
+        }
+        if (strncmp(text, "closed", 6) == 0) {
+            s->state = PCM_STATE_CLOSED;
+            continue;
+        }
+        s->state = parse_state(text);
+        s->owner_pid = (int)field_number(text, "owner_pid");
+        s->hw_ptr = field_number(text, "hw_ptr");
+        s->appl_ptr = field_number(text, "appl_ptr");
+        s->delay = (long)field_number(text, "delay");
+        s->avail = (long)field_number(text, "avail");
+
+        // hw_params reads "no setup" until the client configures it
+        if (read_file(e->hw_params_fd, text) <= 0 || find_field(text, "access") == NULL) continue;
+        field_word(text, "access", s->access, sizeof(s->access));
+        field_word(text, "format", s->format, sizeof(s->format));
+        s->channels = (int)field_number(text, "channels");
+        s->rate = (int)field_number(text, "rate");
+        s->period_size = (long)field_number(text, "period_size");
+        s->buffer_size = (long)field_number(text, "buffer_size");
+    }
+    return n;
+}
+
+#else
+
+// No procfs: nothing to sample
+
+PcmStatusSampler* pcm_status_open(const char* root) {
+    (void)root;
+    return NULL;
+}
+
+int pcm_status_rescan(PcmStatusSampler* sampler) {
+    (void)sampler;
+    return 0;
+}
+
+int pcm_status_sample(PcmStatusSampler* sampler, PcmStreamStatus* statuses, int max_statuses) {
+    (void)sampler;
+    (void)statuses;
+    (void)max_statuses;
+    return 0;
+}
+
+void pcm_status_close(PcmStatusSampler* sampler) {
+    (void)sampler;
+}
+
+#endif
@@ -0,0 +1,75 @@
+// pcm_status.h - Per-substream PCM status from /proc/asound, without opening any PCM
+#ifndef PCM_STATUS_H
+#define PCM_STATUS_H
+
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PCM_STATUS_MAX_SUBDEVICES 256
+#define PCM_STATUS_DEFAULT_ROOT "/proc/asound"
+
+typedef enum {
+    PCM_STATE_CLOSED,
+    PCM_STATE_OPEN,
+    PCM_STATE_SETUP,
+    PCM_STATE_PREPARED,
+    PCM_STATE_RUNNING,
+    PCM_STATE_XRUN,
+    PCM_STATE_DRAINING,
+    PCM_STATE_PAUSED,
+    PCM_STATE_SUSPENDED,
+    PCM_STATE_DISCONNECTED,
+    PCM_STATE_UNKNOWN
+} PcmState;
+
+typedef struct {
+    int card;
+    int device;
+    int subdevice;
+    AudioDeviceDirection direction;
+    char id[32];                    // hw:C,D, as in AudioDevice.id
+    PcmState state;
+    int owner_pid;                  // 0 when closed or not reported by the kernel
+    // From hw_params, once the client has configured the stream
+    char access[32];
+    char format[32];
+    int channels;
+    int rate;
+    long period_size;
+    long buffer_size;
+    // From status while open
+    long long hw_ptr;
+    long long appl_ptr;
+    long delay;
+    long avail;
+} PcmStreamStatus;
+
+typedef struct PcmStatusSampler PcmStatusSampler;
+
+// Find every substream's status and hw_params file under root (NULL for
+// /proc/asound, or a fixture tree laid out the same way) and keep them
+// open. Returns NULL if root can't be read.
+PcmStatusSampler* pcm_status_open(const char* root);
+
+// Pick up substreams of cards that came or went. Files still present
+// keep their descriptors. Returns the number of substreams.
+int pcm_status_rescan(PcmStatusSampler* sampler);
+
+// Re-read every substream. Returns the number of entries filled.
+int pcm_status_sample(PcmStatusSampler* sampler, PcmStreamStatus* statuses, int max_statuses);
+
+void pcm_status_close(PcmStatusSampler* sampler);
+
+const char* pcm_state_to_string(PcmState state);
+
+// Set is_running on each device with a running or draining substream
+void pcm_status_mark_running(const PcmStreamStatus* statuses, int count, AudioDevice* devices, int device_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PCM_STATUS_H
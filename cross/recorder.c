@@ -0,0 +1,460 @@
+// recorder.c - Record what an output device plays, from its loopback or monitor capture PCM
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "recorder.h"
+
+void recorder_default_config(RecorderConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->sample_rate = 48000;
+    config->channels = 2;
+    config->period_frames = 480;
+    config->ring_ms = 4000;
+    config->io_interval_ms = 250;
+    snprintf(config->path_prefix, sizeof(config->path_prefix), "recording");
+}
+
+static bool contains_ignore_case(const char* haystack, const char* needle) {
+    size_t n = strlen(needle);
+    for (; *haystack; haystack++) {
+        size_t i = 0;
+        while (i < n && tolower((unsigned char)haystack[i]) == needle[i]) i++;
+        if (i == n) return true;
+    }
+    return false;
+}
+
+int recorder_monitor_pcm(const AudioDevice* output, const AudioDevice* devices, int count,
+                         char* pcm, size_t pcm_size) {
+    static const char* monitor_names[] = { "loopback", "monitor", "stereo mix", "what u hear" };
+    int card, dev;
+
+    if (sscanf(output->id, "hw:%d,%d", &card, &dev) != 2) return -1;
+
+    // snd-aloop: what is played into one device of a pair is captured
+    // from the other, subdevice for subdevice
+    if (strncmp(output->name, "Loopback", 8) == 0 && (dev == 0 || dev == 1)) {
+        snprintf(pcm, pcm_size, "hw:%d,%d", card, 1 - dev);
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int capture_card;
+        if (devices[i].direction != DEVICE_DIRECTION_CAPTURE) continue;
+        if (sscanf(devices[i].id, "hw:%d", &capture_card) != 1 || capture_card != card) continue;
+        for (size_t n = 0; n < sizeof(monitor_names) / sizeof(monitor_names[0]); n++) {
+            if (contains_ignore_case(devices[i].name, monitor_names[n])) {
+                snprintf(pcm, pcm_size, "%s", devices[i].id);
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+#if defined(__linux__)
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "sample_convert.h"
+#include "wav.h"
+
+// The capture thread fills a ring of period-sized slots and never waits
+// on the writer: with the ring full it still reads the period, to keep
+// the device running, and counts it dropped. The writer wakes every
+// io_interval_ms and writes each contiguous run of slots, up to the
+// whole page-aligned ring, with one call.
+#define RECORDER_RING_ALIGN 4096
+#define RECORDER_HEADER_INTERVAL_S 1        // header sizes refreshed this often, for crash safety
+
+struct Recorder {
+    RecorderConfig config;
+    char pcm_name[256];
+    snd_pcm_t* pcm;
+    SampleFormat format;
+    int sample_rate;
+    int channels;
+    long period_frames;
+    size_t frame_bytes;
+    size_t period_bytes;
+
+    unsigned char* ring;
+    uint32_t slots;                 // power of two
+    uint32_t mask;
+    long* slot_frames;              // frames in each slot; only the last slot can be short
+    uint64_t head;                  // next slot to write, advanced by the writer
+    uint64_t tail;                  // next slot to fill, advanced by the capture thread
+    void* discard;
+
+    pthread_t capture_thread;
+    pthread_t io_thread;
+    bool started;
+    int running;
+    int capturing;
+    int64_t max_frames;
+
+    int64_t frames_captured;
+    int64_t frames_written;
+    long periods_captured;
+    long dropped_periods;
+    int overruns;
+    int error;
+
+    // Writer thread state; current_file is also read by recorder_stats
+    WavWriter writer;
+    bool file_open;
+    int files;
+    int64_t file_frames;
+    int64_t header_frames;
+    char current_file[512];
+    pthread_mutex_t file_lock;
+};
+
+static uint32_t round_up_pow2(uint32_t v) {
+    uint32_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+static void set_error(Recorder* r, int err) {
+    int expected = 0;
+    __atomic_compare_exchange_n(&r->error, &expected, err, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+static int configure_capture(Recorder* r) {
+    snd_pcm_hw_params_t* hw;
+    unsigned int rate = (unsigned int)r->config.sample_rate;
+    unsigned int channels = (unsigned int)r->config.channels;
+    snd_pcm_uframes_t period = (snd_pcm_uframes_t)r->config.period_frames;
+    snd_pcm_uframes_t buffer = period * 8;
+    int err;
+
+    snd_pcm_hw_params_alloca(&hw);
+    if ((err = snd_pcm_hw_params_any(r->pcm, hw)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_access(r->pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) return err;
+
+    // Samples go to disk as captured, so only formats WAV can hold
+    r->format = SAMPLE_FORMAT_UNKNOWN;
+    for (int i = 0; i < SAMPLE_FORMAT_PREFERENCE_COUNT; i++) {
+        if (sample_format_preference[i] == SAMPLE_FORMAT_S24) continue;
+        snd_pcm_format_t candidate = (snd_pcm_format_t)sample_format_to_alsa(sample_format_preference[i]);
+        if (snd_pcm_hw_params_test_format(r->pcm, hw, candidate) == 0) {
+            r->format = sample_format_preference[i];
+            break;
+        }
+    }
+    if (r->format == SAMPLE_FORMAT_UNKNOWN) return -EINVAL;
+    if ((err = snd_pcm_hw_params_set_format(r->pcm, hw, (snd_pcm_format_t)sample_format_to_alsa(r->format))) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_channels_near(r->pcm, hw, &channels)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_rate_near(r->pcm, hw, &rate, NULL)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_period_size_near(r->pcm, hw, &period, NULL)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(r->pcm, hw, &buffer)) < 0) return err;
+    if ((err = snd_pcm_hw_params(r->pcm, hw)) < 0) return err;
+    snd_pcm_hw_params_get_period_size(hw, &period, NULL);
+
+    r->sample_rate = (int)rate;
+    r->channels = (int)channels;
+    r->period_frames = (long)period;
+    r->frame_bytes = (size_t)channels * sample_format_bytes(r->format);
+    r->period_bytes = (size_t)period * r->frame_bytes;
+    return 0;
+}
+
+Recorder* recorder_open(const char* pcm, const RecorderConfig* config, char* error, size_t error_size) {
+    Recorder* r = (Recorder*)calloc(1, sizeof(Recorder));
+    int err;
+
+    if (r == NULL) {
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    r->config = *config;
+    snprintf(r->pcm_name, sizeof(r->pcm_name), "%s", pcm);
+    pthread_mutex_init(&r->file_lock, NULL);
+
+    if ((err = snd_pcm_open(&r->pcm, pcm, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+        r->pcm = NULL;
+        snprintf(error, error_size, "%s", snd_strerror(err));
+        recorder_close(r);
+        return NULL;
+    }
+    if ((err = configure_capture(r)) < 0) {
+        snprintf(error, error_size, "%s", snd_strerror(err));
+        recorder_close(r);
+        return NULL;
+    }
+
+    uint32_t periods = (uint32_t)((int64_t)config->ring_ms * r->sample_rate / 1000 / r->period_frames);
+    r->slots = round_up_pow2(periods < 4 ? 4 : periods);
+    r->mask = r->slots - 1;
+    void* ring = NULL;
+    if (posix_memalign(&ring, RECORDER_RING_ALIGN, r->slots * r->period_bytes) != 0) ring = NULL;
+    r->ring = (unsigned char*)ring;
+    r->slot_frames = (long*)calloc(r->slots, sizeof(long));
+    r->discard = malloc(r->period_bytes);
+    if (!r->ring || !r->slot_frames || !r->discard) {
+        snprintf(error, error_size, "out of memory");
+        recorder_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+// Read count frames into dst, recovering from overruns. Returns frames
+// read; fewer than count only on an unrecoverable error.
+static long capture_period(Recorder* r, unsigned char* dst, long count) {
+    long done = 0;
+    while (done < count && __atomic_load_n(&r->running, __ATOMIC_ACQUIRE)) {
+        snd_pcm_sframes_t got = snd_pcm_readi(r->pcm, dst + done * r->frame_bytes, (snd_pcm_uframes_t)(count - done));
+        if (got > 0) {
+            done += (long)got;
+            continue;
+        }
+        if (got == -EAGAIN) continue;
+        if (got == -EPIPE || got == -ESTRPIPE) __atomic_fetch_add(&r->overruns, 1, __ATOMIC_RELAXED);
+        int err = snd_pcm_recover(r->pcm, (int)got, 1);
+        if (err < 0) {
+            set_error(r, err);
+            break;
+        }
+    }
+    return done;
+}
+
+static void* capture_thread(void* arg) {
+    Recorder* r = (Recorder*)arg;
+
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    while (__atomic_load_n(&r->running, __ATOMIC_ACQUIRE)) {
+        long count = r->period_frames;
+        if (r->max_frames > 0) {
+            int64_t left = r->max_frames - r->frames_captured;
+            if (left <= 0) break;
+            if (left < count) count = (long)left;
+        }
+
+        uint64_t tail = r->tail;
+        bool full = tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) >= r->slots;
+        unsigned char* dst = full ? (unsigned char*)r->discard : r->ring + (tail & r->mask) * r->period_bytes;
+
+        long got = capture_period(r, dst, count);
+        if (got > 0) {
+            if (full) {
+                __atomic_fetch_add(&r->dropped_periods, 1, __ATOMIC_RELAXED);
+            } else {
+                r->slot_frames[tail & r->mask] = got;
+                __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+            }
+            __atomic_fetch_add(&r->periods_captured, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&r->frames_captured, got, __ATOMIC_RELAXED);
+        }
+        if (got < count) break;
+    }
+
+    __atomic_store_n(&r->capturing, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void finish_file(Recorder* r) {
+    if (!r->file_open) return;
+    if (wav_close_write(&r->writer) != 0) set_error(r, -errno);
+    r->file_open = false;
+    if (r->config.on_file) {
+        r->config.on_file(r->current_file, r->file_frames, r->writer.data_bytes, r->config.user);
+    }
+}
+
+static bool start_file(Recorder* r) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s-%04d.%s", r->config.path_prefix, r->files + 1, r->config.w64 ? "w64" : "wav");
+    if (wav_open_write(&r->writer, path, r->format, r->sample_rate, r->channels, r->config.w64) != 0) {
+        set_error(r, -errno);
+        return false;
+    }
+    pthread_mutex_lock(&r->file_lock);
+    snprintf(r->current_file, sizeof(r->current_file), "%s", path);
+    r->files++;
+    pthread_mutex_unlock(&r->file_lock);
+    r->file_open = true;
+    r->file_frames = 0;
+    r->header_frames = 0;
+    return true;
+}
+
+// Frames the current file can still take before it has to roll
+static int64_t file_room(const Recorder* r) {
+    int64_t room = (wav_max_data_bytes(&r->writer) - r->writer.data_bytes) / (int64_t)r->frame_bytes;
+    if (r->config.max_file_bytes > 0) {
+        int64_t left = (r->config.max_file_bytes - r->writer.data_bytes) / (int64_t)r->frame_bytes;
+        if (left < room) room = left;
+    }
+    if (r->config.max_file_seconds > 0) {
+        int64_t left = (int64_t)r->config.max_file_seconds * r->sample_rate - r->file_frames;
+        if (left < room) room = left;
+    }
+    return room;
+}
+
+// Write every slot captured so far
+static void drain(Recorder* r) {
+    uint64_t head = r->head;
+    uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    while (head < tail) {
+        uint32_t index = (uint32_t)(head & r->mask);
+        if (!r->file_open || (file_room(r) < r->slot_frames[index] && r->file_frames > 0)) {
+            finish_file(r);
+            if (__atomic_load_n(&r->error, __ATOMIC_ACQUIRE) == 0) start_file(r);
+        }
+
+        // One run: contiguous in memory, within the file's room, and
+        // ending at any short slot
+        int64_t room = r->file_open ? file_room(r) : 0;
+        uint32_t n = 0;
+        int64_t frames = 0;
+        while (head + n < tail && index + n < r->slots) {
+            long slot = r->slot_frames[index + n];
+            if (n > 0 && frames + slot > room) break;
+            frames += slot;
+            n++;
+            if (slot < r->period_frames) break;
+        }
+
+        // After a write error the capture keeps its ring moving, so
+        // the failure shows up as an error rather than as dropped periods
+        if (r->file_open && __atomic_load_n(&r->error, __ATOMIC_ACQUIRE) == 0) {
+            if (wav_write(&r->writer, r->ring + (size_t)index * r->period_bytes, (size_t)frames * r->frame_bytes) != 0) {
+                set_error(r, -errno);
+            } else {
+                r->file_frames += frames;
+                __atomic_fetch_add(&r->frames_written, frames, __ATOMIC_RELAXED);
+                if (r->file_frames - r->header_frames >= (int64_t)RECORDER_HEADER_INTERVAL_S * r->sample_rate) {
+                    wav_update_header(&r->writer);
+                    r->header_frames = r->file_frames;
+                }
+            }
+        }
+
+        head += n;
+        __atomic_store_n(&r->head, head, __ATOMIC_RELEASE);
+    }
+}
+
+static void* io_thread(void* arg) {
+    Recorder* r = (Recorder*)arg;
+    struct timespec interval;
+    interval.tv_sec = r->config.io_interval_ms / 1000;
+    interval.tv_nsec = (long)(r->config.io_interval_ms % 1000) * 1000000L;
+
+    for (;;) {
+        // Checked before draining, so every slot captured before the stop
+        // is written
+        bool last = !__atomic_load_n(&r->capturing, __ATOMIC_ACQUIRE);
+        drain(r);
+        if (last) break;
+        nanosleep(&interval, NULL);
+    }
+    finish_file(r);
+    return NULL;
+}
+
+int recorder_start(Recorder* r, int64_t max_frames) {
+    int err;
+    if (r->started) return -EBUSY;
+    r->max_frames = max_frames;
+    r->running = 1;
+    r->capturing = 1;
+
+    if ((err = pthread_create(&r->io_thread, NULL, io_thread, r)) != 0) return -err;
+    if ((err = pthread_create(&r->capture_thread, NULL, capture_thread, r)) != 0) {
+        __atomic_store_n(&r->capturing, 0, __ATOMIC_RELEASE);
+        pthread_join(r->io_thread, NULL);
+        return -err;
+    }
+    r->started = true;
+    return 0;
+}
+
+bool recorder_finished(Recorder* r) {
+    return !__atomic_load_n(&r->capturing, __ATOMIC_ACQUIRE);
+}
+
+void recorder_stop(Recorder* r) {
+    if (!r->started) return;
+    __atomic_store_n(&r->running, 0, __ATOMIC_RELEASE);
+    pthread_join(r->capture_thread, NULL);
+    pthread_join(r->io_thread, NULL);
+    r->started = false;
+}
+
+void recorder_stats(Recorder* r, RecorderStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    snprintf(stats->pcm, sizeof(stats->pcm), "%s", r->pcm_name);
+    stats->sample_rate = r->sample_rate;
+    stats->channels = r->channels;
+    stats->format = snd_pcm_format_name((snd_pcm_format_t)sample_format_to_alsa(r->format));
+    stats->frames_captured = __atomic_load_n(&r->frames_captured, __ATOMIC_RELAXED);
+    stats->frames_written = __atomic_load_n(&r->frames_written, __ATOMIC_RELAXED);
+    stats->periods_captured = __atomic_load_n(&r->periods_captured, __ATOMIC_RELAXED);
+    stats->dropped_periods = __atomic_load_n(&r->dropped_periods, __ATOMIC_RELAXED);
+    stats->overruns = __atomic_load_n(&r->overruns, __ATOMIC_RELAXED);
+    stats->error = __atomic_load_n(&r->error, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&r->file_lock);
+    stats->files = r->files;
+    snprintf(stats->current_file, sizeof(stats->current_file), "%s", r->current_file);
+    pthread_mutex_unlock(&r->file_lock);
+}
+
+void recorder_close(Recorder* r) {
+    if (r == NULL) return;
+    recorder_stop(r);
+    if (r->pcm) snd_pcm_close(r->pcm);
+    free(r->ring);
+    free(r->slot_frames);
+    free(r->discard);
+    pthread_mutex_destroy(&r->file_lock);
+    free(r);
+}
+
+#else
+
+// Loopback capture needs ALSA
+
+Recorder* recorder_open(const char* pcm, const RecorderConfig* config, char* error, size_t error_size) {
+    (void)pcm;
+    (void)config;
+    snprintf(error, error_size, "recording is only supported on Linux");
+    return NULL;
+}
+
+int recorder_start(Recorder* recorder, int64_t max_frames) {
+    (void)recorder;
+    (void)max_frames;
+    return -1;
+}
+
+bool recorder_finished(Recorder* recorder) {
+    (void)recorder;
+    return true;
+}
+
+void recorder_stop(Recorder* recorder) {
+    (void)recorder;
+}
+
+void recorder_stats(Recorder* recorder, RecorderStats* stats) {
+    (void)recorder;
+    memset(stats, 0, sizeof(*stats));
+}
+
+void recorder_close(Recorder* recorder) {
+    (void)recorder;
+}
+
+#endif
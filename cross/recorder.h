@@ -0,0 +1,77 @@
+// recorder.h - Record what an output device plays, from its loopback or monitor capture PCM
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_devices.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int sample_rate;                // requested; the device may pick its nearest
+    int channels;
+    int period_frames;
+    int ring_ms;                    // capture kept in memory while the disk catches up
+    int io_interval_ms;             // how long the writer lets audio collect between writes
+    bool w64;                       // Wave64 instead of WAV
+    int64_t max_file_bytes;         // roll to a new file past this much audio, 0 for no limit
+    int max_file_seconds;           // and past this long, 0 for no limit
+    char path_prefix[256];          // files are <prefix>-0001.wav, -0002.wav, ...
+    // Called on the writer thread as each file is finished
+    void (*on_file)(const char* path, int64_t frames, int64_t bytes, void* user);
+    void* user;
+} RecorderConfig;
+
+typedef struct {
+    char pcm[256];
+    int sample_rate;                // as opened
+    int channels;
+    const char* format;             // device sample format, written to disk unchanged
+    int64_t frames_captured;
+    int64_t frames_written;
+    long periods_captured;
+    long dropped_periods;           // read while the ring was full and discarded
+    int overruns;                   // device overruns recovered from
+    int files;                      // files started so far
+    char current_file[512];
+    int error;                      // first capture or write error, 0 if none
+} RecorderStats;
+
+typedef struct Recorder Recorder;
+
+void recorder_default_config(RecorderConfig* config);
+
+// Find the capture PCM that carries what plays on an output device:
+// the other half of an snd-aloop pair (hw:C,0 <-> hw:C,1), or a capture
+// endpoint on the same card named like a loopback or monitor. devices
+// must list both directions. Returns 0, or -1 if the device has none.
+int recorder_monitor_pcm(const AudioDevice* output, const AudioDevice* devices, int count,
+                         char* pcm, size_t pcm_size);
+
+// Open and configure a capture PCM (any PCM, e.g. an ALSA file plugin
+// fixture). Returns NULL with error set on failure.
+Recorder* recorder_open(const char* pcm, const RecorderConfig* config, char* error, size_t error_size);
+
+// Start the capture and writer threads. max_frames stops the capture
+// after that many frames; 0 records until recorder_stop.
+int recorder_start(Recorder* recorder, int64_t max_frames);
+
+// True once a max_frames limit was reached or capture failed
+bool recorder_finished(Recorder* recorder);
+
+// Stop capturing, write out what the ring holds and finish the file
+void recorder_stop(Recorder* recorder);
+
+void recorder_stats(Recorder* recorder, RecorderStats* stats);
+
+void recorder_close(Recorder* recorder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RECORDER_H
@@ -0,0 +1,1032 @@
+// sample_convert.c - Sample format, channel layout and sample rate conversion
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "sample_convert.h"
+
+// The scalar kernels are the reference the vector ones must match bit for
+// bit, so a multiply and an add must never be fused into one rounding
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONVERT_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#elif defined(__aarch64__)
+#define CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// ALSA's *_LE formats match the host byte order on every platform this
+// builds for, so samples are stored natively
+const SampleFormat sample_format_preference[SAMPLE_FORMAT_PREFERENCE_COUNT] = {
+    SAMPLE_FORMAT_FLOAT,
+    SAMPLE_FORMAT_S32,
+    SAMPLE_FORMAT_S24,
+    SAMPLE_FORMAT_S24_3,
+    SAMPLE_FORMAT_S16
+};
+
+int sample_format_bytes(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_FORMAT_S16: return 2;
+        case SAMPLE_FORMAT_S24_3: return 3;
+        case SAMPLE_FORMAT_S24:
+        case SAMPLE_FORMAT_S32:
+        case SAMPLE_FORMAT_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+const char* sample_isa_to_string(SampleIsa isa) {
+    switch (isa) {
+        case SAMPLE_ISA_SCALAR: return "scalar";
+        case SAMPLE_ISA_SSE2: return "sse2";
+        case SAMPLE_ISA_AVX2: return "avx2";
+        case SAMPLE_ISA_NEON: return "neon";
+        default: return "unknown";
+    }
+}
+
+// One implementation of every hot loop per instruction set. Vector
+// kernels handle whole vectors and hand the tail to the scalar kernel, so
+// the scalar set is also the reference the others must match.
+typedef struct {
+    SampleIsa isa;
+    void (*from_float_s16)(const float* src, int16_t* dst, long n);
+    void (*from_float_s24)(const float* src, int32_t* dst, long n);
+    void (*from_float_s32)(const float* src, int32_t* dst, long n);
+    void (*from_float_float)(const float* src, float* dst, long n);
+    void (*to_float_s16)(const int16_t* src, float* dst, long n);
+    void (*to_float_s24)(const int32_t* src, float* dst, long n);
+    void (*to_float_s32)(const int32_t* src, float* dst, long n);
+    void (*deinterleave2)(const float* src, float* left, float* right, long frames);
+    void (*interleave2)(const float* left, const float* right, float* dst, long frames);
+    // Dot products of x with both a and b; n is a multiple of 8
+    void (*dot2)(const float* x, const float* a, const float* b, int n, float* da, float* db);
+    void (*peak_energy)(const float* x, long n, float* peak, float* energy);
+    void (*butterfly)(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, long n);
+} SampleKernels;
+
+static const float S16_SCALE = 32767.0f;
+static const float S24_SCALE = 8388607.0f;
+static const double S32_SCALE = 2147483647.0;
+static const float S16_INV = 1.0f / 32768.0f;
+static const float S24_INV = 1.0f / 8388608.0f;
+static const float S32_INV = 1.0f / 2147483648.0f;
+
+// Scalar reference
+
+static inline float clamp_unit(float x) {
+    return x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static void scalar_from_float_s16(const float* src, int16_t* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        dst[i] = (int16_t)(clamp_unit(src[i]) * S16_SCALE);
+    }
+}
+
+static void scalar_from_float_s24(const float* src, int32_t* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        dst[i] = (int32_t)(clamp_unit(src[i]) * S24_SCALE);
+    }
+}
+
+static void scalar_from_float_s32(const float* src, int32_t* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        dst[i] = (int32_t)((double)clamp_unit(src[i]) * S32_SCALE);
+    }
+}
+
+static void scalar_from_float_float(const float* src, float* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        dst[i] = clamp_unit(src[i]);
+    }
+}
+
+static void scalar_to_float_s16(const int16_t* src, float* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        dst[i] = (float)src[i] * S16_INV;
+    }
+}
+
+// The container's top byte is padding: sign-extend from bit 23
+static void scalar_to_float_s24(const int32_t* src, float* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        dst[i] = (float)((int32_t)((uint32_t)src[i] << 8) >> 8) * S24_INV;
+    }
+}
+
+static void scalar_to_float_s32(const int32_t* src, float* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        dst[i] = (float)src[i] * S32_INV;
+    }
+}
+
+static void scalar_deinterleave2(const float* src, float* left, float* right, long frames) {
+    for (long i = 0; i < frames; i++) {
+        left[i] = src[i * 2];
+        right[i] = src[i * 2 + 1];
+    }
+}
+
+static void scalar_interleave2(const float* left, const float* right, float* dst, long frames) {
+    for (long i = 0; i < frames; i++) {
+        dst[i * 2] = left[i];
+        dst[i * 2 + 1] = right[i];
+    }
+}
+
+static void scalar_dot2(const float* x, const float* a, const float* b, int n, float* da, float* db) {
+    float sa = 0.0f, sb = 0.0f;
+    for (int i = 0; i < n; i++) {
+        sa += x[i] * a[i];
+        sb += x[i] * b[i];
+    }
+    *da = sa;
+    *db = sb;
+}
+
+// The sum of squares has one order for every kernel set: sample i adds to
+// lane i % ENERGY_LANES, and the lanes fold in halves (lane k takes lane
+// k + 8, then k + 4, ...), which is how the vector registers reduce
+#define ENERGY_LANES 16
+
+static void finish_peak_energy(float p, float* lanes, const float* x, long n, float* peak, float* energy) {
+    for (long i = 0; i < n; i++) {
+        float a = fabsf(x[i]);
+        if (a > p) p = a;
+        lanes[i] += x[i] * x[i];
+    }
+    for (int width = ENERGY_LANES / 2; width > 0; width /= 2) {
+        for (int k = 0; k < width; k++) lanes[k] += lanes[k + width];
+    }
+    *peak = p;
+    *energy = lanes[0];
+}
+
+static void scalar_peak_energy(const float* x, long n, float* peak, float* energy) {
+    float p = 0.0f, lanes[ENERGY_LANES] = { 0.0f };
+    long i = 0;
+    for (; i + ENERGY_LANES <= n; i += ENERGY_LANES) {
+        for (int k = 0; k < ENERGY_LANES; k++) {
+            float a = fabsf(x[i + k]);
+            if (a > p) p = a;
+            lanes[k] += x[i + k] * x[i + k];
+        }
+    }
+    finish_peak_energy(p, lanes, x + i, n - i, peak, energy);
+}
+
+static void scalar_butterfly(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, long n) {
+    for (long i = 0; i < n; i++) {
+        float tr = br[i] * wr[i] - bi[i] * wi[i];
+        float ti = br[i] * wi[i] + bi[i] * wr[i];
+        br[i] = ar[i] - tr;
+        bi[i] = ai[i] - ti;
+        ar[i] += tr;
+        ai[i] += ti;
+    }
+}
+
+static const SampleKernels scalar_kernels = {
+    SAMPLE_ISA_SCALAR,
+    scalar_from_float_s16, scalar_from_float_s24, scalar_from_float_s32, scalar_from_float_float,
+    scalar_to_float_s16, scalar_to_float_s24, scalar_to_float_s32,
+    scalar_deinterleave2, scalar_interleave2,
+    scalar_dot2,
+    scalar_peak_energy, scalar_butterfly
+};
+
+#if CONVERT_X86
+
+// SSE2, four samples per vector. Truncating conversions match the C casts
+// in the reference; S32 goes through double for the same reason.
+
+TARGET_SSE2 static inline __m128 sse2_clamp(__m128 x) {
+    return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+TARGET_SSE2 static void sse2_from_float_s16(const float* src, int16_t* dst, long n) {
+    __m128 scale = _mm_set1_ps(S16_SCALE);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = _mm_cvttps_epi32(_mm_mul_ps(sse2_clamp(_mm_loadu_ps(src + i)), scale));
+        __m128i hi = _mm_cvttps_epi32(_mm_mul_ps(sse2_clamp(_mm_loadu_ps(src + i + 4)), scale));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    scalar_from_float_s16(src + i, dst + i, n - i);
+}
+
+TARGET_SSE2 static void sse2_from_float_s24(const float* src, int32_t* dst, long n) {
+    __m128 scale = _mm_set1_ps(S24_SCALE);
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_cvttps_epi32(_mm_mul_ps(sse2_clamp(_mm_loadu_ps(src + i)), scale));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    scalar_from_float_s24(src + i, dst + i, n - i);
+}
+
+TARGET_SSE2 static void sse2_from_float_s32(const float* src, int32_t* dst, long n) {
+    __m128d scale = _mm_set1_pd(S32_SCALE);
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = sse2_clamp(_mm_loadu_ps(src + i));
+        __m128i lo = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(x), scale));
+        __m128i hi = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), scale));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi64(lo, hi));
+    }
+    scalar_from_float_s32(src + i, dst + i, n - i);
+}
+
+TARGET_SSE2 static void sse2_from_float_float(const float* src, float* dst, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(dst + i, sse2_clamp(_mm_loadu_ps(src + i)));
+    }
+    scalar_from_float_float(src + i, dst + i, n - i);
+}
+
+TARGET_SSE2 static void sse2_to_float_s16(const int16_t* src, float* dst, long n) {
+    __m128 scale = _mm_set1_ps(S16_INV);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    scalar_to_float_s16(src + i, dst + i, n - i);
+}
+
+TARGET_SSE2 static void sse2_to_float_s24(const int32_t* src, float* dst, long n) {
+    __m128 scale = _mm_set1_ps(S24_INV);
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        v = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    scalar_to_float_s24(src + i, dst + i, n - i);
+}
+
+TARGET_SSE2 static void sse2_to_float_s32(const int32_t* src, float* dst, long n) {
+    __m128 scale = _mm_set1_ps(S32_INV);
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    scalar_to_float_s32(src + i, dst + i, n - i);
+}
+
+TARGET_SSE2 static void sse2_deinterleave2(const float* src, float* left, float* right, long frames) {
+    long i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 a = _mm_loadu_ps(src + i * 2);
+        __m128 b = _mm_loadu_ps(src + i * 2 + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    scalar_deinterleave2(src + i * 2, left + i, right + i, frames - i);
+}
+
+TARGET_SSE2 static void sse2_interleave2(const float* left, const float* right, float* dst, long frames) {
+    long i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+    }
+    scalar_interleave2(left + i, right + i, dst + i * 2, frames - i);
+}
+
+TARGET_SSE2 static float sse2_hsum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+TARGET_SSE2 static void sse2_dot2(const float* x, const float* a, const float* b, int n, float* da, float* db) {
+    __m128 sa0 = _mm_setzero_ps(), sa1 = _mm_setzero_ps();
+    __m128 sb0 = _mm_setzero_ps(), sb1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        __m128 x0 = _mm_loadu_ps(x + i);
+        __m128 x1 = _mm_loadu_ps(x + i + 4);
+        sa0 = _mm_add_ps(sa0, _mm_mul_ps(x0, _mm_loadu_ps(a + i)));
+        sa1 = _mm_add_ps(sa1, _mm_mul_ps(x1, _mm_loadu_ps(a + i + 4)));
+        sb0 = _mm_add_ps(sb0, _mm_mul_ps(x0, _mm_loadu_ps(b + i)));
+        sb1 = _mm_add_ps(sb1, _mm_mul_ps(x1, _mm_loadu_ps(b + i + 4)));
+    }
+    *da = sse2_hsum(_mm_add_ps(sa0, sa1));
+    *db = sse2_hsum(_mm_add_ps(sb0, sb1));
+}
+
+TARGET_SSE2 static float sse2_hmax(__m128 v) {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+TARGET_SSE2 static void sse2_peak_energy(const float* x, long n, float* peak, float* energy) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 p = _mm_setzero_ps(), e[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+    long i = 0;
+    for (; i + ENERGY_LANES <= n; i += ENERGY_LANES) {
+        for (int k = 0; k < 4; k++) {
+            __m128 v = _mm_loadu_ps(x + i + k * 4);
+            p = _mm_max_ps(p, _mm_and_ps(v, abs_mask));
+            e[k] = _mm_add_ps(e[k], _mm_mul_ps(v, v));
+        }
+    }
+    float lanes[ENERGY_LANES];
+    for (int k = 0; k < 4; k++) _mm_storeu_ps(lanes + k * 4, e[k]);
+    finish_peak_energy(sse2_hmax(p), lanes, x + i, n - i, peak, energy);
+}
+
+TARGET_SSE2 static void sse2_butterfly(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 xr = _mm_loadu_ps(br + i), xi = _mm_loadu_ps(bi + i);
+        __m128 cr = _mm_loadu_ps(wr + i), ci = _mm_loadu_ps(wi + i);
+        __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+        __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+        __m128 yr = _mm_loadu_ps(ar + i), yi = _mm_loadu_ps(ai + i);
+        _mm_storeu_ps(br + i, _mm_sub_ps(yr, tr));
+        _mm_storeu_ps(bi + i, _mm_sub_ps(yi, ti));
+        _mm_storeu_ps(ar + i, _mm_add_ps(yr, tr));
+        _mm_storeu_ps(ai + i, _mm_add_ps(yi, ti));
+    }
+    scalar_butterfly(ar + i, ai + i, br + i, bi + i, wr + i, wi + i, n - i);
+}
+
+static const SampleKernels sse2_kernels = {
+    SAMPLE_ISA_SSE2,
+    sse2_from_float_s16, sse2_from_float_s24, sse2_from_float_s32, sse2_from_float_float,
+    sse2_to_float_s16, sse2_to_float_s24, sse2_to_float_s32,
+    sse2_deinterleave2, sse2_interleave2,
+    sse2_dot2,
+    sse2_peak_energy, sse2_butterfly
+};
+
+// AVX2, eight samples per vector
+
+TARGET_AVX2 static inline __m256 avx2_clamp(__m256 x) {
+    return _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+}
+
+TARGET_AVX2 static void avx2_from_float_s16(const float* src, int16_t* dst, long n) {
+    __m256 scale = _mm256_set1_ps(S16_SCALE);
+    long i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = _mm256_cvttps_epi32(_mm256_mul_ps(avx2_clamp(_mm256_loadu_ps(src + i)), scale));
+        __m256i hi = _mm256_cvttps_epi32(_mm256_mul_ps(avx2_clamp(_mm256_loadu_ps(src + i + 8)), scale));
+        // The pack works per 128-bit lane; put the quarters back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+    scalar_from_float_s16(src + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static void avx2_from_float_s24(const float* src, int32_t* dst, long n) {
+    __m256 scale = _mm256_set1_ps(S24_SCALE);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvttps_epi32(_mm256_mul_ps(avx2_clamp(_mm256_loadu_ps(src + i)), scale));
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    scalar_from_float_s24(src + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static void avx2_from_float_s32(const float* src, int32_t* dst, long n) {
+    __m256d scale = _mm256_set1_pd(S32_SCALE);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = avx2_clamp(_mm256_loadu_ps(src + i));
+        __m128i lo = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(x)), scale));
+        __m128i hi = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), scale));
+        _mm_storeu_si128((__m128i*)(dst + i), lo);
+        _mm_storeu_si128((__m128i*)(dst + i + 4), hi);
+    }
+    scalar_from_float_s32(src + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static void avx2_from_float_float(const float* src, float* dst, long n) {
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, avx2_clamp(_mm256_loadu_ps(src + i)));
+    }
+    scalar_from_float_float(src + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static void avx2_to_float_s16(const int16_t* src, float* dst, long n) {
+    __m256 scale = _mm256_set1_ps(S16_INV);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    scalar_to_float_s16(src + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static void avx2_to_float_s24(const int32_t* src, float* dst, long n) {
+    __m256 scale = _mm256_set1_ps(S24_INV);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        v = _mm256_srai_epi32(_mm256_slli_epi32(v, 8), 8);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    scalar_to_float_s24(src + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static void avx2_to_float_s32(const int32_t* src, float* dst, long n) {
+    __m256 scale = _mm256_set1_ps(S32_INV);
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    scalar_to_float_s32(src + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static void avx2_deinterleave2(const float* src, float* left, float* right, long frames) {
+    long i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 a = _mm256_loadu_ps(src + i * 2);
+        __m256 b = _mm256_loadu_ps(src + i * 2 + 8);
+        // Shuffles stay within 128-bit lanes; a 64-bit permute restores order
+        __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        l = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0)));
+        r = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(left + i, l);
+        _mm256_storeu_ps(right + i, r);
+    }
+    scalar_deinterleave2(src + i * 2, left + i, right + i, frames - i);
+}
+
+TARGET_AVX2 static void avx2_interleave2(const float* left, const float* right, float* dst, long frames) {
+    long i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+        __m256 lo = _mm256_unpacklo_ps(l, r);
+        __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dst + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dst + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    scalar_interleave2(left + i, right + i, dst + i * 2, frames - i);
+}
+
+TARGET_AVX2 static float avx2_hsum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+TARGET_AVX2 static void avx2_dot2(const float* x, const float* a, const float* b, int n, float* da, float* db) {
+    __m256 sa = _mm256_setzero_ps();
+    __m256 sb = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        __m256 xv = _mm256_loadu_ps(x + i);
+        sa = _mm256_fmadd_ps(xv, _mm256_loadu_ps(a + i), sa);
+        sb = _mm256_fmadd_ps(xv, _mm256_loadu_ps(b + i), sb);
+    }
+    *da = avx2_hsum(sa);
+    *db = avx2_hsum(sb);
+}
+
+TARGET_AVX2 static void avx2_peak_energy(const float* x, long n, float* peak, float* energy) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 p = _mm256_setzero_ps(), e0 = _mm256_setzero_ps(), e1 = _mm256_setzero_ps();
+    long i = 0;
+    for (; i + ENERGY_LANES <= n; i += ENERGY_LANES) {
+        __m256 x0 = _mm256_loadu_ps(x + i);
+        __m256 x1 = _mm256_loadu_ps(x + i + 8);
+        p = _mm256_max_ps(p, _mm256_max_ps(_mm256_and_ps(x0, abs_mask), _mm256_and_ps(x1, abs_mask)));
+        // Not FMA: the scalar reference rounds the square before adding
+        e0 = _mm256_add_ps(e0, _mm256_mul_ps(x0, x0));
+        e1 = _mm256_add_ps(e1, _mm256_mul_ps(x1, x1));
+    }
+    __m128 p4 = _mm_max_ps(_mm256_castps256_ps128(p), _mm256_extractf128_ps(p, 1));
+    p4 = _mm_max_ps(p4, _mm_movehl_ps(p4, p4));
+    p4 = _mm_max_ss(p4, _mm_shuffle_ps(p4, p4, 1));
+    float lanes[ENERGY_LANES];
+    _mm256_storeu_ps(lanes, e0);
+    _mm256_storeu_ps(lanes + 8, e1);
+    finish_peak_energy(_mm_cvtss_f32(p4), lanes, x + i, n - i, peak, energy);
+}
+
+// Plain multiplies rather than FMA keep the FFT bit-exact with the
+// reference
+TARGET_AVX2 static void avx2_butterfly(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, long n) {
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 xr = _mm256_loadu_ps(br + i), xi = _mm256_loadu_ps(bi + i);
+        __m256 cr = _mm256_loadu_ps(wr + i), ci = _mm256_loadu_ps(wi + i);
+        __m256 tr = _mm256_sub_ps(_mm256_mul_ps(xr, cr), _mm256_mul_ps(xi, ci));
+        __m256 ti = _mm256_add_ps(_mm256_mul_ps(xr, ci), _mm256_mul_ps(xi, cr));
+        __m256 yr = _mm256_loadu_ps(ar + i), yi = _mm256_loadu_ps(ai + i);
+        _mm256_storeu_ps(br + i, _mm256_sub_ps(yr, tr));
+        _mm256_storeu_ps(bi + i, _mm256_sub_ps(yi, ti));
+        _mm256_storeu_ps(ar + i, _mm256_add_ps(yr, tr));
+        _mm256_storeu_ps(ai + i, _mm256_add_ps(yi, ti));
+    }
+    scalar_butterfly(ar + i, ai + i, br + i, bi + i, wr + i, wi + i, n - i);
+}
+
+static const SampleKernels avx2_kernels = {
+    SAMPLE_ISA_AVX2,
+    avx2_from_float_s16, avx2_from_float_s24, avx2_from_float_s32, avx2_from_float_float,
+    avx2_to_float_s16, avx2_to_float_s24, avx2_to_float_s32,
+    avx2_deinterleave2, avx2_interleave2,
+    avx2_dot2,
+    avx2_peak_energy, avx2_butterfly
+};
+
+#endif // CONVERT_X86
+
+#if CONVERT_NEON
+
+// NEON, four samples per vector. vcvtq_s32_f32 truncates like the C cast.
+
+static inline float32x4_t neon_clamp(float32x4_t x) {
+    return vminq_f32(vmaxq_f32(x, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+}
+
+static void neon_from_float_s16(const float* src, int16_t* dst, long n) {
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int32x4_t lo = vcvtq_s32_f32(vmulq_n_f32(neon_clamp(vld1q_f32(src + i)), S16_SCALE));
+        int32x4_t hi = vcvtq_s32_f32(vmulq_n_f32(neon_clamp(vld1q_f32(src + i + 4)), S16_SCALE));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    scalar_from_float_s16(src + i, dst + i, n - i);
+}
+
+static void neon_from_float_s24(const float* src, int32_t* dst, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_s32(dst + i, vcvtq_s32_f32(vmulq_n_f32(neon_clamp(vld1q_f32(src + i)), S24_SCALE)));
+    }
+    scalar_from_float_s24(src + i, dst + i, n - i);
+}
+
+static void neon_from_float_s32(const float* src, int32_t* dst, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = neon_clamp(vld1q_f32(src + i));
+        float64x2_t lo = vmulq_n_f64(vcvt_f64_f32(vget_low_f32(x)), S32_SCALE);
+        float64x2_t hi = vmulq_n_f64(vcvt_high_f64_f32(x), S32_SCALE);
+        vst1q_s32(dst + i, vcombine_s32(vmovn_s64(vcvtq_s64_f64(lo)), vmovn_s64(vcvtq_s64_f64(hi))));
+    }
+    scalar_from_float_s32(src + i, dst + i, n - i);
+}
+
+static void neon_from_float_float(const float* src, float* dst, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, neon_clamp(vld1q_f32(src + i)));
+    }
+    scalar_from_float_float(src + i, dst + i, n - i);
+}
+
+static void neon_to_float_s16(const int16_t* src, float* dst, long n) {
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), S16_INV));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), S16_INV));
+    }
+    scalar_to_float_s16(src + i, dst + i, n - i);
+}
+
+static void neon_to_float_s24(const int32_t* src, float* dst, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t v = vshrq_n_s32(vshlq_n_s32(vld1q_s32(src + i), 8), 8);
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(v), S24_INV));
+    }
+    scalar_to_float_s24(src + i, dst + i, n - i);
+}
+
+static void neon_to_float_s32(const int32_t* src, float* dst, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), S32_INV));
+    }
+    scalar_to_float_s32(src + i, dst + i, n - i);
+}
+
+static void neon_deinterleave2(const float* src, float* left, float* right, long frames) {
+    long i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t v = vld2q_f32(src + i * 2);
+        vst1q_f32(left + i, v.val[0]);
+        vst1q_f32(right + i, v.val[1]);
+    }
+    scalar_deinterleave2(src + i * 2, left + i, right + i, frames - i);
+}
+
+static void neon_interleave2(const float* left, const float* right, float* dst, long frames) {
+    long i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t v = { { vld1q_f32(left + i), vld1q_f32(right + i) } };
+        vst2q_f32(dst + i * 2, v);
+    }
+    scalar_interleave2(left + i, right + i, dst + i * 2, frames - i);
+}
+
+static void neon_dot2(const float* x, const float* a, const float* b, int n, float* da, float* db) {
+    float32x4_t sa0 = vdupq_n_f32(0.0f), sa1 = vdupq_n_f32(0.0f);
+    float32x4_t sb0 = vdupq_n_f32(0.0f), sb1 = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 8) {
+        float32x4_t x0 = vld1q_f32(x + i);
+        float32x4_t x1 = vld1q_f32(x + i + 4);
+        sa0 = vfmaq_f32(sa0, x0, vld1q_f32(a + i));
+        sa1 = vfmaq_f32(sa1, x1, vld1q_f32(a + i + 4));
+        sb0 = vfmaq_f32(sb0, x0, vld1q_f32(b + i));
+        sb1 = vfmaq_f32(sb1, x1, vld1q_f32(b + i + 4));
+    }
+    *da = vaddvq_f32(vaddq_f32(sa0, sa1));
+    *db = vaddvq_f32(vaddq_f32(sb0, sb1));
+}
+
+static void neon_peak_energy(const float* x, long n, float* peak, float* energy) {
+    float32x4_t p = vdupq_n_f32(0.0f), e[4] = { vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f) };
+    long i = 0;
+    for (; i + ENERGY_LANES <= n; i += ENERGY_LANES) {
+        for (int k = 0; k < 4; k++) {
+            float32x4_t v = vld1q_f32(x + i + k * 4);
+            p = vmaxq_f32(p, vabsq_f32(v));
+            // Not vfmaq: the scalar reference rounds the square before adding
+            e[k] = vaddq_f32(e[k], vmulq_f32(v, v));
+        }
+    }
+    float lanes[ENERGY_LANES];
+    for (int k = 0; k < 4; k++) vst1q_f32(lanes + k * 4, e[k]);
+    finish_peak_energy(vmaxvq_f32(p), lanes, x + i, n - i, peak, energy);
+}
+
+static void neon_butterfly(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, long n) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t xr = vld1q_f32(br + i), xi = vld1q_f32(bi + i);
+        float32x4_t cr = vld1q_f32(wr + i), ci = vld1q_f32(wi + i);
+        float32x4_t tr = vsubq_f32(vmulq_f32(xr, cr), vmulq_f32(xi, ci));
+        float32x4_t ti = vaddq_f32(vmulq_f32(xr, ci), vmulq_f32(xi, cr));
+        float32x4_t yr = vld1q_f32(ar + i), yi = vld1q_f32(ai + i);
+        vst1q_f32(br + i, vsubq_f32(yr, tr));
+        vst1q_f32(bi + i, vsubq_f32(yi, ti));
+        vst1q_f32(ar + i, vaddq_f32(yr, tr));
+        vst1q_f32(ai + i, vaddq_f32(yi, ti));
+    }
+    scalar_butterfly(ar + i, ai + i, br + i, bi + i, wr + i, wi + i, n - i);
+}
+
+static const SampleKernels neon_kernels = {
+    SAMPLE_ISA_NEON,
+    neon_from_float_s16, neon_from_float_s24, neon_from_float_s32, neon_from_float_float,
+    neon_to_float_s16, neon_to_float_s24, neon_to_float_s32,
+    neon_deinterleave2, neon_interleave2,
+    neon_dot2,
+    neon_peak_energy, neon_butterfly
+};
+
+#endif // CONVERT_NEON
+
+// Dispatch
+
+static const SampleKernels* kernels_for(SampleIsa isa) {
+    switch (isa) {
+        case SAMPLE_ISA_SCALAR: return &scalar_kernels;
+#if CONVERT_X86
+        case SAMPLE_ISA_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") ? &sse2_kernels : NULL;
+        case SAMPLE_ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? &avx2_kernels : NULL;
+#endif
+#if CONVERT_NEON
+        case SAMPLE_ISA_NEON: return &neon_kernels;
+#endif
+        default: return NULL;
+    }
+}
+
+// Detection is idempotent, so threads racing through the first call all
+// store the same table
+static const SampleKernels* volatile active_kernels;
+
+static const SampleKernels* kernels(void) {
+    const SampleKernels* k = active_kernels;
+    if (k != NULL) return k;
+
+    static const SampleIsa widest_first[] = { SAMPLE_ISA_AVX2, SAMPLE_ISA_NEON, SAMPLE_ISA_SSE2 };
+    k = &scalar_kernels;
+    for (size_t i = 0; i < sizeof(widest_first) / sizeof(widest_first[0]); i++) {
+        const SampleKernels* candidate = kernels_for(widest_first[i]);
+        if (candidate != NULL) {
+            k = candidate;
+            break;
+        }
+    }
+    active_kernels = k;
+    return k;
+}
+
+SampleIsa sample_convert_isa(void) {
+    return kernels()->isa;
+}
+
+int sample_convert_set_isa(SampleIsa isa) {
+    const SampleKernels* k = kernels_for(isa);
+    if (k == NULL) return -1;
+    active_kernels = k;
+    return 0;
+}
+
+// Format conversion. Packed 24-bit has no vector kernel: its 3-byte
+// stride doesn't map onto lanes, and devices using it are rare.
+
+static void from_float_s24_3(const float* src, uint8_t* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        int32_t v = (int32_t)(clamp_unit(src[i]) * S24_SCALE);
+        dst[i * 3] = (uint8_t)v;
+        dst[i * 3 + 1] = (uint8_t)(v >> 8);
+        dst[i * 3 + 2] = (uint8_t)(v >> 16);
+    }
+}
+
+static void to_float_s24_3(const uint8_t* src, float* dst, long n) {
+    for (long i = 0; i < n; i++) {
+        uint32_t v = (uint32_t)src[i * 3] << 8 | (uint32_t)src[i * 3 + 1] << 16 | (uint32_t)src[i * 3 + 2] << 24;
+        dst[i] = (float)((int32_t)v >> 8) * S24_INV;
+    }
+}
+
+void sample_convert_from_float(SampleFormat format, const float* src, void* dst, long n) {
+    const SampleKernels* k = kernels();
+    switch (format) {
+        case SAMPLE_FORMAT_S16: k->from_float_s16(src, (int16_t*)dst, n); break;
+        case SAMPLE_FORMAT_S24: k->from_float_s24(src, (int32_t*)dst, n); break;
+        case SAMPLE_FORMAT_S24_3: from_float_s24_3(src, (uint8_t*)dst, n); break;
+        case SAMPLE_FORMAT_S32: k->from_float_s32(src, (int32_t*)dst, n); break;
+        case SAMPLE_FORMAT_FLOAT: k->from_float_float(src, (float*)dst, n); break;
+        default: break;
+    }
+}
+
+void sample_convert_to_float(SampleFormat format, const void* src, float* dst, long n) {
+    const SampleKernels* k = kernels();
+    switch (format) {
+        case SAMPLE_FORMAT_S16: k->to_float_s16((const int16_t*)src, dst, n); break;
+        case SAMPLE_FORMAT_S24: k->to_float_s24((const int32_t*)src, dst, n); break;
+        case SAMPLE_FORMAT_S24_3: to_float_s24_3((const uint8_t*)src, dst, n); break;
+        case SAMPLE_FORMAT_S32: k->to_float_s32((const int32_t*)src, dst, n); break;
+        case SAMPLE_FORMAT_FLOAT: memcpy(dst, src, (size_t)n * sizeof(float)); break;
+        default: break;
+    }
+}
+
+// Stereo has vector kernels; other layouts are a plain strided copy
+
+void sample_deinterleave(const float* src, float* const* dst, int channels, long frames) {
+    if (channels == 2) {
+        kernels()->deinterleave2(src, dst[0], dst[1], frames);
+        return;
+    }
+    for (int c = 0; c < channels; c++) {
+        float* plane = dst[c];
+        for (long i = 0; i < frames; i++) {
+            plane[i] = src[i * channels + c];
+        }
+    }
+}
+
+void sample_interleave(const float* const* src, float* dst, int channels, long frames) {
+    if (channels == 2) {
+        kernels()->interleave2(src[0], src[1], dst, frames);
+        return;
+    }
+    for (int c = 0; c < channels; c++) {
+        const float* plane = src[c];
+        for (long i = 0; i < frames; i++) {
+            dst[i * channels + c] = plane[i];
+        }
+    }
+}
+
+// Analysis
+
+void sample_peak_energy(const float* x, long n, float* peak, float* energy) {
+    kernels()->peak_energy(x, n, peak, energy);
+}
+
+void sample_butterfly(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, long n) {
+    kernels()->butterfly(ar, ai, br, bi, wr, wi, n);
+}
+
+// Resampler. Each output frame is a dot product of a window of input with
+// one row of a table of windowed-sinc filters, one row per fractional
+// input position. Positions between rows blend the two nearest rows, so
+// any ratio (including a drifting one) is exact to well below the noise
+// floor. The window is held per channel so the dot products run over
+// contiguous samples.
+
+#define RESAMPLER_PHASE_BITS 8          // 256 filter rows per input sample
+#define RESAMPLER_PHASES (1 << RESAMPLER_PHASE_BITS)
+#define RESAMPLER_BASE_TAPS 64          // at unity ratio; downsampling widens the filter
+#define RESAMPLER_MAX_TAPS 512
+#define RESAMPLER_BLOCK 512             // input frames staged per refill
+#define RESAMPLER_PASSBAND 0.91         // cutoff as a fraction of the lower Nyquist rate
+#define RESAMPLER_KAISER_BETA 8.6       // about 90 dB of stopband rejection
+
+static const double PI = 3.141592653589793;
+
+struct Resampler {
+    const SampleKernels* kernels;
+    int channels;
+    int taps;
+    float* coefs;                       // (RESAMPLER_PHASES + 1) rows of taps
+    float* history;                     // channels planes of stride floats
+    float** planes;
+    float** staging;
+    int stride;
+    long fill;                          // frames held in each plane
+    uint64_t position;                  // 32.32 fixed point: next window start
+    uint64_t step;
+    double base_step;
+};
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static void build_filters(Resampler* r, double cutoff) {
+    int taps = r->taps;
+    double half = taps / 2.0;
+    double center = half - 1.0;
+    double norm = bessel_i0(RESAMPLER_KAISER_BETA);
+
+    for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+        float* row = r->coefs + (size_t)p * taps;
+        double sum = 0.0;
+        for (int k = 0; k < taps; k++) {
+            // Distance from the output instant to input sample k
+            double d = k - center - (double)p / RESAMPLER_PHASES;
+            double x = cutoff * d;
+            double sinc = x == 0.0 ? 1.0 : sin(PI * x) / (PI * x);
+            double u = d / half;
+            double window = u * u < 1.0 ? bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - u * u)) / norm : 0.0;
+            double h = cutoff * sinc * window;
+            row[k] = (float)h;
+            sum += h;
+        }
+        // Unity gain at DC for every row, so blending rows can't ripple
+        for (int k = 0; k < taps; k++) {
+            row[k] = (float)(row[k] / sum);
+        }
+    }
+}
+
+Resampler* resampler_create(int in_rate, int out_rate, int channels) {
+    if (in_rate <= 0 || out_rate <= 0 || channels <= 0) return NULL;
+
+    Resampler* r = (Resampler*)calloc(1, sizeof(Resampler));
+    if (r == NULL) return NULL;
+    r->kernels = kernels();
+    r->channels = channels;
+
+    // Downsampling lowers the cutoff below the output Nyquist rate; the
+    // filter widens by the same factor to keep its transition band
+    double ratio = (double)out_rate / in_rate;
+    double cutoff = (ratio < 1.0 ? ratio : 1.0) * RESAMPLER_PASSBAND;
+    int taps = (int)ceil(RESAMPLER_BASE_TAPS / (ratio < 1.0 ? ratio : 1.0));
+    taps = (taps + 7) & ~7;
+    r->taps = taps < RESAMPLER_MAX_TAPS ? taps : RESAMPLER_MAX_TAPS;
+    r->stride = r->taps + RESAMPLER_BLOCK;
+
+    r->coefs = (float*)malloc((size_t)(RESAMPLER_PHASES + 1) * r->taps * sizeof(float));
+    r->history = (float*)calloc((size_t)channels * r->stride, sizeof(float));
+    r->planes = (float**)malloc((size_t)channels * sizeof(float*));
+    r->staging = (float**)malloc((size_t)channels * sizeof(float*));
+    if (!r->coefs || !r->history || !r->planes || !r->staging) {
+        resampler_destroy(r);
+        return NULL;
+    }
+    for (int c = 0; c < channels; c++) {
+        r->planes[c] = r->history + (size_t)c * r->stride;
+    }
+    build_filters(r, cutoff);
+
+    // Leading silence puts the first output on the first input sample
+    r->fill = r->taps / 2 - 1;
+    r->base_step = (double)in_rate / out_rate;
+    resampler_set_drift(r, 0.0);
+    return r;
+}
+
+void resampler_destroy(Resampler* r) {
+    if (r == NULL) return;
+    free(r->coefs);
+    free(r->history);
+    free(r->planes);
+    free(r->staging);
+    free(r);
+}
+
+void resampler_set_drift(Resampler* r, double ppm) {
+    r->step = (uint64_t)(r->base_step * (1.0 + ppm * 1e-6) * 4294967296.0);
+}
+
+long resampler_input_needed(const Resampler* r, long out_frames) {
+    if (out_frames <= 0) return 0;
+    uint64_t last = r->position + r->step * (uint64_t)(out_frames - 1);
+    long needed = (long)(last >> 32) + r->taps - r->fill;
+    return needed > 0 ? needed : 0;
+}
+
+long resampler_process(Resampler* r, const float* in, long in_frames, long* consumed,
+                       float* out, long out_frames) {
+    const SampleKernels* k = r->kernels;
+    int channels = r->channels;
+    int taps = r->taps;
+    long produced = 0, used = 0;
+
+    while (produced < out_frames) {
+        long index = (long)(r->position >> 32);
+        if (index + taps > r->fill) {
+            if (used == in_frames) break;
+
+            // Slide the spent part of the window out, then stage more input
+            long drop = index < r->fill ? index : r->fill;
+            if (drop > 0) {
+                for (int c = 0; c < channels; c++) {
+                    memmove(r->planes[c], r->planes[c] + drop, (size_t)(r->fill - drop) * sizeof(float));
+                }
+                r->fill -= drop;
+                r->position -= (uint64_t)drop << 32;
+            }
+            long n = in_frames - used;
+            if (n > r->stride - r->fill) n = r->stride - r->fill;
+            for (int c = 0; c < channels; c++) {
+                r->staging[c] = r->planes[c] + r->fill;
+            }
+            sample_deinterleave(in + (size_t)used * channels, r->staging, channels, n);
+            r->fill += n;
+            used += n;
+            continue;
+        }
+
+        uint32_t frac = (uint32_t)r->position;
+        const float* row = r->coefs + (size_t)(frac >> (32 - RESAMPLER_PHASE_BITS)) * taps;
+        float t = (float)(frac & ((1u << (32 - RESAMPLER_PHASE_BITS)) - 1)) *
+                  (1.0f / (float)(1u << (32 - RESAMPLER_PHASE_BITS)));
+        for (int c = 0; c < channels; c++) {
+            float a, b;
+            k->dot2(r->planes[c] + index, row, row + taps, taps, &a, &b);
+            out[produced * channels + c] = a + (b - a) * t;
+        }
+        r->position += r->step;
+        produced++;
+    }
+
+    *consumed = used;
+    return produced;
+}
+
+#if defined(__linux__)
+#include <alsa/asoundlib.h>
+
+int sample_format_to_alsa(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_FORMAT_S16: return SND_PCM_FORMAT_S16_LE;
+        case SAMPLE_FORMAT_S24: return SND_PCM_FORMAT_S24_LE;
+        case SAMPLE_FORMAT_S24_3: return SND_PCM_FORMAT_S24_3LE;
+        case SAMPLE_FORMAT_S32: return SND_PCM_FORMAT_S32_LE;
+        case SAMPLE_FORMAT_FLOAT: return SND_PCM_FORMAT_FLOAT_LE;
+        default: return SND_PCM_FORMAT_UNKNOWN;
+    }
+}
+#endif
@@ -0,0 +1,87 @@
+// sample_convert.h - Sample format, channel layout and sample rate conversion
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SAMPLE_FORMAT_UNKNOWN,
+    SAMPLE_FORMAT_S16,          // S16_LE
+    SAMPLE_FORMAT_S24,          // S24_LE, 24 bits in a 32-bit container
+    SAMPLE_FORMAT_S24_3,        // S24_3LE, packed
+    SAMPLE_FORMAT_S32,          // S32_LE
+    SAMPLE_FORMAT_FLOAT         // FLOAT_LE
+} SampleFormat;
+
+// Kernel sets. Every set produces bit-identical format conversions,
+// interleaving, peak/energy and butterflies; resampler sums may differ in
+// the last bit because the vector kernels add in a different order.
+typedef enum {
+    SAMPLE_ISA_SCALAR,          // portable reference
+    SAMPLE_ISA_SSE2,
+    SAMPLE_ISA_AVX2,            // AVX2 with FMA
+    SAMPLE_ISA_NEON             // AArch64
+} SampleIsa;
+
+// Device formats in order of preference, highest resolution first
+#define SAMPLE_FORMAT_PREFERENCE_COUNT 5
+extern const SampleFormat sample_format_preference[SAMPLE_FORMAT_PREFERENCE_COUNT];
+
+int sample_format_bytes(SampleFormat format);
+
+// ALSA snd_pcm_format_t value (Linux only), as int so this header needs
+// no ALSA headers
+int sample_format_to_alsa(SampleFormat format);
+
+// The widest kernel set the CPU supports, picked on first use
+SampleIsa sample_convert_isa(void);
+
+// Switch kernel sets, e.g. to the scalar reference for comparison.
+// Returns 0, or -1 if this build or CPU lacks the set.
+int sample_convert_set_isa(SampleIsa isa);
+
+const char* sample_isa_to_string(SampleIsa isa);
+
+// Convert n interleaved float samples, clamped to [-1, 1]
+void sample_convert_from_float(SampleFormat format, const float* src, void* dst, long n);
+
+// Convert n native samples to float in [-1, 1)
+void sample_convert_to_float(SampleFormat format, const void* src, float* dst, long n);
+
+// Split interleaved frames into one plane per channel, and back
+void sample_deinterleave(const float* src, float* const* dst, int channels, long frames);
+void sample_interleave(const float* const* src, float* dst, int channels, long frames);
+
+// Largest magnitude and sum of squares of n samples
+void sample_peak_energy(const float* x, long n, float* peak, float* energy);
+
+// Radix-2 FFT butterflies on split complex arrays: with t = w * b,
+// a becomes a + t and b becomes a - t, for n independent pairs
+void sample_butterfly(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, long n);
+
+// Windowed-sinc polyphase resampler for interleaved float frames between
+// any two rates, with a fine ratio adjustment for clock drift
+typedef struct Resampler Resampler;
+
+Resampler* resampler_create(int in_rate, int out_rate, int channels);
+void resampler_destroy(Resampler* resampler);
+
+// Consume input faster (positive) or slower by ppm on top of the rate ratio
+void resampler_set_drift(Resampler* resampler, double ppm);
+
+// Input frames still needed before out_frames more frames can be produced
+long resampler_input_needed(const Resampler* resampler, long out_frames);
+
+// Produce up to out_frames frames, stopping early when the input runs out.
+// *consumed receives the input frames used; the rest must be passed again.
+// Returns the frames produced.
+long resampler_process(Resampler* resampler, const float* in, long in_frames, long* consumed,
+                       float* out, long out_frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_CONVERT_H
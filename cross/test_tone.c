@@ -0,0 +1,314 @@
+// test_tone.c - Play a generated test signal on an output device
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "test_tone.h"
+#include "sample_convert.h"
+
+#define WAVETABLE_BITS 12
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+#define PINK_ROWS 12
+#define FADE_MS 5
+
+static const double TWO_PI = 6.283185307179586;
+
+void test_tone_default_options(TestToneOptions* options) {
+    options->signal = TEST_SIGNAL_TONE;
+    options->frequency_hz = 440.0;
+    options->amplitude = 0.25;
+    options->duration_ms = 1000;
+    options->sample_rate = 48000;
+    options->channels = 2;
+}
+
+const char* test_signal_to_string(TestSignal signal) {
+    switch (signal) {
+        case TEST_SIGNAL_TONE: return "tone";
+        case TEST_SIGNAL_PINK_NOISE: return "pink";
+        default: return "unknown";
+    }
+}
+
+// The tone reads a precomputed sine table with a 32-bit phase
+// accumulator; pink noise uses the Voss-McCartney row sum
+struct ToneGenerator {
+    TestSignal signal;
+    float table[WAVETABLE_SIZE + 1];    // one guard point for interpolation
+    uint32_t phase;
+    uint32_t phase_step;
+    float amplitude;
+    uint32_t rng;
+    uint32_t counter;
+    float rows[PINK_ROWS];
+    float row_sum;
+    long position;
+    long total;
+    long fade;                          // fade-in/out length, avoids clicks
+};
+
+ToneGenerator* tone_generator_create(const TestToneOptions* options, int sample_rate, long total) {
+    ToneGenerator* gen = (ToneGenerator*)calloc(1, sizeof(ToneGenerator));
+    if (gen == NULL) return NULL;
+    gen->signal = options->signal;
+    gen->amplitude = (float)options->amplitude;
+    gen->total = total;
+    gen->fade = (long)sample_rate * FADE_MS / 1000;
+    gen->rng = 0x9e3779b9u;
+
+    for (int i = 0; i < WAVETABLE_SIZE; i++) {
+        gen->table[i] = (float)sin(TWO_PI * i / WAVETABLE_SIZE);
+    }
+    gen->table[WAVETABLE_SIZE] = gen->table[0];
+    // The accumulator wraps at 2^32, so only the fraction of a cycle per
+    // sample matters. Reducing it first keeps the conversion in range for
+    // any frequency, including ones above the rate or negative.
+    double cycles = sample_rate > 0 ? fmod(options->frequency_hz / sample_rate, 1.0) : 0.0;
+    if (cycles < 0.0) cycles += 1.0;
+    if (!(cycles >= 0.0 && cycles < 1.0)) cycles = 0.0;    // NaN, or -tiny rounded up to 1
+    gen->phase_step = (uint32_t)(cycles * 4294967296.0);
+    return gen;
+}
+
+void tone_generator_destroy(ToneGenerator* gen) {
+    free(gen);
+}
+
+// xorshift32, scaled to [-1, 1)
+static float white_noise(ToneGenerator* gen) {
+    uint32_t x = gen->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen->rng = x;
+    return (float)(int32_t)x * (1.0f / 2147483648.0f);
+}
+
+static float pink_noise(ToneGenerator* gen) {
+    // Row k is refreshed every 2^(k+1) samples: pick it from the trailing
+    // zero count of the sample counter
+    uint32_t n = ++gen->counter;
+    int k = 0;
+    while (k < PINK_ROWS && (n & 1) == 0) {
+        n >>= 1;
+        k++;
+    }
+    if (k < PINK_ROWS) {
+        gen->row_sum -= gen->rows[k];
+        gen->rows[k] = white_noise(gen);
+        gen->row_sum += gen->rows[k];
+    }
+    return (gen->row_sum + white_noise(gen)) / (PINK_ROWS + 1);
+}
+
+void tone_generator_render(ToneGenerator* gen, float* out, long frames, int channels) {
+    for (long i = 0; i < frames; i++) {
+        float sample;
+        if (gen->signal == TEST_SIGNAL_TONE) {
+            uint32_t index = gen->phase >> (32 - WAVETABLE_BITS);
+            float frac = (float)(gen->phase & ((1u << (32 - WAVETABLE_BITS)) - 1)) *
+                         (1.0f / (float)(1u << (32 - WAVETABLE_BITS)));
+            sample = gen->table[index] + (gen->table[index + 1] - gen->table[index]) * frac;
+            gen->phase += gen->phase_step;
+        } else {
+            sample = pink_noise(gen);
+        }
+
+        float gain = gen->amplitude;
+        long edge = gen->position < gen->total - gen->position ? gen->position : gen->total - gen->position;
+        if (edge < gen->fade) gain *= (float)edge / (float)gen->fade;
+        gen->position++;
+
+        for (int c = 0; c < channels; c++) {
+            out[i * channels + c] = sample * gain;
+        }
+    }
+}
+
+#if defined(__linux__)
+#include <alsa/asoundlib.h>
+#include <errno.h>
+
+static void set_error(TestToneResult* result, int err, const char* what) {
+    result->status = err;
+    snprintf(result->error, sizeof(result->error), "%s: %s", what, snd_strerror(err));
+}
+
+static int configure(snd_pcm_t* pcm, const TestToneOptions* options, TestToneResult* result,
+                     SampleFormat* format, snd_pcm_uframes_t* period, snd_pcm_uframes_t* buffer) {
+    snd_pcm_hw_params_t* hw;
+    snd_pcm_sw_params_t* sw;
+    unsigned int rate = (unsigned int)options->sample_rate;
+    unsigned int channels = (unsigned int)options->channels;
+    int err;
+
+    snd_pcm_hw_params_alloca(&hw);
+    if ((err = snd_pcm_hw_params_any(pcm, hw)) < 0) return err;
+
+    // Prefer writing into the ring buffer itself; fall back to writei
+    // for PCMs without mmap support
+    result->mmap = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+    if (!result->mmap && (err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+        return err;
+    }
+
+    // Highest resolution first, so the device gets its native format
+    // rather than one the plug layer would convert again
+    *format = SAMPLE_FORMAT_UNKNOWN;
+    for (int i = 0; i < SAMPLE_FORMAT_PREFERENCE_COUNT; i++) {
+        snd_pcm_format_t candidate = (snd_pcm_format_t)sample_format_to_alsa(sample_format_preference[i]);
+        if (snd_pcm_hw_params_test_format(pcm, hw, candidate) == 0) {
+            *format = sample_format_preference[i];
+            break;
+        }
+    }
+    if (*format == SAMPLE_FORMAT_UNKNOWN) return -EINVAL;
+    if ((err = snd_pcm_hw_params_set_format(pcm, hw, (snd_pcm_format_t)sample_format_to_alsa(*format))) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_channels_near(pcm, hw, &channels)) < 0) return err;
+    if ((err = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, NULL)) < 0) return err;
+
+    // 20 ms periods, four per buffer
+    *period = rate / 50;
+    if ((err = snd_pcm_hw_params_set_period_size_near(pcm, hw, period, NULL)) < 0) return err;
+    *buffer = *period * 4;
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, buffer)) < 0) return err;
+    if ((err = snd_pcm_hw_params(pcm, hw)) < 0) return err;
+    snd_pcm_hw_params_get_period_size(hw, period, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw, buffer);
+
+    snd_pcm_sw_params_alloca(&sw);
+    if ((err = snd_pcm_sw_params_current(pcm, sw)) < 0) return err;
+    snd_pcm_sw_params_set_start_threshold(pcm, sw, *buffer);
+    snd_pcm_sw_params_set_avail_min(pcm, sw, *period);
+    if ((err = snd_pcm_sw_params(pcm, sw)) < 0) return err;
+
+    snprintf(result->format, sizeof(result->format), "%s",
+             snd_pcm_format_name((snd_pcm_format_t)sample_format_to_alsa(*format)));
+    result->sample_rate = (int)rate;
+    result->channels = (int)channels;
+    return 0;
+}
+
+// Recover from an underrun or suspend, counting underruns
+static int recover(snd_pcm_t* pcm, int err, TestToneResult* result) {
+    if (err == -EPIPE) result->underruns++;
+    return snd_pcm_recover(pcm, err, 1);
+}
+
+int play_test_output(const char* device_id, const TestToneOptions* options, TestToneResult* result) {
+    snd_pcm_t* pcm = NULL;
+    SampleFormat format;
+    snd_pcm_uframes_t period, buffer;
+    ToneGenerator* gen = NULL;
+    float* samples = NULL;
+    void* native = NULL;
+    int err;
+
+    memset(result, 0, sizeof(*result));
+
+    if ((err = snd_pcm_open(&pcm, device_id, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
+        set_error(result, err, "open");
+        return result->status;
+    }
+    if ((err = configure(pcm, options, result, &format, &period, &buffer)) < 0) {
+        set_error(result, err, "configure");
+        snd_pcm_close(pcm);
+        return result->status;
+    }
+
+    int channels = result->channels;
+    long total = (long)result->sample_rate * options->duration_ms / 1000;
+    size_t frame_bytes = (size_t)channels * sample_format_bytes(format);
+
+    // Float staging for one period; the writei fallback also needs a
+    // native-format period to hand to the kernel
+    gen = tone_generator_create(options, result->sample_rate, total);
+    samples = (float*)malloc(period * channels * sizeof(float));
+    if (!result->mmap) native = malloc(period * frame_bytes);
+    if (gen == NULL || samples == NULL || (!result->mmap && native == NULL)) {
+        set_error(result, -ENOMEM, "allocate");
+        goto done;
+    }
+
+    while (result->frames < total) {
+        snd_pcm_uframes_t frames = period;
+        if ((long)frames > total - result->frames) frames = (snd_pcm_uframes_t)(total - result->frames);
+
+        if (!result->mmap) {
+            tone_generator_render(gen, samples, (long)frames, channels);
+            sample_convert_from_float(format, samples, native, (long)frames * channels);
+            snd_pcm_sframes_t written = snd_pcm_writei(pcm, native, frames);
+            if (written < 0) {
+                if ((err = recover(pcm, (int)written, result)) < 0) break;
+                continue;
+            }
+            result->frames += written;
+            continue;
+        }
+
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+        if (avail < 0) {
+            if ((err = recover(pcm, (int)avail, result)) < 0) break;
+            continue;
+        }
+        if ((snd_pcm_uframes_t)avail < frames) {
+            // Buffer full: start it if the threshold was never reached,
+            // otherwise sleep until a period has played
+            if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED) {
+                snd_pcm_start(pcm);
+            } else if ((err = snd_pcm_wait(pcm, 1000)) < 0) {
+                if ((err = recover(pcm, err, result)) < 0) break;
+            }
+            continue;
+        }
+
+        // Render straight into the mapped ring buffer area
+        const snd_pcm_channel_area_t* areas;
+        snd_pcm_uframes_t offset;
+        if ((err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames)) < 0) {
+            if ((err = recover(pcm, err, result)) < 0) break;
+            continue;
+        }
+        char* dst = (char*)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+        tone_generator_render(gen, samples, (long)frames, channels);
+        sample_convert_from_float(format, samples, dst, (long)frames * channels);
+
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm, offset, frames);
+        if (committed < 0 || (snd_pcm_uframes_t)committed != frames) {
+            if ((err = recover(pcm, committed < 0 ? (int)committed : -EPIPE, result)) < 0) break;
+            continue;
+        }
+        result->frames += committed;
+    }
+
+    if (err < 0) {
+        set_error(result, err, "write");
+    } else {
+        // Bursts shorter than the buffer never hit the start threshold
+        if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED) snd_pcm_start(pcm);
+        snd_pcm_drain(pcm);
+    }
+
+done:
+    free(native);
+    free(samples);
+    tone_generator_destroy(gen);
+    snd_pcm_close(pcm);
+    return result->status;
+}
+
+#else
+
+// Playback drives ALSA PCMs directly; other backends only report that it
+// is unavailable
+int play_test_output(const char* device_id, const TestToneOptions* options, TestToneResult* result) {
+    (void)device_id;
+    (void)options;
+    memset(result, 0, sizeof(*result));
+    result->status = -1;
+    snprintf(result->error, sizeof(result->error), "test output is not supported on this platform");
+    return result->status;
+}
+
+#endif
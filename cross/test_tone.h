@@ -0,0 +1,55 @@
+// test_tone.h - Play a generated test signal on an output device
+#ifndef TEST_TONE_H
+#define TEST_TONE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TEST_SIGNAL_TONE,
+    TEST_SIGNAL_PINK_NOISE
+} TestSignal;
+
+typedef struct {
+    TestSignal signal;
+    double frequency_hz;        // tone only
+    double amplitude;           // linear, 0..1
+    int duration_ms;
+    int sample_rate;            // requested; the device may grant a nearby rate
+    int channels;               // every channel carries the same signal
+} TestToneOptions;
+
+typedef struct {
+    int status;                 // 0 on success, negative error code otherwise
+    char error[128];
+    char format[32];            // native sample format the signal was converted to
+    int sample_rate;
+    int channels;
+    bool mmap;                  // written straight into the device ring buffer
+    long frames;
+    int underruns;
+} TestToneResult;
+
+void test_tone_default_options(TestToneOptions* options);
+
+// Signal source for callers that do their own output. The signal fades in
+// and out over total_frames; frames are duplicated into every channel.
+typedef struct ToneGenerator ToneGenerator;
+ToneGenerator* tone_generator_create(const TestToneOptions* options, int sample_rate, long total_frames);
+void tone_generator_render(ToneGenerator* gen, float* out, long frames, int channels);
+void tone_generator_destroy(ToneGenerator* gen);
+
+// Play the signal on device_id (an enumerated id or any ALSA PCM name,
+// such as "null" or a file plugin) and wait until it has drained
+int play_test_output(const char* device_id, const TestToneOptions* options, TestToneResult* result);
+
+const char* test_signal_to_string(TestSignal signal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_TONE_H
@@ -0,0 +1,20 @@
+// check.h - Minimal assertions shared by the test programs
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int check_failures;
+
+// Record a failure and keep going, so one run reports every broken check
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        check_failures++; \
+    } \
+} while (0)
+
+// Exit status for main: 0 when every check passed
+#define CHECK_RESULT() (check_failures == 0 ? 0 : 1)
+
+#endif // CHECK_H
@@ -0,0 +1,483 @@
+#!/bin/sh
+# run_fixtures.sh - Run the CLI against the fixtures in tests/fixtures and check its output
+#
+# Usage: tests/run_fixtures.sh [path/to/list_audio_devices]
+#
+# ALSA only sees the PCMs in fixtures/asound.conf, and procfs and sysfs
+# are read from the fixture trees, so the results don't depend on the
+# machine's sound hardware. Exits non-zero if any check failed.
+
+here=$(cd "$(dirname "$0")" && pwd)
+cli=${1:-$here/../list_audio_devices}
+fixtures=$here/fixtures
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+ALSA_CONFIG_PATH=$fixtures/asound.conf
+FIXTURE_WORK=$work
+export ALSA_CONFIG_PATH FIXTURE_WORK
+
+# run NAME ARGS...: run the CLI, keeping its output and exit status under NAME
+run() {
+    name=$1
+    shift
+    "$cli" "$@" >"$work/$name.out" 2>"$work/$name.err"
+    echo $? >"$work/$name.status"
+}
+
+fail() {
+    echo "FAIL $1: $2"
+    sed 's/^/    /' "$work/$1.out" "$work/$1.err"
+    failures=$((failures + 1))
+}
+
+# expect NAME TEXT: the output of NAME contains TEXT
+expect() {
+    grep -qF -- "$2" "$work/$1.out" || fail "$1" "expected $2"
+}
+
+# reject NAME TEXT: the output of NAME doesn't contain TEXT
+reject() {
+    ! grep -qF -- "$2" "$work/$1.out" || fail "$1" "unexpected $2"
+}
+
+# expect_status NAME CODE
+expect_status() {
+    [ "$(cat "$work/$1.status")" = "$2" ] || fail "$1" "exit status $(cat "$work/$1.status"), expected $2"
+}
+
+# size_of FILE: bytes in FILE, 0 if it doesn't exist
+size_of() {
+    wc -c <"$1" 2>/dev/null || echo 0
+}
+
+# --measure-latency on named PCMs: the null PCM is measured and picked,
+# one that doesn't exist reports its error and is never the lowest
+check_latency() {
+    run latency --measure-latency --pcm fixture_null --format 48000:16:2 --burst 100
+    expect_status latency 0
+    expect latency '"format": { "sample_rate": 48000, "bit_depth": 16, "channels": 2 }'
+    expect latency '"pcm": "fixture_null"'
+    expect latency '"period_frames": '
+    expect latency '"jitter_ms": '
+    expect latency '"lowest": "fixture_null"'
+
+    run latency_missing --measure-latency --pcm fixture_missing --pcm fixture_null --burst 100
+    expect_status latency_missing 0
+    expect latency_missing '"pcm": "fixture_missing"'
+    expect latency_missing '"error": '
+    expect latency_missing '"lowest": "fixture_null"'
+
+    run latency_bad_format --measure-latency --format 0:16:2
+    expect_status latency_bad_format 2
+}
+
+# --test-output: the tone reaches the file PCM as the frames it reports,
+# pink noise plays, and out-of-range signal options are usage errors
+check_test_output() {
+    rm -f "$work/fixture_file.raw"
+    run tone --test-output fixture_file --duration 250 --frequency 1000 --amplitude 0.5
+    expect_status tone 0
+    expect tone '"device": "fixture_file"'
+    expect tone '"signal": "tone"'
+    expect tone '"frames": 12000'
+    expect tone '"underruns": 0'
+    size=$(size_of "$work/fixture_file.raw")
+    [ "$size" -eq 48000 ] || fail tone "file PCM got $size bytes, expected 48000"
+
+    run pink --test-output fixture_null --signal pink --duration 100
+    expect_status pink 0
+    expect pink '"signal": "pink"'
+
+    for bad in "--frequency 0" "--frequency -440" "--frequency 24000" "--amplitude 1.5" \
+               "--amplitude -0.1" "--duration 0" "--duration -5"; do
+        # shellcheck disable=SC2086
+        run bad_tone --test-output fixture_null $bad
+        [ "$(cat "$work/bad_tone.status")" = 2 ] || fail bad_tone "$bad accepted"
+    done
+    run nyquist_at_low_rate --test-output fixture_null --format 8000 --frequency 5000
+    expect_status nyquist_at_low_rate 2
+}
+
+# --fanout: a tone and a program on stdin reach both file sinks, one of
+# them clocks the others, and a sink that can't open is reported on its own
+check_fanout() {
+    rm -f "$work/fixture_file.raw" "$work/fixture_file_b.raw"
+    run fanout --fanout fixture_file --fanout fixture_file_b --duration 200
+    expect_status fanout 0
+    expect fanout '"pcm": "fixture_file"'
+    expect fanout '"pcm": "fixture_file_b"'
+    expect fanout '"reference": true'
+    expect fanout '"frames_played": '
+    reject fanout '"error"'
+    [ "$(size_of "$work/fixture_file.raw")" -gt 0 ] || fail fanout "nothing reached fixture_file"
+    [ "$(size_of "$work/fixture_file_b.raw")" -gt 0 ] || fail fanout "nothing reached fixture_file_b"
+
+    # 100 ms of S16_LE stereo silence as the program
+    rm -f "$work/fixture_file.raw"
+    head -c 19200 /dev/zero | run fanout_stdin --fanout fixture_file --input -
+    expect_status fanout_stdin 0
+    reject fanout_stdin '"error"'
+    [ "$(size_of "$work/fixture_file.raw")" -ge 19200 ] || fail fanout_stdin "program didn't reach fixture_file"
+
+    run fanout_missing --fanout fixture_null --fanout fixture_missing --duration 100
+    expect_status fanout_missing 0
+    expect fanout_missing '"pcm": "fixture_missing",'
+    expect fanout_missing '"error": '
+    expect fanout_missing '"reference": true'
+}
+
+# --failover: plays to the first candidate that opens, switches when the
+# device fails mid-stream or leaves the configuration and replays into
+# the next one, reports the switch on stderr and in the summary, and
+# fails only with no candidate
+check_failover() {
+    rm -f "$work/fixture_file.raw"
+    run failover --failover fixture_file --duration 200
+    expect_status failover 0
+    expect failover '"pcm": "fixture_file"'
+    expect failover '"current": "fixture_file"'
+    expect failover '"failover_count": 0'
+    [ "$(size_of "$work/fixture_file.raw")" -gt 0 ] || fail failover "nothing reached fixture_file"
+
+    run failover_skip --failover fixture_missing --failover fixture_null --duration 100
+    expect_status failover_skip 0
+    expect failover_skip '"current": "fixture_null"'
+    expect failover_skip '"failover_count": 0'
+
+    rm -f "$work/fixture_file.raw"
+    run failover_switch --failover fixture_full --failover fixture_file --duration 1000
+    expect_status failover_switch 0
+    expect failover_switch '"current": "fixture_file"'
+    expect failover_switch '"failover_count": 1'
+    expect failover_switch '{ "from": "fixture_full", "to": "fixture_file", "reason": "write: '
+    expect failover_switch '"ok": true }'
+    grep -qF '"from": "fixture_full"' "$work/failover_switch.err" ||
+        fail failover_switch "switch not reported on stderr"
+    [ "$(size_of "$work/fixture_file.raw")" -gt 0 ] || fail failover_switch "nothing reached fixture_file"
+
+    # Dropped from the configuration mid-stream: the periodic check sees
+    # the PCM gone from the reloaded tree and switches within the budget
+    cp "$fixtures/asound.conf" "$work/asound.conf"
+    rm -f "$work/fixture_file.raw" "$work/fixture_file_b.raw"
+    ALSA_CONFIG_PATH=$work/asound.conf "$cli" --failover fixture_file_b --failover fixture_file \
+        --failover-budget 250 --duration 3000 >"$work/failover_removed.out" 2>"$work/failover_removed.err" &
+    pid=$!
+    sleep 1
+    sed '/^pcm\.fixture_file_b {/,/^}/d; /^pcm\.fixture_file_b_sink {/,/^}/d' "$fixtures/asound.conf" >"$work/asound.conf.new"
+    mv "$work/asound.conf.new" "$work/asound.conf"
+    wait "$pid"
+    echo $? >"$work/failover_removed.status"
+    expect_status failover_removed 0
+    expect failover_removed '"current": "fixture_file"'
+    expect failover_removed '"failover_count": 1'
+    expect failover_removed '{ "from": "fixture_file_b", "to": "fixture_file", "reason": "removed from configuration", "elapsed_ms": '
+    elapsed=$(sed -n 's/.*"reason": "removed from configuration", "elapsed_ms": \([0-9.]*\).*/\1/p' "$work/failover_removed.out" | head -n 1)
+    [ -n "$elapsed" ] && awk -v ms="$elapsed" 'BEGIN { exit !(ms <= 250) }' ||
+        fail failover_removed "switch took ${elapsed:-?} ms, budget 250"
+    grep -qF '"reason": "removed from configuration"' "$work/failover_removed.err" ||
+        fail failover_removed "switch not reported on stderr"
+    [ "$(size_of "$work/fixture_file_b.raw")" -gt 0 ] || fail failover_removed "nothing reached fixture_file_b"
+    [ "$(size_of "$work/fixture_file.raw")" -gt 0 ] || fail failover_removed "nothing reached fixture_file after the switch"
+
+    run failover_none --failover fixture_missing --duration 100
+    expect_status failover_none 1
+    expect failover_none '"error": "no candidate could be opened"'
+
+    run failover_bad_rank --failover fixture_null --failover-rank type=nonsense
+    expect_status failover_bad_rank 2
+}
+
+# frame_bytes FORMAT CHANNELS: bytes per frame of an ALSA format name
+frame_bytes() {
+    case $1 in
+        S16_LE) echo $((2 * $2)) ;;
+        S24_3LE) echo $((3 * $2)) ;;
+        *) echo $((4 * $2)) ;;
+    esac
+}
+
+# json_value NAME KEY: the bare value of "KEY": in the output of NAME
+json_value() {
+    sed -n "s/^ *\"$2\": \"*\([^\",]*\).*/\1/p" "$work/$1.out" | head -n 1
+}
+
+# --record of a capture PCM: the WAV holds exactly the bytes captured,
+# files roll on time, W64 is written on request, and a PCM that can't
+# open or a bad container is an error
+check_recorder() {
+    head -c 2000000 /dev/urandom >"$work/capture.raw"
+    run record --record fixture_capture --format 48000:16:2 --record-duration 1 --record-to "$work/rec"
+    expect_status record 0
+    expect record '"pcm": "fixture_capture"'
+    expect record '"container": "wav"'
+    expect record '"frames_written": 48000'
+    expect record '"dropped_periods": 0'
+    expect record '"files": 1'
+    reject record '"error"'
+    grep -qF "\"file\": \"$work/rec-0001.wav\"" "$work/record.err" || fail record "file not reported on stderr"
+    data=$((48000 * $(frame_bytes "$(json_value record format)" 2)))
+    head -c "$data" "$work/capture.raw" >"$work/expected.raw"
+    tail -c "$data" "$work/rec-0001.wav" >"$work/recorded.raw"
+    cmp -s "$work/expected.raw" "$work/recorded.raw" || fail record "recorded samples differ from the capture"
+    [ "$(head -c 4 "$work/rec-0001.wav")" = RIFF ] || fail record "not a RIFF file"
+
+    run record_roll --record fixture_capture --format 48000:16:2 --record-duration 2 --roll-time 1 \
+        --record-to "$work/roll"
+    expect_status record_roll 0
+    expect record_roll '"frames_written": 96000'
+    [ -s "$work/roll-0001.wav" ] && [ -s "$work/roll-0002.wav" ] || fail record_roll "didn't roll to a second file"
+
+    run record_w64 --record fixture_capture --format 48000:16:2 --record-duration 1 --record-format w64 \
+        --record-to "$work/w64"
+    expect_status record_w64 0
+    expect record_w64 '"container": "w64"'
+    [ "$(head -c 4 "$work/w64-0001.w64")" = riff ] || fail record_w64 "not a Wave64 file"
+
+    run record_missing --record fixture_missing --record-duration 1 --record-to "$work/missing"
+    expect_status record_missing 1
+    grep -qF "Cannot record fixture_missing" "$work/record_missing.err" || fail record_missing "no error message"
+
+    run record_bad_container --record fixture_capture --record-format mp3
+    expect_status record_bad_container 2
+}
+
+# --meter-wav on a generated 16-bit stereo 1 kHz sine at -23 dBFS (EBU
+# Tech 3341 case 1): the header describes the file, a reading is streamed
+# every 100 ms of audio, and the last one has the tone's level on every
+# loudness scale, to within 0.1 LU
+check_meter() {
+    # One 48-frame period as printf octal escapes, doubled past 5 s
+    printf "$(awk 'BEGIN {
+        for (i = 0; i < 48; i++) {
+            x = 2320 * sin(2 * 3.141592653589793 * i / 48)
+            v = x < 0 ? int(x - 0.5) + 65536 : int(x + 0.5)
+            printf "\\%03o\\%03o\\%03o\\%03o", v % 256, int(v / 256), v % 256, int(v / 256)
+        }
+    }')" >"$work/tone.raw"
+    for i in 1 2 3 4 5 6 7 8 9 10 11 12 13; do
+        cat "$work/tone.raw" "$work/tone.raw" >"$work/tone2.raw"
+        mv "$work/tone2.raw" "$work/tone.raw"
+    done
+    # 44-byte header for 960000 bytes of data: 48 kHz, 2 channels, 16 bits
+    printf 'RIFF\044\246\016\000WAVEfmt \020\000\000\000\001\000\002\000\200\273\000\000\000\356\002\000\004\000\020\000data\000\246\016\000' >"$work/tone.wav"
+    head -c 960000 "$work/tone.raw" >>"$work/tone.wav"
+
+    run meter --meter-wav "$work/tone.wav"
+    expect_status meter 0
+    head -n 1 "$work/meter.out" | grep -qF "{ \"source\": \"$work/tone.wav\", \"sample_rate\": 48000, \"channels\": 2, \"publish_hz\": 10, \"isa\": " ||
+        fail meter "header doesn't describe the file"
+    [ "$(grep -c '^{ "time": ' "$work/meter.out")" -eq 50 ] || fail meter "expected 50 readings"
+    tail -n 1 "$work/meter.out" | grep -q '^{ "time": 5\.000, "peak_db": \[-23\.0[0-9], -23\.0[0-9]\], "rms_db": \[-26\.0[0-9], -26\.0[0-9]\], "momentary_lufs": ' ||
+        fail meter "last reading's time or levels"
+    tail -n 1 "$work/meter.out" | awk '{
+        for (i = 1; i < NF; i++) {
+            if ($i ~ /^"(momentary|short_term|integrated)_lufs":$/) {
+                found++
+                v = $(i + 1) + 0
+                if (v < -23.1 || v > -22.9) bad = 1
+            }
+        }
+        exit found == 3 && !bad ? 0 : 1
+    }' || fail meter "loudness not -23 LUFS"
+
+    run meter_missing --meter-wav "$work/no-such.wav"
+    expect_status meter_missing 1
+    grep -qF "Cannot meter $work/no-such.wav" "$work/meter_missing.err" || fail meter_missing "no error message"
+}
+
+# --pcm-status against a copy of the recorded procfs tree: open streams
+# with their hw_params and pointers, closed ones only counted; with an
+# interval the same files are re-read and a card that appears is picked up
+check_pcm_status() {
+    cp -R "$fixtures/proc" "$work/proc"
+    asound=$work/proc/asound
+
+    run pcm_status --pcm-status --proc-root "$asound"
+    expect_status pcm_status 0
+    expect pcm_status '{ "subdevices": 7, "streams": [ '
+    expect pcm_status '{ "id": "hw:0,0", "subdevice": 0, "direction": "playback", "state": "RUNNING", "owner_pid": 4242, "access": "RW_INTERLEAVED", "format": "S16_LE", "channels": 2, "rate": 48000, "period_size": 1024, "buffer_size": 4096, "hw_ptr": 480000, "appl_ptr": 481024, "delay": 1024, "avail": 3072 }'
+    expect pcm_status '{ "id": "hw:0,0", "subdevice": 0, "direction": "capture", "state": "OPEN", "owner_pid": 4243 }'
+    expect pcm_status '{ "id": "hw:1,3", "subdevice": 0, "direction": "playback", "state": "XRUN", "owner_pid": 5150, "access": "MMAP_INTERLEAVED", "format": "S32_LE", "channels": 8,'
+    reject pcm_status '"subdevice": 1'
+    reject pcm_status '"hw:1,7"'
+    [ "$(wc -l <"$work/pcm_status.out")" -eq 1 ] || fail pcm_status "expected one sample"
+
+    "$cli" --pcm-status --proc-root "$asound" --interval 200 >"$work/pcm_status_live.out" 2>"$work/pcm_status_live.err" &
+    pid=$!
+    sleep 1
+    sed 's/^hw_ptr      : 480000$/hw_ptr      : 528000/' "$asound/card0/pcm0p/sub0/status" >"$work/status"
+    cat "$work/status" >"$asound/card0/pcm0p/sub0/status"
+    mkdir -p "$asound/card3/pcm0p/sub0"
+    cp "$asound/card0/pcm0p/sub0/status" "$asound/card0/pcm0p/sub0/hw_params" "$asound/card3/pcm0p/sub0/"
+    sleep 2
+    kill -TERM "$pid"
+    wait "$pid"
+    echo $? >"$work/pcm_status_live.status"
+    expect_status pcm_status_live 0
+    tail -n 1 "$work/pcm_status_live.out" >"$work/pcm_status_last.out"
+    : >"$work/pcm_status_last.err"
+    expect pcm_status_last '"hw_ptr": 528000'
+    expect pcm_status_last '{ "id": "hw:3,0", "subdevice": 0, "direction": "playback", "state": "RUNNING"'
+    expect pcm_status_last '"subdevices": 8'
+
+    run pcm_status_missing --pcm-status --proc-root "$work/no-such-dir"
+    expect_status pcm_status_missing 1
+}
+
+# --power-aware against the sysfs and procfs trees: the cards come from
+# sysfs, and the suspended USB headset is listed from procfs without its
+# control device being opened; --wake queries it anyway. The active cards
+# are queried on the machine's own hardware, so only their reports are checked.
+check_power_aware() {
+    roots="--sys-root $fixtures/sys --proc-root $fixtures/proc/asound"
+
+    run power_aware --direction all --power-aware $roots
+    expect_status power_aware 0
+    expect power_aware '"name": "Jabra EVOLVE LINK - USB Audio",'
+    expect power_aware '"type": "USB Audio",'
+    expect power_aware '"direction": "capture",'
+    expect power_aware '"duplex_peer_id": "hw:2,0",'
+    expect power_aware '"is_suspended": true'
+    expect power_aware '{ "card": 0, "suspended": false, "queried": true, "woke": false },'
+    expect power_aware '{ "card": 1, "suspended": false, "queried": true, "woke": false },'
+    expect power_aware '{ "card": 2, "suspended": true, "queried": false, "woke": false }'
+    [ "$(grep -c '"id": "hw:2,0"' "$work/power_aware.out")" -eq 2 ] || fail power_aware "expected hw:2,0 in both directions"
+
+    run power_aware_playback --power-aware $roots
+    expect_status power_aware_playback 0
+    reject power_aware_playback '"direction": "capture"'
+    [ "$(grep -c '"is_suspended": true' "$work/power_aware_playback.out")" -eq 1 ] || fail power_aware_playback "expected one suspended entry"
+
+    run power_aware_wake --direction all --wake $roots
+    expect_status power_aware_wake 0
+    expect power_aware_wake '{ "card": 2, "suspended": true, "queried": true, "woke": false }'
+    reject power_aware_wake '"is_suspended": true'
+
+    run power_aware_plain --direction all $roots
+    expect_status power_aware_plain 0
+    reject power_aware_plain '"cards": ['
+    reject power_aware_plain '"is_suspended": true'
+}
+
+# entry NAME ID DIRECTION TEXT: the device ID listed for DIRECTION in the
+# output of NAME contains TEXT
+entry() {
+    awk -v id="\"id\": \"$2\"," -v direction="\"direction\": \"$3\"," '
+        /^    \{$/ { object = ""; next }
+        /^    \}/ { if (index(object, id) && index(object, direction)) print object; next }
+        { sub(/^ +/, ""); object = object $0 " " }' "$work/$1.out" | grep -qF -- "$4" ||
+        fail "$1" "expected $2 ($3) with $4"
+}
+
+# --plugins against the hinted PCMs: each is listed in both directions
+# with the hw PCM its slave chain ends on, read from the configuration
+# alone, and is_default is on the "default" entries only
+check_plugins() {
+    run plugins --direction all --plugins
+    expect_status plugins 0
+    entry plugins default playback '"hardware_id": "hw:0,0",'
+    entry plugins default capture '"hardware_id": "hw:1,3",'
+    entry plugins default playback '"is_default": true,'
+    entry plugins default capture '"is_default": true,'
+    entry plugins default playback '"name": "Fixture default",'
+    entry plugins fixture_plug_hw playback '"hardware_id": "hw:0,0",'
+    entry plugins fixture_plug_hw capture '"hardware_id": "hw:0,0",'
+    entry plugins fixture_plug_hw playback '"is_default": false,'
+    entry plugins fixture_plug_hw playback '"name": "Fixture plug - over hw:0,0",'
+    entry plugins fixture_nested playback '"hardware_id": "hw:1,3",'
+    entry plugins fixture_nested capture '"hardware_id": "hw:1,3",'
+    entry plugins fixture_nested capture '"is_default": false,'
+    reject plugins '"id": "fixture_file",'
+    reject plugins '"id": "null",'
+
+    run plugins_playback --plugins
+    expect_status plugins_playback 0
+    reject plugins_playback '"direction": "capture"'
+    entry plugins_playback default playback '"is_default": true,'
+
+    run plugins_plain --direction all
+    expect_status plugins_plain 0
+    reject plugins_plain '"id": "default",'
+    reject plugins_plain '"id": "fixture_plug_hw",'
+}
+
+# --metrics-file over two listings and a timeout the caller reports with
+# --metrics-count, then --metrics-export: the counters add up, every
+# histogram's cumulative buckets never decrease and its _count equals its
+# +Inf bucket
+check_metrics() {
+    metrics=$work/metrics
+    run metrics_list1 --metrics-file "$metrics"
+    expect_status metrics_list1 0
+    run metrics_list2 --metrics-file "$metrics"
+    expect_status metrics_list2 0
+    run metrics_timeout --metrics-file "$metrics" --metrics-count timeouts
+    expect_status metrics_timeout 0
+
+    run metrics --metrics-export "$metrics"
+    expect_status metrics 0
+    expect metrics '# TYPE audio_enum_successes_total counter'
+    expect metrics 'audio_enum_successes_total 2'
+    expect metrics 'audio_enum_timeouts_total 1'
+    expect metrics 'audio_enum_fallbacks_total 0'
+    expect metrics 'audio_enum_phase_duration_seconds_count{phase="total"} 2'
+    : >"$work/metrics_buckets.err"
+    awk '
+        /^[a-z_]+_bucket\{/ {
+            series = $1
+            sub(/,?le="[^"]*"/, "", series)
+            sub(/_bucket\{/, "{", series)
+            if (series in last && $2 < last[series]) {
+                print "bucket decreases: " $0
+                bad = 1
+            }
+            last[series] = $2
+            if ($1 ~ /le="\+Inf"/) inf[series] = $2
+        }
+        /^[a-z_]+_count\{/ {
+            series = $1
+            sub(/_count\{/, "{", series)
+            count[series] = $2
+        }
+        END {
+            for (series in count) {
+                if (!(series in inf) || inf[series] != count[series]) {
+                    print "_count differs from +Inf bucket: " series
+                    bad = 1
+                }
+            }
+            for (series in inf) n++
+            if (n == 0) { print "no histograms"; bad = 1 }
+            exit bad
+        }' "$work/metrics.out" >"$work/metrics_buckets.out" || fail metrics_buckets "histogram inconsistent"
+
+    run metrics_out --metrics-export "$metrics" --metrics-out "$work/metrics.prom"
+    expect_status metrics_out 0
+    cmp -s "$work/metrics.out" "$work/metrics.prom" || fail metrics_out "--metrics-out differs from stdout"
+
+    run metrics_unknown --metrics-file "$metrics" --metrics-count no_such_counter
+    expect_status metrics_unknown 2
+    run metrics_no_file --metrics-count timeouts
+    expect_status metrics_no_file 2
+    run metrics_missing --metrics-export "$work/no-such-metrics"
+    expect_status metrics_missing 1
+}
+
+check_latency
+check_test_output
+check_fanout
+check_failover
+check_recorder
+check_meter
+check_pcm_status
+check_power_aware
+check_plugins
+check_metrics
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures fixture check(s) failed"
+    exit 1
+fi
+echo "All fixture checks passed"
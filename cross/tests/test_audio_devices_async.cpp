@@ -0,0 +1,268 @@
+// test_audio_devices_async.cpp - Coroutine API over a fake backend: overlapping queries on one thread
+//
+// Linked against the async and C++ wrapper sources only; the C entry
+// points they call are defined here, with short sleeps standing in for
+// slow control and PCM opens.
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "audio_devices_async.hpp"
+#include "check.h"
+
+using namespace audio_devices;
+
+namespace {
+
+constexpr int fake_devices = 3;
+constexpr auto list_delay = std::chrono::milliseconds(5);
+constexpr auto probe_delay = std::chrono::milliseconds(40);
+
+std::atomic<int> probes_started{0};
+std::atomic<int> probes_in_flight{0};
+std::atomic<int> max_probes_in_flight{0};
+std::atomic<int> lists_in_flight{0};
+std::atomic<int> max_lists_in_flight{0};
+int change_pipe[2] = { -1, -1 };
+
+void track_max(std::atomic<int>& in_flight, std::atomic<int>& max_in_flight) {
+    int now = ++in_flight;
+    int seen = max_in_flight.load();
+    while (now > seen && !max_in_flight.compare_exchange_weak(seen, now)) {}
+}
+
+} // namespace
+
+// Fake backend
+struct audio_ctx {
+    std::mutex lock;            // the real context serialises queries the same way
+};
+
+struct audio_watch {
+    int fd;
+};
+
+extern "C" {
+
+audio_ctx_t* audio_ctx_create(void) { return new audio_ctx; }
+void audio_ctx_destroy(audio_ctx_t* ctx) { delete ctx; }
+
+int audio_ctx_list_devices(audio_ctx_t* ctx, AudioDeviceDirection direction, AudioDevice* devices, int max_devices) {
+    std::lock_guard<std::mutex> lock(ctx->lock);
+    track_max(lists_in_flight, max_lists_in_flight);
+    std::this_thread::sleep_for(list_delay);
+    for (int i = 0; i < fake_devices && i < max_devices; i++) {
+        std::memset(&devices[i], 0, sizeof(devices[i]));
+        std::snprintf(devices[i].id, sizeof(devices[i].id), "hw:%d,0", i);
+        devices[i].direction = direction;
+    }
+    lists_in_flight--;
+    return fake_devices;
+}
+
+int list_audio_devices(AudioDevice** devices, AudioDeviceDirection direction) {
+    (void)direction;
+    *devices = nullptr;
+    return 0;
+}
+
+void free_audio_devices(AudioDevice* devices) { std::free(devices); }
+
+// The channel count tells which device was probed
+int probe_audio_device(const AudioDevice* device, AudioDeviceCaps* caps) {
+    probes_started++;
+    track_max(probes_in_flight, max_probes_in_flight);
+    std::this_thread::sleep_for(probe_delay);
+    std::memset(caps, 0, sizeof(*caps));
+    caps->min_sample_rate = 8000;
+    caps->max_sample_rate = 192000;
+    caps->max_channels = 2 + (device->id[3] - '0');
+    probes_in_flight--;
+    return 0;
+}
+
+audio_watch_t* audio_watch_open(void) {
+    std::this_thread::sleep_for(list_delay);
+    return new audio_watch{ change_pipe[0] };
+}
+
+int audio_watch_descriptors(audio_watch_t* watch, int* fds, int max_fds) {
+    if (max_fds < 1) return 0;
+    fds[0] = watch->fd;
+    return 1;
+}
+
+int audio_watch_read(audio_watch_t* watch) {
+    char buffer[64];
+    int total = 0;
+    ssize_t n;
+    while ((n = read(watch->fd, buffer, sizeof(buffer))) > 0) total += (int)n;
+    return total;
+}
+
+void audio_watch_close(audio_watch_t* watch) { delete watch; }
+
+} // extern "C"
+
+namespace {
+
+struct Shared {
+    PollLoop* loop;
+    std::thread::id loop_thread;
+    int running = 0;
+    int wrong_thread = 0;
+    int failed = 0;
+};
+
+void finished(Shared& shared) {
+    if (--shared.running == 0) shared.loop->stop();
+}
+
+// One enumeration, then a probe of one of the devices found
+Task<> list_and_probe(AsyncEnumerator& enumerator, Shared& shared, int index) {
+    AudioDevice devices[fake_devices];
+    Listed listed = co_await enumerator.enumerate(devices, fake_devices);
+    if (std::this_thread::get_id() != shared.loop_thread) shared.wrong_thread++;
+    if (listed.status != Status::ok || listed.count != fake_devices) shared.failed++;
+
+    const AudioDevice& device = devices[index % fake_devices];
+    Probed probed = co_await enumerator.probe(device);
+    if (std::this_thread::get_id() != shared.loop_thread) shared.wrong_thread++;
+    if (probed.status != Status::ok || probed.caps.max_channels != 2 + index % fake_devices) shared.failed++;
+    finished(shared);
+}
+
+// Many queries in flight at once from coroutines on the loop's thread:
+// probes overlap on the pool, enumerations of the shared context queue
+// up, and every coroutine resumes on the loop
+void test_overlapping_queries() {
+    constexpr int tasks = 64;
+    PollLoop loop;
+    AsyncEnumerator enumerator(loop, 4);
+    Shared shared{ &loop, std::this_thread::get_id() };
+    probes_started = 0;
+
+    std::vector<Task<>> running;
+    for (int i = 0; i < tasks; i++) running.push_back(list_and_probe(enumerator, shared, i));
+    shared.running = tasks;
+    auto start = std::chrono::steady_clock::now();
+    for (Task<>& task : running) task.start();
+    loop.run();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    for (Task<>& task : running) CHECK(task.done());
+    CHECK(shared.failed == 0);
+    CHECK(shared.wrong_thread == 0);
+    CHECK(probes_started == tasks);
+    CHECK(max_lists_in_flight == 1);
+    CHECK(max_probes_in_flight > 1 && max_probes_in_flight <= 4);
+    // Serial probes alone would take tasks * probe_delay
+    CHECK(elapsed < tasks * probe_delay * 3 / 4);
+}
+
+Task<> probe_with_stop(AsyncEnumerator& enumerator, Shared& shared, const AudioDevice& device,
+                       std::stop_token stop, Status* status) {
+    Probed probed = co_await enumerator.probe(device, std::move(stop));
+    if (std::this_thread::get_id() != shared.loop_thread) shared.wrong_thread++;
+    *status = probed.status;
+    finished(shared);
+}
+
+// With one worker busy, a queued probe is taken back on request_stop()
+// and resumes cancelled without ever reaching the backend
+void test_cancel_queued() {
+    PollLoop loop;
+    AsyncEnumerator enumerator(loop, 1);
+    Shared shared{ &loop, std::this_thread::get_id() };
+    AudioDevice device;
+    std::memset(&device, 0, sizeof(device));
+    std::snprintf(device.id, sizeof(device.id), "hw:1,0");
+    probes_started = 0;
+
+    std::stop_source first_stop, second_stop;
+    Status first = Status::failed, second = Status::failed;
+    Task<> busy = probe_with_stop(enumerator, shared, device, first_stop.get_token(), &first);
+    Task<> queued = probe_with_stop(enumerator, shared, device, second_stop.get_token(), &second);
+    shared.running = 2;
+    busy.start();
+    queued.start();
+
+    // From another thread, as an application's UI would
+    std::thread canceller([&] { second_stop.request_stop(); });
+    canceller.join();
+    loop.run();
+
+    CHECK(first == Status::ok);
+    CHECK(second == Status::cancelled);
+    CHECK(probes_started == 1);
+    CHECK(shared.wrong_thread == 0);
+
+    // Already stopped: completes at once, never queued
+    shared.running = 1;
+    Status early = Status::failed;
+    Task<> stopped = probe_with_stop(enumerator, shared, device, second_stop.get_token(), &early);
+    stopped.start();
+    CHECK(stopped.done());
+    CHECK(early == Status::cancelled);
+}
+
+Task<> watch_changes(AsyncEnumerator& enumerator, Shared& shared, std::stop_token stop, Status* statuses) {
+    statuses[0] = co_await enumerator.changed();           // opens the control devices
+    statuses[1] = co_await enumerator.changed();           // a byte on the pipe
+    statuses[2] = co_await enumerator.changed(stop);       // stopped while waiting
+    if (std::this_thread::get_id() != shared.loop_thread) shared.wrong_thread++;
+    finished(shared);
+}
+
+// Notifications are waited for on the loop alongside other queries
+void test_changes_with_queries() {
+    PollLoop loop;
+    AsyncEnumerator enumerator(loop, 2);
+    Shared shared{ &loop, std::this_thread::get_id() };
+    std::stop_source stop;
+    Status statuses[3] = { Status::failed, Status::failed, Status::failed };
+
+    Task<> watcher = watch_changes(enumerator, shared, stop.get_token(), statuses);
+    std::vector<Task<>> queries;
+    for (int i = 0; i < 8; i++) queries.push_back(list_and_probe(enumerator, shared, i));
+    shared.running = 1 + 8;
+    watcher.start();
+    for (Task<>& task : queries) task.start();
+
+    std::thread producer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        char byte = 1;
+        CHECK(write(change_pipe[1], &byte, 1) == 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        stop.request_stop();
+    });
+    loop.run();
+    producer.join();
+
+    CHECK(statuses[0] == Status::ok);
+    CHECK(statuses[1] == Status::ok);
+    CHECK(statuses[2] == Status::cancelled);
+    CHECK(shared.failed == 0);
+    CHECK(shared.wrong_thread == 0);
+}
+
+} // namespace
+
+int main() {
+    if (pipe(change_pipe) != 0) return 1;
+    fcntl(change_pipe[0], F_SETFL, O_NONBLOCK);
+
+    test_overlapping_queries();
+    test_cancel_queued();
+    test_changes_with_queries();
+
+    close(change_pipe[0]);
+    close(change_pipe[1]);
+    return CHECK_RESULT();
+}
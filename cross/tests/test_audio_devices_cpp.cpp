@@ -0,0 +1,200 @@
+// test_audio_devices_cpp.cpp - DeviceList ownership, FilterView, the filter predicates and probed caps
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include "audio_devices.hpp"
+#include "check.h"
+
+using namespace audio_devices;
+
+namespace {
+
+AudioDevice make_device(const char* id, AudioDeviceType type, AudioConnectionType connection,
+                        AudioDeviceDirection direction) {
+    AudioDevice d;
+    std::memset(&d, 0, sizeof(d));
+    std::snprintf(d.id, sizeof(d.id), "%s", id);
+    std::snprintf(d.name, sizeof(d.name), "Device %s", id);
+    d.type = type;
+    d.connection = connection;
+    d.direction = direction;
+    return d;
+}
+
+// Buffers handed to DeviceList are released with free_audio_devices()
+DeviceList make_list() {
+    AudioDevice* devices = static_cast<AudioDevice*>(std::calloc(5, sizeof(AudioDevice)));
+    devices[0] = make_device("hw:0,0", DEVICE_TYPE_SPEAKERS, CONNECTION_BUILTIN, DEVICE_DIRECTION_PLAYBACK);
+    devices[0].output_channels = 2;
+    devices[0].sample_rate = 48000;
+    devices[0].bit_depth = 24;
+    devices[1] = make_device("hw:0,3", DEVICE_TYPE_HDMI, CONNECTION_WIRED, DEVICE_DIRECTION_PLAYBACK);
+    devices[1].output_channels = 8;
+    devices[1].is_default = true;
+    devices[2] = make_device("hw:1,0", DEVICE_TYPE_USB, CONNECTION_WIRED, DEVICE_DIRECTION_CAPTURE);
+    devices[2].input_channels = 4;
+    devices[2].sample_rate = 44100;
+    devices[2].is_default = true;
+    devices[3] = make_device("hw:1,1", DEVICE_TYPE_USB, CONNECTION_WIRED, DEVICE_DIRECTION_PLAYBACK);
+    devices[3].output_channels = 2;
+    devices[4] = make_device("bt", DEVICE_TYPE_BLUETOOTH, CONNECTION_WIRELESS, DEVICE_DIRECTION_ALL);
+    devices[4].input_channels = 1;
+    devices[4].output_channels = 2;
+    return DeviceList::adopt(devices, 5);
+}
+
+template <class View>
+int count(const View& view) {
+    int n = 0;
+    for (const AudioDevice& d : view) {
+        (void)d;
+        n++;
+    }
+    return n;
+}
+
+void test_device_list_ownership() {
+    DeviceList empty;
+    CHECK(empty.empty());
+    CHECK(empty.size() == 0);
+    CHECK(empty.begin() == empty.end());
+    CHECK(empty.find("hw:0,0") == nullptr);
+    CHECK(empty.default_device() == nullptr);
+
+    CHECK(DeviceList::adopt(nullptr, -1).size() == 0);
+
+    DeviceList list = make_list();
+    CHECK(list.size() == 5);
+    CHECK(id(list[2]) == "hw:1,0");
+    CHECK(name(list[2]) == "Device hw:1,0");
+
+    DeviceList moved(std::move(list));
+    CHECK(list.empty());
+    CHECK(moved.size() == 5);
+
+    DeviceList assigned = make_list();
+    assigned = std::move(moved);
+    CHECK(moved.empty());
+    CHECK(assigned.size() == 5);
+
+    // Self-assignment keeps the buffer
+    DeviceList& self = assigned;
+    assigned = std::move(self);
+    CHECK(assigned.size() == 5);
+}
+
+void test_find_and_default() {
+    DeviceList list = make_list();
+    const AudioDevice* usb = list.find("hw:1,0");
+    CHECK(usb == &list[2]);
+    CHECK(list.find("hw:1") == nullptr);
+    CHECK(list.find("") == nullptr);
+
+    // The first default entry in list order
+    CHECK(list.default_device() == &list[1]);
+}
+
+void test_filters() {
+    DeviceList list = make_list();
+    CHECK(count(list | is_default()) == 2);
+    CHECK(count(list | by_type(DEVICE_TYPE_USB)) == 2);
+    CHECK(count(list | by_type(DEVICE_TYPE_VIRTUAL)) == 0);
+    CHECK(count(list | by_connection(CONNECTION_WIRED)) == 3);
+    CHECK(count(list | by_direction(DEVICE_DIRECTION_CAPTURE)) == 2);
+    CHECK(count(list | by_direction(DEVICE_DIRECTION_PLAYBACK)) == 4);
+    CHECK(count(list | by_direction(DEVICE_DIRECTION_ALL)) == 5);
+
+    CHECK((list | by_type(DEVICE_TYPE_VIRTUAL)).empty());
+    CHECK((list | by_type(DEVICE_TYPE_VIRTUAL)).first() == nullptr);
+    CHECK((list | by_type(DEVICE_TYPE_HDMI)).first() == &list[1]);
+}
+
+void test_chained_filters() {
+    DeviceList list = make_list();
+    auto usb_capture = list | by_type(DEVICE_TYPE_USB) | by_direction(DEVICE_DIRECTION_CAPTURE);
+    CHECK(count(usb_capture) == 1);
+    CHECK(usb_capture.first() == &list[2]);
+
+    auto default_playback = list | by_direction(DEVICE_DIRECTION_PLAYBACK) | is_default() |
+                            by_connection(CONNECTION_WIRED);
+    CHECK(count(default_playback) == 1);
+    CHECK(default_playback.first() == &list[1]);
+
+    // Iteration visits matches in list order and stops at end()
+    auto wired = list | by_connection(CONNECTION_WIRED);
+    auto it = wired.begin();
+    CHECK(it != wired.end() && &*it == &list[1]);
+    CHECK(++it != wired.end() && it->type == DEVICE_TYPE_USB);
+    it++;
+    CHECK(it != wired.end() && id(*it) == "hw:1,1");
+    CHECK(++it == wired.end());
+}
+
+void test_matches_reported_format() {
+    DeviceList list = make_list();
+    CHECK(count(list | matches_reported_format({})) == 5);
+    CHECK(count(list | matches_reported_format({48000, 0, 0})) == 4);   // all but the 44.1 kHz interface
+    CHECK(count(list | matches_reported_format({0, 32, 0})) == 4);      // hw:0,0 is 24-bit
+    CHECK(count(list | matches_reported_format({0, 16, 0})) == 5);
+
+    // Channels are checked in each device's direction: the capture
+    // interface has 4 inputs and no outputs
+    CHECK(matches_reported_format({0, 0, 4})(list[2]));
+    CHECK(!matches_reported_format({0, 0, 6})(list[2]));
+    CHECK(!matches_reported_format({0, 0, 4})(list[0]));
+    CHECK(matches_reported_format({0, 0, 8})(list[1]));
+
+    // A duplex entry offers the wider of its two sides
+    CHECK(matches_reported_format({0, 0, 2})(list[4]));
+    CHECK(!matches_reported_format({0, 0, 3})(list[4]));
+
+    auto four_in = list | by_direction(DEVICE_DIRECTION_CAPTURE) | matches_reported_format({0, 0, 4});
+    CHECK(count(four_in) == 1);
+    CHECK(four_in.first() == &list[2]);
+}
+
+// An ALSA hardware entry reports no format at all, so it matches any
+// request: the predicate can't tell it apart from a device that fits
+void test_all_zero_entry() {
+    AudioDevice bare = make_device("hw:2,0", DEVICE_TYPE_USB, CONNECTION_WIRED, DEVICE_DIRECTION_PLAYBACK);
+    CHECK(matches_reported_format({})(bare));
+    CHECK(matches_reported_format({192000, 32, 32})(bare));
+    CHECK(matches_reported_format({8000, 8, 1})(bare));
+}
+
+// Probed caps answer what the device accepts
+void test_supports_caps() {
+    AudioDeviceCaps caps = { 44100, 96000, 1, 2, AUDIO_FORMAT_S16 | AUDIO_FORMAT_S24 };
+    CHECK(supports(caps, {}));
+    CHECK(supports(caps, {48000, 24, 2}));
+    CHECK(supports(caps, {44100, 16, 1}));
+    CHECK(supports(caps, {96000, 0, 0}));
+    CHECK(!supports(caps, {192000, 0, 0}));
+    CHECK(!supports(caps, {32000, 0, 0}));
+    CHECK(!supports(caps, {0, 0, 4}));
+    CHECK(!supports(caps, {0, 32, 0}));
+    CHECK(!supports(caps, {0, 64, 0}));
+
+    AudioDeviceCaps float_only = { 48000, 48000, 2, 8, AUDIO_FORMAT_FLOAT };
+    CHECK(supports(float_only, {48000, 32, 8}));
+    CHECK(supports(float_only, {0, 16, 0}));
+    CHECK(!supports(float_only, {0, 0, 1}));
+
+    // Nothing probed yet: all zeros accept nothing, unlike an entry
+    AudioDeviceCaps none = {};
+    CHECK(!supports(none, {}));
+    CHECK(!supports(none, {48000, 16, 2}));
+}
+
+} // namespace
+
+int main() {
+    test_device_list_ownership();
+    test_find_and_default();
+    test_filters();
+    test_chained_filters();
+    test_matches_reported_format();
+    test_all_zero_entry();
+    test_supports_caps();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,128 @@
+// test_device_diff.c - Snapshot save/load, replacement of bad files and pruning
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include "device_diff.h"
+#include "check.h"
+
+static char cache_dir[64];
+
+static void make_devices(AudioDevice* devices, int count, int seed) {
+    memset(devices, 0, (size_t)count * sizeof(AudioDevice));
+    for (int i = 0; i < count; i++) {
+        snprintf(devices[i].id, sizeof(devices[i].id), "hw:%d,%d", seed, i);
+        snprintf(devices[i].name, sizeof(devices[i].name), "Card %d - PCM %d", seed, i);
+        devices[i].output_channels = 2;
+    }
+}
+
+static void token_for(const AudioDevice* devices, int count, char token[DEVICE_SNAPSHOT_TOKEN_SIZE]) {
+    device_snapshot_token(device_snapshot_hash(devices, count), token);
+}
+
+static void path_for(const char* token, char* path, size_t size) {
+    snprintf(path, size, "%s/audio_devices_%s.snap", cache_dir, token);
+}
+
+static void test_round_trip(void) {
+    AudioDevice devices[3];
+    char token[DEVICE_SNAPSHOT_TOKEN_SIZE];
+    make_devices(devices, 3, 0);
+    token_for(devices, 3, token);
+
+    CHECK(device_snapshot_save(token, devices, 3) == 0);
+    AudioDevice* loaded;
+    CHECK(device_snapshot_load(token, &loaded) == 3);
+    CHECK(loaded != NULL && memcmp(loaded, devices, sizeof(devices)) == 0);
+    free(loaded);
+
+    // Saving the same list again leaves the file alone
+    CHECK(device_snapshot_save(token, devices, 3) == 0);
+
+    CHECK(device_snapshot_save("../etc/passwd", devices, 3) == -1);
+    CHECK(device_snapshot_load("0123", &loaded) == -1);
+}
+
+// A truncated file under the token is rewritten, not trusted
+static void test_bad_file_replaced(void) {
+    AudioDevice devices[2];
+    char token[DEVICE_SNAPSHOT_TOKEN_SIZE];
+    char path[1024];
+    make_devices(devices, 2, 1);
+    token_for(devices, 2, token);
+    path_for(token, path, sizeof(path));
+
+    FILE* file = fopen(path, "wb");
+    CHECK(file != NULL);
+    if (file != NULL) {
+        fputs("VADS", file);
+        fclose(file);
+    }
+
+    AudioDevice* loaded;
+    CHECK(device_snapshot_load(token, &loaded) == -1);
+    CHECK(device_snapshot_save(token, devices, 2) == 0);
+    CHECK(device_snapshot_load(token, &loaded) == 2);
+    free(loaded);
+}
+
+static void test_pruned_to_newest(void) {
+    char tokens[DEVICE_SNAPSHOT_KEEP + 8][DEVICE_SNAPSHOT_TOKEN_SIZE];
+    AudioDevice device;
+    int total = DEVICE_SNAPSHOT_KEEP + 8;
+
+    // A directory of its own, so only these snapshots compete
+    strncat(cache_dir, "/prune", sizeof(cache_dir) - strlen(cache_dir) - 1);
+    mkdir(cache_dir, 0700);
+    setenv("XDG_CACHE_HOME", cache_dir, 1);
+
+    for (int i = 0; i < total; i++) {
+        make_devices(&device, 1, 100 + i);
+        token_for(&device, 1, tokens[i]);
+        CHECK(device_snapshot_save(tokens[i], &device, 1) == 0);
+
+        // Spread the modification times so the order doesn't depend on
+        // the file system's timestamp resolution
+        char path[1024];
+        struct utimbuf times = { 1000000 + i, 1000000 + i };
+        path_for(tokens[i], path, sizeof(path));
+        utime(path, &times);
+    }
+
+    // One more save prunes everything but the newest
+    make_devices(&device, 1, 99);
+    char last[DEVICE_SNAPSHOT_TOKEN_SIZE];
+    token_for(&device, 1, last);
+    CHECK(device_snapshot_save(last, &device, 1) == 0);
+
+    int kept = 0;
+    for (int i = 0; i < total; i++) {
+        char path[1024];
+        path_for(tokens[i], path, sizeof(path));
+        bool exists = access(path, F_OK) == 0;
+        if (exists) kept++;
+        if (i >= total - (DEVICE_SNAPSHOT_KEEP - 1)) CHECK(exists);
+    }
+    CHECK(kept == DEVICE_SNAPSHOT_KEEP - 1);
+
+    AudioDevice* loaded;
+    CHECK(device_snapshot_load(last, &loaded) == 1);
+    free(loaded);
+}
+
+int main(void) {
+    snprintf(cache_dir, sizeof(cache_dir), "/tmp/test_device_diff_%d", (int)getpid());
+    mkdir(cache_dir, 0700);
+    setenv("XDG_CACHE_HOME", cache_dir, 1);
+
+    test_round_trip();
+    test_bad_file_replaced();
+    test_pruned_to_newest();
+
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf /tmp/test_device_diff_%d", (int)getpid());
+    CHECK(system(command) == 0);
+    return CHECK_RESULT();
+}
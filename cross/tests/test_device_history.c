@@ -0,0 +1,361 @@
+// test_device_history.c - Ring file appends, torn slots, snapshots and replayed stats
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "device_diff.h"
+#include "device_history.h"
+#include "check.h"
+
+#define CAPACITY DEVICE_HISTORY_MIN_CAPACITY
+#define APPENDERS 4
+#define APPENDER_POLLS 200
+
+static char path[64];
+
+static void make_device(AudioDevice* device, int card, int pcm) {
+    memset(device, 0, sizeof(*device));
+    snprintf(device->id, sizeof(device->id), "hw:%d,%d", card, pcm);
+    snprintf(device->name, sizeof(device->name), "Card %d - PCM %d", card, pcm);
+    device->direction = DEVICE_DIRECTION_PLAYBACK;
+    device->output_channels = 2;
+    device->sample_rate = 48000;
+}
+
+// Timestamps are the writer's clock, so polls are spaced to keep every
+// event on its own microsecond
+static int record_after_pause(DeviceHistoryWriter* writer, const AudioDevice* devices, int count) {
+    usleep(2000);
+    return device_history_record(writer, devices, count);
+}
+
+// The file as the writer left it, read and written around the API the way
+// a crash or a concurrent overwrite would leave it
+typedef struct {
+    void* mapping;
+    size_t size;
+    DeviceHistoryHeader* header;
+    DeviceHistoryRecord* records;
+} RawHistory;
+
+static bool raw_open(RawHistory* raw) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return false;
+    DeviceHistoryHeader header;
+    bool ok = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    raw->size = DEVICE_HISTORY_HEADER_SIZE + (size_t)header.capacity * sizeof(DeviceHistoryRecord);
+    raw->mapping = ok ? mmap(NULL, raw->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (raw->mapping == MAP_FAILED) return false;
+    raw->header = (DeviceHistoryHeader*)raw->mapping;
+    raw->records = (DeviceHistoryRecord*)((char*)raw->mapping + DEVICE_HISTORY_HEADER_SIZE);
+    return true;
+}
+
+static DeviceHistoryRecord* raw_record(RawHistory* raw, uint64_t index) {
+    return &raw->records[index % raw->header->capacity];
+}
+
+static void raw_close(RawHistory* raw) {
+    munmap(raw->mapping, raw->size);
+}
+
+static bool has_device(const DeviceHistoryDevice* devices, int count, const char* id) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(devices[i].id, id) == 0) return true;
+    }
+    return false;
+}
+
+static const DeviceHistoryStats* find_stats(const DeviceHistoryStats* stats, int count, const char* id) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(stats[i].device.id, id) == 0) return &stats[i];
+    }
+    return NULL;
+}
+
+// First snapshot, then only deltas; every slot committed with its index
+static void test_commit_words(void) {
+    unlink(path);
+    DeviceHistoryWriter* writer = device_history_writer_open(path, CAPACITY);
+    CHECK(writer != NULL);
+    if (writer == NULL) return;
+
+    AudioDevice devices[3];
+    for (int i = 0; i < 3; i++) make_device(&devices[i], 0, i);
+    CHECK(device_history_record(writer, devices, 3) == 4);
+    CHECK(record_after_pause(writer, devices, 3) == 0);
+    devices[1].sample_rate = 44100;
+    CHECK(record_after_pause(writer, devices, 3) == 1);
+    devices[1].volume = 0.5f;               // not tracked
+    CHECK(record_after_pause(writer, devices, 3) == 0);
+    CHECK(record_after_pause(writer, devices, 2) == 1);
+    device_history_writer_close(writer);
+
+    RawHistory raw;
+    CHECK(raw_open(&raw));
+    CHECK(raw.header->capacity == CAPACITY);
+    CHECK(raw.header->head == 6);
+    CHECK(raw.header->snapshot == 0);
+    for (uint64_t i = 0; i < raw.header->head; i++) CHECK(raw_record(&raw, i)->commit == i + 1);
+    CHECK(raw_record(&raw, 0)->kind == DEVICE_HISTORY_SNAPSHOT && raw_record(&raw, 0)->changed_fields == 3);
+    CHECK(raw_record(&raw, 4)->kind == DEVICE_HISTORY_MODIFIED);
+    CHECK(raw_record(&raw, 4)->changed_fields == 1u << DEVICE_FIELD_SAMPLE_RATE);
+    CHECK(raw_record(&raw, 5)->kind == DEVICE_HISTORY_REMOVED && strcmp(raw_record(&raw, 5)->id, "hw:0,2") == 0);
+    CHECK(raw_record(&raw, 6)->commit == 0);
+    raw_close(&raw);
+
+    DeviceHistoryReader* reader = device_history_reader_open(path);
+    CHECK(reader != NULL);
+    DeviceHistoryDevice listed[8];
+    int64_t oldest, newest;
+    device_history_span(reader, &oldest, &newest);
+    CHECK(oldest > 0 && newest > oldest);
+    CHECK(device_history_devices_at(reader, oldest - 1, listed, 8) == -1);
+    CHECK(device_history_devices_at(reader, oldest, listed, 8) == 3);
+    CHECK(device_history_devices_at(reader, newest, listed, 8) == 2);
+    CHECK(!has_device(listed, 2, "hw:0,2"));
+    for (int i = 0; i < 2; i++) {
+        if (strcmp(listed[i].id, "hw:0,1") == 0) CHECK(listed[i].sample_rate == 44100);
+    }
+    device_history_reader_close(reader);
+}
+
+// A slot left at commit 0 (a writer that died mid-copy) is skipped; a
+// snapshot missing a member doesn't count, so replay starts at the next
+// complete one
+static void test_torn_slots(void) {
+    unlink(path);
+    DeviceHistoryWriter* writer = device_history_writer_open(path, CAPACITY);
+    CHECK(writer != NULL);
+    if (writer == NULL) return;
+
+    AudioDevice devices[4];
+    for (int i = 0; i < 4; i++) make_device(&devices[i], 1, i);
+    device_history_record(writer, devices, 2);          // 0: snapshot, 1-2: present
+    record_after_pause(writer, devices, 3);             // 3: hw:1,2 added
+    record_after_pause(writer, devices, 4);             // 4: hw:1,3 added
+    device_history_writer_close(writer);
+
+    // A second session appends its own snapshot: 5, then 6-9
+    writer = device_history_writer_open(path, CAPACITY);
+    CHECK(writer != NULL);
+    if (writer == NULL) return;
+    record_after_pause(writer, devices, 4);
+    device_history_writer_close(writer);
+
+    RawHistory raw;
+    CHECK(raw_open(&raw));
+    CHECK(raw.header->head == 10);
+    int64_t first_time = raw_record(&raw, 0)->time_usec;
+    int64_t added_time = raw_record(&raw, 3)->time_usec;
+    int64_t second_time = raw_record(&raw, 5)->time_usec;
+    raw_record(&raw, 3)->commit = 0;
+    raw_close(&raw);
+
+    DeviceHistoryReader* reader = device_history_reader_open(path);
+    CHECK(reader != NULL);
+    DeviceHistoryDevice listed[8];
+    CHECK(device_history_devices_at(reader, added_time, listed, 8) == 2);
+    CHECK(!has_device(listed, 2, "hw:1,2"));
+    CHECK(device_history_devices_at(reader, second_time - 1, listed, 8) == 3);
+    CHECK(has_device(listed, 3, "hw:1,3"));
+    CHECK(device_history_devices_at(reader, second_time, listed, 8) == 4);
+
+    // Overwritten mid-copy: the commit word names another lap of the ring
+    CHECK(raw_open(&raw));
+    raw_record(&raw, 1)->commit = 1 + CAPACITY + 1;
+    raw_close(&raw);
+    CHECK(device_history_devices_at(reader, first_time, listed, 8) == -1);
+    CHECK(device_history_devices_at(reader, second_time - 1, listed, 8) == -1);
+    CHECK(device_history_devices_at(reader, second_time, listed, 8) == 4);
+    int64_t oldest, newest;
+    device_history_span(reader, &oldest, &newest);
+    CHECK(oldest == second_time);           // the first snapshot's own record is intact
+    device_history_reader_close(reader);
+}
+
+// Far past capacity the ring still holds a complete snapshot, older
+// times are out of reach and the newest state replays correctly
+static void test_wrap(void) {
+    unlink(path);
+    DeviceHistoryWriter* writer = device_history_writer_open(path, CAPACITY);
+    CHECK(writer != NULL);
+    if (writer == NULL) return;
+
+    AudioDevice devices[6];
+    for (int i = 0; i < 6; i++) make_device(&devices[i], 2, i);
+    device_history_record(writer, devices, 6);
+    RawHistory raw;
+    CHECK(raw_open(&raw));
+    int64_t start_time = raw_record(&raw, 0)->time_usec;
+
+    // Toggle the last device, two records per round trip
+    int final_count = 6;
+    for (int poll = 1; raw.header->head < 3 * CAPACITY + 7; poll++) {
+        final_count = poll % 2 ? 5 : 6;
+        device_history_record(writer, devices, final_count);
+        CHECK(raw.header->head - raw.header->snapshot < CAPACITY / 2);
+    }
+    uint64_t head = raw.header->head;
+    uint64_t snapshot = raw.header->snapshot;
+    CHECK(head > 3 * CAPACITY);
+    CHECK(snapshot + CAPACITY > head);
+    CHECK(raw_record(&raw, snapshot)->kind == DEVICE_HISTORY_SNAPSHOT);
+    raw_close(&raw);
+    device_history_record(writer, devices, final_count);
+    device_history_writer_close(writer);
+
+    DeviceHistoryReader* reader = device_history_reader_open(path);
+    CHECK(reader != NULL);
+    DeviceHistoryDevice listed[8];
+    int64_t oldest, newest;
+    device_history_span(reader, &oldest, &newest);
+    CHECK(oldest > start_time);
+    CHECK(device_history_devices_at(reader, start_time, listed, 8) == -1);
+    CHECK(device_history_devices_at(reader, newest, listed, 8) == final_count);
+    CHECK(has_device(listed, final_count, "hw:2,4"));
+    CHECK(has_device(listed, final_count, "hw:2,5") == (final_count == 6));
+    device_history_reader_close(reader);
+}
+
+// Uptime, drops, flaps and the shortest gap, against the record times.
+// Reopening is a new session whose snapshot turns what changed while
+// nothing recorded into a drop.
+static void test_stats_and_sessions(void) {
+    unlink(path);
+    DeviceHistoryWriter* writer = device_history_writer_open(path, CAPACITY);
+    CHECK(writer != NULL);
+    if (writer == NULL) return;
+
+    AudioDevice devices[3];
+    for (int i = 0; i < 3; i++) make_device(&devices[i], 3, i);
+    device_history_record(writer, devices, 2);          // 0-2: hw:3,0 and hw:3,1
+    record_after_pause(writer, devices, 1);             // 3: hw:3,1 removed
+    record_after_pause(writer, devices, 2);             // 4: back
+    record_after_pause(writer, devices, 1);             // 5: removed again
+    usleep(10000);
+    record_after_pause(writer, devices, 2);             // 6: back after a longer gap
+    device_history_writer_close(writer);
+
+    // Reopened with another capacity: the file keeps its own
+    writer = device_history_writer_open(path, CAPACITY * 4);
+    CHECK(writer != NULL);
+    if (writer == NULL) return;
+    AudioDevice session[2] = { devices[0], devices[2] };
+    record_after_pause(writer, session, 2);             // 7-9: hw:3,1 gone, hw:3,2 new
+    device_history_writer_close(writer);
+
+    RawHistory raw;
+    CHECK(raw_open(&raw));
+    CHECK(raw.header->capacity == CAPACITY);
+    CHECK(raw.header->head == 10);
+    CHECK(raw.header->snapshot == 7);
+    int64_t t[8];
+    for (int i = 0; i < 8; i++) t[i] = raw_record(&raw, (uint64_t)i)->time_usec;
+    int64_t updated = raw.header->updated_usec;
+    raw_close(&raw);
+    CHECK(updated == t[7]);
+
+    DeviceHistoryReader* reader = device_history_reader_open(path);
+    CHECK(reader != NULL);
+    DeviceHistoryStats stats[8];
+    int count = device_history_stats(reader, 0, 0, stats, 8);
+    CHECK(count == 2);
+
+    const DeviceHistoryStats* steady = find_stats(stats, count, "hw:3,0");
+    CHECK(steady != NULL && steady->present && steady->drops == 0 && steady->flaps == 0);
+    CHECK(steady != NULL && steady->uptime_usec == t[7] - t[0]);
+
+    const DeviceHistoryStats* flapping = find_stats(stats, count, "hw:3,1");
+    CHECK(flapping != NULL && !flapping->present);
+    if (flapping != NULL) {
+        CHECK(flapping->drops == 3);
+        CHECK(flapping->flaps == 2);
+        CHECK(flapping->shortest_gap_usec == t[4] - t[3]);
+        CHECK(flapping->uptime_usec == (t[3] - t[0]) + (t[5] - t[4]) + (t[7] - t[6]));
+        CHECK(flapping->first_seen_usec == t[0]);
+        CHECK(flapping->last_seen_usec == t[7]);
+    }
+
+    // Present only from the last instant on: no time inside the window
+    CHECK(find_stats(stats, count, "hw:3,2") == NULL);
+    count = device_history_stats(reader, 0, t[7] + 1000, stats, 8);
+    CHECK(count == 3);
+    const DeviceHistoryStats* added = find_stats(stats, count, "hw:3,2");
+    CHECK(added != NULL && added->present && added->uptime_usec == 1000 && added->first_seen_usec == t[7]);
+
+    // A window that cuts the first absence: only what lies inside counts
+    int64_t from = t[3] + (t[4] - t[3]) / 2;
+    count = device_history_stats(reader, from, t[6], stats, 8);
+    CHECK(count == 2);
+    flapping = find_stats(stats, count, "hw:3,1");
+    CHECK(flapping != NULL && flapping->present);
+    if (flapping != NULL) {
+        CHECK(flapping->drops == 1);
+        CHECK(flapping->flaps == 2);
+        CHECK(flapping->uptime_usec == t[5] - t[4]);
+    }
+    device_history_reader_close(reader);
+}
+
+static void* appender_main(void* arg) {
+    int card = (int)(intptr_t)arg;
+    DeviceHistoryWriter* writer = device_history_writer_open(path, CAPACITY * 4);
+    CHECK(writer != NULL);
+    AudioDevice devices[3];
+    for (int i = 0; i < 3; i++) make_device(&devices[i], card, i);
+    for (int poll = 0; writer != NULL && poll < APPENDER_POLLS; poll++) {
+        device_history_record(writer, devices, 1 + poll % 3);
+    }
+    device_history_writer_close(writer);
+    return NULL;
+}
+
+// Appenders on one file never share a slot, and each batch lands
+// contiguous: every snapshot is followed by its own members
+static void test_concurrent_appenders(void) {
+    unlink(path);
+    DeviceHistoryWriter* creator = device_history_writer_open(path, CAPACITY * 4);
+    CHECK(creator != NULL);
+
+    pthread_t threads[APPENDERS];
+    for (int i = 0; i < APPENDERS; i++) pthread_create(&threads[i], NULL, appender_main, (void*)(intptr_t)(10 + i));
+    for (int i = 0; i < APPENDERS; i++) pthread_join(threads[i], NULL);
+    device_history_writer_close(creator);
+
+    // Per appender: a 2-record snapshot, then per 3 polls +1, +1, -2
+    uint64_t expected = APPENDERS * (2 + (APPENDER_POLLS - 1) / 3 * 4 + ((APPENDER_POLLS - 1) % 3 >= 1 ? 1 : 0) +
+                                     ((APPENDER_POLLS - 1) % 3 >= 2 ? 1 : 0));
+    RawHistory raw;
+    CHECK(raw_open(&raw));
+    CHECK(raw.header->head == expected);
+    CHECK(raw.header->head < raw.header->capacity);
+    int snapshots = 0;
+    for (uint64_t i = 0; i < raw.header->head; i++) {
+        const DeviceHistoryRecord* record = raw_record(&raw, i);
+        CHECK(record->commit == i + 1);
+        if (record->kind != DEVICE_HISTORY_SNAPSHOT) continue;
+        snapshots++;
+        CHECK(record->changed_fields == 1);
+        const DeviceHistoryRecord* member = raw_record(&raw, i + 1);
+        CHECK(member->kind == DEVICE_HISTORY_PRESENT && member->time_usec == record->time_usec);
+    }
+    CHECK(snapshots == APPENDERS);
+    raw_close(&raw);
+}
+
+int main(void) {
+    snprintf(path, sizeof(path), "/tmp/test_device_history_%d.ring", (int)getpid());
+
+    test_commit_words();
+    test_torn_slots();
+    test_wrap();
+    test_stats_and_sessions();
+    test_concurrent_appenders();
+
+    unlink(path);
+    return CHECK_RESULT();
+}
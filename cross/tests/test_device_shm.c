@@ -0,0 +1,206 @@
+// test_device_shm.c - Concurrent publishers and readers of the shared device table
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "device_shm.h"
+#include "check.h"
+
+#define WRITERS 2
+#define READERS 4
+#define PUBLISHES 20000
+
+static char segment[64];
+static int writers_running;
+static long torn_reads;
+static long good_reads;
+static long busy_reads;
+
+// Every device of one publish carries the same tag, and the count follows
+// from the tag, so a copy mixing two publishes can't pass validate()
+static int expected_count(int tag) {
+    return 1 + (tag % 1000000 * 7 + tag / 1000000) % DEVICE_SHM_MAX_DEVICES;
+}
+
+static int fill(AudioDevice* devices, int tag) {
+    int count = expected_count(tag);
+    memset(devices, 0, (size_t)count * sizeof(AudioDevice));
+    for (int i = 0; i < count; i++) {
+        snprintf(devices[i].name, sizeof(devices[i].name), "device %d of %d", i, tag);
+        memset(devices[i].serial_number, 'a' + tag % 26, sizeof(devices[i].serial_number) - 1);
+        devices[i].device_id_numeric = tag;
+        devices[i].input_channels = i;
+    }
+    return count;
+}
+
+static bool validate(const AudioDevice* devices, int count, int total) {
+    if (count == 0) return total == 0;
+    int tag = devices[0].device_id_numeric;
+    if (count != expected_count(tag) || total != count) return false;
+
+    char name[256];
+    for (int i = 0; i < count; i++) {
+        const AudioDevice* d = &devices[i];
+        snprintf(name, sizeof(name), "device %d of %d", i, tag);
+        if (d->device_id_numeric != tag || d->input_channels != i || strcmp(d->name, name) != 0) return false;
+        for (size_t j = 0; j + 1 < sizeof(d->serial_number); j++) {
+            if (d->serial_number[j] != 'a' + tag % 26) return false;
+        }
+    }
+    return true;
+}
+
+static void* writer_main(void* arg) {
+    int writer = (int)(intptr_t)arg;
+    AudioDevice* devices = malloc(DEVICE_SHM_MAX_DEVICES * sizeof(AudioDevice));
+    DeviceShmPublisher* publisher = device_shm_publisher_open(segment);
+    CHECK(devices != NULL && publisher != NULL);
+
+    for (int i = 0; devices != NULL && publisher != NULL && i < PUBLISHES; i++) {
+        int tag = writer * 1000000 + i;
+        device_shm_publish(publisher, devices, fill(devices, tag));
+    }
+
+    device_shm_publisher_close(publisher, false);
+    free(devices);
+    __atomic_fetch_sub(&writers_running, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void* reader_main(void* arg) {
+    (void)arg;
+    AudioDevice* devices = malloc(DEVICE_SHM_MAX_DEVICES * sizeof(AudioDevice));
+    DeviceShmReader* reader = device_shm_reader_open(segment);
+    CHECK(devices != NULL && reader != NULL);
+
+    while (devices != NULL && reader != NULL && __atomic_load_n(&writers_running, __ATOMIC_ACQUIRE) > 0) {
+        int total = -1;
+        int count = device_shm_read(reader, devices, DEVICE_SHM_MAX_DEVICES, NULL, &total);
+        if (count < 0) {
+            // Writers kept it busy for the whole timeout; retryable
+            CHECK(errno == EAGAIN);
+            __atomic_fetch_add(&busy_reads, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (validate(devices, count, total)) {
+            __atomic_fetch_add(&good_reads, 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_fetch_add(&torn_reads, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    device_shm_reader_close(reader);
+    free(devices);
+    return NULL;
+}
+
+static void test_concurrent_publish_and_read(void) {
+    // Readers open an existing segment, so create it first
+    DeviceShmPublisher* creator = device_shm_publisher_open(segment);
+    CHECK(creator != NULL);
+
+    pthread_t writers[WRITERS];
+    pthread_t readers[READERS];
+    writers_running = WRITERS;
+    for (int i = 0; i < READERS; i++) pthread_create(&readers[i], NULL, reader_main, NULL);
+    for (int i = 0; i < WRITERS; i++) pthread_create(&writers[i], NULL, writer_main, (void*)(intptr_t)i);
+    for (int i = 0; i < WRITERS; i++) pthread_join(writers[i], NULL);
+    for (int i = 0; i < READERS; i++) pthread_join(readers[i], NULL);
+
+    CHECK(torn_reads == 0);
+    CHECK(good_reads > 0);
+    // A reader waits out a preempted publisher instead of giving up, so
+    // timeouts stay rare even with every thread on one CPU
+    printf("reads: %ld good, %ld busy\n", good_reads, busy_reads);
+    CHECK(busy_reads * 100 <= good_reads);
+    device_shm_publisher_close(creator, false);
+}
+
+static void test_truncated_list(void) {
+    AudioDevice* devices = calloc(100, sizeof(AudioDevice));
+    AudioDevice* copy = calloc(DEVICE_SHM_MAX_DEVICES, sizeof(AudioDevice));
+    DeviceShmPublisher* publisher = device_shm_publisher_open(segment);
+    DeviceShmReader* reader = device_shm_reader_open(segment);
+    CHECK(devices != NULL && copy != NULL && publisher != NULL && reader != NULL);
+    if (devices == NULL || copy == NULL || publisher == NULL || reader == NULL) return;
+
+    for (int i = 0; i < 100; i++) devices[i].device_id_numeric = i;
+    CHECK(device_shm_publish(publisher, devices, 100) == DEVICE_SHM_MAX_DEVICES);
+
+    int total = 0;
+    CHECK(device_shm_read(reader, copy, DEVICE_SHM_MAX_DEVICES, NULL, &total) == DEVICE_SHM_MAX_DEVICES);
+    CHECK(total == 100);
+    CHECK(copy[DEVICE_SHM_MAX_DEVICES - 1].device_id_numeric == DEVICE_SHM_MAX_DEVICES - 1);
+
+    total = 0;
+    CHECK(device_shm_read(reader, copy, 10, NULL, &total) == 10);
+    CHECK(total == 100);
+
+    device_shm_reader_close(reader);
+    device_shm_publisher_close(publisher, false);
+    free(devices);
+    free(copy);
+}
+
+static void on_alarm(int sig) {
+    (void)sig;
+    static const char message[] = "publisher stuck behind a dead writer\n";
+    ssize_t written = write(2, message, sizeof(message) - 1);
+    (void)written;
+    _exit(1);
+}
+
+// A publisher that died mid-update leaves writer_pid set and the counter
+// odd; the next one takes over instead of spinning forever
+static void test_dead_writer_taken_over(void) {
+    DeviceShmPublisher* publisher = device_shm_publisher_open(segment);
+    CHECK(publisher != NULL);
+    if (publisher == NULL) return;
+
+    pid_t child = fork();
+    if (child == 0) _exit(0);
+    waitpid(child, NULL, 0);
+
+    int fd = shm_open(segment, O_RDWR, 0);
+    DeviceShmTable* table = mmap(NULL, sizeof(DeviceShmTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(table != MAP_FAILED);
+    if (table == MAP_FAILED) return;
+    table->writer_pid = (int32_t)child;
+    table->seq |= 1;
+
+    signal(SIGALRM, on_alarm);
+    alarm(5);
+    AudioDevice device;
+    memset(&device, 0, sizeof(device));
+    CHECK(device_shm_publish(publisher, &device, 1) == 1);
+    alarm(0);
+
+    CHECK((table->seq & 1) == 0);
+    CHECK(table->writer_pid == 0);
+
+    DeviceShmReader* reader = device_shm_reader_open(segment);
+    CHECK(reader != NULL);
+    CHECK(device_shm_read(reader, &device, 1, NULL, NULL) == 1);
+    device_shm_reader_close(reader);
+
+    munmap(table, sizeof(DeviceShmTable));
+    device_shm_publisher_close(publisher, false);
+}
+
+int main(void) {
+    snprintf(segment, sizeof(segment), "/voxi_test_shm_%d", (int)getpid());
+
+    test_concurrent_publish_and_read();
+    test_truncated_list();
+    test_dead_writer_taken_over();
+
+    shm_unlink(segment);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,149 @@
+// test_meter.c - Loudness against the EBU Tech 3341 test signals, and levels of a known tone
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "meter.h"
+#include "check.h"
+
+#define RATE 48000
+#define BLOCK_FRAMES 1024
+#define TOLERANCE_LU 0.1
+
+static const double PI = 3.141592653589793;
+
+// A stereo 1 kHz sine made of segments at different levels, as Tech 3341
+// specifies its test signals (dBFS of the sine's peak, both channels)
+typedef struct {
+    double level_dbfs;
+    double seconds;
+} Segment;
+
+typedef struct {
+    MeterReading last;
+    int readings;
+    float max_momentary;
+    float max_short_term;
+} Collected;
+
+static void collect(const MeterReading* reading, void* user) {
+    Collected* collected = (Collected*)user;
+    collected->last = *reading;
+    collected->readings++;
+    if (reading->momentary_lufs > collected->max_momentary) collected->max_momentary = reading->momentary_lufs;
+    if (reading->short_term_lufs > collected->max_short_term) collected->max_short_term = reading->short_term_lufs;
+}
+
+static void run_signal(const Segment* segments, int count, Collected* collected) {
+    MeterConfig config;
+    meter_default_config(&config);
+    config.sample_rate = RATE;
+    config.channels = 2;
+    Meter* meter = meter_create(&config);
+    CHECK(meter != NULL);
+    memset(collected, 0, sizeof(*collected));
+    collected->max_momentary = METER_FLOOR_DB;
+    collected->max_short_term = METER_FLOOR_DB;
+    if (meter == NULL) return;
+
+    static float block[BLOCK_FRAMES * 2];
+    long n = 0;
+    for (int s = 0; s < count; s++) {
+        double amplitude = pow(10.0, segments[s].level_dbfs / 20.0);
+        long frames = (long)(segments[s].seconds * RATE + 0.5);
+        while (frames > 0) {
+            long chunk = frames < BLOCK_FRAMES ? frames : BLOCK_FRAMES;
+            for (long i = 0; i < chunk; i++, n++) {
+                float x = (float)(amplitude * sin(2.0 * PI * 1000.0 * n / RATE));
+                block[i * 2] = x;
+                block[i * 2 + 1] = x;
+            }
+            meter_process(meter, block, chunk, collect, collected);
+            frames -= chunk;
+        }
+    }
+    meter_destroy(meter);
+}
+
+static bool near(double value, double expected, double tolerance) {
+    return fabs(value - expected) <= tolerance;
+}
+
+// Cases 1 and 2: a steady tone reads its level on every loudness scale
+static void test_steady(double level) {
+    Segment signal[] = { { level, 20.0 } };
+    Collected c;
+    run_signal(signal, 1, &c);
+    printf("steady %.0f dBFS: M %.2f S %.2f I %.2f LUFS\n", level, c.last.momentary_lufs,
+           c.last.short_term_lufs, c.last.integrated_lufs);
+    CHECK(c.readings > 0);
+    CHECK(near(c.last.momentary_lufs, level, TOLERANCE_LU));
+    CHECK(near(c.last.short_term_lufs, level, TOLERANCE_LU));
+    CHECK(near(c.last.integrated_lufs, level, TOLERANCE_LU));
+
+    // The sine's sample peak and RMS, per channel
+    for (int ch = 0; ch < 2; ch++) {
+        CHECK(near(c.last.peak_db[ch], level, 0.1));
+        CHECK(near(c.last.rms_db[ch], level - 3.01, 0.1));
+    }
+
+    // 1 kHz lands in the loudest band, at the tone's level
+    int loudest = 0;
+    for (int b = 1; b < METER_SPECTRUM_BANDS; b++) {
+        if (c.last.spectrum_db[b] > c.last.spectrum_db[loudest]) loudest = b;
+    }
+    MeterConfig config;
+    meter_default_config(&config);
+    config.sample_rate = RATE;
+    config.channels = 2;
+    Meter* meter = meter_create(&config);
+    if (meter != NULL) {
+        float low = loudest > 0 ? meter_band_hz(meter, loudest - 1) : 0.0f;
+        float high = loudest + 1 < METER_SPECTRUM_BANDS ? meter_band_hz(meter, loudest + 1) : RATE / 2.0f;
+        CHECK(low < 1000.0f && 1000.0f < high);
+        meter_destroy(meter);
+    }
+    CHECK(near(c.last.spectrum_db[loudest], level, 1.0));
+}
+
+// Cases 3 to 5: the gates leave the -23 LUFS part as the integrated
+// loudness, whatever quieter material surrounds it, while momentary and
+// short-term follow the loudest segment
+static void test_gated(const char* name, const Segment* segments, int count, double loudest) {
+    Collected c;
+    run_signal(segments, count, &c);
+    printf("%s: I %.2f LUFS, max M %.2f S %.2f\n", name, c.last.integrated_lufs, c.max_momentary,
+           c.max_short_term);
+    CHECK(near(c.last.integrated_lufs, -23.0, TOLERANCE_LU));
+    CHECK(near(c.max_momentary, loudest, TOLERANCE_LU));
+    CHECK(near(c.max_short_term, loudest, TOLERANCE_LU));
+}
+
+// Nothing measurable yet: the meter reports its floor, not a number
+// computed from silence
+static void test_silence(void) {
+    Segment signal[] = { { -200.0, 5.0 } };
+    Collected c;
+    run_signal(signal, 1, &c);
+    CHECK(c.readings > 0);
+    CHECK(c.last.integrated_lufs == METER_FLOOR_DB);
+    CHECK(c.last.momentary_lufs <= -70.0f);
+}
+
+int main(void) {
+    test_steady(-23.0);
+    test_steady(-33.0);
+
+    // Relative gate
+    static const Segment case3[] = { { -36.0, 10.0 }, { -23.0, 60.0 }, { -36.0, 10.0 } };
+    test_gated("case 3", case3, 3, -23.0);
+    // Absolute gate at -70 LUFS, then the relative one
+    static const Segment case4[] = { { -72.0, 10.0 }, { -36.0, 10.0 }, { -23.0, 60.0 }, { -36.0, 10.0 }, { -72.0, 10.0 } };
+    test_gated("case 4", case4, 5, -23.0);
+    // Louder and quieter parts that average to -23
+    static const Segment case5[] = { { -26.0, 20.0 }, { -20.0, 20.1 }, { -26.0, 20.0 } };
+    test_gated("case 5", case5, 3, -20.0);
+
+    test_silence();
+    return CHECK_RESULT();
+}
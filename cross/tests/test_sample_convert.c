@@ -0,0 +1,285 @@
+// test_sample_convert.c - Every kernel set against the scalar reference, and resampler quality
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "sample_convert.h"
+#include "check.h"
+
+// Odd, so each vector kernel also runs its scalar tail
+#define SAMPLES 4099
+#define MAX_CHANNELS 8
+#define FORMATS 5
+
+static const SampleFormat formats[FORMATS] = {
+    SAMPLE_FORMAT_S16, SAMPLE_FORMAT_S24, SAMPLE_FORMAT_S24_3, SAMPLE_FORMAT_S32, SAMPLE_FORMAT_FLOAT
+};
+static const int channel_counts[] = { 1, 2, 3, 6, 8 };
+#define CHANNEL_COUNTS (int)(sizeof(channel_counts) / sizeof(channel_counts[0]))
+
+typedef struct {
+    uint8_t from_float[FORMATS][SAMPLES * 4];
+    float to_float[FORMATS][SAMPLES];
+    float planes[CHANNEL_COUNTS][SAMPLES];
+    float interleaved[CHANNEL_COUNTS][SAMPLES];
+    float peak[SAMPLES % 64 + 64];
+    float energy[SAMPLES % 64 + 64];
+    float ar[SAMPLES], ai[SAMPLES], br[SAMPLES], bi[SAMPLES];
+} Results;
+
+static float input[SAMPLES];
+static uint8_t native[SAMPLES * 4];
+static float pairs[4][SAMPLES], wr[SAMPLES], wi[SAMPLES];
+static Results reference, results;
+
+// Fixed seed, so a failure reproduces
+static uint32_t next_random(void) {
+    static uint32_t state = 0x9e3779b9u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float random_float(float range) {
+    return ((float)(next_random() >> 8) / 8388608.0f * 2.0f - 1.0f) * range;
+}
+
+static void make_input(void) {
+    // Past full scale too, so clamping is covered
+    for (int i = 0; i < SAMPLES; i++) input[i] = random_float(1.25f);
+    input[0] = 1.0f;
+    input[1] = -1.0f;
+    input[2] = 0.0f;
+    input[3] = -0.0f;
+    for (int i = 0; i < SAMPLES * 4; i++) native[i] = (uint8_t)next_random();
+    for (int i = 0; i < SAMPLES; i++) {
+        for (int k = 0; k < 4; k++) pairs[k][i] = random_float(1.0f);
+        wr[i] = random_float(1.0f);
+        wi[i] = random_float(1.0f);
+    }
+}
+
+static void run_kernels(Results* r) {
+    memset(r, 0, sizeof(*r));
+    for (int f = 0; f < FORMATS; f++) {
+        sample_convert_from_float(formats[f], input, r->from_float[f], SAMPLES);
+        sample_convert_to_float(formats[f], native, r->to_float[f], SAMPLES);
+    }
+
+    // Whole frames of each layout, deinterleaved and put back
+    for (int c = 0; c < CHANNEL_COUNTS; c++) {
+        int channels = channel_counts[c];
+        long frames = SAMPLES / channels;
+        float* planes[MAX_CHANNELS];
+        for (int ch = 0; ch < channels; ch++) planes[ch] = r->planes[c] + ch * frames;
+        sample_deinterleave(input, planes, channels, frames);
+        sample_interleave((const float* const*)planes, r->interleaved[c], channels, frames);
+    }
+
+    // Every length up to a few vectors, then the whole buffer from each
+    // misaligned start
+    int runs = 0;
+    for (long n = 0; n < 64; n++, runs++) {
+        sample_peak_energy(input, n, &r->peak[runs], &r->energy[runs]);
+    }
+    for (long offset = 0; offset < SAMPLES % 64; offset++, runs++) {
+        sample_peak_energy(input + offset, SAMPLES - offset, &r->peak[runs], &r->energy[runs]);
+    }
+
+    memcpy(r->ar, pairs[0], sizeof(r->ar));
+    memcpy(r->ai, pairs[1], sizeof(r->ai));
+    memcpy(r->br, pairs[2], sizeof(r->br));
+    memcpy(r->bi, pairs[3], sizeof(r->bi));
+    sample_butterfly(r->ar, r->ai, r->br, r->bi, wr, wi, SAMPLES);
+}
+
+static void test_matches_scalar(SampleIsa isa) {
+    printf("%s\n", sample_isa_to_string(isa));
+    CHECK(sample_convert_set_isa(SAMPLE_ISA_SCALAR) == 0);
+    run_kernels(&reference);
+
+    CHECK(sample_convert_set_isa(isa) == 0);
+    CHECK(sample_convert_isa() == isa);
+    run_kernels(&results);
+
+    for (int f = 0; f < FORMATS; f++) {
+        CHECK(memcmp(results.from_float[f], reference.from_float[f], sizeof(reference.from_float[f])) == 0);
+        CHECK(memcmp(results.to_float[f], reference.to_float[f], sizeof(reference.to_float[f])) == 0);
+    }
+    for (int c = 0; c < CHANNEL_COUNTS; c++) {
+        CHECK(memcmp(results.planes[c], reference.planes[c], sizeof(reference.planes[c])) == 0);
+        CHECK(memcmp(results.interleaved[c], reference.interleaved[c], sizeof(reference.interleaved[c])) == 0);
+    }
+    CHECK(memcmp(results.peak, reference.peak, sizeof(reference.peak)) == 0);
+    CHECK(memcmp(results.energy, reference.energy, sizeof(reference.energy)) == 0);
+    CHECK(memcmp(results.ar, reference.ar, sizeof(reference.ar)) == 0);
+    CHECK(memcmp(results.ai, reference.ai, sizeof(reference.ai)) == 0);
+    CHECK(memcmp(results.br, reference.br, sizeof(reference.br)) == 0);
+    CHECK(memcmp(results.bi, reference.bi, sizeof(reference.bi)) == 0);
+}
+
+// Resampler: two tones well inside the passband, one per channel so a
+// mixed-up channel shows, converted to 48 kHz from each common rate
+#define OUT_RATE 48000
+#define OUT_FRAMES 9600
+#define SETTLE_FRAMES 512           // filter start-up, left out of the SNR
+#define CHUNK_FRAMES 441            // odd-sized pushes exercise the refill
+#define SNR_FLOOR_DB 100.0
+#define MAX_GAIN_ERROR 1e-4          // 0.001 dB of passband ripple
+#define MAX_DEVIATION 1e-5f
+
+static const int in_rates[] = { 44100, 48000, 96000, 192000 };
+#define IN_RATES (int)(sizeof(in_rates) / sizeof(in_rates[0]))
+static const double tone_hz[2] = { 997.0, 5003.0 };
+static const double tone_amplitude = 0.5;
+static float resampled[OUT_FRAMES * 2], resampled_reference[IN_RATES][OUT_FRAMES * 2];
+
+static float tone(int channel, double seconds) {
+    return (float)(tone_amplitude * sin(2.0 * 3.141592653589793 * tone_hz[channel] * seconds));
+}
+
+// Run a stereo resampler over the tones with the current kernel set.
+// Returns the frames produced.
+static long resample_tones(int in_rate, double ppm, float* out) {
+    Resampler* r = resampler_create(in_rate, OUT_RATE, 2);
+    CHECK(r != NULL);
+    if (r == NULL) return 0;
+    resampler_set_drift(r, ppm);
+
+    float chunk[CHUNK_FRAMES * 2];
+    long next = 0, produced = 0;
+    while (produced < OUT_FRAMES) {
+        for (int i = 0; i < CHUNK_FRAMES; i++) {
+            for (int c = 0; c < 2; c++) chunk[i * 2 + c] = tone(c, (double)(next + i) / in_rate);
+        }
+        long offset = 0;
+        while (offset < CHUNK_FRAMES && produced < OUT_FRAMES) {
+            long consumed;
+            produced += resampler_process(r, chunk + offset * 2, CHUNK_FRAMES - offset, &consumed,
+                                          out + produced * 2, OUT_FRAMES - produced);
+            offset += consumed;
+        }
+        next += offset;
+    }
+    resampler_destroy(r);
+    return produced;
+}
+
+// Signal to noise and distortion: the tone at its known frequency is
+// fitted by least squares (absorbing the filter's small passband gain and
+// any phase offset) and what remains is the noise. Output frame n sits on
+// input frame n * step. *gain_error receives the fitted amplitude's
+// largest relative error.
+static double snr_db(const float* out, int in_rate, double ppm, double* gain_error) {
+    double step = (double)in_rate / OUT_RATE * (1.0 + ppm * 1e-6);
+    double signal = 0.0, noise = 0.0;
+    *gain_error = 0.0;
+    for (int c = 0; c < 2; c++) {
+        double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+        for (long n = SETTLE_FRAMES; n < OUT_FRAMES; n++) {
+            double w = 2.0 * 3.141592653589793 * tone_hz[c] * n * step / in_rate;
+            double y = out[n * 2 + c];
+            ss += sin(w) * sin(w);
+            cc += cos(w) * cos(w);
+            sc += sin(w) * cos(w);
+            ys += y * sin(w);
+            yc += y * cos(w);
+        }
+        double det = ss * cc - sc * sc;
+        double a = (ys * cc - yc * sc) / det;
+        double b = (yc * ss - ys * sc) / det;
+        for (long n = SETTLE_FRAMES; n < OUT_FRAMES; n++) {
+            double w = 2.0 * 3.141592653589793 * tone_hz[c] * n * step / in_rate;
+            double fit = a * sin(w) + b * cos(w);
+            double error = out[n * 2 + c] - fit;
+            signal += fit * fit;
+            noise += error * error;
+        }
+        double gain = fabs(sqrt(a * a + b * b) / tone_amplitude - 1.0);
+        if (gain > *gain_error) *gain_error = gain;
+    }
+    return 10.0 * log10(signal / noise);
+}
+
+static void test_resampler_quality(SampleIsa isa) {
+    CHECK(sample_convert_set_isa(isa) == 0);
+    for (int i = 0; i < IN_RATES; i++) {
+        CHECK(resample_tones(in_rates[i], 0.0, resampled) == OUT_FRAMES);
+        double gain_error;
+        double snr = snr_db(resampled, in_rates[i], 0.0, &gain_error);
+        printf("%s: %d -> %d Hz, SNR %.1f dB, gain error %.1e\n", sample_isa_to_string(isa), in_rates[i],
+               OUT_RATE, snr, gain_error);
+        CHECK(snr >= SNR_FLOOR_DB);
+        CHECK(gain_error <= MAX_GAIN_ERROR);
+
+        // The vector dot products add in another order, so only close
+        if (isa == SAMPLE_ISA_SCALAR) {
+            memcpy(resampled_reference[i], resampled, sizeof(resampled));
+            continue;
+        }
+        float deviation = 0.0f;
+        for (int n = 0; n < OUT_FRAMES * 2; n++) {
+            float d = fabsf(resampled[n] - resampled_reference[i][n]);
+            if (d > deviation) deviation = d;
+        }
+        CHECK(deviation <= MAX_DEVIATION);
+    }
+}
+
+// Drift bends the ratio without costing quality, and input_needed is
+// exactly what process consumes
+static void test_resampler_drift(void) {
+    CHECK(sample_convert_set_isa(SAMPLE_ISA_SCALAR) == 0);
+    static const double drifts[] = { -500.0, 250.0, 1000.0 };
+    for (size_t i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++) {
+        CHECK(resample_tones(48000, drifts[i], resampled) == OUT_FRAMES);
+        double gain_error;
+        CHECK(snr_db(resampled, 48000, drifts[i], &gain_error) >= SNR_FLOOR_DB);
+        CHECK(gain_error <= MAX_GAIN_ERROR);
+    }
+
+    static float in[OUT_FRAMES * 2 * 2], out[OUT_FRAMES];
+    for (long n = 0; n < OUT_FRAMES * 2; n++) in[n] = tone(0, (double)n / 44100);
+    for (size_t i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++) {
+        Resampler* r = resampler_create(44100, OUT_RATE, 1);
+        resampler_set_drift(r, drifts[i]);
+        long needed = resampler_input_needed(r, OUT_FRAMES);
+        double expected = (OUT_FRAMES - 1) * 44100.0 / OUT_RATE * (1.0 + drifts[i] * 1e-6);
+        CHECK(needed > expected && needed < expected + 512);
+
+        // One frame short leaves the last output undone
+        long consumed;
+        CHECK(resampler_process(r, in, needed - 1, &consumed, out, OUT_FRAMES) == OUT_FRAMES - 1);
+        CHECK(consumed == needed - 1);
+        CHECK(resampler_input_needed(r, 1) == 1);
+        CHECK(resampler_process(r, in + consumed, 1, &consumed, out, 1) == 1);
+        CHECK(consumed == 1);
+        CHECK(resampler_input_needed(r, 0) == 0);
+        resampler_destroy(r);
+    }
+
+    CHECK(resampler_create(0, OUT_RATE, 2) == NULL);
+    CHECK(resampler_create(OUT_RATE, OUT_RATE, 0) == NULL);
+}
+
+int main(void) {
+    make_input();
+
+    static const SampleIsa vector_sets[] = { SAMPLE_ISA_SSE2, SAMPLE_ISA_AVX2, SAMPLE_ISA_NEON };
+    for (size_t i = 0; i < sizeof(vector_sets) / sizeof(vector_sets[0]); i++) {
+        if (sample_convert_set_isa(vector_sets[i]) != 0) {
+            printf("%s: not available\n", sample_isa_to_string(vector_sets[i]));
+            continue;
+        }
+        test_matches_scalar(vector_sets[i]);
+    }
+
+    // The scalar set is always there, and goes first as the reference
+    test_resampler_quality(SAMPLE_ISA_SCALAR);
+    for (size_t i = 0; i < sizeof(vector_sets) / sizeof(vector_sets[0]); i++) {
+        if (sample_convert_set_isa(vector_sets[i]) == 0) test_resampler_quality(vector_sets[i]);
+    }
+    test_resampler_drift();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,262 @@
+// wav.c - WAV file input and WAV/W64 output
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "wav.h"
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define WAV_SCRATCH_FRAMES 4096
+
+static uint16_t le16(const unsigned char* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t le32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int fail(WavReader* reader, char* error, size_t error_size, const char* reason) {
+    snprintf(error, error_size, "%s", reason);
+    wav_close_read(reader);
+    return -1;
+}
+
+static SampleFormat wav_sample_format(int code, int bits) {
+    if (code == WAV_FORMAT_FLOAT && bits == 32) return SAMPLE_FORMAT_FLOAT;
+    if (code != WAV_FORMAT_PCM) return SAMPLE_FORMAT_UNKNOWN;
+    switch (bits) {
+        case 16: return SAMPLE_FORMAT_S16;
+        case 24: return SAMPLE_FORMAT_S24_3;
+        case 32: return SAMPLE_FORMAT_S32;
+        default: return SAMPLE_FORMAT_UNKNOWN;
+    }
+}
+
+int wav_open_read(WavReader* reader, const char* path, char* error, size_t error_size) {
+    unsigned char header[12];
+    bool have_format = false;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) return fail(reader, error, error_size, "cannot open file");
+
+    if (fread(header, 1, sizeof(header), reader->file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        return fail(reader, error, error_size, "not a RIFF/WAVE file");
+    }
+
+    // Walk the chunks up to "data"; chunks are padded to an even size
+    for (;;) {
+        unsigned char chunk[8];
+        if (fread(chunk, 1, sizeof(chunk), reader->file) != sizeof(chunk)) {
+            return fail(reader, error, error_size, "no data chunk");
+        }
+        uint32_t size = le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            unsigned char fmt[40] = { 0 };
+            size_t wanted = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (size < 16 || fread(fmt, 1, wanted, reader->file) != wanted) {
+                return fail(reader, error, error_size, "truncated fmt chunk");
+            }
+            if (fseek(reader->file, (long)(size - wanted + (size & 1)), SEEK_CUR) != 0) {
+                return fail(reader, error, error_size, "truncated fmt chunk");
+            }
+
+            // Extensible files carry the real format code at the start of
+            // the subformat GUID
+            int code = le16(fmt);
+            if (code == WAV_FORMAT_EXTENSIBLE && size >= 40) code = le16(fmt + 24);
+            reader->channels = le16(fmt + 2);
+            reader->sample_rate = (int)le32(fmt + 4);
+            reader->format = wav_sample_format(code, le16(fmt + 14));
+            if (reader->format == SAMPLE_FORMAT_UNKNOWN) {
+                return fail(reader, error, error_size, "unsupported sample format");
+            }
+            if (reader->channels <= 0 || reader->sample_rate <= 0) {
+                return fail(reader, error, error_size, "invalid fmt chunk");
+            }
+            have_format = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_format) return fail(reader, error, error_size, "data before fmt chunk");
+            reader->frames = size / ((int64_t)reader->channels * sample_format_bytes(reader->format));
+            reader->remaining = reader->frames;
+            break;
+        } else if (fseek(reader->file, (long)(size + (size & 1)), SEEK_CUR) != 0) {
+            return fail(reader, error, error_size, "truncated chunk");
+        }
+    }
+
+    reader->scratch_frames = WAV_SCRATCH_FRAMES;
+    reader->scratch = malloc((size_t)reader->scratch_frames * reader->channels * sample_format_bytes(reader->format));
+    if (reader->scratch == NULL) return fail(reader, error, error_size, "out of memory");
+    return 0;
+}
+
+long wav_read_float(WavReader* reader, float* out, long frames) {
+    size_t frame_bytes = (size_t)reader->channels * sample_format_bytes(reader->format);
+    long done = 0;
+
+    if (frames > reader->remaining) frames = (long)reader->remaining;
+    while (done < frames) {
+        long chunk = frames - done;
+        if (chunk > reader->scratch_frames) chunk = reader->scratch_frames;
+        size_t got = fread(reader->scratch, frame_bytes, (size_t)chunk, reader->file);
+        if (got == 0) {
+            if (ferror(reader->file)) return -1;
+            reader->remaining = 0;
+            break;
+        }
+        sample_convert_to_float(reader->format, reader->scratch, out + (size_t)done * reader->channels,
+                                (long)got * reader->channels);
+        done += (long)got;
+        reader->remaining -= (int64_t)got;
+    }
+    return done;
+}
+
+void wav_close_read(WavReader* reader) {
+    if (reader->file) fclose(reader->file);
+    free(reader->scratch);
+    reader->file = NULL;
+    reader->scratch = NULL;
+}
+
+// Output
+
+// W64 chunk ids are GUIDs; riff, wave and the chunk names each lead theirs
+static const unsigned char W64_RIFF[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+static const unsigned char W64_WAVE[16] = { 'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const unsigned char W64_FMT[16] = { 'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const unsigned char W64_DATA[16] = { 'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const unsigned char SUBFORMAT_TAIL[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+static void put16(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put32(unsigned char* p, uint32_t v) {
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static void put64(unsigned char* p, uint64_t v) {
+    put32(p, (uint32_t)v);
+    put32(p + 4, (uint32_t)(v >> 32));
+}
+
+// fmt chunk body; more than two channels need WAVE_FORMAT_EXTENSIBLE
+static size_t build_fmt(const WavWriter* w, unsigned char* fmt) {
+    int bytes = sample_format_bytes(w->format);
+    int code = w->format == SAMPLE_FORMAT_FLOAT ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM;
+    bool extensible = w->channels > 2;
+
+    put16(fmt, extensible ? WAV_FORMAT_EXTENSIBLE : (uint32_t)code);
+    put16(fmt + 2, (uint32_t)w->channels);
+    put32(fmt + 4, (uint32_t)w->sample_rate);
+    put32(fmt + 8, (uint32_t)(w->sample_rate * w->channels * bytes));
+    put16(fmt + 12, (uint32_t)(w->channels * bytes));
+    put16(fmt + 14, (uint32_t)(bytes * 8));
+    if (!extensible) return 16;
+
+    put16(fmt + 16, 22);
+    put16(fmt + 18, (uint32_t)(bytes * 8));
+    put32(fmt + 20, 0);                 // no speaker positions
+    put16(fmt + 24, (uint32_t)code);
+    memcpy(fmt + 26, SUBFORMAT_TAIL, sizeof(SUBFORMAT_TAIL));
+    return 40;
+}
+
+// The whole header up to the start of the samples. Returns its length.
+static size_t build_header(const WavWriter* w, unsigned char* header) {
+    unsigned char fmt[40];
+    size_t fmt_size = build_fmt(w, fmt);
+    uint64_t data = (uint64_t)w->data_bytes;
+
+    if (w->w64) {
+        size_t fmt_chunk = (24 + fmt_size + 7) & ~(size_t)7;
+        size_t size = 40 + fmt_chunk + 24;
+        memcpy(header, W64_RIFF, 16);
+        put64(header + 16, size + ((data + 7) & ~(uint64_t)7));
+        memcpy(header + 24, W64_WAVE, 16);
+        memcpy(header + 40, W64_FMT, 16);
+        put64(header + 56, 24 + fmt_size);
+        memset(header + 64, 0, fmt_chunk - 24);
+        memcpy(header + 64, fmt, fmt_size);
+        memcpy(header + 40 + fmt_chunk, W64_DATA, 16);
+        put64(header + 56 + fmt_chunk, 24 + data);
+        return size;
+    }
+
+    size_t size = 12 + 8 + fmt_size + 8;
+    memcpy(header, "RIFF", 4);
+    put32(header + 4, (uint32_t)(size - 8 + data + (data & 1)));
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    put32(header + 16, (uint32_t)fmt_size);
+    memcpy(header + 20, fmt, fmt_size);
+    memcpy(header + 20 + fmt_size, "data", 4);
+    put32(header + 24 + fmt_size, (uint32_t)data);
+    return size;
+}
+
+int wav_open_write(WavWriter* writer, const char* path, SampleFormat format, int sample_rate, int channels, bool w64) {
+    memset(writer, 0, sizeof(*writer));
+    if (format == SAMPLE_FORMAT_UNKNOWN || format == SAMPLE_FORMAT_S24 || channels <= 0 || sample_rate <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    writer->w64 = w64;
+    writer->format = format;
+    writer->sample_rate = sample_rate;
+    writer->channels = channels;
+
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) return -1;
+    setvbuf(writer->file, NULL, _IONBF, 0);
+
+    unsigned char header[128];
+    size_t size = build_header(writer, header);
+    if (fwrite(header, 1, size, writer->file) != size) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int wav_write(WavWriter* writer, const void* data, size_t bytes) {
+    if (fwrite(data, 1, bytes, writer->file) != bytes) return -1;
+    writer->data_bytes += (int64_t)bytes;
+    return 0;
+}
+
+int wav_update_header(WavWriter* writer) {
+    unsigned char header[128];
+    size_t size = build_header(writer, header);
+    if (fseek(writer->file, 0, SEEK_SET) != 0) return -1;
+    int result = fwrite(header, 1, size, writer->file) == size ? 0 : -1;
+    if (fseek(writer->file, 0, SEEK_END) != 0) return -1;
+    return result;
+}
+
+int64_t wav_max_data_bytes(const WavWriter* writer) {
+    // RIFF sizes are 32-bit and count the header too
+    return writer->w64 ? INT64_MAX : (int64_t)0xFFFFFFFFu - 128;
+}
+
+int wav_close_write(WavWriter* writer) {
+    if (writer->file == NULL) return 0;
+
+    // Chunks end on a 2-byte (WAV) or 8-byte (W64) boundary
+    static const unsigned char zeros[8] = { 0 };
+    size_t pad = writer->w64 ? (size_t)((8 - writer->data_bytes % 8) % 8) : (size_t)(writer->data_bytes & 1);
+    int result = fwrite(zeros, 1, pad, writer->file) == pad ? 0 : -1;
+    if (wav_update_header(writer) != 0) result = -1;
+    if (fclose(writer->file) != 0) result = -1;
+    writer->file = NULL;
+    return result;
+}
@@ -0,0 +1,66 @@
+// wav.h - WAV file input and WAV/W64 output
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sample_convert.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    FILE* file;
+    SampleFormat format;        // S16, S24_3, S32 or FLOAT
+    int sample_rate;
+    int channels;
+    int64_t frames;             // total frames in the data chunk
+    int64_t remaining;
+    void* scratch;              // one read's worth of native samples
+    long scratch_frames;
+} WavReader;
+
+// Open a PCM or IEEE float WAV (plain or WAVE_FORMAT_EXTENSIBLE). Returns
+// 0, or -1 with error set to the reason.
+int wav_open_read(WavReader* reader, const char* path, char* error, size_t error_size);
+
+// Read up to frames interleaved frames as float. Returns frames read, 0 at
+// the end of the data, -1 on a read error.
+long wav_read_float(WavReader* reader, float* out, long frames);
+
+void wav_close_read(WavReader* reader);
+
+typedef struct {
+    FILE* file;
+    bool w64;
+    SampleFormat format;
+    int sample_rate;
+    int channels;
+    int64_t data_bytes;
+} WavWriter;
+
+// Create a WAV file, or a Sony Wave64 file when w64 is set (64-bit sizes,
+// for recordings past RIFF's 4 GiB). S24 (24 bits in 32) has no WAV
+// layout; write S24_3 or S32 instead. Header sizes stay provisional until
+// wav_update_header or wav_close_write. Returns 0, or -1 with errno set.
+int wav_open_write(WavWriter* writer, const char* path, SampleFormat format, int sample_rate, int channels, bool w64);
+
+// Append raw interleaved samples in the writer's format, unbuffered so a
+// large write reaches the kernel as one call. Returns 0, or -1.
+int wav_write(WavWriter* writer, const void* data, size_t bytes);
+
+// Rewrite the header for the data written so far
+int wav_update_header(WavWriter* writer);
+
+// Largest data chunk the container can describe
+int64_t wav_max_data_bytes(const WavWriter* writer);
+
+int wav_close_write(WavWriter* writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WAV_H
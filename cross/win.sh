@@ -1,5 +1,5 @@
 # Using MinGW
-gcc -D_WIN32 -DINITGUID -Wall -Wextra -O2 main.c audio_devices.c -o list_audio_devices.exe -lole32 -loleaut32 -luuid -lpropsys -lmmdevapi
+gcc -D_WIN32 -DINITGUID -Wall -Wextra -O2 main.c audio_devices.c device_shm.c device_shm_reader.c device_diff.c latency.c test_tone.c sample_convert.c fanout.c failover.c meter.c wav.c recorder.c pcm_status.c card_power.c device_history.c device_history_reader.c metrics.c -o list_audio_devices.exe -lole32 -loleaut32 -luuid -lpropsys -lmmdevapi
 
 # Using Visual Studio Developer Command Prompt
-# cl /D_WIN32 main.c audio_devices.c /Felist_audio_devices.exe ole32.lib oleaut32.lib uuid.lib
\ No newline at end of file
+# cl /D_WIN32 main.c audio_devices.c device_shm.c device_shm_reader.c device_diff.c latency.c test_tone.c sample_convert.c fanout.c failover.c meter.c wav.c recorder.c pcm_status.c card_power.c device_history.c device_history_reader.c metrics.c /Felist_audio_devices.exe ole32.lib oleaut32.lib uuid.lib
\ No newline at end of file
@@ -1,6 +1,6 @@
 const { app, BrowserWindow, ipcMain, systemPreferences, dialog } = require('electron');
 const path = require('path');
-const { exec } = require('child_process');
+const { exec, execFile, spawn } = require('child_process');
 const os = require('os');
 
 // Disable GPU acceleration to prevent GPU process errors
@@ -95,6 +95,86 @@ ipcMain.handle('get-native-output-devices', async () => {
   }
 });
 
+// Last native snapshot, kept so the binary only has to send what changed
+// (--since <token>) and unchanged devices are not re-mapped
+const nativeSnapshot = {
+  token: null,
+  rawDevices: new Map(),
+  devices: new Map()
+};
+
+// Convert a native device record to our expected format
+function mapNativeDevice(device) {
+  return {
+    name: device.name || 'Unknown Device',
+    id: device.id || 'unknown',
+    deviceType: mapNativeDeviceType(device.type),
+    connectivity: mapNativeConnectionType(device.connection),
+    isDefault: device.is_default || false,
+    platform: os.platform(),
+    type: device.direction === 'capture' ? 'input' : 'output',
+    source: 'native-c'
+  };
+}
+
+// Apply a full list or a delta from the native binary to the cached
+// snapshot. Returns whether anything changed, or null for invalid output.
+function applyNativeSnapshot(result) {
+  if (!result || typeof result.token !== 'string') {
+    return null;
+  }
+
+  if (Array.isArray(result.devices)) {
+    nativeSnapshot.rawDevices.clear();
+    nativeSnapshot.devices.clear();
+    result.devices.forEach(device => {
+      nativeSnapshot.rawDevices.set(device.id, device);
+      nativeSnapshot.devices.set(device.id, mapNativeDevice(device));
+    });
+    nativeSnapshot.token = result.token;
+    return true;
+  }
+
+  if (!Array.isArray(result.added) || !Array.isArray(result.removed) || !Array.isArray(result.modified)) {
+    return null;
+  }
+
+  result.removed.forEach(entry => {
+    nativeSnapshot.rawDevices.delete(entry.id);
+    nativeSnapshot.devices.delete(entry.id);
+  });
+
+  result.added.forEach(device => {
+    nativeSnapshot.rawDevices.set(device.id, device);
+    nativeSnapshot.devices.set(device.id, mapNativeDevice(device));
+  });
+
+  result.modified.forEach(entry => {
+    const raw = nativeSnapshot.rawDevices.get(entry.id);
+    if (!raw) {
+      return;
+    }
+    Object.keys(entry.changes).forEach(field => {
+      raw[field] = entry.changes[field].to;
+    });
+    nativeSnapshot.devices.set(entry.id, mapNativeDevice(raw));
+  });
+
+  nativeSnapshot.token = result.token;
+  return result.added.length > 0 || result.removed.length > 0 || result.modified.length > 0;
+}
+
+// Optional cumulative enumerator metrics (export them with
+// `list_audio_devices --metrics-export FILE`)
+const enumeratorMetricsFile = process.env.AUDIO_ENUM_METRICS_FILE || null;
+
+// Timeouts and fallbacks are only visible from here, so hand them to the
+// enumerator's metrics file
+function countEnumeratorMetric(binaryPath, counter) {
+  if (!enumeratorMetricsFile) return;
+  execFile(binaryPath, ['--metrics-file', enumeratorMetricsFile, '--metrics-count', counter], { timeout: 2000 }, () => {});
+}
+
 // Native C library integration
 async function getNativeAudioDevices() {
   return new Promise((resolve, reject) => {
@@ -116,15 +196,21 @@ async function getNativeAudioDevices() {
       return;
     }
     
-    exec(binaryPath, { timeout: 5000 }, (error, stdout, stderr) => {
+    // Ask only for changes since the snapshot we already hold
+    const args = nativeSnapshot.token ? ['--since', nativeSnapshot.token] : [];
+    if (enumeratorMetricsFile) args.push('--metrics-file', enumeratorMetricsFile);
+    
+    execFile(binaryPath, args, { timeout: 5000 }, (error, stdout, stderr) => {
       if (error) {
         if (error.code === 'ENOENT') {
           console.log('Native binary not executable, falling back to platform-specific detection');
         } else if (error.signal === 'SIGTERM') {
           console.log('Native binary timed out, falling back to platform-specific detection');
+          countEnumeratorMetric(binaryPath, 'timeouts');
         } else {
           console.log(`Native binary error: ${error.message}, falling back to platform-specific detection`);
         }
+        if (error.code !== 'ENOENT') countEnumeratorMetric(binaryPath, 'fallbacks');
         resolve(null);
         return;
       }
@@ -137,6 +223,7 @@ async function getNativeAudioDevices() {
         // Validate output is not empty
         if (!stdout || stdout.trim() === '') {
           console.log('Native binary returned empty output, falling back to platform-specific detection');
+          countEnumeratorMetric(binaryPath, 'fallbacks');
           resolve(null);
           return;
         }
@@ -144,30 +231,23 @@ async function getNativeAudioDevices() {
         // Parse the JSON output from the native binary
         const result = JSON.parse(stdout);
         
-        // Validate result structure
-        if (!result || !Array.isArray(result.devices)) {
+        // Validate result structure and merge it into the cached snapshot
+        const changed = applyNativeSnapshot(result);
+        if (changed === null) {
           console.log('Native binary returned invalid structure, falling back to platform-specific detection');
+          countEnumeratorMetric(binaryPath, 'fallbacks');
           resolve(null);
           return;
         }
         
-        // Convert to our expected format
-        const devices = result.devices.map(device => ({
-          name: device.name || 'Unknown Device',
-          id: device.id || 'unknown',
-          deviceType: mapNativeDeviceType(device.type),
-          connectivity: mapNativeConnectionType(device.connection),
-          isDefault: device.is_default || false,
-          platform: os.platform(),
-          type: 'output',
-          source: 'native-c'
-        }));
+        const devices = Array.from(nativeSnapshot.devices.values());
         
-        console.log(`Native C library detected ${devices.length} audio output devices`);
-        resolve({ devices, platform: os.platform(), source: 'native-c' });
+        console.log(`Native C library detected ${devices.length} audio output devices${changed ? '' : ' (unchanged)'}`);
+        resolve({ devices, platform: os.platform(), source: 'native-c', changed });
       } catch (parseError) {
         console.error('Error parsing native binary output:', parseError.message);
         console.log('Raw output:', stdout);
+        countEnumeratorMetric(binaryPath, 'fallbacks');
         resolve(null);
       }
     });
@@ -501,4 +581,69 @@ ipcMain.handle('get-cross-referenced-devices', async () => {
       crossReferenceEnabled: false 
     };
   }
-});
\ No newline at end of file
+});
+
+// Level meters come from the native binary's --meter stream, one process
+// per metered capture device, so the renderer needs no Web Audio graph
+const levelMeters = new Map();
+
+function nativeBinaryPath() {
+  const name = os.platform() === 'win32' ? 'list_audio_devices.exe' : 'list_audio_devices';
+  return path.join(__dirname, 'cross', name);
+}
+
+ipcMain.handle('start-level-meter', (event, deviceId, publishHz) => {
+  if (levelMeters.has(deviceId)) {
+    return true;
+  }
+  
+  const args = ['--meter', deviceId, '--meter-rate', String(publishHz || 20)];
+  const child = spawn(nativeBinaryPath(), args, { stdio: ['ignore', 'pipe', 'pipe'] });
+  const sender = event.sender;
+  let pending = '';
+  let header = null;
+  
+  // The first line describes the stream; every later line is a reading
+  child.stdout.on('data', (chunk) => {
+    pending += chunk.toString();
+    const lines = pending.split('\n');
+    pending = lines.pop();
+    for (const line of lines) {
+      if (!line.trim()) continue;
+      try {
+        const message = JSON.parse(line);
+        if (header === null) {
+          header = message;
+          continue;
+        }
+        if (!sender.isDestroyed()) {
+          sender.send('level-meter-reading', { deviceId, bandHz: header.band_hz, reading: message });
+        }
+      } catch (error) {
+        console.warn('Unparseable meter line:', line);
+      }
+    }
+  });
+  child.stderr.on('data', (chunk) => console.warn(`Meter ${deviceId}:`, chunk.toString().trim()));
+  child.on('error', (error) => console.error(`Meter ${deviceId} failed:`, error.message));
+  child.on('exit', () => levelMeters.delete(deviceId));
+  
+  levelMeters.set(deviceId, child);
+  return true;
+});
+
+ipcMain.handle('stop-level-meter', (event, deviceId) => {
+  const child = levelMeters.get(deviceId);
+  if (child) {
+    child.kill('SIGTERM');
+    levelMeters.delete(deviceId);
+  }
+  return true;
+});
+
+app.on('will-quit', () => {
+  for (const child of levelMeters.values()) {
+    child.kill('SIGTERM');
+  }
+  levelMeters.clear();
+});
@@ -6,7 +6,16 @@ contextBridge.exposeInMainWorld('nativeAudio', {
   getNativeOutputDevices: () => ipcRenderer.invoke('get-native-output-devices'),
   
   // Get cross-referenced devices (native + Web Audio API matching)
-  getCrossReferencedDevices: () => ipcRenderer.invoke('get-cross-referenced-devices')
+  getCrossReferencedDevices: () => ipcRenderer.invoke('get-cross-referenced-devices'),
+  
+  // Stream peak/RMS/loudness/spectrum readings for a capture or monitor device
+  startLevelMeter: (deviceId, publishHz) => ipcRenderer.invoke('start-level-meter', deviceId, publishHz),
+  stopLevelMeter: (deviceId) => ipcRenderer.invoke('stop-level-meter', deviceId),
+  onLevelMeterReading: (callback) => {
+    const listener = (event, message) => callback(message);
+    ipcRenderer.on('level-meter-reading', listener);
+    return () => ipcRenderer.removeListener('level-meter-reading', listener);
+  }
 });
 
 // Expose platform information
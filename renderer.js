@@ -9,77 +9,336 @@ function updateStatus(message, type = 'info') {
     statusDiv.className = `status ${type}`;
 }
 
-// Removed enumerate audio input devices functionality - only supporting output devices
-
-// Removed native input device enumeration functionality - only supporting output devices
-
-function displayOutputDevices(devices, platform, source) {
-    outputDeviceList.innerHTML = '';
+// Windowed, keyed list rendering for large device tables. Only rows in
+// the viewport (plus a small overscan) exist in the DOM, rows are matched
+// to items by key and updated in place, and every DOM write for a refresh
+// or scroll happens in a single animation frame. Rows keep their natural
+// height: each one is measured after it is laid out, heights are cached
+// by key, and positions are prefix sums over that cache, with the average
+// measured height standing in for rows not seen yet.
+class VirtualList {
+    constructor(container, { getKey, createRow, updateRow, maxHeight = 600, overscan = 4, gap = 10, estimatedHeight = 120 }) {
+        this.getKey = getKey;
+        this.createRow = createRow;
+        this.updateRow = updateRow;
+        this.overscan = overscan;
+        this.gap = gap;
+        this.items = [];
+        this.keys = [];
+        this.heights = new Map();
+        this.measuredSum = 0;
+        this.estimate = estimatedHeight + gap;
+        this.offsets = new Float64Array(1);
+        this.offsetsValid = true;
+        this.rows = new Map();
+        this.pool = [];
+        this.frame = 0;
+        
+        this.viewport = document.createElement('div');
+        this.viewport.style.cssText = `position: relative; overflow-y: auto; max-height: ${maxHeight}px; text-align: left;`;
+        this.spacer = document.createElement('div');
+        this.spacer.style.cssText = 'position: relative; width: 100%;';
+        this.viewport.appendChild(this.spacer);
+        container.appendChild(this.viewport);
+        
+        this.viewport.addEventListener('scroll', () => this.schedule(), { passive: true });
+        
+        // Rows laid out while the list was hidden measure 0 and aren't
+        // cached; showing or resizing the list measures them again
+        if (typeof ResizeObserver !== 'undefined') {
+            new ResizeObserver(() => this.schedule()).observe(this.viewport);
+        }
+    }
     
-    devices.forEach((device, index) => {
-        const deviceDiv = document.createElement('div');
-        const isNativeSource = source === 'native-c' || device.source === 'native-c';
-        const borderColor = isNativeSource ? '#dc3545' : '#28a745';
-        const backgroundColor = isNativeSource ? '#fff5f5' : '#f8fff9';
-        
-        deviceDiv.style.cssText = `
-            border: 1px solid ${borderColor};
-            border-radius: 5px;
-            padding: 15px;
-            margin: 10px 0;
-            background: ${backgroundColor};
-        `;
-        
-        let deviceInfo = `
-            <strong>Output Device ${index + 1}:</strong> ${device.name}<br>
-            <strong>ID:</strong> ${device.id}<br>
-            <strong>Platform:</strong> ${platform}<br>
-            <strong>Type:</strong> <span style="color: #007bff;">${device.deviceType || 'unknown'}</span><br>
-            <strong>Connectivity:</strong> <span style="color: #28a745;">${device.connectivity || 'unknown'}</span><br>
-        `;
+    setItems(items) {
+        // Duplicate keys get the index appended so every row stays unique
+        const keys = new Array(items.length);
+        const seen = new Set();
+        for (let i = 0; i < items.length; i++) {
+            let key = this.getKey(items[i]);
+            if (seen.has(key)) {
+                key = `${key}#${i}`;
+            }
+            seen.add(key);
+            keys[i] = key;
+        }
         
-        // Show source information with enhanced details
-        if (isNativeSource) {
-            deviceInfo += `<strong>Source:</strong> <span style="color: #dc3545; font-weight: bold;">Native C Library</span><br>`;
-            if (device.isDefault) {
-                deviceInfo += `<strong>Status:</strong> <span style="color: #ffc107; font-weight: bold;">🔊 Default Device</span><br>`;
+        // Forget the heights of items that are gone
+        this.heights.forEach((height, key) => {
+            if (!seen.has(key)) {
+                this.measuredSum -= height;
+                this.heights.delete(key);
             }
-        } else {
-            const sourceLabels = {
-                'windows-modern-api': '🪟 Windows Modern API',
-                'windows-wmi': '🪟 Windows WMI',
-                'windows-api': '🪟 Windows API'
-            };
-            const sourceLabel = sourceLabels[device.source] || 'Platform API';
-            deviceInfo += `<strong>Source:</strong> <span style="color: #6c757d;">${sourceLabel}</span><br>`;
-            
-            if (device.isDefault) {
-                deviceInfo += `<strong>Status:</strong> <span style="color: #ffc107; font-weight: bold;">🔊 Default Device</span><br>`;
+        });
+        
+        this.items = items;
+        this.keys = keys;
+        this.offsetsValid = false;
+        this.schedule();
+    }
+    
+    schedule() {
+        if (this.frame) {
+            return;
+        }
+        this.frame = requestAnimationFrame(() => {
+            this.frame = 0;
+            this.render();
+        });
+    }
+    
+    // offsets[i] is the top of item i and offsets[length] the total height
+    layout() {
+        if (this.offsetsValid) {
+            return;
+        }
+        const count = this.items.length;
+        const offsets = new Float64Array(count + 1);
+        for (let i = 0; i < count; i++) {
+            const height = this.heights.get(this.keys[i]);
+            offsets[i + 1] = offsets[i] + (height === undefined ? this.estimate : height);
+        }
+        this.offsets = offsets;
+        this.offsetsValid = true;
+    }
+    
+    // Index of the item covering position y
+    indexAt(y) {
+        const offsets = this.offsets;
+        let low = 0;
+        let high = this.items.length - 1;
+        while (low < high) {
+            const mid = (low + high + 1) >> 1;
+            if (offsets[mid] <= y) {
+                low = mid;
+            } else {
+                high = mid - 1;
             }
         }
+        return Math.max(0, low);
+    }
+    
+    render() {
+        const items = this.items;
+        this.layout();
+        
+        // Read scroll state before any writes to avoid forced layouts
+        const scrollTop = this.viewport.scrollTop;
+        const viewportHeight = this.viewport.clientHeight || this.estimate * 10;
+        const anchor = this.indexAt(scrollTop);
+        const anchorTop = this.offsets[anchor];
+        const first = Math.max(0, anchor - this.overscan);
+        const last = items.length === 0 ? 0 :
+            Math.min(items.length, this.indexAt(scrollTop + viewportHeight) + 1 + this.overscan);
+        
+        const visible = new Map();
+        for (let i = first; i < last; i++) {
+            visible.set(this.keys[i], i);
+        }
+        
+        // Rows whose item scrolled out or disappeared are recycled
+        const stale = [];
+        this.rows.forEach((row, key) => {
+            if (!visible.has(key)) {
+                stale.push(row);
+                this.rows.delete(key);
+            }
+        });
         
-        // Platform-specific information
-        if (platform === 'darwin') {
-            deviceInfo += `
-                <strong>Manufacturer:</strong> ${device.manufacturer || 'N/A'}<br>
-                <strong>Output Channels:</strong> ${device.outputChannels || 'N/A'}<br>
-                <strong>Sample Rate:</strong> ${device.sampleRate || 'N/A'}<br>
-            `;
-        } else if (platform === 'win32') {
-            deviceInfo += `
-                <strong>Manufacturer:</strong> ${device.manufacturer || 'N/A'}<br>
-                <strong>Status:</strong> ${device.status || 'N/A'}<br>
-            `;
-        } else if (platform === 'linux') {
-            deviceInfo += `
-                <strong>Driver:</strong> ${device.driver || 'ALSA'}<br>
-                ${device.description ? `<strong>Description:</strong> ${device.description}<br>` : ''}
-            `;
+        this.spacer.style.height = `${this.offsets[items.length]}px`;
+        
+        visible.forEach((index, key) => {
+            let row = this.rows.get(key);
+            if (!row) {
+                row = stale.pop() || this.pool.pop() || this.createRow();
+                if (!row.parentNode) {
+                    this.spacer.appendChild(row);
+                }
+                row.style.position = 'absolute';
+                row.style.left = '0';
+                row.style.right = '0';
+                row.style.boxSizing = 'border-box';
+                row.style.display = '';
+                this.rows.set(key, row);
+            }
+            const top = `${this.offsets[index]}px`;
+            if (row.style.top !== top) {
+                row.style.top = top;
+            }
+            this.updateRow(row, items[index], index);
+        });
+        
+        stale.forEach(row => {
+            row.style.display = 'none';
+            this.pool.push(row);
+        });
+        
+        // Measure once every write is done, so the frame lays out only once
+        let changed = false;
+        visible.forEach((index, key) => {
+            const height = this.rows.get(key).offsetHeight;
+            if (!height) {
+                return;
+            }
+            const measured = height + this.gap;
+            const previous = this.heights.get(key);
+            if (previous !== measured) {
+                this.measuredSum += measured - (previous || 0);
+                this.heights.set(key, measured);
+                changed = true;
+            }
+        });
+        if (!changed) {
+            return;
         }
         
-        deviceDiv.innerHTML = deviceInfo;
-        outputDeviceList.appendChild(deviceDiv);
+        // Place the rows again with their real heights, keeping the item at
+        // the top of the viewport where the user sees it
+        this.estimate = this.measuredSum / this.heights.size;
+        this.offsetsValid = false;
+        this.layout();
+        const shift = this.offsets[anchor] - anchorTop;
+        if (shift) {
+            this.viewport.scrollTop = scrollTop + shift;
+        }
+        this.schedule();
+    }
+}
+
+// Build a row from a template once and cache its data-field elements
+function createTemplateRow(html) {
+    const row = document.createElement('div');
+    row.innerHTML = html;
+    row.fields = {};
+    row.querySelectorAll('[data-field]').forEach(el => { row.fields[el.dataset.field] = el; });
+    return row;
+}
+
+// In-place updates that skip the DOM when nothing changed
+function setText(el, text) {
+    const value = String(text);
+    if (el.textContent !== value) {
+        el.textContent = value;
+    }
+}
+
+function setShown(el, shown) {
+    const display = shown ? '' : 'none';
+    if (el.style.display !== display) {
+        el.style.display = display;
+    }
+}
+
+// Style values are cached because the browser normalizes what it reports
+function setStyle(el, styles) {
+    const cache = el.styleCache || (el.styleCache = {});
+    Object.keys(styles).forEach(prop => {
+        if (cache[prop] !== styles[prop]) {
+            cache[prop] = styles[prop];
+            el.style[prop] = styles[prop];
+        }
     });
+}
+
+// Removed enumerate audio input devices functionality - only supporting output devices
+
+// Removed native input device enumeration functionality - only supporting output devices
+
+const outputSourceLabels = {
+    'windows-modern-api': '🪟 Windows Modern API',
+    'windows-wmi': '🪟 Windows WMI',
+    'windows-api': '🪟 Windows API'
+};
+
+const outputDeviceRowTemplate = `
+    <strong>Output Device <span data-field="index"></span>:</strong> <span data-field="name"></span><br>
+    <strong>ID:</strong> <span data-field="id"></span><br>
+    <strong>Platform:</strong> <span data-field="platform"></span><br>
+    <strong>Type:</strong> <span style="color: #007bff;" data-field="deviceType"></span><br>
+    <strong>Connectivity:</strong> <span style="color: #28a745;" data-field="connectivity"></span><br>
+    <strong>Source:</strong> <span data-field="source"></span><br>
+    <span data-field="defaultLine"><strong>Status:</strong> <span style="color: #ffc107; font-weight: bold;">🔊 Default Device</span><br></span>
+    <span data-field="darwinLines">
+        <strong>Manufacturer:</strong> <span data-field="darwinManufacturer"></span><br>
+        <strong>Output Channels:</strong> <span data-field="outputChannels"></span><br>
+        <strong>Sample Rate:</strong> <span data-field="sampleRate"></span><br>
+    </span>
+    <span data-field="win32Lines">
+        <strong>Manufacturer:</strong> <span data-field="win32Manufacturer"></span><br>
+        <strong>Status:</strong> <span data-field="status"></span><br>
+    </span>
+    <span data-field="linuxLines">
+        <strong>Driver:</strong> <span data-field="driver"></span><br>
+        <span data-field="descriptionLine"><strong>Description:</strong> <span data-field="description"></span><br></span>
+    </span>
+`;
+
+let outputDeviceView = null;
+let outputDevicePlatform = '';
+let outputDeviceSource = '';
+
+function updateOutputDeviceRow(row, device, index) {
+    const f = row.fields;
+    const platform = outputDevicePlatform;
+    const isNativeSource = outputDeviceSource === 'native-c' || device.source === 'native-c';
+    const borderColor = isNativeSource ? '#dc3545' : '#28a745';
+    const backgroundColor = isNativeSource ? '#fff5f5' : '#f8fff9';
+    
+    setStyle(row, {
+        border: `1px solid ${borderColor}`,
+        borderRadius: '5px',
+        padding: '15px',
+        background: backgroundColor
+    });
+    setText(f.index, index + 1);
+    setText(f.name, device.name);
+    setText(f.id, device.id);
+    setText(f.platform, platform);
+    setText(f.deviceType, device.deviceType || 'unknown');
+    setText(f.connectivity, device.connectivity || 'unknown');
+    
+    // Show source information with enhanced details
+    if (isNativeSource) {
+        setText(f.source, 'Native C Library');
+        setStyle(f.source, { color: '#dc3545', fontWeight: 'bold' });
+    } else {
+        setText(f.source, outputSourceLabels[device.source] || 'Platform API');
+        setStyle(f.source, { color: '#6c757d', fontWeight: 'normal' });
+    }
+    setShown(f.defaultLine, !!device.isDefault);
+    
+    // Platform-specific information
+    setShown(f.darwinLines, platform === 'darwin');
+    setShown(f.win32Lines, platform === 'win32');
+    setShown(f.linuxLines, platform === 'linux');
+    if (platform === 'darwin') {
+        setText(f.darwinManufacturer, device.manufacturer || 'N/A');
+        setText(f.outputChannels, device.outputChannels || 'N/A');
+        setText(f.sampleRate, device.sampleRate || 'N/A');
+    } else if (platform === 'win32') {
+        setText(f.win32Manufacturer, device.manufacturer || 'N/A');
+        setText(f.status, device.status || 'N/A');
+    } else if (platform === 'linux') {
+        setText(f.driver, device.driver || 'ALSA');
+        setShown(f.descriptionLine, !!device.description);
+        setText(f.description, device.description || '');
+    }
+}
+
+function displayOutputDevices(devices, platform, source) {
+    if (!outputDeviceView) {
+        outputDeviceList.innerHTML = '';
+        outputDeviceView = new VirtualList(outputDeviceList, {
+            getKey: device => device.id,
+            createRow: () => createTemplateRow(outputDeviceRowTemplate),
+            updateRow: updateOutputDeviceRow
+        });
+    }
+    
+    // Rows are keyed by device id, so a refresh only touches what changed
+    outputDevicePlatform = platform;
+    outputDeviceSource = source;
+    outputDeviceView.setItems(devices);
     
     outputDeviceInfo.style.display = 'block';
     
@@ -323,6 +582,156 @@ async function crossReferenceDevices() {
     }
 }
 
+const confidenceOrder = { high: 3, medium: 2, low: 1 };
+
+const confidenceColors = {
+    high: '#28a745',
+    medium: '#ffc107',
+    low: '#6c757d'
+};
+
+const matchTypeLabels = {
+    'name-exact': 'Exact Name Match',
+    'name-substring': 'Substring Match',
+    'keywords-match': 'Keyword Match',
+    'fuzzy-similarity': 'Fuzzy Text Similarity',
+    'brand-match': 'Brand/Manufacturer Match',
+    'name-partial': 'Partial Name Match', // Legacy fallback
+    'no-match': 'No Match'
+};
+
+const codeStyle = 'font-size: 0.8em; background: #e9ecef; padding: 2px 4px; border-radius: 3px;';
+
+const crossRefSummaryTemplate = `
+    <div style="background: #f8f9fa; padding: 15px; border-radius: 8px; margin: 10px 0;">
+        <h4>📊 Cross-Reference Analysis Summary</h4>
+        <p><strong>Platform:</strong> <span data-field="platform"></span></p>
+        <p><strong>Source:</strong> <span data-field="source"></span></p>
+        <p><strong>Total Native Devices:</strong> <span data-field="nativeTotal"></span></p>
+        <p><strong>Total Web Audio Devices:</strong> <span data-field="webTotal"></span></p>
+        <p><strong>Successfully Matched:</strong> <span data-field="matched"></span> <span style="color: #28a745;">✓</span></p>
+        <p><strong>Unmatched Native:</strong> <span data-field="unmatchedNative"></span> <span style="color: #ffc107;">⚠</span></p>
+        <p><strong>Unmatched Web Audio:</strong> <span data-field="unmatchedWeb"></span> <span style="color: #dc3545;">⚠</span></p>
+        <p><strong>Match Rate:</strong> <span data-field="matchRate"></span>%</p>
+        <hr>
+        <p style="font-size: 0.9em; color: #6c757d;">
+            <strong>Note:</strong> Web Audio API uses encrypted/hashed device IDs for security. 
+            Matching is primarily done via device names and characteristics rather than raw device IDs.
+        </p>
+    </div>
+`;
+
+const matchRowTemplate = `
+    <div style="display: flex; justify-content: space-between; align-items: center; margin-bottom: 10px;">
+        <strong style="font-size: 1.1em;">Match <span data-field="index"></span></strong>
+        <span style="color: white; padding: 3px 8px; border-radius: 12px; font-size: 0.8em; font-weight: bold;" data-field="confidence"></span>
+    </div>
+    <p style="margin: 5px 0;">
+        <strong>Strategy:</strong> <span data-field="strategy"></span>
+        <span style="color: #6c757d; font-size: 0.9em;" data-field="score"></span>
+    </p>
+    <div style="display: grid; grid-template-columns: 1fr 1fr; gap: 15px; margin-top: 10px;">
+        <div style="background: #f8f9fa; padding: 10px; border-radius: 5px;">
+            <strong style="color: #495057;">🔧 Native System API</strong><br>
+            <strong>Name:</strong> <span data-field="nativeName"></span><br>
+            <strong>ID:</strong> <code style="${codeStyle}" data-field="nativeId"></code><br>
+            <strong>Type:</strong> <span data-field="nativeType"></span> | <strong>Connection:</strong> <span data-field="nativeConnectivity"></span>
+            <span data-field="nativeDefault"><br><span style="color: #ffc107;">🔊 Default Device</span></span>
+        </div>
+        <div style="background: #f8f9fa; padding: 10px; border-radius: 5px;">
+            <strong style="color: #495057;">🌐 Web Audio API</strong><br>
+            <strong>Label:</strong> <span data-field="webLabel"></span><br>
+            <strong>Device ID:</strong> <code style="${codeStyle}" data-field="webDeviceId"></code><br>
+            <strong>Group ID:</strong> <code style="${codeStyle}" data-field="webGroupId"></code>
+        </div>
+    </div>
+`;
+
+const unmatchedNativeRowTemplate = `
+    <strong data-field="name"></strong><br>
+    ID: <span data-field="id"></span><br>
+    Type: <span data-field="deviceType"></span> | Connectivity: <span data-field="connectivity"></span>
+`;
+
+const unmatchedWebRowTemplate = `
+    <strong data-field="label"></strong><br>
+    ID: <span data-field="deviceId"></span><br>
+    Group ID: <span data-field="groupId"></span>
+`;
+
+function updateMatchRow(row, match, index) {
+    const f = row.fields;
+    const confidenceColor = confidenceColors[match.confidence];
+    
+    setStyle(row, {
+        background: '#d4edda',
+        padding: '15px',
+        borderRadius: '8px',
+        borderLeft: `4px solid ${confidenceColor}`
+    });
+    setText(f.index, index + 1);
+    setText(f.confidence, `${match.confidence.toUpperCase()} CONFIDENCE`);
+    setStyle(f.confidence, { background: confidenceColor });
+    setText(f.strategy, matchTypeLabels[match.matchType] || match.matchType);
+    setText(f.score, match.score ? ` (Score: ${Math.round(match.score)}/100)` : '');
+    setText(f.nativeName, match.native.name);
+    setText(f.nativeId, match.native.id);
+    setText(f.nativeType, match.native.deviceType);
+    setText(f.nativeConnectivity, match.native.connectivity);
+    setShown(f.nativeDefault, !!match.native.isDefault);
+    setText(f.webLabel, match.webAudio.label);
+    setText(f.webDeviceId, match.webAudio.deviceId);
+    setText(f.webGroupId, match.webAudio.groupId);
+}
+
+function updateUnmatchedNativeRow(row, device) {
+    const f = row.fields;
+    setStyle(row, { background: '#fff3cd', padding: '10px', borderRadius: '5px' });
+    setText(f.name, device.name);
+    setText(f.id, device.id);
+    setText(f.deviceType, device.deviceType);
+    setText(f.connectivity, device.connectivity);
+}
+
+function updateUnmatchedWebRow(row, device) {
+    const f = row.fields;
+    setStyle(row, { background: '#f8d7da', padding: '10px', borderRadius: '5px' });
+    setText(f.label, device.label || 'Unknown Device');
+    setText(f.deviceId, device.deviceId);
+    setText(f.groupId, device.groupId);
+}
+
+// Built once; later results update the summary and lists in place
+let crossRefView = null;
+
+function createCrossRefView(content) {
+    const summary = createTemplateRow(crossRefSummaryTemplate);
+    content.appendChild(summary);
+    
+    const addList = (title, gap, getKey, template, updateRow) => {
+        const section = document.createElement('div');
+        section.innerHTML = `<h4>${title}</h4>`;
+        content.appendChild(section);
+        const list = new VirtualList(section, {
+            getKey,
+            gap,
+            createRow: () => createTemplateRow(template),
+            updateRow
+        });
+        return { section, list };
+    };
+    
+    return {
+        summary,
+        matches: addList('✅ Successfully Matched Devices', 10, match => match.native.id,
+            matchRowTemplate, updateMatchRow),
+        unmatchedNative: addList('⚠️ Unmatched Native Devices', 5, device => device.id,
+            unmatchedNativeRowTemplate, updateUnmatchedNativeRow),
+        unmatchedWeb: addList('⚠️ Unmatched Web Audio Devices', 5, device => device.deviceId,
+            unmatchedWebRowTemplate, updateUnmatchedWebRow)
+    };
+}
+
 // Display cross-reference results
 function displayCrossReferenceResults(matches, unmatchedNative, unmatchedWeb, crossRefResult) {
     // Create or update cross-reference section
@@ -336,114 +745,30 @@ function displayCrossReferenceResults(matches, unmatchedNative, unmatchedWeb, cr
         `;
         document.body.appendChild(crossRefSection);
     }
-    
-    const content = document.getElementById('crossRefContent');
-    let html = `
-        <div style="background: #f8f9fa; padding: 15px; border-radius: 8px; margin: 10px 0;">
-            <h4>📊 Cross-Reference Analysis Summary</h4>
-            <p><strong>Platform:</strong> ${crossRefResult.platform}</p>
-            <p><strong>Source:</strong> ${crossRefResult.source}</p>
-            <p><strong>Total Native Devices:</strong> ${crossRefResult.nativeDevices.length}</p>
-            <p><strong>Total Web Audio Devices:</strong> ${matches.length + unmatchedWeb.length}</p>
-            <p><strong>Successfully Matched:</strong> ${matches.length} <span style="color: #28a745;">✓</span></p>
-            <p><strong>Unmatched Native:</strong> ${unmatchedNative.length} <span style="color: #ffc107;">⚠</span></p>
-            <p><strong>Unmatched Web Audio:</strong> ${unmatchedWeb.length} <span style="color: #dc3545;">⚠</span></p>
-            <p><strong>Match Rate:</strong> ${crossRefResult.nativeDevices.length > 0 ? Math.round((matches.length / crossRefResult.nativeDevices.length) * 100) : 0}%</p>
-            <hr>
-            <p style="font-size: 0.9em; color: #6c757d;">
-                <strong>Note:</strong> Web Audio API uses encrypted/hashed device IDs for security. 
-                Matching is primarily done via device names and characteristics rather than raw device IDs.
-            </p>
-        </div>
-    `;
-    
-    // Show matches
-    if (matches.length > 0) {
-        html += '<h4>✅ Successfully Matched Devices</h4>';
-        // Sort matches by confidence level
-        const sortedMatches = matches.sort((a, b) => {
-            const confidenceOrder = { high: 3, medium: 2, low: 1 };
-            return confidenceOrder[b.confidence] - confidenceOrder[a.confidence];
-        });
-        
-        sortedMatches.forEach((match, index) => {
-            const confidenceColor = {
-                high: '#28a745',
-                medium: '#ffc107', 
-                low: '#6c757d'
-            }[match.confidence];
-            
-            const matchTypeLabels = {
-                'name-exact': 'Exact Name Match',
-                'name-substring': 'Substring Match',
-                'keywords-match': 'Keyword Match',
-                'fuzzy-similarity': 'Fuzzy Text Similarity',
-                'brand-match': 'Brand/Manufacturer Match',
-                'name-partial': 'Partial Name Match', // Legacy fallback
-                'no-match': 'No Match'
-            };
-            
-            html += `
-                <div style="background: #d4edda; padding: 15px; margin: 10px 0; border-radius: 8px; border-left: 4px solid ${confidenceColor};">
-                    <div style="display: flex; justify-content: space-between; align-items: center; margin-bottom: 10px;">
-                        <strong style="font-size: 1.1em;">Match ${index + 1}</strong>
-                        <span style="background: ${confidenceColor}; color: white; padding: 3px 8px; border-radius: 12px; font-size: 0.8em; font-weight: bold;">
-                            ${match.confidence.toUpperCase()} CONFIDENCE
-                        </span>
-                    </div>
-                    <p style="margin: 5px 0;">
-                        <strong>Strategy:</strong> ${matchTypeLabels[match.matchType] || match.matchType}
-                        ${match.score ? `<span style="color: #6c757d; font-size: 0.9em;"> (Score: ${Math.round(match.score)}/100)</span>` : ''}
-                    </p>
-                    <div style="display: grid; grid-template-columns: 1fr 1fr; gap: 15px; margin-top: 10px;">
-                        <div style="background: #f8f9fa; padding: 10px; border-radius: 5px;">
-                            <strong style="color: #495057;">🔧 Native System API</strong><br>
-                            <strong>Name:</strong> ${match.native.name}<br>
-                            <strong>ID:</strong> <code style="font-size: 0.8em; background: #e9ecef; padding: 2px 4px; border-radius: 3px;">${match.native.id}</code><br>
-                            <strong>Type:</strong> ${match.native.deviceType} | <strong>Connection:</strong> ${match.native.connectivity}
-                            ${match.native.isDefault ? '<br><span style="color: #ffc107;">🔊 Default Device</span>' : ''}
-                        </div>
-                        <div style="background: #f8f9fa; padding: 10px; border-radius: 5px;">
-                            <strong style="color: #495057;">🌐 Web Audio API</strong><br>
-                            <strong>Label:</strong> ${match.webAudio.label}<br>
-                            <strong>Device ID:</strong> <code style="font-size: 0.8em; background: #e9ecef; padding: 2px 4px; border-radius: 3px;">${match.webAudio.deviceId}</code><br>
-                            <strong>Group ID:</strong> <code style="font-size: 0.8em; background: #e9ecef; padding: 2px 4px; border-radius: 3px;">${match.webAudio.groupId}</code>
-                        </div>
-                    </div>
-                </div>
-            `;
-        });
+    if (!crossRefView) {
+        crossRefView = createCrossRefView(document.getElementById('crossRefContent'));
     }
     
-    // Show unmatched native devices
-    if (unmatchedNative.length > 0) {
-        html += '<h4>⚠️ Unmatched Native Devices</h4>';
-        unmatchedNative.forEach(device => {
-            html += `
-                <div style="background: #fff3cd; padding: 10px; margin: 5px 0; border-radius: 5px;">
-                    <strong>${device.name}</strong><br>
-                    ID: ${device.id}<br>
-                    Type: ${device.deviceType} | Connectivity: ${device.connectivity}
-                </div>
-            `;
-        });
-    }
+    const f = crossRefView.summary.fields;
+    const nativeTotal = crossRefResult.nativeDevices.length;
+    setText(f.platform, crossRefResult.platform);
+    setText(f.source, crossRefResult.source);
+    setText(f.nativeTotal, nativeTotal);
+    setText(f.webTotal, matches.length + unmatchedWeb.length);
+    setText(f.matched, matches.length);
+    setText(f.unmatchedNative, unmatchedNative.length);
+    setText(f.unmatchedWeb, unmatchedWeb.length);
+    setText(f.matchRate, nativeTotal > 0 ? Math.round((matches.length / nativeTotal) * 100) : 0);
     
-    // Show unmatched web audio devices
-    if (unmatchedWeb.length > 0) {
-        html += '<h4>⚠️ Unmatched Web Audio Devices</h4>';
-        unmatchedWeb.forEach(device => {
-            html += `
-                <div style="background: #f8d7da; padding: 10px; margin: 5px 0; border-radius: 5px;">
-                    <strong>${device.label || 'Unknown Device'}</strong><br>
-                    ID: ${device.deviceId}<br>
-                    Group ID: ${device.groupId}
-                </div>
-            `;
-        });
-    }
+    // Sort matches by confidence level
+    const sortedMatches = matches.sort((a, b) => confidenceOrder[b.confidence] - confidenceOrder[a.confidence]);
     
-    content.innerHTML = html;
+    setShown(crossRefView.matches.section, sortedMatches.length > 0);
+    setShown(crossRefView.unmatchedNative.section, unmatchedNative.length > 0);
+    setShown(crossRefView.unmatchedWeb.section, unmatchedWeb.length > 0);
+    crossRefView.matches.list.setItems(sortedMatches);
+    crossRefView.unmatchedNative.list.setItems(unmatchedNative);
+    crossRefView.unmatchedWeb.list.setItems(unmatchedWeb);
 }
 
 // Add cross-reference button to the UI
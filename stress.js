@@ -0,0 +1,96 @@
+// Stress harness for the device list: fills it with synthetic devices
+// whose rows differ in height, scrolls it end to end one step per frame,
+// then refreshes it with a tenth of the devices changed. Reports frame
+// times, how many rows were live and whether any placed rows overlapped.
+// Loaded after renderer.js by stress.html only; open it, or call
+// runListStress(count) from its console.
+function syntheticDevices(count, generation = 0) {
+    const types = ['speakers', 'headphones', 'hdmi', 'usb', 'bluetooth'];
+    const connections = ['built-in', 'wired', 'wireless'];
+    const devices = new Array(count);
+    for (let i = 0; i < count; i++) {
+        const changed = generation > 0 && i % 10 === 0;
+        const card = Math.floor(i / 8);
+        devices[i] = {
+            id: `hw:${card},${i % 8}`,
+            name: `Card ${card} - PCM ${i % 8}${changed ? ' (renamed)' : ''}`,
+            deviceType: types[i % types.length],
+            connectivity: connections[i % connections.length],
+            source: 'native-c',
+            isDefault: (i % 97 === 0) !== changed,
+            driver: i % 3 === 0 ? 'snd_hda_intel' : 'snd_usb_audio',
+            // Empty, one line, or long enough to wrap
+            description: i % 4 === 0 ? '' : 'Analog output with jack sensing '.repeat(1 + (i % 7))
+        };
+    }
+    return devices;
+}
+
+function nextFrame() {
+    return new Promise(resolve => requestAnimationFrame(resolve));
+}
+
+function percentile(sorted, fraction) {
+    return sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * fraction))] : 0;
+}
+
+// Rows in the DOM placed on top of one another
+function countOverlaps(view) {
+    const placed = [];
+    view.rows.forEach(row => placed.push({ top: parseFloat(row.style.top), height: row.offsetHeight }));
+    placed.sort((a, b) => a.top - b.top);
+    let overlaps = 0;
+    for (let i = 1; i < placed.length; i++) {
+        if (placed[i - 1].top + placed[i - 1].height > placed[i].top + 0.5) {
+            overlaps++;
+        }
+    }
+    return overlaps;
+}
+
+async function runListStress(count = 5000, steps = 300) {
+    displayOutputDevices(syntheticDevices(count), 'linux', 'native-c');
+    await nextFrame();
+    await nextFrame();
+    
+    const view = outputDeviceView;
+    const viewport = view.viewport;
+    const frameTimes = [];
+    let liveRows = 0;
+    let overlaps = 0;
+    let previous = performance.now();
+    for (let step = 0; step <= steps; step++) {
+        viewport.scrollTop = (viewport.scrollHeight - viewport.clientHeight) * step / steps;
+        await nextFrame();
+        const now = performance.now();
+        frameTimes.push(now - previous);
+        previous = now;
+        liveRows = Math.max(liveRows, view.rows.size);
+        overlaps += countOverlaps(view);
+    }
+    
+    const refreshStart = performance.now();
+    displayOutputDevices(syntheticDevices(count, 1), 'linux', 'native-c');
+    await nextFrame();
+    const refreshMs = performance.now() - refreshStart;
+    
+    frameTimes.sort((a, b) => a - b);
+    const result = {
+        devices: count,
+        frames: frameTimes.length,
+        medianFrameMs: percentile(frameTimes, 0.5),
+        p95FrameMs: percentile(frameTimes, 0.95),
+        maxFrameMs: frameTimes[frameTimes.length - 1],
+        maxLiveRows: liveRows,
+        domRows: view.spacer.childElementCount,
+        measuredRows: view.heights.size,
+        overlaps,
+        refreshMs
+    };
+    console.log('List stress:', result);
+    updateStatus(`Stress: ${count} devices, p95 frame ${result.p95FrameMs.toFixed(1)} ms, ` +
+        `${liveRows} live rows, ${overlaps} overlaps`, overlaps === 0 ? 'success' : 'error');
+    return result;
+}
+
+window.runListStress = runListStress;